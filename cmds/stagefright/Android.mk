@@ -165,3 +165,126 @@ LOCAL_MODULE:= codec
 
 include $(BUILD_EXECUTABLE)
 
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+        seekbench.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	libstagefright liblog libutils libbinder libstagefright_foundation
+
+LOCAL_C_INCLUDES:= \
+	frameworks/av/media/libstagefright \
+	$(TOP)/frameworks/native/include/media/openmax
+
+LOCAL_CFLAGS += -Wno-multichar
+
+LOCAL_MODULE_TAGS := debug
+
+LOCAL_MODULE:= seekbench
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+        colorconvbench.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	libstagefright liblog libutils libstagefright_foundation
+
+LOCAL_C_INCLUDES:= \
+	frameworks/av/media/libstagefright \
+	$(TOP)/frameworks/native/include/media/openmax
+
+LOCAL_CFLAGS += -Wno-multichar
+
+LOCAL_MODULE_TAGS := debug
+
+LOCAL_MODULE:= colorconvbench
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+        startcodebench.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	libstagefright liblog libutils libstagefright_foundation
+
+LOCAL_C_INCLUDES:= \
+	frameworks/av/media/libstagefright \
+	$(TOP)/frameworks/native/include/media/openmax
+
+LOCAL_CFLAGS += -Wno-multichar
+
+LOCAL_MODULE_TAGS := debug
+
+LOCAL_MODULE:= startcodebench
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+        soundpoolbench.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	libmedia liblog libutils libbinder
+
+LOCAL_MODULE_TAGS := debug
+
+LOCAL_MODULE:= soundpoolbench
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+        omxbatchbench.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	libstagefright libmedia liblog libutils libbinder libcutils \
+	libstagefright_foundation
+
+LOCAL_C_INCLUDES:= \
+	frameworks/av/media/libstagefright \
+	$(TOP)/frameworks/native/include/media/openmax
+
+LOCAL_CFLAGS += -Wno-multichar
+
+LOCAL_MODULE_TAGS := debug
+
+LOCAL_MODULE:= omxbatchbench
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+        timedeventqueuebench.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	libstagefright liblog libutils libstagefright_foundation
+
+LOCAL_C_INCLUDES:= \
+	frameworks/av/media/libstagefright
+
+LOCAL_MODULE_TAGS := debug
+
+LOCAL_MODULE:= timedeventqueuebench
+
+include $(BUILD_EXECUTABLE)
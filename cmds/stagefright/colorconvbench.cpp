@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "colorconvbench"
+#include <utils/Log.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/ColorConverter.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-w width] [-h height] [-n iterations] "
+                    "[-t maxThreads]\n"
+                    "\t\treports color conversion throughput to RGB565 "
+                    "per source format\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+static const struct {
+    OMX_COLOR_FORMATTYPE mFormat;
+    const char *mName;
+} kFormats[] = {
+    { OMX_COLOR_FormatYUV420Planar, "YUV420Planar" },
+    { OMX_COLOR_FormatYUV420SemiPlanar, "YUV420SemiPlanar" },
+    { OMX_QCOM_COLOR_FormatYVU420SemiPlanar, "QCOMYVU420SemiPlanar" },
+    { OMX_TI_COLOR_FormatYUV420PackedSemiPlanar, "TIYUV420PackedSemiPlanar" },
+};
+
+static double runConversion(
+        ColorConverter *converter, size_t maxThreads,
+        const uint8_t *src, uint16_t *dst,
+        size_t width, size_t height, int iterations) {
+    converter->setMaxThreads(maxThreads);
+
+    int64_t startUs = ALooper::GetNowUs();
+    for (int i = 0; i < iterations; ++i) {
+        CHECK_EQ(converter->convert(
+                    src, width, height, 0, 0, width - 1, height - 1,
+                    dst, width, height, 0, 0, width - 1, height - 1),
+                 (status_t)OK);
+    }
+    int64_t delayUs = ALooper::GetNowUs() - startUs;
+
+    return (double)width * height * iterations / delayUs;
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    size_t width = 1920;
+    size_t height = 1080;
+    int iterations = 100;
+    size_t maxThreads = 0;
+
+    int res;
+    while ((res = getopt(argc, argv, "w:h:n:t:")) >= 0) {
+        switch (res) {
+            case 'w':
+                width = atoi(optarg);
+                break;
+            case 'h':
+                height = atoi(optarg);
+                break;
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            case 't':
+                maxThreads = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                break;
+        }
+    }
+
+    if (width < 2 || height < 2 || (width & 1) || (height & 1)
+            || iterations < 1) {
+        usage(argv[0]);
+    }
+
+    size_t srcSize = width * height * 3 / 2;
+    uint8_t *src = new uint8_t[srcSize];
+    for (size_t i = 0; i < srcSize; ++i) {
+        src[i] = rand() & 0xff;
+    }
+
+    uint16_t *dst = new uint16_t[width * height];
+    uint16_t *reference = new uint16_t[width * height];
+
+    printf("%dx%d, %d iterations, ", width, height, iterations);
+    if (maxThreads == 0) {
+        printf("multithreaded runs use the default thread count\n");
+    } else {
+        printf("multithreaded runs use up to %d threads\n", maxThreads);
+    }
+
+    for (size_t i = 0; i < sizeof(kFormats) / sizeof(kFormats[0]); ++i) {
+        ColorConverter converter(
+                kFormats[i].mFormat, OMX_COLOR_Format16bitRGB565);
+        CHECK(converter.isValid());
+
+        double single = runConversion(
+                &converter, 1, src, reference, width, height, iterations);
+
+        double multi = runConversion(
+                &converter, maxThreads, src, dst, width, height, iterations);
+
+        // Splitting the frame into row bands must not change the output.
+        CHECK(!memcmp(dst, reference, width * height * sizeof(uint16_t)));
+
+        printf("%-26s %8.1f MPixel/s single, %8.1f MPixel/s multithreaded\n",
+               kFormats[i].mName, single, multi);
+    }
+
+    delete[] reference;
+    delete[] dst;
+    delete[] src;
+
+    return 0;
+}
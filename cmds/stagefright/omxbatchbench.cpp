@@ -0,0 +1,388 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "omxbatchbench"
+#include <utils/Log.h>
+
+#include <binder/IServiceManager.h>
+#include <binder/ProcessState.h>
+#include <cutils/atomic.h>
+#include <cutils/properties.h>
+#include <media/IMediaPlayerService.h>
+#include <media/IOMX.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MediaExtractor.h>
+#include <media/stagefright/MetaData.h>
+#include <media/stagefright/OMXCodec.h>
+#include <utils/Timers.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s file\n"
+                    "\t\tdecodes the audio track of the file with a software "
+                    "codec in the media server, once with and once without "
+                    "batching, and counts the binder transactions spent on "
+                    "buffer traffic\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+struct Counters {
+    Counters() {
+        memset(this, 0, sizeof(*this));
+    }
+
+    volatile int32_t mFillBufferCalls;
+    volatile int32_t mEmptyBufferCalls;
+    volatile int32_t mSubmitBuffersCalls;
+    volatile int32_t mSubmittedCommands;
+    volatile int32_t mOnMessageCalls;
+    volatile int32_t mOnMessagesCalls;
+    volatile int32_t mDeliveredMessages;
+};
+
+// Passes the messages on to the codec's observer, counting them.
+struct CountingObserver : public BnOMXObserver {
+    CountingObserver(const sp<IOMXObserver> &observer, Counters *counters)
+        : mObserver(observer),
+          mCounters(counters) {
+    }
+
+    virtual void onMessage(const omx_message &msg) {
+        android_atomic_inc(&mCounters->mOnMessageCalls);
+        android_atomic_inc(&mCounters->mDeliveredMessages);
+        mObserver->onMessage(msg);
+    }
+
+    virtual void onMessages(const List<omx_message> &messages) {
+        android_atomic_inc(&mCounters->mOnMessagesCalls);
+        android_atomic_add(messages.size(), &mCounters->mDeliveredMessages);
+        mObserver->onMessages(messages);
+    }
+
+private:
+    sp<IOMXObserver> mObserver;
+    Counters *mCounters;
+
+    DISALLOW_EVIL_CONSTRUCTORS(CountingObserver);
+};
+
+// Forwards every call to the media server's IOMX, counting the buffer
+// traffic. OMXClient would run the software codecs in this process, which
+// wouldn't exercise binder at all.
+struct CountingOMX : public BnOMX {
+    CountingOMX(const sp<IOMX> &omx, Counters *counters)
+        : mOMX(omx),
+          mCounters(counters) {
+    }
+
+    virtual bool livesLocally(node_id node, pid_t pid) {
+        return mOMX->livesLocally(node, pid);
+    }
+
+    virtual status_t listNodes(List<ComponentInfo> *list) {
+        return mOMX->listNodes(list);
+    }
+
+    virtual status_t allocateNode(
+            const char *name, const sp<IOMXObserver> &observer,
+            node_id *node) {
+        return mOMX->allocateNode(
+                name, new CountingObserver(observer, mCounters), node);
+    }
+
+    virtual status_t freeNode(node_id node) {
+        return mOMX->freeNode(node);
+    }
+
+    virtual status_t sendCommand(
+            node_id node, OMX_COMMANDTYPE cmd, OMX_S32 param) {
+        return mOMX->sendCommand(node, cmd, param);
+    }
+
+    virtual status_t getParameter(
+            node_id node, OMX_INDEXTYPE index,
+            void *params, size_t size) {
+        return mOMX->getParameter(node, index, params, size);
+    }
+
+    virtual status_t setParameter(
+            node_id node, OMX_INDEXTYPE index,
+            const void *params, size_t size) {
+        return mOMX->setParameter(node, index, params, size);
+    }
+
+    virtual status_t getConfig(
+            node_id node, OMX_INDEXTYPE index,
+            void *params, size_t size) {
+        return mOMX->getConfig(node, index, params, size);
+    }
+
+    virtual status_t setConfig(
+            node_id node, OMX_INDEXTYPE index,
+            const void *params, size_t size) {
+        return mOMX->setConfig(node, index, params, size);
+    }
+
+    virtual status_t getState(
+            node_id node, OMX_STATETYPE* state) {
+        return mOMX->getState(node, state);
+    }
+
+    virtual status_t storeMetaDataInBuffers(
+            node_id node, OMX_U32 port_index, OMX_BOOL enable) {
+        return mOMX->storeMetaDataInBuffers(node, port_index, enable);
+    }
+
+    virtual status_t enableGraphicBuffers(
+            node_id node, OMX_U32 port_index, OMX_BOOL enable) {
+        return mOMX->enableGraphicBuffers(node, port_index, enable);
+    }
+
+    virtual status_t getGraphicBufferUsage(
+            node_id node, OMX_U32 port_index, OMX_U32* usage) {
+        return mOMX->getGraphicBufferUsage(node, port_index, usage);
+    }
+
+    virtual status_t useBuffer(
+            node_id node, OMX_U32 port_index, const sp<IMemory> &params,
+            buffer_id *buffer) {
+        return mOMX->useBuffer(node, port_index, params, buffer);
+    }
+
+    virtual status_t useGraphicBuffer(
+            node_id node, OMX_U32 port_index,
+            const sp<GraphicBuffer> &graphicBuffer, buffer_id *buffer) {
+        return mOMX->useGraphicBuffer(node, port_index, graphicBuffer, buffer);
+    }
+
+    virtual status_t allocateBuffer(
+            node_id node, OMX_U32 port_index, size_t size,
+            buffer_id *buffer, void **buffer_data) {
+        return mOMX->allocateBuffer(
+                node, port_index, size, buffer, buffer_data);
+    }
+
+    virtual status_t allocateBufferWithBackup(
+            node_id node, OMX_U32 port_index, const sp<IMemory> &params,
+            buffer_id *buffer) {
+        return mOMX->allocateBufferWithBackup(node, port_index, params, buffer);
+    }
+
+    virtual status_t freeBuffer(
+            node_id node, OMX_U32 port_index, buffer_id buffer) {
+        return mOMX->freeBuffer(node, port_index, buffer);
+    }
+
+    virtual status_t fillBuffer(node_id node, buffer_id buffer) {
+        android_atomic_inc(&mCounters->mFillBufferCalls);
+        return mOMX->fillBuffer(node, buffer);
+    }
+
+    virtual status_t emptyBuffer(
+            node_id node,
+            buffer_id buffer,
+            OMX_U32 range_offset, OMX_U32 range_length,
+            OMX_U32 flags, OMX_TICKS timestamp) {
+        android_atomic_inc(&mCounters->mEmptyBufferCalls);
+        return mOMX->emptyBuffer(
+                node, buffer, range_offset, range_length, flags, timestamp);
+    }
+
+    virtual status_t getExtensionIndex(
+            node_id node,
+            const char *parameter_name,
+            OMX_INDEXTYPE *index) {
+        return mOMX->getExtensionIndex(node, parameter_name, index);
+    }
+
+    virtual status_t submitBuffers(
+            node_id node, const Vector<BufferCommand> &commands) {
+        android_atomic_inc(&mCounters->mSubmitBuffersCalls);
+        android_atomic_add(commands.size(), &mCounters->mSubmittedCommands);
+        return mOMX->submitBuffers(node, commands);
+    }
+
+private:
+    sp<IOMX> mOMX;
+    Counters *mCounters;
+
+    DISALLOW_EVIL_CONSTRUCTORS(CountingOMX);
+};
+
+static sp<MediaSource> findAudioTrack(const char *path) {
+    sp<DataSource> dataSource = DataSource::CreateFromURI(path);
+    if (dataSource == NULL) {
+        fprintf(stderr, "unable to create data source for %s\n", path);
+        return NULL;
+    }
+
+    sp<MediaExtractor> extractor = MediaExtractor::Create(dataSource);
+    if (extractor == NULL) {
+        fprintf(stderr, "could not create extractor for %s\n", path);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < extractor->countTracks(); ++i) {
+        sp<MetaData> meta = extractor->getTrackMetaData(i);
+
+        const char *mime;
+        CHECK(meta->findCString(kKeyMIMEType, &mime));
+
+        if (!strncasecmp(mime, "audio/", 6)) {
+            return extractor->getTrack(i);
+        }
+    }
+
+    fprintf(stderr, "no audio track in %s\n", path);
+    return NULL;
+}
+
+static const char *kBatchingProperty = "debug.stagefright.omx-batching";
+
+// Decodes the file with batching switched on or off, both in this process
+// and in the media server, which reads the property when the node is
+// allocated.
+static void decode(const sp<IOMX> &omx, const char *path, bool batching) {
+    sp<MediaSource> source = findAudioTrack(path);
+    if (source == NULL) {
+        exit(1);
+    }
+
+    if (property_set(kBatchingProperty, batching ? "1" : "0") != 0) {
+        fprintf(stderr, "unable to set %s\n", kBatchingProperty);
+        exit(1);
+    }
+
+    Counters counters;
+    sp<IOMX> countingOMX = new CountingOMX(omx, &counters);
+
+    sp<MediaSource> decoder = OMXCodec::Create(
+            countingOMX, source->getFormat(), false /* createEncoder */,
+            source, NULL /* matchComponentName */,
+            OMXCodec::kSoftwareCodecsOnly);
+    if (decoder == NULL) {
+        fprintf(stderr, "no software decoder for %s\n", path);
+        exit(1);
+    }
+
+    CHECK_EQ(decoder->start(), (status_t)OK);
+
+    sp<MetaData> format = decoder->getFormat();
+    int32_t sampleRate, numChannels;
+    CHECK(format->findInt32(kKeySampleRate, &sampleRate));
+    CHECK(format->findInt32(kKeyChannelCount, &numChannels));
+
+    int64_t numBytes = 0;
+    nsecs_t start = systemTime();
+
+    for (;;) {
+        MediaBuffer *buffer;
+        status_t err = decoder->read(&buffer);
+
+        if (err == INFO_FORMAT_CHANGED) {
+            format = decoder->getFormat();
+            CHECK(format->findInt32(kKeySampleRate, &sampleRate));
+            CHECK(format->findInt32(kKeyChannelCount, &numChannels));
+            continue;
+        } else if (err != OK) {
+            break;
+        }
+
+        numBytes += buffer->range_length();
+        buffer->release();
+    }
+
+    nsecs_t elapsed = systemTime() - start;
+
+    CHECK_EQ(decoder->stop(), (status_t)OK);
+
+    double seconds =
+        (double)numBytes / (2 * numChannels) / sampleRate;
+    if (seconds <= 0) {
+        fprintf(stderr, "nothing was decoded\n");
+        exit(1);
+    }
+
+    int32_t transactions =
+        counters.mFillBufferCalls + counters.mEmptyBufferCalls
+            + counters.mSubmitBuffersCalls
+            + counters.mOnMessageCalls + counters.mOnMessagesCalls;
+
+    printf("%s:\n", batching ? "batched" : "unbatched");
+
+    printf("  decoded %.2f secs of audio in %.2f ms\n",
+           seconds, elapsed / 1E6);
+
+    printf("  submitted %d commands in %d single calls and %d batches\n",
+           counters.mFillBufferCalls + counters.mEmptyBufferCalls
+                + counters.mSubmittedCommands,
+           counters.mFillBufferCalls + counters.mEmptyBufferCalls,
+           counters.mSubmitBuffersCalls);
+
+    printf("  received %d messages in %d single and %d batched callbacks\n",
+           counters.mDeliveredMessages,
+           counters.mOnMessageCalls,
+           counters.mOnMessagesCalls);
+
+    printf("  transactions per second of audio: %.1f\n",
+           transactions / seconds);
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    if (argc != 2) {
+        usage(argv[0]);
+    }
+
+    ProcessState::self()->startThreadPool();
+
+    DataSource::RegisterDefaultSniffers();
+
+    sp<IServiceManager> sm = defaultServiceManager();
+    sp<IBinder> binder = sm->getService(String16("media.player"));
+    sp<IMediaPlayerService> service =
+        interface_cast<IMediaPlayerService>(binder);
+
+    CHECK(service.get() != NULL);
+
+    sp<IOMX> omx = service->getOMX();
+    CHECK(omx.get() != NULL);
+
+    char value[PROPERTY_VALUE_MAX];
+    property_get(kBatchingProperty, value, "");
+
+    decode(omx, argv[1], false /* batching */);
+    decode(omx, argv[1], true /* batching */);
+
+    property_set(kBatchingProperty, value);
+
+    return 0;
+}
@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "seekbench"
+#include <utils/Log.h>
+
+#include "include/SampleTable.h"
+
+#include <binder/ProcessState.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/FileSource.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaExtractor.h>
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/MetaData.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-n numSeeks] [-l readLatencyUs] file.mp4\n"
+                    "\t\tcompares seek latency with and without the "
+                    "in-memory sample index\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+// Adds a fixed latency to every read to emulate a network backed source
+// and counts the reads issued.
+struct LatencySource : public DataSource {
+    LatencySource(const sp<DataSource> &source, int64_t latencyUs)
+        : mSource(source),
+          mLatencyUs(latencyUs),
+          mNumReads(0) {
+    }
+
+    virtual status_t initCheck() const {
+        return mSource->initCheck();
+    }
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size) {
+        ++mNumReads;
+        if (mLatencyUs > 0) {
+            usleep(mLatencyUs);
+        }
+        return mSource->readAt(offset, data, size);
+    }
+
+    virtual status_t getSize(off64_t *size) {
+        return mSource->getSize(size);
+    }
+
+    int64_t numReads() const { return mNumReads; }
+
+private:
+    sp<DataSource> mSource;
+    int64_t mLatencyUs;
+    int64_t mNumReads;
+
+    DISALLOW_EVIL_CONSTRUCTORS(LatencySource);
+};
+
+static void runBenchmark(
+        const char *path, size_t indexBudget, int numSeeks,
+        int64_t latencyUs) {
+    SampleTable::SetIndexMemoryBudget(indexBudget);
+
+    sp<LatencySource> source =
+        new LatencySource(new FileSource(path), latencyUs);
+    CHECK_EQ(source->initCheck(), (status_t)OK);
+
+    int64_t startUs = ALooper::GetNowUs();
+
+    sp<MediaExtractor> extractor =
+        MediaExtractor::Create(source, MEDIA_MIMETYPE_CONTAINER_MPEG4);
+    CHECK(extractor != NULL);
+
+    // Prefer the video track, seeking is dominated by its tables.
+    size_t trackIndex = 0;
+    for (size_t i = 0; i < extractor->countTracks(); ++i) {
+        const char *mime;
+        CHECK(extractor->getTrackMetaData(i)->findCString(
+                    kKeyMIMEType, &mime));
+
+        if (!strncasecmp(mime, "video/", 6)) {
+            trackIndex = i;
+            break;
+        }
+    }
+
+    sp<MediaSource> track = extractor->getTrack(trackIndex);
+    CHECK(track != NULL);
+
+    int64_t durationUs;
+    CHECK(track->getFormat()->findInt64(kKeyDuration, &durationUs));
+
+    CHECK_EQ(track->start(), (status_t)OK);
+
+    int64_t openUs = ALooper::GetNowUs() - startUs;
+    int64_t openReads = source->numReads();
+
+    srand(1);
+
+    int64_t totalUs = 0;
+    int64_t maxUs = 0;
+    for (int i = 0; i < numSeeks; ++i) {
+        MediaSource::ReadOptions options;
+        options.setSeekTo((int64_t)((double)rand() / RAND_MAX * durationUs));
+
+        int64_t seekStartUs = ALooper::GetNowUs();
+
+        MediaBuffer *buffer;
+        status_t err = track->read(&buffer, &options);
+
+        int64_t seekUs = ALooper::GetNowUs() - seekStartUs;
+
+        if (err == OK) {
+            buffer->release();
+            buffer = NULL;
+        }
+
+        totalUs += seekUs;
+        if (seekUs > maxUs) {
+            maxUs = seekUs;
+        }
+    }
+
+    track->stop();
+
+    printf("index budget %d bytes: open %.2f ms (%lld reads), "
+           "seek avg %.2f ms max %.2f ms (%.1f reads/seek)\n",
+           indexBudget,
+           openUs / 1E3,
+           openReads,
+           numSeeks > 0 ? totalUs / 1E3 / numSeeks : 0.0,
+           maxUs / 1E3,
+           numSeeks > 0
+                ? (double)(source->numReads() - openReads) / numSeeks : 0.0);
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+
+    int numSeeks = 100;
+    int64_t latencyUs = 0;
+
+    int res;
+    while ((res = getopt(argc, argv, "hn:l:")) >= 0) {
+        switch (res) {
+            case 'n':
+            {
+                numSeeks = atoi(optarg);
+                break;
+            }
+
+            case 'l':
+            {
+                latencyUs = atoll(optarg);
+                break;
+            }
+
+            case '?':
+            case 'h':
+            default:
+            {
+                usage(me);
+            }
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc != 1) {
+        usage(me);
+    }
+
+    ProcessState::self()->startThreadPool();
+
+    DataSource::RegisterDefaultSniffers();
+
+    runBenchmark(argv[0], 0, numSeeks, latencyUs);
+    runBenchmark(argv[0], 2 * 1024 * 1024, numSeeks, latencyUs);
+
+    return 0;
+}
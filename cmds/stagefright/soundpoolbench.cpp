@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "soundpoolbench"
+#include <utils/Log.h>
+
+#include <binder/ProcessState.h>
+#include <media/mediaplayer.h>
+#include <media/SoundPool.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-c cacheDir] file...\n"
+                    "\t\tcompares the time to decode the files one after the "
+                    "other with SoundPool loads, cold and from the cache\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+struct LoadWaiter {
+    LoadWaiter() : mNumLoaded(0), mNumFailed(0) {}
+
+    static void callback(SoundPoolEvent event, SoundPool *, void *user) {
+        LoadWaiter *waiter = static_cast<LoadWaiter *>(user);
+        if (event.mMsg != SoundPoolEvent::SAMPLE_LOADED) {
+            return;
+        }
+
+        Mutex::Autolock autoLock(waiter->mLock);
+        ++waiter->mNumLoaded;
+        if (event.mArg2 != 0) {
+            ++waiter->mNumFailed;
+        }
+        waiter->mCondition.signal();
+    }
+
+    int waitFor(int count) {
+        Mutex::Autolock autoLock(mLock);
+        while (mNumLoaded < count) {
+            mCondition.wait(mLock);
+        }
+        return mNumFailed;
+    }
+
+private:
+    Mutex mLock;
+    Condition mCondition;
+    int mNumLoaded;
+    int mNumFailed;
+};
+
+static void decodeSerially(int numFiles, char **files) {
+    nsecs_t start = systemTime();
+    size_t totalBytes = 0;
+
+    for (int i = 0; i < numFiles; ++i) {
+        int fd = open(files[i], O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            fprintf(stderr, "can't open %s\n", files[i]);
+            exit(1);
+        }
+
+        uint32_t sampleRate;
+        int numChannels;
+        audio_format_t format;
+        sp<IMemory> data = MediaPlayer::decode(
+                fd, 0, st.st_size, &sampleRate, &numChannels, &format);
+        close(fd);
+
+        if (data == NULL) {
+            fprintf(stderr, "can't decode %s\n", files[i]);
+            exit(1);
+        }
+        totalBytes += data->size();
+    }
+
+    printf("serial decode:    %8.2f ms (%d files, %d KB of PCM)\n",
+           (systemTime() - start) / 1E6, numFiles, (int)(totalBytes / 1024));
+}
+
+static void loadWithSoundPool(
+        const char *name, int numFiles, char **files, const char *cacheDir) {
+    SoundPool soundPool(1, AUDIO_STREAM_MUSIC, 0);
+    LoadWaiter waiter;
+    soundPool.setCallback(LoadWaiter::callback, &waiter);
+    if (cacheDir != NULL) {
+        soundPool.setCacheDirectory(cacheDir);
+    }
+
+    nsecs_t start = systemTime();
+
+    for (int i = 0; i < numFiles; ++i) {
+        int fd = open(files[i], O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            fprintf(stderr, "can't open %s\n", files[i]);
+            exit(1);
+        }
+        // the sample keeps its own descriptor
+        soundPool.load(fd, 0, st.st_size, 1);
+        close(fd);
+    }
+
+    int numFailed = waiter.waitFor(numFiles);
+
+    printf("%-17s %8.2f ms (%d failed)\n",
+           name, (systemTime() - start) / 1E6, numFailed);
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+    const char *cacheDir = NULL;
+
+    int res;
+    while ((res = getopt(argc, argv, "hc:")) >= 0) {
+        switch (res) {
+            case 'c':
+            {
+                cacheDir = optarg;
+                break;
+            }
+
+            case '?':
+            case 'h':
+            default:
+            {
+                usage(me);
+            }
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc < 1) {
+        usage(me);
+    }
+
+    ProcessState::self()->startThreadPool();
+
+    decodeSerially(argc, argv);
+    loadWithSoundPool("soundpool:", argc, argv, NULL);
+
+    if (cacheDir != NULL) {
+        // the first pass fills the cache, the second one maps it
+        loadWithSoundPool("soundpool cold:", argc, argv, cacheDir);
+        loadWithSoundPool("soundpool cached:", argc, argv, cacheDir);
+    }
+
+    return 0;
+}
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "startcodebench"
+#include <utils/Log.h>
+
+#include "include/avc_utils.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-b Mbps] [-f fps] [-s seconds] "
+                    "[-n iterations]\n"
+                    "\t\treports startcode scanning throughput on a "
+                    "synthetic H.264 byte stream\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+// Builds an Annex B stream with one slice NAL unit per frame at the given
+// bitrate, the payload is random but free of startcode emulation.
+static size_t makeStream(
+        uint8_t *data, size_t size, size_t frameSize, size_t *numNALUnits) {
+    size_t offset = 0;
+    *numNALUnits = 0;
+
+    while (offset + 5 + frameSize < size) {
+        memcpy(&data[offset], "\x00\x00\x00\x01\x41", 5);
+        offset += 5;
+        ++*numNALUnits;
+
+        size_t zeroes = 0;
+        for (size_t i = 0; i < frameSize; ++i) {
+            uint8_t byte = rand() & 0xff;
+            if ((rand() & 7) == 0) {
+                byte = 0x00;
+            }
+
+            if (zeroes >= 2 && byte <= 0x03) {
+                data[offset++] = 0x03;
+                zeroes = 0;
+            }
+
+            data[offset++] = byte;
+            zeroes = (byte == 0x00) ? zeroes + 1 : 0;
+        }
+
+        // A slice never ends in 0x00.
+        data[offset++] = 0x80;
+    }
+
+    return offset;
+}
+
+static size_t scanBytewise(const uint8_t *data, size_t size) {
+    size_t count = 0;
+    for (size_t i = 0; i + 2 < size; ++i) {
+        if (!memcmp("\x00\x00\x01", &data[i], 3)) {
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+static size_t scanFindStartCode(const uint8_t *data, size_t size) {
+    size_t count = 0;
+    size_t offset = 0;
+    for (;;) {
+        ssize_t pos = FindStartCode(&data[offset], size - offset);
+        if (pos < 0) {
+            break;
+        }
+
+        ++count;
+        offset += pos + 3;
+    }
+
+    return count;
+}
+
+static size_t scanNALUnits(const uint8_t *data, size_t size) {
+    size_t count = 0;
+    const uint8_t *nalStart;
+    size_t nalSize;
+    while (getNextNALUnit(&data, &size, &nalStart, &nalSize, true) == OK) {
+        ++count;
+    }
+
+    return count;
+}
+
+static double measure(
+        size_t (*scan)(const uint8_t *, size_t),
+        const uint8_t *data, size_t size, int iterations,
+        size_t expected) {
+    int64_t startUs = ALooper::GetNowUs();
+    for (int i = 0; i < iterations; ++i) {
+        CHECK_EQ(scan(data, size), expected);
+    }
+    int64_t delayUs = ALooper::GetNowUs() - startUs;
+
+    return (double)size * iterations / delayUs;
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    int bitrateMbps = 8;
+    int fps = 30;
+    int seconds = 60;
+    int iterations = 5;
+
+    int res;
+    while ((res = getopt(argc, argv, "b:f:s:n:")) >= 0) {
+        switch (res) {
+            case 'b':
+                bitrateMbps = atoi(optarg);
+                break;
+            case 'f':
+                fps = atoi(optarg);
+                break;
+            case 's':
+                seconds = atoi(optarg);
+                break;
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                break;
+        }
+    }
+
+    if (bitrateMbps < 1 || fps < 1 || seconds < 1 || iterations < 1) {
+        usage(argv[0]);
+    }
+
+    size_t frameSize = (size_t)bitrateMbps * 1000000 / 8 / fps;
+
+    // Leave room for the emulation prevention bytes.
+    size_t capacity = (frameSize * 3 / 2 + 6) * fps * seconds;
+    uint8_t *data = new uint8_t[capacity];
+
+    size_t numNALUnits;
+    size_t size = makeStream(data, capacity, frameSize, &numNALUnits);
+
+    printf("%d Mbps at %d fps, %d seconds: %d bytes in %d NAL units\n",
+           bitrateMbps, fps, seconds, size, numNALUnits);
+
+#if defined(__ARM_NEON__)
+    printf("FindStartCode uses NEON\n");
+#elif defined(__SSE2__)
+    printf("FindStartCode uses SSE2\n");
+#else
+    printf("FindStartCode is scalar\n");
+#endif
+
+    printf("%-16s %8.1f MB/s\n", "bytewise",
+           measure(scanBytewise, data, size, iterations, numNALUnits));
+
+    printf("%-16s %8.1f MB/s\n", "FindStartCode",
+           measure(scanFindStartCode, data, size, iterations, numNALUnits));
+
+    printf("%-16s %8.1f MB/s\n", "getNextNALUnit",
+           measure(scanNALUnits, data, size, iterations, numNALUnits));
+
+    delete[] data;
+    data = NULL;
+
+    return 0;
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "timedeventqueuebench"
+#include <utils/Log.h>
+
+#include "include/TimedEventQueue.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <utils/List.h>
+#include <utils/Timers.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-n numPending] [-r numReposts]\n"
+                    "\t\tposts, reposts and cancels events with the given "
+                    "number of events pending\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+struct BenchEvent : public TimedEventQueue::Event {
+    BenchEvent()
+        : mDueUs(0),
+          mLatenessUs(-1) {
+    }
+
+    int64_t mDueUs;
+    volatile int64_t mLatenessUs;
+
+protected:
+    virtual void fire(TimedEventQueue *queue, int64_t now_us) {
+        mLatenessUs = ALooper::GetNowUs() - mDueUs;
+    }
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(BenchEvent);
+};
+
+static void report(const char *name, nsecs_t elapsed, int numOps) {
+    printf("%-28s %8.2f ms %8.3f us/op\n",
+           name, elapsed / 1E6, elapsed / 1E3 / numOps);
+}
+
+// The sorted list insertion the queue used to do.
+static void listInsertion(const Vector<int64_t> &times) {
+    List<int64_t> list;
+
+    nsecs_t start = systemTime();
+    for (size_t i = 0; i < times.size(); ++i) {
+        List<int64_t>::iterator it = list.begin();
+        while (it != list.end() && times[i] >= *it) {
+            ++it;
+        }
+        list.insert(it, times[i]);
+    }
+    report("post (sorted list)", systemTime() - start, times.size());
+}
+
+static void run(int numPending, int numReposts) {
+    TimedEventQueue queue;
+    queue.start();
+
+    // All of these are far enough out not to fire during the run.
+    int64_t baseUs = ALooper::GetNowUs() + 60000000ll;
+
+    Vector<int64_t> times;
+    Vector<sp<TimedEventQueue::Event> > events;
+    for (int i = 0; i < numPending; ++i) {
+        times.push(baseUs + (rand() % 10000) * 1000ll);
+        events.push(new BenchEvent);
+    }
+
+    nsecs_t start = systemTime();
+    for (int i = 0; i < numPending; ++i) {
+        queue.postTimedEvent(events[i], times[i]);
+    }
+    report("post", systemTime() - start, numPending);
+
+    listInsertion(times);
+
+    // What AwesomePlayer does with its video event on every frame.
+    start = systemTime();
+    for (int i = 0; i < numReposts; ++i) {
+        const sp<TimedEventQueue::Event> &event =
+            events[rand() % numPending];
+        CHECK(queue.cancelEvent(event));
+        queue.postTimedEvent(event, baseUs + (rand() % 10000) * 1000ll);
+    }
+    report("cancel + repost", systemTime() - start, numReposts);
+
+    int numById = numPending / 4;
+    start = systemTime();
+    for (int i = 0; i < numById; ++i) {
+        CHECK(queue.cancelEvent(events[i]->eventID()));
+    }
+    report("cancel by id", systemTime() - start, numById);
+
+    start = systemTime();
+    for (int i = numById; i < numPending; ++i) {
+        CHECK(queue.cancelEvent(events[i]));
+    }
+    report("cancel by handle", systemTime() - start, numPending - numById);
+
+    // Now let a batch of events fire, close together, and see how late
+    // they are.
+    Vector<sp<BenchEvent> > firing;
+    int64_t nowUs = ALooper::GetNowUs();
+    for (int i = 0; i < numPending; ++i) {
+        sp<BenchEvent> event = new BenchEvent;
+        event->mDueUs = nowUs + 100000ll + (rand() % 500) * 1000ll;
+        queue.postTimedEvent(event, event->mDueUs);
+        firing.push(event);
+    }
+
+    queue.stop(true /* flush */);
+
+    int64_t sumUs = 0;
+    int64_t maxUs = 0;
+    for (size_t i = 0; i < firing.size(); ++i) {
+        int64_t latenessUs = firing[i]->mLatenessUs;
+        CHECK_GE(latenessUs, -(int64_t)1000);
+        sumUs += latenessUs;
+        if (latenessUs > maxUs) {
+            maxUs = latenessUs;
+        }
+    }
+    printf("fired %d events, lateness avg %lld us, max %lld us\n",
+           (int)firing.size(), sumUs / (int64_t)firing.size(), maxUs);
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+    int numPending = 5000;
+    int numReposts = 100000;
+
+    int res;
+    while ((res = getopt(argc, argv, "hn:r:")) >= 0) {
+        switch (res) {
+            case 'n':
+            {
+                numPending = atoi(optarg);
+                break;
+            }
+
+            case 'r':
+            {
+                numReposts = atoi(optarg);
+                break;
+            }
+
+            case '?':
+            case 'h':
+            default:
+            {
+                usage(me);
+            }
+        }
+    }
+
+    if (numPending <= 0 || numReposts < 0) {
+        usage(me);
+    }
+
+    srand(1);
+    run(numPending, numReposts);
+
+    return 0;
+}
@@ -35,6 +35,9 @@
 
 #define INVALID_BUFFER_LENGTH -1
 
+// Upper limit on the number of ranges in a PREAD_BATCH transaction
+#define MAX_READ_RANGES 64
+
 using namespace android;
 
 static void writeDecryptHandleToParcelData(
@@ -797,6 +800,61 @@ ssize_t BpDrmManagerService::pread(
     return result;
 }
 
+status_t BpDrmManagerService::setReadBuffer(
+            int uniqueId, DecryptHandle* decryptHandle, const sp<IMemory>& buffer) {
+    ALOGV("setReadBuffer");
+    Parcel data, reply;
+
+    data.writeInterfaceToken(IDrmManagerService::getInterfaceDescriptor());
+    data.writeInt32(uniqueId);
+
+    writeDecryptHandleToParcelData(decryptHandle, &data);
+
+    if (NULL != buffer.get()) {
+        data.writeInt32(1);
+        data.writeStrongBinder(buffer->asBinder());
+    } else {
+        data.writeInt32(0);
+    }
+
+    status_t status = remote()->transact(SET_READ_BUFFER, data, &reply);
+    if (NO_ERROR != status) {
+        return status;
+    }
+    return reply.readInt32();
+}
+
+status_t BpDrmManagerService::preadBatch(int uniqueId, DecryptHandle* decryptHandle,
+            const Vector<DrmReadRange>& ranges, Vector<ssize_t>* results) {
+    ALOGV("preadBatch");
+    Parcel data, reply;
+
+    data.writeInterfaceToken(IDrmManagerService::getInterfaceDescriptor());
+    data.writeInt32(uniqueId);
+
+    writeDecryptHandleToParcelData(decryptHandle, &data);
+
+    data.writeInt32(ranges.size());
+    for (size_t i = 0; i < ranges.size(); i++) {
+        data.writeInt64(ranges[i].offset);
+        data.writeInt32(ranges[i].numBytes);
+        data.writeInt32(ranges[i].bufferOffset);
+    }
+
+    status_t status = remote()->transact(PREAD_BATCH, data, &reply);
+    if (NO_ERROR != status) {
+        return status;
+    }
+    status = reply.readInt32();
+    if (DRM_NO_ERROR == status) {
+        results->clear();
+        for (size_t i = 0; i < ranges.size(); i++) {
+            results->push(reply.readInt32());
+        }
+    }
+    return status;
+}
+
 IMPLEMENT_META_INTERFACE(DrmManagerService, "drm.IDrmManagerService");
 
 status_t BnDrmManagerService::onTransact(
@@ -1514,6 +1572,67 @@ status_t BnDrmManagerService::onTransact(
         return DRM_NO_ERROR;
     }
 
+    case SET_READ_BUFFER:
+    {
+        ALOGV("BnDrmManagerService::onTransact :SET_READ_BUFFER");
+        CHECK_INTERFACE(IDrmManagerService, data, reply);
+
+        const int uniqueId = data.readInt32();
+
+        DecryptHandle handle;
+        readDecryptHandleFromParcelData(&handle, data);
+
+        sp<IMemory> buffer;
+        if (0 != data.readInt32()) {
+            buffer = interface_cast<IMemory>(data.readStrongBinder());
+        }
+
+        const status_t status = setReadBuffer(uniqueId, &handle, buffer);
+        reply->writeInt32(status);
+
+        clearDecryptHandle(&handle);
+        return DRM_NO_ERROR;
+    }
+
+    case PREAD_BATCH:
+    {
+        ALOGV("BnDrmManagerService::onTransact :PREAD_BATCH");
+        CHECK_INTERFACE(IDrmManagerService, data, reply);
+
+        const int uniqueId = data.readInt32();
+
+        DecryptHandle handle;
+        readDecryptHandleFromParcelData(&handle, data);
+
+        const int count = data.readInt32();
+        if (count < 0 || count > MAX_READ_RANGES) {
+            clearDecryptHandle(&handle);
+            reply->writeInt32(DRM_ERROR_UNKNOWN);
+            return DRM_NO_ERROR;
+        }
+
+        Vector<DrmReadRange> ranges;
+        for (int i = 0; i < count; i++) {
+            DrmReadRange range;
+            range.offset = data.readInt64();
+            range.numBytes = data.readInt32();
+            range.bufferOffset = data.readInt32();
+            ranges.push(range);
+        }
+
+        Vector<ssize_t> results;
+        const status_t status = preadBatch(uniqueId, &handle, ranges, &results);
+        reply->writeInt32(status);
+        if (DRM_NO_ERROR == status) {
+            for (int i = 0; i < count; i++) {
+                reply->writeInt32(results[i]);
+            }
+        }
+
+        clearDecryptHandle(&handle);
+        return DRM_NO_ERROR;
+    }
+
     default:
         return BBinder::onTransact(code, data, reply, flags);
     }
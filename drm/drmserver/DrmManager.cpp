@@ -18,7 +18,9 @@
 #define LOG_TAG "DrmManager(Native)"
 #include "utils/Log.h"
 
+#include <sys/mman.h>
 #include <utils/String8.h>
+#include <binder/IMemory.h>
 #include <drm/DrmInfo.h>
 #include <drm/DrmInfoEvent.h>
 #include <drm/DrmRights.h>
@@ -42,11 +44,12 @@ const String8 DrmManager::EMPTY_STRING("");
 DrmManager::DrmManager() :
     mDecryptSessionId(0),
     mConvertId(0) {
-
+    mReadBufferDeathRecipient = new ReadBufferDeathRecipient(this);
 }
 
 DrmManager::~DrmManager() {
-
+    Mutex::Autolock _l(mDecryptLock);
+    clearReadBuffers_l();
 }
 
 int DrmManager::addUniqueId(bool isNative) {
@@ -127,7 +130,11 @@ status_t DrmManager::loadPlugIns(const String8& plugInDirPath) {
 status_t DrmManager::unloadPlugIns() {
     Mutex::Autolock _l(mLock);
     mConvertSessionMap.clear();
-    mDecryptSessionMap.clear();
+    {
+        Mutex::Autolock _d(mDecryptLock);
+        mDecryptSessionMap.clear();
+        clearReadBuffers_l();
+    }
     mPlugInManager.unloadPlugIns();
     mSupportInfoToPlugInIdMap.clear();
     return DRM_NO_ERROR;
@@ -522,6 +529,7 @@ status_t DrmManager::closeDecryptSession(int uniqueId, DecryptHandle* decryptHan
         result = drmEngine->closeDecryptSession(uniqueId, decryptHandle);
         if (DRM_NO_ERROR == result) {
             mDecryptSessionMap.removeItem(decryptHandle->decryptId);
+            removeReadBuffer_l(decryptHandle->decryptId);
         }
     }
     return result;
@@ -574,6 +582,99 @@ ssize_t DrmManager::pread(int uniqueId, DecryptHandle* decryptHandle,
     return result;
 }
 
+status_t DrmManager::setReadBuffer(
+            int uniqueId, DecryptHandle* decryptHandle, const sp<IMemory>& buffer) {
+    Mutex::Autolock _l(mDecryptLock);
+    if (mDecryptSessionMap.indexOfKey(decryptHandle->decryptId) == NAME_NOT_FOUND) {
+        return DRM_ERROR_SESSION_NOT_OPENED;
+    }
+    if (NULL == buffer.get()) {
+        removeReadBuffer_l(decryptHandle->decryptId);
+        return DRM_NO_ERROR;
+    }
+
+    // The offset and size come from the client, make sure the plug-in can
+    // only ever write inside the heap that was actually mapped.
+    ssize_t memOffset = 0;
+    size_t memSize = 0;
+    sp<IMemoryHeap> heap = buffer->getMemory(&memOffset, &memSize);
+    if (NULL == heap.get() || MAP_FAILED == heap->getBase() ||
+            NULL == heap->getBase() || memOffset < 0 || 0 == memSize) {
+        return DRM_ERROR_UNKNOWN;
+    }
+    const size_t heapSize = heap->getSize();
+    if ((size_t)memOffset > heapSize || memSize > heapSize - (size_t)memOffset) {
+        ALOGE("setReadBuffer: memory [%d, +%d) exceeds heap size %d",
+                (int)memOffset, (int)memSize, (int)heapSize);
+        return DRM_ERROR_UNKNOWN;
+    }
+
+    removeReadBuffer_l(decryptHandle->decryptId);
+    mReadBufferMap.add(decryptHandle->decryptId, buffer);
+    // fails for a buffer from our own process, which can't die before us
+    buffer->asBinder()->linkToDeath(mReadBufferDeathRecipient);
+    return DRM_NO_ERROR;
+}
+
+void DrmManager::ReadBufferDeathRecipient::binderDied(const wp<IBinder>& who) {
+    mDrmManager->onReadBufferDied(who);
+}
+
+void DrmManager::onReadBufferDied(const wp<IBinder>& who) {
+    Mutex::Autolock _l(mDecryptLock);
+    for (size_t i = mReadBufferMap.size(); i > 0; i--) {
+        if (mReadBufferMap.valueAt(i - 1)->asBinder().get() == who.unsafe_get()) {
+            ALOGV("dropping the read buffer of decrypt session %d, its client died",
+                    mReadBufferMap.keyAt(i - 1));
+            mReadBufferMap.removeItemsAt(i - 1);
+        }
+    }
+}
+
+void DrmManager::removeReadBuffer_l(int decryptId) {
+    ssize_t index = mReadBufferMap.indexOfKey(decryptId);
+    if (index >= 0) {
+        mReadBufferMap.valueAt(index)->asBinder()->unlinkToDeath(mReadBufferDeathRecipient);
+        mReadBufferMap.removeItemsAt(index);
+    }
+}
+
+void DrmManager::clearReadBuffers_l() {
+    for (size_t i = 0; i < mReadBufferMap.size(); i++) {
+        mReadBufferMap.valueAt(i)->asBinder()->unlinkToDeath(mReadBufferDeathRecipient);
+    }
+    mReadBufferMap.clear();
+}
+
+status_t DrmManager::preadBatch(int uniqueId, DecryptHandle* decryptHandle,
+            const Vector<DrmReadRange>& ranges, Vector<ssize_t>* results) {
+    Mutex::Autolock _l(mDecryptLock);
+    const int decryptId = decryptHandle->decryptId;
+    if (mDecryptSessionMap.indexOfKey(decryptId) == NAME_NOT_FOUND ||
+            mReadBufferMap.indexOfKey(decryptId) == NAME_NOT_FOUND) {
+        return DRM_ERROR_SESSION_NOT_OPENED;
+    }
+    IDrmEngine* drmEngine = mDecryptSessionMap.valueFor(decryptId);
+    const sp<IMemory>& buffer = mReadBufferMap.valueFor(decryptId);
+    uint8_t* base = static_cast<uint8_t*>(buffer->pointer());
+    const size_t size = buffer->size();
+
+    // The plug-in decrypts straight into the memory shared with the client.
+    results->clear();
+    for (size_t i = 0; i < ranges.size(); i++) {
+        const DrmReadRange& range = ranges[i];
+        ssize_t result = DECRYPT_FILE_ERROR;
+        if (range.numBytes >= 0 && range.bufferOffset >= 0 && range.offset >= 0 &&
+                (size_t)range.bufferOffset <= size &&
+                (size_t)range.numBytes <= size - range.bufferOffset) {
+            result = drmEngine->pread(uniqueId, decryptHandle,
+                    base + range.bufferOffset, range.numBytes, range.offset);
+        }
+        results->push(result);
+    }
+    return DRM_NO_ERROR;
+}
+
 String8 DrmManager::getSupportedPlugInId(
             int uniqueId, const String8& path, const String8& mimeType) {
     String8 plugInId("");
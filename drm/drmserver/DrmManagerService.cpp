@@ -274,6 +274,24 @@ ssize_t DrmManagerService::pread(int uniqueId, DecryptHandle* decryptHandle,
     return mDrmManager->pread(uniqueId, decryptHandle, buffer, numBytes, offset);
 }
 
+status_t DrmManagerService::setReadBuffer(
+            int uniqueId, DecryptHandle* decryptHandle, const sp<IMemory>& buffer) {
+    ALOGV("Entering setReadBuffer");
+    if (!isProtectedCallAllowed()) {
+        return DRM_ERROR_NO_PERMISSION;
+    }
+    return mDrmManager->setReadBuffer(uniqueId, decryptHandle, buffer);
+}
+
+status_t DrmManagerService::preadBatch(int uniqueId, DecryptHandle* decryptHandle,
+            const Vector<DrmReadRange>& ranges, Vector<ssize_t>* results) {
+    ALOGV("Entering preadBatch");
+    if (!isProtectedCallAllowed()) {
+        return DRM_ERROR_NO_PERMISSION;
+    }
+    return mDrmManager->preadBatch(uniqueId, decryptHandle, ranges, results);
+}
+
 status_t DrmManagerService::dump(int fd, const Vector<String16>& args)
 {
     const size_t SIZE = 256;
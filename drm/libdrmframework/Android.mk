@@ -19,7 +19,8 @@ include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES:= \
     DrmManagerClientImpl.cpp \
-    DrmManagerClient.cpp
+    DrmManagerClient.cpp \
+    DrmReadChannel.cpp
 
 LOCAL_MODULE:= libdrmframework
 
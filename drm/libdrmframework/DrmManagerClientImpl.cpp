@@ -23,6 +23,7 @@
 #include <binder/IServiceManager.h>
 
 #include "DrmManagerClientImpl.h"
+#include "DrmReadChannel.h"
 
 using namespace android;
 
@@ -281,6 +282,10 @@ status_t DrmManagerClientImpl::closeDecryptSession(
         int uniqueId, sp<DecryptHandle> &decryptHandle) {
     status_t status = DRM_ERROR_UNKNOWN;
     if (NULL != decryptHandle.get()) {
+        {
+            Mutex::Autolock _l(mReadChannelLock);
+            mReadChannels.removeItem(decryptHandle->decryptId);
+        }
         status = getDrmManagerService()->closeDecryptSession(
                 uniqueId, decryptHandle.get());
     }
@@ -326,12 +331,38 @@ ssize_t DrmManagerClientImpl::pread(int uniqueId, sp<DecryptHandle> &decryptHand
             void* buffer, ssize_t numBytes, off64_t offset) {
     ssize_t retCode = INVALID_VALUE;
     if ((NULL != decryptHandle.get()) && (NULL != buffer) && (0 < numBytes)) {
-        retCode = getDrmManagerService()->pread(
-                uniqueId, decryptHandle.get(), buffer, numBytes, offset);
+        sp<DrmReadChannel> channel = getReadChannel(uniqueId, decryptHandle);
+        if (NULL != channel.get()) {
+            retCode = channel->pread(
+                    uniqueId, decryptHandle.get(), buffer, numBytes, offset);
+        } else {
+            retCode = getDrmManagerService()->pread(
+                    uniqueId, decryptHandle.get(), buffer, numBytes, offset);
+        }
     }
     return retCode;
 }
 
+sp<DrmReadChannel> DrmManagerClientImpl::getReadChannel(
+        int uniqueId, sp<DecryptHandle> &decryptHandle) {
+    Mutex::Autolock _l(mReadChannelLock);
+    const int decryptId = decryptHandle->decryptId;
+    ssize_t index = mReadChannels.indexOfKey(decryptId);
+    if (0 <= index) {
+        return mReadChannels.valueAt(index);
+    }
+
+    // A session that can't get a channel keeps a NULL entry, so that the set
+    // up isn't retried on every read.
+    sp<DrmReadChannel> channel = new DrmReadChannel(getDrmManagerService());
+    if (DRM_NO_ERROR != channel->init(uniqueId, decryptHandle.get())) {
+        ALOGW("No shared read buffer for decrypt session %d", decryptId);
+        channel.clear();
+    }
+    mReadChannels.add(decryptId, channel);
+    return channel;
+}
+
 status_t DrmManagerClientImpl::notify(const DrmInfoEvent& event) {
     if (NULL != mOnInfoListener.get()) {
         Mutex::Autolock _l(mLock);
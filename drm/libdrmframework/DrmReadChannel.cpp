@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "DrmReadChannel(Native)"
+#include <utils/Log.h>
+
+#include <string.h>
+#include <sys/mman.h>
+#include <binder/MemoryBase.h>
+#include <binder/MemoryHeapBase.h>
+#include <utils/Vector.h>
+
+#include "DrmReadChannel.h"
+
+using namespace android;
+
+DrmReadChannel::DrmReadChannel(const sp<IDrmManagerService>& service)
+    : mService(service),
+      mBase(NULL),
+      mNextSlot(0),
+      mNextOffset(-1) {
+    memset(mSlots, 0, sizeof(mSlots));
+}
+
+DrmReadChannel::~DrmReadChannel() {
+}
+
+status_t DrmReadChannel::init(int uniqueId, DecryptHandle* decryptHandle) {
+    sp<MemoryHeapBase> heap =
+        new MemoryHeapBase(kNumSlots * kSlotSize, 0, "DrmReadChannel");
+    if (NULL == heap->getBase() || MAP_FAILED == heap->getBase()) {
+        ALOGE("failed to allocate the shared read buffer");
+        return DRM_ERROR_UNKNOWN;
+    }
+
+    sp<IMemory> memory = new MemoryBase(heap, 0, kNumSlots * kSlotSize);
+    status_t status = mService->setReadBuffer(uniqueId, decryptHandle, memory);
+    if (DRM_NO_ERROR != status) {
+        ALOGV("setReadBuffer failed (%d)", status);
+        return status;
+    }
+
+    mMemory = memory;
+    mBase = static_cast<uint8_t*>(memory->pointer());
+    return DRM_NO_ERROR;
+}
+
+ssize_t DrmReadChannel::findSlot(off64_t offset) const {
+    for (size_t i = 0; i < kNumSlots; i++) {
+        const Slot& slot = mSlots[i];
+        if (slot.valid && offset >= slot.offset &&
+                offset < slot.offset + (off64_t)slot.length) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+status_t DrmReadChannel::fetch(int uniqueId, DecryptHandle* decryptHandle,
+            off64_t offset, size_t numBytes, bool sequential) {
+    // Sequential reads are likely to go on, fetch whole slots and one more.
+    size_t total;
+    if (sequential) {
+        total = (numBytes + kSlotSize - 1) / kSlotSize * kSlotSize + kSlotSize;
+    } else {
+        total = (numBytes + kMinReadSize - 1) / kMinReadSize * kMinReadSize;
+    }
+    if (total > kNumSlots * kSlotSize) {
+        total = kNumSlots * kSlotSize;
+    }
+
+    Vector<DrmReadRange> ranges;
+    Vector<size_t> slotIndices;
+    for (size_t pos = 0; pos < total; pos += kSlotSize) {
+        const size_t index = mNextSlot;
+        mNextSlot = (mNextSlot + 1) % kNumSlots;
+        mSlots[index].valid = false;
+
+        DrmReadRange range;
+        range.offset = offset + pos;
+        range.numBytes = (total - pos < kSlotSize) ? total - pos : kSlotSize;
+        range.bufferOffset = index * kSlotSize;
+        ranges.push(range);
+        slotIndices.push(index);
+    }
+
+    Vector<ssize_t> results;
+    status_t status = mService->preadBatch(uniqueId, decryptHandle, ranges, &results);
+    if (DRM_NO_ERROR != status) {
+        return status;
+    }
+
+    for (size_t i = 0; i < ranges.size(); i++) {
+        if (results[i] < 0) {
+            // Only the first range is needed for the read to make progress.
+            return (0 == i) ? (status_t)results[i] : DRM_NO_ERROR;
+        }
+        Slot& slot = mSlots[slotIndices[i]];
+        slot.offset = ranges[i].offset;
+        slot.length = results[i];
+        slot.valid = true;
+        slot.endOfContent = results[i] < ranges[i].numBytes;
+        if (slot.endOfContent) {
+            break;
+        }
+    }
+    return DRM_NO_ERROR;
+}
+
+ssize_t DrmReadChannel::pread(int uniqueId, DecryptHandle* decryptHandle,
+            void* buffer, size_t numBytes, off64_t offset) {
+    Mutex::Autolock _l(mLock);
+
+    const bool sequential = (offset == mNextOffset);
+    uint8_t* dst = static_cast<uint8_t*>(buffer);
+    size_t done = 0;
+
+    while (done < numBytes) {
+        const off64_t pos = offset + done;
+        ssize_t index = findSlot(pos);
+        if (index < 0) {
+            status_t status = fetch(uniqueId, decryptHandle, pos, numBytes - done, sequential);
+            if (DRM_NO_ERROR != status) {
+                if (0 == done) {
+                    return status;
+                }
+                break;
+            }
+            index = findSlot(pos);
+            if (index < 0) {
+                // End of content
+                break;
+            }
+        }
+
+        const Slot& slot = mSlots[index];
+        const size_t available = slot.offset + slot.length - pos;
+        const size_t n = (available < numBytes - done) ? available : numBytes - done;
+        memcpy(dst + done, mBase + index * kSlotSize + (pos - slot.offset), n);
+        done += n;
+
+        if (slot.endOfContent && n == available) {
+            break;
+        }
+    }
+
+    mNextOffset = offset + done;
+    return done;
+}
@@ -19,8 +19,10 @@
 
 #include <utils/Errors.h>
 #include <utils/threads.h>
+#include <binder/IMemory.h>
 #include <drm/drm_framework_common.h>
 #include "IDrmEngine.h"
+#include "IDrmManagerService.h"
 #include "PlugInManager.h"
 #include "IDrmServiceListener.h"
 
@@ -132,6 +134,11 @@ public:
     ssize_t pread(int uniqueId, DecryptHandle* decryptHandle,
             void* buffer, ssize_t numBytes, off64_t offset);
 
+    status_t setReadBuffer(int uniqueId, DecryptHandle* decryptHandle, const sp<IMemory>& buffer);
+
+    status_t preadBatch(int uniqueId, DecryptHandle* decryptHandle,
+            const Vector<DrmReadRange>& ranges, Vector<ssize_t>* results);
+
     void onInfo(const DrmInfoEvent& event);
 
 private:
@@ -143,6 +150,23 @@ private:
 
     bool canHandle(int uniqueId, const String8& path);
 
+    // Drops the read buffer of a client whose process died, as it never
+    // gets to close its decrypt session.
+    class ReadBufferDeathRecipient : public IBinder::DeathRecipient {
+    public:
+        ReadBufferDeathRecipient(DrmManager* drmManager) : mDrmManager(drmManager) {}
+        virtual void binderDied(const wp<IBinder>& who);
+
+    private:
+        DrmManager* mDrmManager;
+    };
+
+    void onReadBufferDied(const wp<IBinder>& who);
+
+    // call with mDecryptLock held
+    void removeReadBuffer_l(int decryptId);
+    void clearReadBuffers_l();
+
 private:
     Vector<int> mUniqueIdVector;
     static const String8 EMPTY_STRING;
@@ -158,6 +182,9 @@ private:
     KeyedVector< int, IDrmEngine*> mConvertSessionMap;
     KeyedVector< int, sp<IDrmServiceListener> > mServiceListeners;
     KeyedVector< int, IDrmEngine*> mDecryptSessionMap;
+    // guarded by mDecryptLock, like mDecryptSessionMap
+    KeyedVector< int, sp<IMemory> > mReadBufferMap;
+    sp<ReadBufferDeathRecipient> mReadBufferDeathRecipient;
 };
 
 };
@@ -26,6 +26,7 @@
 namespace android {
 
 class DrmInfoEvent;
+class DrmReadChannel;
 /**
  * This is implementation class for DrmManagerClient class.
  *
@@ -420,10 +421,23 @@ private:
      */
     status_t installDrmEngine(int uniqueId, const String8& drmEngineFile);
 
+    /**
+     * Returns the shared memory read channel of the decryption session, set up
+     * on first use. NULL if the session has to use plain pread transactions.
+     *
+     * @param[in] uniqueId Unique identifier for a session
+     * @param[in] decryptHandle Handle for the decryption session
+     * @return sp<DrmReadChannel>
+     */
+    sp<DrmReadChannel> getReadChannel(int uniqueId, sp<DecryptHandle> &decryptHandle);
+
 private:
     Mutex mLock;
     sp<DrmManagerClient::OnInfoListener> mOnInfoListener;
 
+    Mutex mReadChannelLock;
+    KeyedVector< int, sp<DrmReadChannel> > mReadChannels;
+
     class DeathNotifier: public IBinder::DeathRecipient {
         public:
             DeathNotifier() {}
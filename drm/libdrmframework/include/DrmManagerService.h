@@ -120,6 +120,11 @@ public:
     ssize_t pread(int uniqueId, DecryptHandle* decryptHandle,
             void* buffer, ssize_t numBytes, off64_t offset);
 
+    status_t setReadBuffer(int uniqueId, DecryptHandle* decryptHandle, const sp<IMemory>& buffer);
+
+    status_t preadBatch(int uniqueId, DecryptHandle* decryptHandle,
+            const Vector<DrmReadRange>& ranges, Vector<ssize_t>* results);
+
     virtual status_t dump(int fd, const Vector<String16>& args);
 
 private:
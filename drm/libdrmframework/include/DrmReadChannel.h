@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DRM_READ_CHANNEL_H__
+#define __DRM_READ_CHANNEL_H__
+
+#include <binder/IMemory.h>
+#include <utils/RefBase.h>
+#include <utils/threads.h>
+#include <drm/drm_framework_common.h>
+
+#include "IDrmManagerService.h"
+
+namespace android {
+
+/**
+ * Client side of the shared memory read path of a decryption session.
+ *
+ * The channel owns a buffer shared with the DRM manager service and split
+ * into a ring of slots. Each slot caches a range of decrypted content. Reads
+ * are served from the slots when possible; otherwise the missing ranges are
+ * requested from the service in a single preadBatch() call and decrypted
+ * straight into the shared buffer. Reads that continue where the previous one
+ * ended fetch whole slots plus one slot of read-ahead.
+ *
+ */
+class DrmReadChannel : public RefBase {
+public:
+    DrmReadChannel(const sp<IDrmManagerService>& service);
+
+    /**
+     * Allocates the shared buffer and registers it for the decryption session.
+     *
+     * @param[in] uniqueId Unique identifier for a session
+     * @param[in] decryptHandle Handle for the decryption session
+     * @return status_t
+     *     Returns DRM_NO_ERROR for success, an error if the channel can't be used
+     */
+    status_t init(int uniqueId, DecryptHandle* decryptHandle);
+
+    /**
+     * Reads the specified number of bytes from an open DRM file.
+     *
+     * @param[in] uniqueId Unique identifier for a session
+     * @param[in] decryptHandle Handle for the decryption session
+     * @param[out] buffer Reference to the buffer that should receive the read data.
+     * @param[in] numBytes Number of bytes to read.
+     * @param[in] offset Offset of the data within the decrypted content.
+     *
+     * @return Number of bytes read. Returns a negative value for failure.
+     */
+    ssize_t pread(int uniqueId, DecryptHandle* decryptHandle,
+            void* buffer, size_t numBytes, off64_t offset);
+
+protected:
+    virtual ~DrmReadChannel();
+
+private:
+    enum {
+        kNumSlots = 4,
+        kSlotSize = 64 * 1024,
+        // Reads that don't continue the previous one are rounded up to this
+        kMinReadSize = 4 * 1024,
+    };
+
+    struct Slot {
+        off64_t offset;
+        size_t length;
+        bool valid;
+        bool endOfContent;  // the service returned less than requested
+    };
+
+    Mutex mLock;
+    sp<IDrmManagerService> mService;
+    sp<IMemory> mMemory;
+    uint8_t* mBase;
+    Slot mSlots[kNumSlots];
+    size_t mNextSlot;
+    off64_t mNextOffset;
+
+    ssize_t findSlot(off64_t offset) const;
+
+    status_t fetch(int uniqueId, DecryptHandle* decryptHandle,
+            off64_t offset, size_t numBytes, bool sequential);
+
+    DrmReadChannel(const DrmReadChannel&);
+    DrmReadChannel& operator=(const DrmReadChannel&);
+};
+
+};
+
+#endif /* __DRM_READ_CHANNEL_H__ */
@@ -19,6 +19,7 @@
 
 #include <utils/RefBase.h>
 #include <binder/IInterface.h>
+#include <binder/IMemory.h>
 #include <binder/Parcel.h>
 #include <drm/drm_framework_common.h>
 #include "IDrmServiceListener.h"
@@ -36,6 +37,16 @@ class DrmConvertedStatus;
 class String8;
 class ActionDescription;
 
+/**
+ * A range of decrypted content to be read into the shared read buffer of a
+ * decryption session, see IDrmManagerService::preadBatch().
+ */
+struct DrmReadRange {
+    off64_t offset;         // position within the decrypted content
+    int32_t numBytes;       // number of bytes to read
+    int32_t bufferOffset;   // where the data goes in the shared read buffer
+};
+
 /**
  * This is the interface class for DRM Manager service.
  *
@@ -75,7 +86,9 @@ public:
         INITIALIZE_DECRYPT_UNIT,
         DECRYPT,
         FINALIZE_DECRYPT_UNIT,
-        PREAD
+        PREAD,
+        SET_READ_BUFFER,
+        PREAD_BATCH
     };
 
 public:
@@ -163,6 +176,12 @@ public:
 
     virtual ssize_t pread(int uniqueId, DecryptHandle* decryptHandle,
             void* buffer, ssize_t numBytes,off64_t offset) = 0;
+
+    virtual status_t setReadBuffer(
+            int uniqueId, DecryptHandle* decryptHandle, const sp<IMemory>& buffer) = 0;
+
+    virtual status_t preadBatch(int uniqueId, DecryptHandle* decryptHandle,
+            const Vector<DrmReadRange>& ranges, Vector<ssize_t>* results) = 0;
 };
 
 /**
@@ -252,6 +271,12 @@ public:
 
     virtual ssize_t pread(int uniqueId, DecryptHandle* decryptHandle,
             void* buffer, ssize_t numBytes, off64_t offset);
+
+    virtual status_t setReadBuffer(
+            int uniqueId, DecryptHandle* decryptHandle, const sp<IMemory>& buffer);
+
+    virtual status_t preadBatch(int uniqueId, DecryptHandle* decryptHandle,
+            const Vector<DrmReadRange>& ranges, Vector<ssize_t>* results);
 };
 
 /**
@@ -680,12 +680,10 @@ ssize_t FwdLockEngine::onPread(int uniqueId,
         (NULL != buffer) &&
         (numBytes > -1) &&
         (offset > -1)) {
-        if (offset != decoderSession->offset) {
-            decoderSession->offset = onLseek(uniqueId, decryptHandle, offset, SEEK_SET);
-        }
-
-        if (((off_t)-1) != decoderSession->offset) {
-            bytesRead = onRead(uniqueId, decryptHandle, buffer, numBytes);
+        // Random access reads don't go through the file position of the session, so no seek is
+        // needed between reads from different parts of the file.
+        if (decoderSession->fileDesc > -1) {
+            bytesRead = FwdLockFile_pread(decoderSession->fileDesc, buffer, numBytes, offset);
             if (bytesRead < 0) {
                 ALOGE("FwdLockEngine::onPread error reading");
             }
@@ -35,3 +35,22 @@ LOCAL_MODULE := libfwdlock-decoder
 LOCAL_MODULE_TAGS := optional
 
 include $(BUILD_STATIC_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    FwdLockFileBench.c
+
+LOCAL_C_INCLUDES := \
+    frameworks/av/drm/libdrmframework/plugins/forward-lock/internal-format/converter \
+    external/openssl/include
+
+LOCAL_SHARED_LIBRARIES := libcrypto liblog
+
+LOCAL_STATIC_LIBRARIES := libfwdlock-decoder libfwdlock-converter libfwdlock-common
+
+LOCAL_MODULE := fwdlockbench
+
+LOCAL_MODULE_TAGS := debug
+
+include $(BUILD_EXECUTABLE)
@@ -24,6 +24,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <openssl/aes.h>
+#include <openssl/evp.h>
 #include <openssl/hmac.h>
 
 #include "FwdLockFile.h"
@@ -52,6 +53,8 @@
 
 #define SIG_CALC_BUFFER_SIZE (16 * SHA1_BLOCK_SIZE)
 
+#define KEY_STREAM_BATCH_SIZE (64 * AES_BLOCK_SIZE)
+
 /**
  * Data type for the per-file state information needed by the decoder.
  */
@@ -66,7 +69,7 @@ typedef struct FwdLockFile_Session {
     unsigned char headerSignature[SHA1_HASH_SIZE];
     off64_t dataOffset;
     off64_t filePos;
-    AES_KEY encryptionRoundKeys;
+    EVP_CIPHER_CTX encryptionContext;
     HMAC_CTX signingContext;
     unsigned char keyStream[AES_BLOCK_SIZE];
     uint64_t blockIndex;
@@ -187,8 +190,14 @@ static int FwdLockFile_DeriveKeys(FwdLockFile_Session_t * pSession) {
                 // Encrypt the 16-byte value {0, 0, ..., 0} to produce the encryption key.
                 memset(pData->value, 0, KEY_SIZE);
                 AES_encrypt(pData->value, pData->key, &pData->sessionRoundKeys);
-                if (AES_set_encrypt_key(pData->key, KEY_SIZE_IN_BITS,
-                                        &pSession->encryptionRoundKeys) != 0) {
+                // The keystream is generated by encrypting whole runs of counter blocks in ECB
+                // mode, which lets libcrypto use its fastest multi-block implementation (e.g.,
+                // AES-NI). The counter is little-endian, so the EVP CTR mode can't be used.
+                EVP_CIPHER_CTX_init(&pSession->encryptionContext);
+                if (!EVP_EncryptInit_ex(&pSession->encryptionContext, EVP_aes_128_ecb(), NULL,
+                                        pData->key, NULL) ||
+                        !EVP_CIPHER_CTX_set_padding(&pSession->encryptionContext, 0)) {
+                    EVP_CIPHER_CTX_cleanup(&pSession->encryptionContext);
                     result = FALSE;
                 } else {
                     // Encrypt the 16-byte value {1, 0, ..., 0} to produce the signing key.
@@ -233,23 +242,115 @@ static void FwdLockFile_CalculateCounter(const unsigned char *pNonce,
 }
 
 /**
- * Decrypts the byte at the current file position using AES-128-CTR. In CTR (or "counter") mode,
- * encryption and decryption are performed using the same algorithm.
+ * Generates the keystream for a run of consecutive blocks.
+ *
+ * @param[in] pSession A reference to a file session.
+ * @param[in] blockIndex The index number of the first block.
+ * @param[in] numBlocks The number of blocks.
+ * @param[out] pKeyStream A reference to the buffer that should receive the keystream.
+ *
+ * @return A Boolean value indicating whether the keystream could be generated.
+ */
+static int FwdLockFile_GenerateKeyStream(FwdLockFile_Session_t *pSession,
+                                         uint64_t blockIndex,
+                                         size_t numBlocks,
+                                         unsigned char *pKeyStream) {
+    int outLength;
+    size_t i;
+    // The first 16 bytes of the encrypted session key is used as the nonce.
+    FwdLockFile_CalculateCounter(pSession->pEncryptedSessionKey, blockIndex, pKeyStream);
+    for (i = 1; i < numBlocks; ++i) {
+        // Increment the previous counter, which is a 16-byte little-endian number.
+        const unsigned char *pPrevious = &pKeyStream[(i - 1) * AES_BLOCK_SIZE];
+        unsigned char *pCounter = &pKeyStream[i * AES_BLOCK_SIZE];
+        unsigned char carry = 1;
+        size_t j;
+        for (j = 0; j < AES_BLOCK_SIZE; ++j) {
+            pCounter[j] = pPrevious[j] + carry;
+            carry = (carry && pCounter[j] == 0) ? 1 : 0;
+        }
+    }
+    // Encrypt the counters in place.
+    return EVP_EncryptUpdate(&pSession->encryptionContext, pKeyStream, &outLength, pKeyStream,
+                             (int)(numBlocks * AES_BLOCK_SIZE)) &&
+            outLength == (int)(numBlocks * AES_BLOCK_SIZE);
+}
+
+/**
+ * XORs a buffer with the keystream, a machine word at a time where possible.
+ *
+ * @param[in,out] pData A reference to the data.
+ * @param[in] pKeyStream A reference to the keystream.
+ * @param[in] numBytes The number of bytes.
+ */
+static void FwdLockFile_XorKeyStream(unsigned char *pData,
+                                     const unsigned char *pKeyStream,
+                                     size_t numBytes) {
+    size_t i = 0;
+    for (; i + sizeof(unsigned long) <= numBytes; i += sizeof(unsigned long)) {
+        unsigned long data;
+        unsigned long key;
+        memcpy(&data, &pData[i], sizeof data);
+        memcpy(&key, &pKeyStream[i], sizeof key);
+        data ^= key;
+        memcpy(&pData[i], &data, sizeof data);
+    }
+    for (; i < numBytes; ++i) {
+        pData[i] ^= pKeyStream[i];
+    }
+}
+
+/**
+ * Decrypts data read from the given position of the embedded content using AES-128-CTR. In CTR
+ * (or "counter") mode, encryption and decryption are performed using the same algorithm. The
+ * keystream is generated in batches of blocks; the last keystream block is kept in the session so
+ * that small sequential reads don't regenerate it.
  *
  * @param[in,out] pSession A reference to a file session.
- * @param[in] pByte The byte to decrypt.
+ * @param[in,out] pBuffer A reference to the data to decrypt.
+ * @param[in] numBytes The number of bytes to decrypt.
+ * @param[in] filePos The position of the data within the embedded content.
+ *
+ * @return A Boolean value indicating whether decryption was successful.
  */
-void FwdLockFile_DecryptByte(FwdLockFile_Session_t * pSession, unsigned char *pByte) {
-    uint64_t blockIndex = pSession->filePos / AES_BLOCK_SIZE;
-    uint64_t blockOffset = pSession->filePos % AES_BLOCK_SIZE;
-    if (blockIndex != pSession->blockIndex) {
-        // The first 16 bytes of the encrypted session key is used as the nonce.
-        unsigned char counter[AES_BLOCK_SIZE];
-        FwdLockFile_CalculateCounter(pSession->pEncryptedSessionKey, blockIndex, counter);
-        AES_encrypt(counter, pSession->keyStream, &pSession->encryptionRoundKeys);
-        pSession->blockIndex = blockIndex;
+static int FwdLockFile_DecryptData(FwdLockFile_Session_t *pSession,
+                                   unsigned char *pBuffer,
+                                   size_t numBytes,
+                                   off64_t filePos) {
+    int result = TRUE;
+    unsigned char keyStream[KEY_STREAM_BATCH_SIZE];
+    while (numBytes > 0) {
+        uint64_t blockIndex = filePos / AES_BLOCK_SIZE;
+        size_t blockOffset = filePos % AES_BLOCK_SIZE;
+        size_t numBlocks = (blockOffset + numBytes + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE;
+        size_t numBytesToDecrypt;
+        const unsigned char *pKeyStream;
+        if (numBlocks > KEY_STREAM_BATCH_SIZE / AES_BLOCK_SIZE) {
+            numBlocks = KEY_STREAM_BATCH_SIZE / AES_BLOCK_SIZE;
+        }
+        if (numBlocks == 1 && blockIndex == pSession->blockIndex) {
+            pKeyStream = pSession->keyStream;
+        } else {
+            if (!FwdLockFile_GenerateKeyStream(pSession, blockIndex, numBlocks, keyStream)) {
+                result = FALSE;
+                break;
+            }
+            memcpy(pSession->keyStream, &keyStream[(numBlocks - 1) * AES_BLOCK_SIZE],
+                   AES_BLOCK_SIZE);
+            pSession->blockIndex = blockIndex + numBlocks - 1;
+            pKeyStream = keyStream;
+        }
+        numBytesToDecrypt = numBlocks * AES_BLOCK_SIZE - blockOffset;
+        if (numBytesToDecrypt > numBytes) {
+            numBytesToDecrypt = numBytes;
+        }
+        FwdLockFile_XorKeyStream(pBuffer, &pKeyStream[blockOffset], numBytesToDecrypt);
+        pBuffer += numBytesToDecrypt;
+        numBytes -= numBytesToDecrypt;
+        filePos += numBytesToDecrypt;
     }
-    *pByte ^= pSession->keyStream[blockOffset];
+    memset(keyStream, 0, sizeof keyStream); // Zero out key data.
+    return result;
 }
 
 int FwdLockFile_attach(int fileDesc) {
@@ -300,11 +401,35 @@ ssize_t FwdLockFile_read(int fileDesc, void *pBuffer, size_t numBytes) {
         numBytesRead = -1;
     } else {
         FwdLockFile_Session_t *pSession = sessionPtrs[sessionId];
-        ssize_t i;
         numBytesRead = read(pSession->fileDesc, pBuffer, numBytes);
-        for (i = 0; i < numBytesRead; ++i) {
-            FwdLockFile_DecryptByte(pSession, &((unsigned char *)pBuffer)[i]);
-            ++pSession->filePos;
+        if (numBytesRead > 0) {
+            if (!FwdLockFile_DecryptData(pSession, pBuffer, numBytesRead, pSession->filePos)) {
+                errno = EIO;
+                numBytesRead = -1;
+            } else {
+                pSession->filePos += numBytesRead;
+            }
+        }
+    }
+    return numBytesRead;
+}
+
+ssize_t FwdLockFile_pread(int fileDesc, void *pBuffer, size_t numBytes, off64_t offset) {
+    ssize_t numBytesRead;
+    int sessionId = FwdLockFile_FindSession(fileDesc);
+    if (sessionId < 0) {
+        numBytesRead = -1;
+    } else if (offset < 0) {
+        errno = EINVAL;
+        numBytesRead = -1;
+    } else {
+        FwdLockFile_Session_t *pSession = sessionPtrs[sessionId];
+        numBytesRead = pread64(pSession->fileDesc, pBuffer, numBytes,
+                               pSession->dataOffset + offset);
+        if (numBytesRead > 0 &&
+                !FwdLockFile_DecryptData(pSession, pBuffer, numBytesRead, offset)) {
+            errno = EIO;
+            numBytesRead = -1;
         }
     }
     return numBytesRead;
@@ -354,6 +479,7 @@ int FwdLockFile_detach(int fileDesc) {
     if (sessionId < 0) {
         return -1;
     }
+    EVP_CIPHER_CTX_cleanup(&sessionPtrs[sessionId]->encryptionContext);
     HMAC_CTX_cleanup(&sessionPtrs[sessionId]->signingContext);
     FwdLockFile_ReleaseSession(sessionId);
     return 0;
@@ -47,6 +47,20 @@ int FwdLockFile_attach(int fileDesc);
  */
 ssize_t FwdLockFile_read(int fileDesc, void *pBuffer, size_t numBytes);
 
+/**
+ * Reads the specified number of bytes from the given position of an open Forward Lock file. The
+ * file position is not changed.
+ *
+ * @param[in] fileDesc The file descriptor of an open Forward Lock file.
+ * @param[out] pBuffer A reference to the buffer that should receive the read data.
+ * @param[in] numBytes The number of bytes to read.
+ * @param[in] offset The position of the data within the embedded content file.
+ *
+ * @return The number of bytes read.
+ * @retval -1 Failure.
+ */
+ssize_t FwdLockFile_pread(int fileDesc, void *pBuffer, size_t numBytes, off64_t offset);
+
 /**
  * Updates the file position within an open Forward Lock file.
  *
@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures the decryption throughput of the Forward Lock decoder. A random payload is wrapped in
+ * an OMA DRM v1 Forward Lock message, converted to the internal format and read back with
+ * FwdLockFile_read() and FwdLockFile_pread(). The result is checked against the payload. For
+ * comparison, the same amount of data is also decrypted the way the decoder used to do it: one
+ * byte at a time, recomputing the counter whenever a block boundary is crossed.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <openssl/aes.h>
+
+#include "FwdLockConv.h"
+#include "FwdLockFile.h"
+
+#define DEFAULT_PAYLOAD_SIZE (32 * 1024 * 1024)
+#define DEFAULT_CHUNK_SIZE (64 * 1024)
+#define NUM_RANDOM_READS 4096
+
+static const char strBoundary[] = "fwdlockbench-boundary";
+
+/**
+ * Returns the value of the monotonic clock in seconds.
+ */
+static double FwdLockFileBench_Now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Prints the throughput of an operation on numBytes bytes that took the given number of seconds.
+ */
+static void FwdLockFileBench_Report(const char *pName, size_t numBytes, double seconds) {
+    printf("%-24s %8.1f MB/s\n", pName, numBytes / seconds / (1024 * 1024));
+}
+
+/**
+ * Writes an OMA DRM v1 Forward Lock message containing the given payload.
+ *
+ * @return A Boolean value indicating whether the message could be written.
+ */
+static int FwdLockFileBench_WriteMessage(const char *pFilename,
+                                         const unsigned char *pPayload,
+                                         size_t payloadSize) {
+    char header[128];
+    char trailer[64];
+    int headerLength = snprintf(header, sizeof header,
+                                "--%s\r\nContent-Type: video/mp4\r\n\r\n", strBoundary);
+    int trailerLength = snprintf(trailer, sizeof trailer, "\r\n--%s--\r\n", strBoundary);
+    int fileDesc = open(pFilename, O_CREAT | O_TRUNC | O_WRONLY, 0600);
+    int result = fileDesc >= 0 &&
+            write(fileDesc, header, headerLength) == headerLength &&
+            write(fileDesc, pPayload, payloadSize) == (ssize_t)payloadSize &&
+            write(fileDesc, trailer, trailerLength) == trailerLength;
+    if (fileDesc >= 0) {
+        close(fileDesc);
+    }
+    return result;
+}
+
+/**
+ * Converts an OMA DRM v1 Forward Lock message to the internal Forward Lock file format.
+ *
+ * @return A Boolean value indicating whether the conversion was successful.
+ */
+static int FwdLockFileBench_Convert(const char *pInputFilename, const char *pOutputFilename) {
+    FwdLockConv_Status_t status = FwdLockConv_Status_FileNotFound;
+    int inputFileDesc = open(pInputFilename, O_RDONLY);
+    if (inputFileDesc >= 0) {
+        int outputFileDesc = open(pOutputFilename, O_CREAT | O_TRUNC | O_WRONLY, 0600);
+        if (outputFileDesc < 0) {
+            status = FwdLockConv_Status_FileCreationFailed;
+        } else {
+            status = FwdLockConv_ConvertOpenFile(inputFileDesc, read, outputFileDesc, write,
+                                                 lseek64, NULL);
+            close(outputFileDesc);
+        }
+        close(inputFileDesc);
+    }
+    if (status != FwdLockConv_Status_OK) {
+        fprintf(stderr, "Conversion failed with status %d\n", status);
+    }
+    return status == FwdLockConv_Status_OK;
+}
+
+/**
+ * Decrypts data the way FwdLockFile_read() used to: byte by byte, generating the keystream block
+ * for every block boundary that is crossed.
+ */
+static void FwdLockFileBench_DecryptBytes(const AES_KEY *pRoundKeys,
+                                          const unsigned char *pNonce,
+                                          unsigned char *pBuffer,
+                                          size_t numBytes,
+                                          uint64_t filePos,
+                                          uint64_t *pBlockIndex,
+                                          unsigned char *pKeyStream) {
+    size_t i;
+    for (i = 0; i < numBytes; ++i, ++filePos) {
+        uint64_t blockIndex = filePos / AES_BLOCK_SIZE;
+        if (blockIndex != *pBlockIndex) {
+            unsigned char counter[AES_BLOCK_SIZE];
+            unsigned char carry = 0;
+            size_t j = 0;
+            for (; j < sizeof blockIndex; ++j) {
+                unsigned char part = pNonce[j] + (unsigned char)(blockIndex >> (j * CHAR_BIT));
+                counter[j] = part + carry;
+                carry = (part < pNonce[j] || counter[j] < part) ? 1 : 0;
+            }
+            for (; j < AES_BLOCK_SIZE; ++j) {
+                counter[j] = pNonce[j] + carry;
+                carry = (counter[j] < pNonce[j]) ? 1 : 0;
+            }
+            AES_encrypt(counter, pKeyStream, pRoundKeys);
+            *pBlockIndex = blockIndex;
+        }
+        pBuffer[i] ^= pKeyStream[filePos % AES_BLOCK_SIZE];
+    }
+}
+
+int main(int argc, char **argv) {
+    size_t payloadSize = DEFAULT_PAYLOAD_SIZE;
+    size_t chunkSize = DEFAULT_CHUNK_SIZE;
+    const char *pDirectory = "/data/local/tmp";
+    char messageFilename[PATH_MAX];
+    char convertedFilename[PATH_MAX];
+    unsigned char *pPayload;
+    unsigned char *pBuffer;
+    int fileDesc;
+    int result = EXIT_FAILURE;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:c:d:")) != -1) {
+        switch (opt) {
+        case 's':
+            payloadSize = strtoul(optarg, NULL, 0) * 1024 * 1024;
+            break;
+        case 'c':
+            chunkSize = strtoul(optarg, NULL, 0) * 1024;
+            break;
+        case 'd':
+            pDirectory = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s payload MB] [-c chunk KB] [-d directory]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (payloadSize == 0 || chunkSize == 0 || chunkSize > payloadSize) {
+        fprintf(stderr, "Invalid payload or chunk size\n");
+        return EXIT_FAILURE;
+    }
+
+    snprintf(messageFilename, sizeof messageFilename, "%s/fwdlockbench.dm", pDirectory);
+    snprintf(convertedFilename, sizeof convertedFilename, "%s/fwdlockbench.fl", pDirectory);
+
+    pPayload = malloc(payloadSize);
+    pBuffer = malloc(payloadSize);
+    if (pPayload == NULL || pBuffer == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        goto cleanup;
+    }
+    srand(1);
+    {
+        size_t i;
+        for (i = 0; i < payloadSize; ++i) {
+            pPayload[i] = (unsigned char)rand();
+        }
+    }
+
+    if (!FwdLockFileBench_WriteMessage(messageFilename, pPayload, payloadSize) ||
+            !FwdLockFileBench_Convert(messageFilename, convertedFilename)) {
+        fprintf(stderr, "Could not create %s: %s\n", convertedFilename, strerror(errno));
+        goto cleanup;
+    }
+
+    fileDesc = open(convertedFilename, O_RDONLY);
+    if (fileDesc < 0 || FwdLockFile_attach(fileDesc) < 0) {
+        fprintf(stderr, "Could not open %s\n", convertedFilename);
+        goto cleanup;
+    }
+
+    printf("payload %zu KB, chunk %zu KB\n", payloadSize / 1024, chunkSize / 1024);
+
+    // Sequential reads.
+    {
+        size_t pos = 0;
+        double start = FwdLockFileBench_Now();
+        while (pos < payloadSize) {
+            size_t numBytes = payloadSize - pos < chunkSize ? payloadSize - pos : chunkSize;
+            if (FwdLockFile_read(fileDesc, &pBuffer[pos], numBytes) != (ssize_t)numBytes) {
+                fprintf(stderr, "FwdLockFile_read failed at %zu\n", pos);
+                goto detach;
+            }
+            pos += numBytes;
+        }
+        FwdLockFileBench_Report("FwdLockFile_read", payloadSize, FwdLockFileBench_Now() - start);
+        if (memcmp(pBuffer, pPayload, payloadSize) != 0) {
+            fprintf(stderr, "FwdLockFile_read returned wrong data\n");
+            goto detach;
+        }
+    }
+
+    // Random access reads at offsets that are not aligned to the AES block size.
+    {
+        size_t totalBytes = 0;
+        double start;
+        int i;
+        srand(2);
+        start = FwdLockFileBench_Now();
+        for (i = 0; i < NUM_RANDOM_READS; ++i) {
+            size_t offset = (size_t)rand() % (payloadSize - chunkSize + 1);
+            size_t numBytes = 1 + (size_t)rand() % chunkSize;
+            if (FwdLockFile_pread(fileDesc, pBuffer, numBytes, offset) != (ssize_t)numBytes ||
+                    memcmp(pBuffer, &pPayload[offset], numBytes) != 0) {
+                fprintf(stderr, "FwdLockFile_pread failed at %zu\n", offset);
+                goto detach;
+            }
+            totalBytes += numBytes;
+        }
+        FwdLockFileBench_Report("FwdLockFile_pread", totalBytes, FwdLockFileBench_Now() - start);
+    }
+
+    // The per-byte reference, reading the same file with a throwaway key.
+    {
+        AES_KEY roundKeys;
+        unsigned char key[AES_BLOCK_SIZE];
+        unsigned char nonce[AES_BLOCK_SIZE];
+        unsigned char keyStream[AES_BLOCK_SIZE];
+        uint64_t blockIndex = (uint64_t)-1;
+        off64_t dataOffset = lseek64(fileDesc, 0, SEEK_END) - payloadSize;
+        size_t pos = 0;
+        double start;
+        memset(key, 0x5a, sizeof key);
+        memset(nonce, 0xa5, sizeof nonce);
+        AES_set_encrypt_key(key, AES_BLOCK_SIZE * CHAR_BIT, &roundKeys);
+        start = FwdLockFileBench_Now();
+        while (pos < payloadSize) {
+            size_t numBytes = payloadSize - pos < chunkSize ? payloadSize - pos : chunkSize;
+            if (pread64(fileDesc, &pBuffer[pos], numBytes, dataOffset + pos) !=
+                    (ssize_t)numBytes) {
+                fprintf(stderr, "pread64 failed at %zu\n", pos);
+                goto detach;
+            }
+            FwdLockFileBench_DecryptBytes(&roundKeys, nonce, &pBuffer[pos], numBytes, pos,
+                                          &blockIndex, keyStream);
+            pos += numBytes;
+        }
+        FwdLockFileBench_Report("per-byte reference", payloadSize,
+                                FwdLockFileBench_Now() - start);
+    }
+
+    result = EXIT_SUCCESS;
+
+detach:
+    FwdLockFile_close(fileDesc);
+cleanup:
+    unlink(messageFilename);
+    unlink(convertedFilename);
+    free(pBuffer);
+    free(pPayload);
+    return result;
+}
@@ -22,6 +22,7 @@
 #include <ui/GraphicBuffer.h>
 #include <utils/List.h>
 #include <utils/String8.h>
+#include <utils/Vector.h>
 
 #include <OMX_Core.h>
 #include <OMX_Video.h>
@@ -123,6 +124,36 @@ public:
             node_id node,
             const char *parameter_name,
             OMX_INDEXTYPE *index) = 0;
+
+    // A fillBuffer or emptyBuffer call, for submitBuffers.
+    struct BufferCommand {
+        enum {
+            FILL_BUFFER,
+            EMPTY_BUFFER,
+        } mType;
+
+        buffer_id mBuffer;
+
+        // EMPTY_BUFFER only
+        OMX_U32 mRangeOffset;
+        OMX_U32 mRangeLength;
+        OMX_U32 mFlags;
+        OMX_TICKS mTimestamp;
+    };
+
+    enum {
+        kMaxBufferCommands = 64,
+    };
+
+    // Performs the commands in order, in a single transaction. Stops at
+    // the first command that fails and returns its error.
+    virtual status_t submitBuffers(
+            node_id node, const Vector<BufferCommand> &commands) = 0;
+
+    // Whether clients batch buffer commands with submitBuffers and the
+    // server batches callbacks, false if debug.stagefright.omx-batching
+    // is set to 0.
+    static bool BufferBatchingEnabled();
 };
 
 struct omx_message {
@@ -167,6 +198,10 @@ public:
     DECLARE_META_INTERFACE(OMXObserver);
 
     virtual void onMessage(const omx_message &msg) = 0;
+
+    // Messages that were pending at the same time are delivered together,
+    // by default they are passed on to onMessage() one by one.
+    virtual void onMessages(const List<omx_message> &messages);
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -21,6 +21,7 @@
 #include <utils/List.h>
 #include <utils/Vector.h>
 #include <utils/KeyedVector.h>
+#include <utils/Timers.h>
 #include <media/AudioTrack.h>
 
 namespace android {
@@ -30,6 +31,8 @@ static const int IDLE_PRIORITY = -1;
 // forward declarations
 class SoundEvent;
 class SoundPoolThread;
+class SoundPoolMixer;
+class SoundPoolCache;
 class SoundPool;
 
 // for queued events
@@ -60,7 +63,7 @@ public:
     size_t size() { return mSize; }
     int state() { return mState; }
     uint8_t* data() { return static_cast<uint8_t*>(mData->pointer()); }
-    status_t doLoad();
+    status_t doLoad(const sp<SoundPoolCache>& cache);
     void startLoad() { mState = LOADING; }
     sp<IMemory> getIMemory() { return mData; }
 
@@ -117,7 +120,8 @@ class SoundChannel : public SoundEvent {
 public:
     enum state { IDLE, RESUMING, STOPPING, PAUSED, PLAYING };
     SoundChannel() : mAudioTrack(NULL), mState(IDLE), mNumChannels(1),
-            mPos(0), mToggle(0), mAutoPaused(false) {}
+            mPos(0), mToggle(0), mAutoPaused(false), mPhase(0), mPhaseIncrement(0),
+            mLoopsRemaining(0), mTriggerTime(0), mMixerDone(false) {}
     ~SoundChannel();
     void init(SoundPool* soundPool);
     void play(const sp<Sample>& sample, int channelID, float leftVolume, float rightVolume,
@@ -128,8 +132,9 @@ public:
     void stop();
     void pause();
     void autoPause();
-    void resume();
-    void autoResume();
+    // both return true if the channel is playing again
+    bool resume();
+    bool autoResume();
     void setRate(float rate);
     int state() { return mState; }
     void setPriority(int priority) { mPriority = priority; }
@@ -140,10 +145,18 @@ public:
     int nextChannelID() { return mNextEvent.channelID(); }
     void dump();
 
+    // mixer mode, called from the mixer AudioTrack thread
+    bool mix(int32_t* out, size_t frameCount);
+    // mixer mode, call with sound pool lock held
+    void mixerDone();
+
 private:
     static void callback(int event, void* user, void *info);
     void process(int event, void *info, unsigned long toggle);
     bool doStop_l();
+    void startVoice_l(const sp<Sample>& sample, int nextChannelID, float leftVolume,
+            float rightVolume, int priority, int loop, float rate);
+    void setPhaseIncrement_l(float rate);
 
     SoundPool*          mSoundPool;
     AudioTrack*         mAudioTrack;
@@ -155,14 +168,25 @@ private:
     int                 mAudioBufferSize;
     unsigned long       mToggle;
     bool                mAutoPaused;
+
+    // mixer mode voice state
+    uint64_t            mPhase;             // position in the sample, 16.16 frames
+    uint32_t            mPhaseIncrement;    // 16.16 frames per output frame
+    int                 mLoopsRemaining;
+    nsecs_t             mTriggerTime;       // time of play() until the first buffer
+    bool                mMixerDone;         // end of sample reached, waiting for stop
 };
 
 // application object for managing a pool of sounds
 class SoundPool {
     friend class SoundPoolThread;
     friend class SoundChannel;
+    friend class SoundPoolMixer;
 public:
-    SoundPool(int maxChannels, audio_stream_type_t streamType, int srcQuality);
+    // If useMixer is true, or the media.soundpool.mixer property is set, all channels
+    // are mixed into a single AudioTrack instead of creating a track for each play.
+    SoundPool(int maxChannels, audio_stream_type_t streamType, int srcQuality,
+            bool useMixer = false);
     ~SoundPool();
     int load(const char* url, int priority);
     int load(int fd, int64_t offset, int64_t length, int priority);
@@ -187,6 +211,13 @@ public:
     // called from AudioTrack thread
     void done_l(SoundChannel* channel);
 
+    // called from AudioTrack thread, latency from play() to the first audio reaching the output
+    void reportLatency(nsecs_t latency);
+
+    // Decoded samples are cached in the given directory and mapped by later loads
+    // of the same file range. NULL disables the cache.
+    void setCacheDirectory(const char* directory);
+
     // callback function
     void setCallback(SoundPoolCallback* callback, void* user);
     void* getUserData() { return mUserData; }
@@ -196,6 +227,7 @@ private:
     bool startThreads();
     void doLoad(sp<Sample>& sample);
     sp<Sample> findSample(int sampleID) { return mSamples.valueFor(sampleID); }
+    sp<SoundPoolCache> cache();
     SoundChannel* findChannel (int channelID);
     SoundChannel* findNextChannel (int channelID);
     SoundChannel* allocateChannel_l(int priority);
@@ -206,6 +238,7 @@ private:
     // restart thread
     void addToRestartList(SoundChannel* channel);
     void addToStopList(SoundChannel* channel);
+    void requestMixerStop();
     static int beginThread(void* arg);
     int run();
     void quit();
@@ -226,6 +259,19 @@ private:
     int                     mNextSampleID;
     int                     mNextChannelID;
     bool                    mQuit;
+    SoundPoolMixer*         mMixer;
+    bool                    mMixerStopRequested;
+
+    // trigger to output latency statistics
+    Mutex                   mLatencyLock;
+    uint32_t                mLatencyCount;
+    nsecs_t                 mLatencySum;
+    nsecs_t                 mLatencyMin;
+    nsecs_t                 mLatencyMax;
+
+    // decoded sample cache, used by the loader threads
+    Mutex                   mCacheLock;
+    sp<SoundPoolCache>      mCache;
 
     // callback
     Mutex                   mCallbackLock;
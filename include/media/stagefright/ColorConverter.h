@@ -33,6 +33,10 @@ struct ColorConverter {
 
     bool isValid() const;
 
+    // Upper bound on the number of threads a single conversion of a large
+    // frame is split across, 0 (the default) picks one per CPU up to 4.
+    void setMaxThreads(size_t maxThreads);
+
     status_t convert(
             const void *srcBits,
             size_t srcWidth, size_t srcHeight,
@@ -59,11 +63,35 @@ private:
         size_t mCropLeft, mCropTop, mCropRight, mCropBottom;
     };
 
+    enum {
+        kMaxThreads         = 8,
+        kMaxAutoThreads     = 4,
+        kMinPixelsPerThread = 640 * 360,
+    };
+
+    struct YUV420Rows;
+    struct RowBand;
+    struct WorkerPool;
+
     OMX_COLOR_FORMATTYPE mSrcFormat, mDstFormat;
     uint8_t *mClip;
+    size_t mMaxThreads;
+
+    // Started on the first conversion that is split, and kept until the
+    // converter goes away.
+    WorkerPool *mWorkers;
 
     uint8_t *initClip();
 
+    void convertRowBands(const YUV420Rows &rows, size_t height);
+
+    static void convertRows(
+            const YUV420Rows &rows, size_t rowBegin, size_t rowEnd);
+
+    static size_t convertRowVector(
+            const uint8_t *src_y, const uint8_t *src_u, const uint8_t *src_v,
+            size_t chromaStep, bool swapRB, uint16_t *dst_ptr, size_t width);
+
     status_t convertCbYCrY(
             const BitmapParams &src, const BitmapParams &dst);
 
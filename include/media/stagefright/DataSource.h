@@ -77,7 +77,12 @@ public:
             const sp<DataSource> &source, String8 *mimeType,
             float *confidence, sp<AMessage> *meta);
 
-    static void RegisterSniffer(SnifferFunc func);
+    // "maxConfidence" is the highest confidence the sniffer can report, if
+    // known. sniff() skips such sniffers once a better match has been found
+    // and lets them read from a shared in-memory copy of the beginning of
+    // the source. Sniffers registered without it always run and always see
+    // the source itself.
+    static void RegisterSniffer(SnifferFunc func, float maxConfidence = -1.0f);
     static void RegisterDefaultSniffers();
 
     // for DRM
@@ -96,8 +101,12 @@ protected:
     virtual ~DataSource() {}
 
 private:
+    struct SnifferList;
+
+    // Registration replaces the list, sniff() only holds the lock long
+    // enough to take a reference to the current one.
     static Mutex gSnifferMutex;
-    static List<SnifferFunc> gSniffers;
+    static sp<SnifferList> gSniffers;
 
     DataSource(const DataSource &);
     DataSource &operator=(const DataSource &);
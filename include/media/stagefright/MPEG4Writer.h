@@ -29,6 +29,7 @@ namespace android {
 class MediaBuffer;
 class MediaSource;
 class MetaData;
+struct FileSink;
 
 class MPEG4Writer : public MediaWriter {
 public:
@@ -67,6 +68,7 @@ private:
     class Track;
 
     int  mFd;
+    sp<FileSink> mSink;
     status_t mInitCheck;
     bool mUse4ByteNalLength;
     bool mUse32BitOffset;
@@ -101,6 +103,7 @@ private:
     status_t startTracks(MetaData *params);
     size_t numTracks();
     int64_t estimateMoovBoxSize(int32_t bitRate);
+    int64_t estimatePreallocationWindow(int32_t bitRate);
 
     struct Chunk {
         Track               *mTrack;        // Owner
@@ -113,6 +113,11 @@ enum {
     kKeyNotRealTime       = 'ntrt',  // bool (int32_t)
     kKeyNumBuffers        = 'nbbf',  // int32_t
 
+    // Passed to MediaSource::start by clients that hold on to several
+    // buffers they have read, sources may allocate that many. Sources that
+    // do set it in their format to the number they allocated.
+    kKeyNumReadAheadBuffers = 'nrab',  // int32_t
+
     // Ogg files can be tagged to be automatically looping...
     kKeyAutoLoop          = 'autL',  // bool (int32_t)
 
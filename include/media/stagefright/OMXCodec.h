@@ -231,6 +231,12 @@ private:
     // a video encoder.
     List<int64_t> mDecodingTimeList;
 
+    // fillBuffer and emptyBuffer calls made while a batch is open are
+    // collected here and sent with a single submitBuffers call.
+    Vector<IOMX::BufferCommand> mBufferCommands;
+    bool mBufferBatchingEnabled;
+    bool mBatchBufferCommands;
+
     OMXCodec(const sp<IOMX> &omx, IOMX::node_id node,
              uint32_t quirks, uint32_t flags,
              bool isEncoder, const char *mime, const char *componentName,
@@ -311,6 +317,17 @@ private:
     void drainInputBuffers();
     void fillOutputBuffers();
 
+    // Returns false if a batch was already open, the caller must then
+    // leave it open.
+    bool beginBufferCommands();
+    void flushBufferCommands();
+    void endBufferCommands();
+    status_t submitFillBuffer(IOMX::buffer_id buffer);
+    status_t submitEmptyBuffer(
+            IOMX::buffer_id buffer,
+            OMX_U32 rangeOffset, OMX_U32 rangeLength,
+            OMX_U32 flags, OMX_TICKS timestamp);
+
     bool drainAnyInputBuffer();
     BufferInfo *findInputBufferByDataPointer(void *ptr);
     BufferInfo *findEmptyInputBuffer();
@@ -27,6 +27,7 @@
 namespace android {
 
 struct AMessage;
+class MediaBufferBase;
 
 struct ABuffer : public RefBase {
     ABuffer(size_t capacity);
@@ -47,6 +48,12 @@ struct ABuffer : public RefBase {
 
     sp<AMessage> meta();
 
+    // Takes over the caller's reference to "mediaBuffer", which is released
+    // once this buffer goes away. Used to wrap a MediaBuffer's data without
+    // copying it.
+    void setMediaBufferBase(MediaBufferBase *mediaBuffer);
+    MediaBufferBase *getMediaBufferBase() { return mMediaBufferBase; }
+
 protected:
     virtual ~ABuffer();
 
@@ -63,6 +70,8 @@ private:
 
     bool mOwnsData;
 
+    MediaBufferBase *mMediaBufferBase;
+
     DISALLOW_EVIL_CONSTRUCTORS(ABuffer);
 };
 
@@ -55,12 +55,20 @@ namespace android {
 #define CBLK_RESTORED_OFF       0x0040  // by AudioFlinger
 #define CBLK_FAST               0x0080  // AudioFlinger successfully created a fast track
 
+// audio_track_cblk_t::mFutex: bit 0 is set while a client is (about to be) waiting in
+// waitServer(), the remaining bits are a sequence number advanced by each wake()
+#define CBLK_FUTEX_WAITING      0x0001
+#define CBLK_FUTEX_SEQUENCE     0x0002
+
 // Important: do not add any virtual methods, including ~
 struct audio_track_cblk_t
 {
 
     // The data members are grouped so that members accessed frequently and in the same context
     // are in the same line of data cache.
+                // lock and cv are only used for control operations (start, loops, position,
+                // restore). The data path is lock-free: each side publishes its own index with
+                // release semantics, and the client waits for the server on mFutex.
                 Mutex       lock;           // sizeof(int)
                 Condition   cv;             // sizeof(int)
 
@@ -111,6 +119,9 @@ public:
 
                 // Cache line boundary (32 bytes)
 
+                // see CBLK_FUTEX_WAITING and CBLK_FUTEX_SEQUENCE
+    volatile    int32_t     mFutex;
+
                 // Since the control block is always located in shared memory, this constructor
                 // is only used for placement new().  It is never used for regular new() or stack.
                             audio_track_cblk_t();
@@ -123,6 +134,14 @@ public:
                 uint32_t    framesReady();                      // called by server only
                 bool        tryLock();
 
+                // Futex based wait for the server to step, called by client only.
+                // prepareWaitServer() returns the sequence to pass to waitServer(); the caller
+                // must check the frame count again between the two calls.
+                int32_t     prepareWaitServer();
+                status_t    waitServer(int32_t sequence, uint32_t waitTimeMs);
+                // Wake up a client waiting in waitServer(), does not block.
+                void        wake();
+
                 // No barriers on the following operations, so the ordering of loads/stores
                 // with respect to other parameters is UNPREDICTABLE. That's considered safe.
 
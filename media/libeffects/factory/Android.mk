@@ -18,3 +18,24 @@ LOCAL_C_INCLUDES := \
     $(call include-path-for, audio-effects)
 
 include $(BUILD_SHARED_LIBRARY)
+
+#
+# build offline effect chain benchmark
+#
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	test-effects.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	libeffects \
+	libcutils
+
+LOCAL_C_INCLUDES := \
+    $(call include-path-for, audio-effects)
+
+LOCAL_MODULE:= test-effects
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,569 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Runs a WAV file through a chain of effects created by the effects factory,
+// outside of AudioFlinger. Reports the CPU cost of each effect's process(),
+// whether process() changed the heap, and optionally compares the output
+// with a golden WAV file.
+
+#include <media/EffectsFactoryApi.h>
+#include <audio_effects/effect_downmix.h>
+#include <cutils/bitops.h>
+#include <system/audio.h>
+#include <errno.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_EFFECTS 16
+#define MAX_PARAMS  16
+
+struct HeaderWav {
+    HeaderWav(size_t size, int nc, int sr, int bits) {
+        strncpy(RIFF, "RIFF", 4);
+        chunkSize = size + sizeof(HeaderWav) - 8;
+        strncpy(WAVE, "WAVE", 4);
+        strncpy(fmt,  "fmt ", 4);
+        fmtSize = 16;
+        audioFormat = 1;
+        numChannels = nc;
+        samplesRate = sr;
+        byteRate = sr * numChannels * (bits/8);
+        align = nc*(bits/8);
+        bitsPerSample = bits;
+        strncpy(data, "data", 4);
+        dataSize = size;
+    }
+
+    char RIFF[4];           // RIFF
+    uint32_t chunkSize;     // File size
+    char WAVE[4];           // WAVE
+    char fmt[4];            // fmt\0
+    uint32_t fmtSize;       // fmt size
+    uint16_t audioFormat;   // 1=PCM
+    uint16_t numChannels;   // num channels
+    uint32_t samplesRate;   // sample rate in hz
+    uint32_t byteRate;      // Bps
+    uint16_t align;         // 2=16-bit mono, 4=16-bit stereo
+    uint16_t bitsPerSample; // bits per sample
+    char data[4];           // "data"
+    uint32_t dataSize;      // size
+};
+
+// 16 bit PCM samples of a WAV file.
+struct Wav {
+    Wav() : channels(0), sampleRate(0), frames(0), samples(NULL) {}
+    ~Wav() { free(samples); }
+
+    uint32_t channels;
+    uint32_t sampleRate;
+    size_t frames;
+    int16_t* samples;
+};
+
+struct Param {
+    int32_t ids[2];
+    size_t numIds;
+    int32_t value;
+    bool isShort;
+};
+
+struct ChainEffect {
+    const char* spec;
+    effect_handle_t handle;
+    effect_descriptor_t desc;
+    bool auxiliary;
+    uint32_t inChannels;
+    uint32_t outChannels;
+    Param params[MAX_PARAMS];
+    size_t numParams;
+    int64_t processNs;
+    int heapChanges;
+    long heapGrowth;
+};
+
+static int usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-l] [-e effect[,param=value]...]... [-f frames] [-r passes] "
+                    "[-o output.wav] [-g golden.wav] [<input.wav>]\n", name);
+    fprintf(stderr, "    -l    list the effects known to the effects factory\n");
+    fprintf(stderr, "    -e    append an effect, by uuid or by name, to the chain\n");
+    fprintf(stderr, "          param is one or two int32 ids separated by '/', value is an\n");
+    fprintf(stderr, "          int32, or an int16 when followed by 's'. For instance\n");
+    fprintf(stderr, "          -e \"Bass Boost,1=1000s\" sets BASSBOOST_PARAM_STRENGTH\n");
+    fprintf(stderr, "    -f    frames per process() call (default 256)\n");
+    fprintf(stderr, "    -r    number of passes over the input, for timing (default 1)\n");
+    fprintf(stderr, "    -o    write the output of the first pass to a WAV file\n");
+    fprintf(stderr, "    -g    compare the output of the first pass with a golden WAV file\n");
+    return -1;
+}
+
+static int64_t now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static bool readWav(const char* path, Wav* wav) {
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "cannot open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    char riff[12];
+    bool ok = fread(riff, 1, sizeof(riff), f) == sizeof(riff) &&
+            !memcmp(riff, "RIFF", 4) && !memcmp(riff + 8, "WAVE", 4);
+    uint16_t bits = 0;
+    while (ok) {
+        char id[4];
+        uint32_t size;
+        if (fread(id, 1, 4, f) != 4 || fread(&size, 1, 4, f) != 4) {
+            ok = false;
+            break;
+        }
+        if (!memcmp(id, "fmt ", 4) && size >= 16) {
+            uint16_t fmt[8];
+            ok = fread(fmt, 1, 16, f) == 16 && fseek(f, size - 16, SEEK_CUR) == 0;
+            if (fmt[0] != 1) {
+                fprintf(stderr, "%s is not PCM\n", path);
+                ok = false;
+            }
+            wav->channels = fmt[1];
+            wav->sampleRate = fmt[2] | (fmt[3] << 16);
+            bits = fmt[7];
+        } else if (!memcmp(id, "data", 4)) {
+            if (bits != 16 || wav->channels == 0) {
+                fprintf(stderr, "%s is not 16 bit PCM\n", path);
+                ok = false;
+                break;
+            }
+            wav->frames = size / (wav->channels * sizeof(int16_t));
+            wav->samples = (int16_t*) malloc(wav->frames * wav->channels * sizeof(int16_t));
+            wav->frames = fread(wav->samples, wav->channels * sizeof(int16_t), wav->frames, f);
+            break;
+        } else {
+            ok = fseek(f, (size + 1) & ~1, SEEK_CUR) == 0;
+        }
+    }
+    fclose(f);
+    if (!ok || wav->samples == NULL) {
+        fprintf(stderr, "cannot parse %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+static bool writeWav(const char* path, const Wav& wav) {
+    FILE* f = fopen(path, "wb");
+    if (f == NULL) {
+        fprintf(stderr, "cannot create %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    size_t size = wav.frames * wav.channels * sizeof(int16_t);
+    HeaderWav header(size, wav.channels, wav.sampleRate, 16);
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+            fwrite(wav.samples, 1, size, f) == size;
+    ok = (fclose(f) == 0) && ok;
+    return ok;
+}
+
+static uint32_t channelMask(uint32_t channels) {
+    switch (channels) {
+    case 1: return AUDIO_CHANNEL_OUT_MONO;
+    case 2: return AUDIO_CHANNEL_OUT_STEREO;
+    case 4: return AUDIO_CHANNEL_OUT_QUAD;
+    case 6: return AUDIO_CHANNEL_OUT_5POINT1;
+    case 8: return AUDIO_CHANNEL_OUT_7POINT1;
+    default: return 0;
+    }
+}
+
+static bool parseUuid(const char* str, effect_uuid_t* uuid) {
+    int tmp[10];
+    if (sscanf(str, "%08x-%04x-%04x-%04x-%02x%02x%02x%02x%02x%02x",
+            tmp, tmp + 1, tmp + 2, tmp + 3, tmp + 4, tmp + 5, tmp + 6, tmp + 7, tmp + 8,
+            tmp + 9) != 10) {
+        return false;
+    }
+    uuid->timeLow = (uint32_t) tmp[0];
+    uuid->timeMid = (uint16_t) tmp[1];
+    uuid->timeHiAndVersion = (uint16_t) tmp[2];
+    uuid->clockSeq = (uint16_t) tmp[3];
+    for (int i = 0; i < 6; i++) {
+        uuid->node[i] = (uint8_t) tmp[4 + i];
+    }
+    return true;
+}
+
+static void printUuid(const effect_uuid_t& uuid) {
+    printf("%08x-%04x-%04x-%04x-%02x%02x%02x%02x%02x%02x",
+            uuid.timeLow, uuid.timeMid, uuid.timeHiAndVersion, uuid.clockSeq,
+            uuid.node[0], uuid.node[1], uuid.node[2], uuid.node[3], uuid.node[4], uuid.node[5]);
+}
+
+static void listEffects() {
+    uint32_t numEffects = 0;
+    EffectQueryNumberEffects(&numEffects);
+    for (uint32_t i = 0; i < numEffects; i++) {
+        effect_descriptor_t desc;
+        if (EffectQueryEffect(i, &desc) != 0) {
+            continue;
+        }
+        printUuid(desc.uuid);
+        printf("  %-32s %s\n", desc.name, desc.implementor);
+    }
+}
+
+// Looks an effect up by uuid, or else by the start of its name.
+static bool findEffect(const char* name, size_t length, effect_descriptor_t* desc) {
+    effect_uuid_t uuid;
+    if (parseUuid(name, &uuid)) {
+        return EffectGetDescriptor(&uuid, desc) == 0;
+    }
+    uint32_t numEffects = 0;
+    EffectQueryNumberEffects(&numEffects);
+    for (uint32_t i = 0; i < numEffects; i++) {
+        if (EffectQueryEffect(i, desc) == 0 && strlen(desc->name) >= length &&
+                !strncasecmp(desc->name, name, length)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parses "name[,id[/id]=value[s]]..."
+static bool parseSpec(const char* spec, ChainEffect* effect) {
+    memset(effect, 0, sizeof(*effect));
+    effect->spec = spec;
+    const char* comma = strchr(spec, ',');
+    size_t length = comma ? (size_t) (comma - spec) : strlen(spec);
+    if (!findEffect(spec, length, &effect->desc)) {
+        fprintf(stderr, "no effect matches %.*s\n", (int) length, spec);
+        return false;
+    }
+    while (comma != NULL) {
+        if (effect->numParams == MAX_PARAMS) {
+            fprintf(stderr, "too many parameters in %s\n", spec);
+            return false;
+        }
+        Param* p = &effect->params[effect->numParams++];
+        char* end;
+        p->ids[p->numIds++] = strtol(comma + 1, &end, 0);
+        if (*end == '/') {
+            p->ids[p->numIds++] = strtol(end + 1, &end, 0);
+        }
+        if (*end != '=') {
+            fprintf(stderr, "bad parameter in %s\n", spec);
+            return false;
+        }
+        p->value = strtol(end + 1, &end, 0);
+        if (*end == 's') {
+            p->isShort = true;
+            end++;
+        }
+        if (*end != ',' && *end != '\0') {
+            fprintf(stderr, "bad parameter in %s\n", spec);
+            return false;
+        }
+        comma = (*end == ',') ? end : NULL;
+    }
+    return true;
+}
+
+static int command(ChainEffect* effect, uint32_t cmd, uint32_t size, void* data) {
+    int reply = 0;
+    uint32_t replySize = sizeof(reply);
+    int status = (*effect->handle)->command(effect->handle, cmd, size, data, &replySize, &reply);
+    return status != 0 ? status : reply;
+}
+
+static int setParam(ChainEffect* effect, const Param& param) {
+    uint32_t buf32[sizeof(effect_param_t) / sizeof(uint32_t) + 3];
+    effect_param_t* p = (effect_param_t*) buf32;
+    p->psize = param.numIds * sizeof(int32_t);
+    p->vsize = param.isShort ? sizeof(int16_t) : sizeof(int32_t);
+    memcpy(p->data, param.ids, p->psize);
+    if (param.isShort) {
+        *(int16_t*) (p->data + p->psize) = (int16_t) param.value;
+    } else {
+        *(int32_t*) (p->data + p->psize) = param.value;
+    }
+    return command(effect, EFFECT_CMD_SET_PARAM, sizeof(effect_param_t) + p->psize + p->vsize, p);
+}
+
+// Creates, configures and enables the effect the way AudioFlinger's EffectModule does,
+// with distinct input and output buffers.
+static bool setUp(ChainEffect* effect, uint32_t inChannels, uint32_t sampleRate,
+        size_t frameCount) {
+    // Effects of the same session share state, like on an AudioFlinger output.
+    const int32_t sessionId = 1;
+    const int32_t ioId = 1;
+    if (EffectCreate(&effect->desc.uuid, sessionId, ioId, &effect->handle) != 0) {
+        fprintf(stderr, "cannot create %s\n", effect->desc.name);
+        return false;
+    }
+    effect->auxiliary =
+            (effect->desc.flags & EFFECT_FLAG_TYPE_MASK) == EFFECT_FLAG_TYPE_AUXILIARY;
+    effect->inChannels = effect->auxiliary ? AUDIO_CHANNEL_OUT_MONO : inChannels;
+    effect->outChannels = inChannels;
+    if (!memcmp(&effect->desc.type, EFFECT_UIID_DOWNMIX, sizeof(effect_uuid_t))) {
+        effect->outChannels = AUDIO_CHANNEL_OUT_STEREO;
+    }
+
+    effect_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.inputCfg.channels = effect->inChannels;
+    config.outputCfg.channels = effect->outChannels;
+    config.inputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+    config.outputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+    config.inputCfg.samplingRate = sampleRate;
+    config.outputCfg.samplingRate = sampleRate;
+    config.inputCfg.accessMode = EFFECT_BUFFER_ACCESS_READ;
+    // auxiliary effects add the wet signal to the dry one, as on an AudioFlinger output
+    config.outputCfg.accessMode = effect->auxiliary ?
+            EFFECT_BUFFER_ACCESS_ACCUMULATE : EFFECT_BUFFER_ACCESS_WRITE;
+    config.inputCfg.mask = EFFECT_CONFIG_ALL;
+    config.outputCfg.mask = EFFECT_CONFIG_ALL;
+    config.inputCfg.buffer.frameCount = frameCount;
+    config.outputCfg.buffer.frameCount = frameCount;
+
+    int status = command(effect, EFFECT_CMD_INIT, 0, NULL);
+    if (status == 0) {
+        status = command(effect, EFFECT_CMD_SET_CONFIG, sizeof(config), &config);
+    }
+    if (status == 0) {
+        status = command(effect, EFFECT_CMD_ENABLE, 0, NULL);
+    }
+    for (size_t i = 0; status == 0 && i < effect->numParams; i++) {
+        status = setParam(effect, effect->params[i]);
+    }
+    if (status != 0) {
+        fprintf(stderr, "cannot set up %s: %d\n", effect->spec, status);
+        return false;
+    }
+    return true;
+}
+
+// Runs one block through the chain. in and out hold frameCount frames of up to 8 channels.
+static bool processBlock(ChainEffect* chain, size_t numEffects, int16_t* in, int16_t* out,
+        int32_t* aux, size_t frameCount) {
+    for (size_t i = 0; i < numEffects; i++) {
+        ChainEffect* effect = &chain[i];
+        audio_buffer_t inBuffer, outBuffer;
+        inBuffer.frameCount = frameCount;
+        outBuffer.frameCount = frameCount;
+        outBuffer.s16 = out;
+        if (effect->auxiliary) {
+            // what AudioMixer sends to an auxiliary effect: the mono mix at unity send level
+            uint32_t channels = popcount(effect->outChannels);
+            for (size_t j = 0; j < frameCount; j++) {
+                int32_t sum = 0;
+                for (uint32_t c = 0; c < channels; c++) {
+                    sum += in[j * channels + c];
+                }
+                aux[j] = (sum / (int32_t) channels) << 12;
+            }
+            memcpy(out, in, frameCount * channels * sizeof(int16_t));
+            inBuffer.s32 = aux;
+        } else {
+            inBuffer.s16 = in;
+        }
+
+        struct mallinfo before = mallinfo();
+        int64_t start = now_ns();
+        int status = (*effect->handle)->process(effect->handle, &inBuffer, &outBuffer);
+        effect->processNs += now_ns() - start;
+        struct mallinfo after = mallinfo();
+        if (after.uordblks != before.uordblks || after.hblkhd != before.hblkhd) {
+            effect->heapChanges++;
+            effect->heapGrowth += (after.uordblks - before.uordblks) +
+                    (after.hblkhd - before.hblkhd);
+        }
+
+        // -ENODATA only means the effect has nothing more to add
+        if (status != 0 && status != -ENODATA) {
+            fprintf(stderr, "%s process() failed: %d\n", effect->desc.name, status);
+            return false;
+        }
+        int16_t* tmp = in;
+        in = out;
+        out = tmp;
+    }
+    // the output of the chain ends up in "in", which is the caller's "in" after an even number
+    // of effects
+    if (!(numEffects & 1)) {
+        memcpy(out, in, frameCount * popcount(chain[numEffects - 1].outChannels) *
+                sizeof(int16_t));
+    }
+    return true;
+}
+
+static bool compare(const Wav& output, const char* path) {
+    Wav golden;
+    if (!readWav(path, &golden)) {
+        return false;
+    }
+    if (golden.channels != output.channels || golden.frames != output.frames) {
+        printf("golden %s: %u channels, %u frames, output: %u channels, %u frames\n",
+                path, golden.channels, (unsigned) golden.frames, output.channels,
+                (unsigned) output.frames);
+        return false;
+    }
+    size_t mismatches = 0;
+    size_t first = 0;
+    int maxDiff = 0;
+    for (size_t i = 0; i < output.frames * output.channels; i++) {
+        int diff = abs(output.samples[i] - golden.samples[i]);
+        if (diff != 0) {
+            if (mismatches++ == 0) {
+                first = i;
+            }
+            if (diff > maxDiff) {
+                maxDiff = diff;
+            }
+        }
+    }
+    if (mismatches != 0) {
+        printf("NOT bit exact with %s: %u samples differ, first at frame %u, "
+                "max difference %d\n", path, (unsigned) mismatches,
+                (unsigned) (first / output.channels), maxDiff);
+        return false;
+    }
+    printf("bit exact with %s\n", path);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    const char* const progname = argv[0];
+    ChainEffect chain[MAX_EFFECTS];
+    size_t numEffects = 0;
+    size_t frameCount = 256;
+    int passes = 1;
+    const char* outputPath = NULL;
+    const char* goldenPath = NULL;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "le:f:r:o:g:")) != -1) {
+        switch (ch) {
+        case 'l':
+            listEffects();
+            return 0;
+        case 'e':
+            if (numEffects == MAX_EFFECTS) {
+                fprintf(stderr, "too many effects\n");
+                return 1;
+            }
+            if (!parseSpec(optarg, &chain[numEffects])) {
+                return 1;
+            }
+            numEffects++;
+            break;
+        case 'f':
+            frameCount = atoi(optarg);
+            break;
+        case 'r':
+            passes = atoi(optarg);
+            break;
+        case 'o':
+            outputPath = optarg;
+            break;
+        case 'g':
+            goldenPath = optarg;
+            break;
+        default:
+            return usage(progname);
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (argc != 1 || numEffects == 0 || frameCount == 0 || passes <= 0) {
+        return usage(progname);
+    }
+
+    Wav input;
+    if (!readWav(argv[0], &input)) {
+        return 1;
+    }
+    uint32_t channels = channelMask(input.channels);
+    if (channels == 0) {
+        fprintf(stderr, "unsupported channel count %u\n", input.channels);
+        return 1;
+    }
+    for (size_t i = 0; i < numEffects; i++) {
+        if (!setUp(&chain[i], channels, input.sampleRate, frameCount)) {
+            return 1;
+        }
+        channels = chain[i].outChannels;
+    }
+
+    Wav output;
+    output.channels = popcount(channels);
+    output.sampleRate = input.sampleRate;
+    output.frames = input.frames;
+    output.samples = (int16_t*) malloc(output.frames * output.channels * sizeof(int16_t));
+
+    // 8 channels is the most any effect takes
+    int16_t* in = new int16_t[frameCount * 8];
+    int16_t* out = new int16_t[frameCount * 8];
+    int32_t* aux = new int32_t[frameCount];
+    for (int pass = 0; pass < passes; pass++) {
+        for (size_t frame = 0; frame < input.frames; frame += frameCount) {
+            // the last block is padded with silence so that every call has frameCount frames
+            size_t frames = input.frames - frame;
+            if (frames > frameCount) {
+                frames = frameCount;
+            }
+            memset(in, 0, frameCount * input.channels * sizeof(int16_t));
+            memcpy(in, input.samples + frame * input.channels,
+                    frames * input.channels * sizeof(int16_t));
+            if (!processBlock(chain, numEffects, in, out, aux, frameCount)) {
+                return 1;
+            }
+            if (pass == 0) {
+                memcpy(output.samples + frame * output.channels, out,
+                        frames * output.channels * sizeof(int16_t));
+            }
+        }
+    }
+
+    const double totalFrames = (double) input.frames * passes;
+    int64_t totalNs = 0;
+    printf("%u frames at %u Hz, %u frames per call, %d passes\n",
+            (unsigned) input.frames, input.sampleRate, (unsigned) frameCount, passes);
+    for (size_t i = 0; i < numEffects; i++) {
+        printf("%-32s %8.1f ns/frame, heap changed in %d process() calls (%ld bytes)\n",
+                chain[i].desc.name, chain[i].processNs / totalFrames, chain[i].heapChanges,
+                chain[i].heapGrowth);
+        totalNs += chain[i].processNs;
+        EffectRelease(chain[i].handle);
+    }
+    printf("%-32s %8.1f ns/frame, %.2f%% of real time\n", "chain", totalNs / totalFrames,
+            totalNs / 1E7 * input.sampleRate / totalFrames);
+
+    delete[] in;
+    delete[] out;
+    delete[] aux;
+
+    if (outputPath != NULL && !writeWav(outputPath, output)) {
+        return 1;
+    }
+    if (goldenPath != NULL && !compare(output, goldenPath)) {
+        return 1;
+    }
+    return 0;
+}
@@ -101,7 +101,8 @@ LOCAL_SRC_FILES:= \
     Common/src/LVC_MixInSoft_D16C31_SAT.c \
     Common/src/AGC_MIX_VOL_2St1Mon_D32_WRA.c \
     Common/src/LVM_Timer.c \
-    Common/src/LVM_Timer_Init.c
+    Common/src/LVM_Timer_Init.c \
+    Common/src/LVM_Simd.c
 
 LOCAL_MODULE:= libmusicbundle
 
@@ -177,3 +178,24 @@ LOCAL_C_INCLUDES += \
     $(LOCAL_PATH)/Common/src
 
 include $(BUILD_STATIC_LIBRARY)
+
+# Bit-exactness test and benchmark of the SIMD kernels
+include $(CLEAR_VARS)
+
+LOCAL_ARM_MODE := arm
+
+LOCAL_SRC_FILES:= \
+    Common/tests/test-lvm-kernels.c
+
+LOCAL_MODULE:= test-lvm-kernels
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_STATIC_LIBRARIES := \
+    libmusicbundle
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/Common/lib \
+    $(LOCAL_PATH)/Common/src
+
+include $(BUILD_EXECUTABLE)
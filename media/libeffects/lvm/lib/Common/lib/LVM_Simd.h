@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LVM_SIMD_H_
+#define _LVM_SIMD_H_
+
+#include "LVM_Types.h"
+
+/**********************************************************************************
+   SIMD SUPPORT
+
+   The stereo biquads, first order filters and mixers have NEON and SSE2 versions
+   which are compiled in when the target supports them (LVM_SIMD is defined).
+   They give bit-exact results with the C versions, which stay the reference and
+   are used when LVM_SimdEnabled is LVM_FALSE.
+
+   LVM_V2 holds the left and right 32-bit samples of a stereo filter, LVM_V8 holds
+   eight 16-bit samples. With SSE2 the two LVM_V2 samples are in lanes 0 and 2,
+   the other lanes are don't care.
+***********************************************************************************/
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define LVM_SIMD_NEON
+#define LVM_SIMD
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define LVM_SIMD_SSE2
+#define LVM_SIMD
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* Selects the SIMD versions at run time, LVM_TRUE by default */
+extern LVM_INT16 LVM_SimdEnabled;
+
+#if defined(LVM_SIMD_NEON)
+
+typedef int32x2_t LVM_V2;
+typedef int16x8_t LVM_V8;
+
+/* Sign extends pSrc[0] and pSrc[1] */
+static inline LVM_V2 LVM_V2_Load16(const LVM_INT16 *pSrc)
+{
+    return vset_lane_s32(pSrc[1], vdup_n_s32(pSrc[0]), 1);
+}
+
+static inline LVM_V2 LVM_V2_Load32(const LVM_INT32 *pSrc)
+{
+    return vld1_s32((const int32_t *)pSrc);
+}
+
+static inline void LVM_V2_Store32(LVM_INT32 *pDst, LVM_V2 a)
+{
+    vst1_s32((int32_t *)pDst, a);
+}
+
+/* Keeps the 16 LSBs */
+static inline void LVM_V2_Store16(LVM_INT16 *pDst, LVM_V2 a)
+{
+    pDst[0] = (LVM_INT16)vget_lane_s32(a, 0);
+    pDst[1] = (LVM_INT16)vget_lane_s32(a, 1);
+}
+
+/* Saturates to 16 bits */
+static inline void LVM_V2_Store16Sat(LVM_INT16 *pDst, LVM_V2 a)
+{
+    int16x4_t s = vqmovn_s32(vcombine_s32(a, a));
+    pDst[0] = vget_lane_s16(s, 0);
+    pDst[1] = vget_lane_s16(s, 1);
+}
+
+static inline LVM_V2 LVM_V2_Dup(LVM_INT32 a)
+{
+    return vdup_n_s32(a);
+}
+
+static inline LVM_V2 LVM_V2_Add(LVM_V2 a, LVM_V2 b)
+{
+    return vadd_s32(a, b);
+}
+
+static inline LVM_V2 LVM_V2_Sub(LVM_V2 a, LVM_V2 b)
+{
+    return vsub_s32(a, b);
+}
+
+/* 32 LSBs of a * b */
+static inline LVM_V2 LVM_V2_Mul(LVM_V2 a, LVM_V2 b)
+{
+    return vmul_s32(a, b);
+}
+
+/* 32 LSBs of (a * b) >> Shift, the product being 64-bit */
+static inline LVM_V2 LVM_V2_MulShr(LVM_V2 a, LVM_V2 b, LVM_INT16 Shift)
+{
+    return vmovn_s64(vshlq_s64(vmull_s32(a, b), vdupq_n_s64(-Shift)));
+}
+
+static inline LVM_V2 LVM_V2_Shl(LVM_V2 a, LVM_INT16 Shift)
+{
+    return vshl_s32(a, vdup_n_s32(Shift));
+}
+
+/* Arithmetic shift */
+static inline LVM_V2 LVM_V2_Shr(LVM_V2 a, LVM_INT16 Shift)
+{
+    return vshl_s32(a, vdup_n_s32(-Shift));
+}
+
+static inline LVM_V8 LVM_V8_Load(const LVM_INT16 *pSrc)
+{
+    return vld1q_s16(pSrc);
+}
+
+static inline void LVM_V8_Store(LVM_INT16 *pDst, LVM_V8 a)
+{
+    vst1q_s16(pDst, a);
+}
+
+static inline LVM_V8 LVM_V8_Dup(LVM_INT16 a)
+{
+    return vdupq_n_s16(a);
+}
+
+/* { a, b, a, b, a, b, a, b } */
+static inline LVM_V8 LVM_V8_Interleave(LVM_INT16 a, LVM_INT16 b)
+{
+    return vreinterpretq_s16_u32(vdupq_n_u32((LVM_UINT16)a | ((uint32_t)(LVM_UINT16)b << 16)));
+}
+
+/* { a, a, a, a, b, b, b, b } */
+static inline LVM_V8 LVM_V8_Halves(LVM_INT16 a, LVM_INT16 b)
+{
+    return vcombine_s16(vdup_n_s16(a), vdup_n_s16(b));
+}
+
+/* 16 LSBs of (a * b) >> 15 */
+static inline LVM_V8 LVM_V8_MulQ15(LVM_V8 a, LVM_V8 b)
+{
+    return vcombine_s16(vshrn_n_s32(vmull_s16(vget_low_s16(a), vget_low_s16(b)), 15),
+                        vshrn_n_s32(vmull_s16(vget_high_s16(a), vget_high_s16(b)), 15));
+}
+
+/* (a * b) >> 15 saturated to 16 bits */
+static inline LVM_V8 LVM_V8_MulQ15Sat(LVM_V8 a, LVM_V8 b)
+{
+    return vcombine_s16(vqshrn_n_s32(vmull_s16(vget_low_s16(a), vget_low_s16(b)), 15),
+                        vqshrn_n_s32(vmull_s16(vget_high_s16(a), vget_high_s16(b)), 15));
+}
+
+/* ((a * b) >> 15) + ((c * d) >> 15) saturated to 16 bits */
+static inline LVM_V8 LVM_V8_MulQ15AddSat(LVM_V8 a, LVM_V8 b, LVM_V8 c, LVM_V8 d)
+{
+    int32x4_t lo = vaddq_s32(vshrq_n_s32(vmull_s16(vget_low_s16(a), vget_low_s16(b)), 15),
+                             vshrq_n_s32(vmull_s16(vget_low_s16(c), vget_low_s16(d)), 15));
+    int32x4_t hi = vaddq_s32(vshrq_n_s32(vmull_s16(vget_high_s16(a), vget_high_s16(b)), 15),
+                             vshrq_n_s32(vmull_s16(vget_high_s16(c), vget_high_s16(d)), 15));
+    return vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi));
+}
+
+#elif defined(LVM_SIMD_SSE2)
+
+typedef __m128i LVM_V2;
+typedef __m128i LVM_V8;
+
+static inline LVM_V2 LVM_V2_Load16(const LVM_INT16 *pSrc)
+{
+    return _mm_set_epi32(0, pSrc[1], 0, pSrc[0]);
+}
+
+static inline LVM_V2 LVM_V2_Load32(const LVM_INT32 *pSrc)
+{
+    return _mm_set_epi32(0, (int)pSrc[1], 0, (int)pSrc[0]);
+}
+
+static inline void LVM_V2_Store32(LVM_INT32 *pDst, LVM_V2 a)
+{
+    pDst[0] = _mm_cvtsi128_si32(a);
+    pDst[1] = _mm_cvtsi128_si32(_mm_srli_si128(a, 8));
+}
+
+static inline void LVM_V2_Store16(LVM_INT16 *pDst, LVM_V2 a)
+{
+    pDst[0] = (LVM_INT16)_mm_cvtsi128_si32(a);
+    pDst[1] = (LVM_INT16)_mm_cvtsi128_si32(_mm_srli_si128(a, 8));
+}
+
+static inline void LVM_V2_Store16Sat(LVM_INT16 *pDst, LVM_V2 a)
+{
+    __m128i s = _mm_packs_epi32(a, a);
+    pDst[0] = (LVM_INT16)_mm_extract_epi16(s, 0);
+    pDst[1] = (LVM_INT16)_mm_extract_epi16(s, 2);
+}
+
+static inline LVM_V2 LVM_V2_Dup(LVM_INT32 a)
+{
+    return _mm_set1_epi32((int)a);
+}
+
+static inline LVM_V2 LVM_V2_Add(LVM_V2 a, LVM_V2 b)
+{
+    return _mm_add_epi32(a, b);
+}
+
+static inline LVM_V2 LVM_V2_Sub(LVM_V2 a, LVM_V2 b)
+{
+    return _mm_sub_epi32(a, b);
+}
+
+/* The low half of the unsigned product is the low half of the signed one */
+static inline LVM_V2 LVM_V2_Mul(LVM_V2 a, LVM_V2 b)
+{
+    return _mm_mul_epu32(a, b);
+}
+
+/* SSE2 only has an unsigned 32x32 multiply. The signed product is the unsigned one
+   minus ((a < 0 ? b : 0) + (b < 0 ? a : 0)) << 32, so after the shift the 32 LSBs
+   only differ by that correction shifted left by 32 - Shift. */
+static inline LVM_V2 LVM_V2_MulShr(LVM_V2 a, LVM_V2 b, LVM_INT16 Shift)
+{
+    __m128i p = _mm_srl_epi64(_mm_mul_epu32(a, b), _mm_cvtsi32_si128(Shift));
+    __m128i c = _mm_add_epi32(_mm_and_si128(_mm_srai_epi32(a, 31), b),
+                              _mm_and_si128(_mm_srai_epi32(b, 31), a));
+    return _mm_sub_epi32(p, _mm_sll_epi32(c, _mm_cvtsi32_si128(32 - Shift)));
+}
+
+static inline LVM_V2 LVM_V2_Shl(LVM_V2 a, LVM_INT16 Shift)
+{
+    return _mm_sll_epi32(a, _mm_cvtsi32_si128(Shift));
+}
+
+static inline LVM_V2 LVM_V2_Shr(LVM_V2 a, LVM_INT16 Shift)
+{
+    return _mm_sra_epi32(a, _mm_cvtsi32_si128(Shift));
+}
+
+static inline LVM_V8 LVM_V8_Load(const LVM_INT16 *pSrc)
+{
+    return _mm_loadu_si128((const __m128i *)pSrc);
+}
+
+static inline void LVM_V8_Store(LVM_INT16 *pDst, LVM_V8 a)
+{
+    _mm_storeu_si128((__m128i *)pDst, a);
+}
+
+static inline LVM_V8 LVM_V8_Dup(LVM_INT16 a)
+{
+    return _mm_set1_epi16(a);
+}
+
+static inline LVM_V8 LVM_V8_Interleave(LVM_INT16 a, LVM_INT16 b)
+{
+    return _mm_set1_epi32((LVM_UINT16)a | ((unsigned int)(LVM_UINT16)b << 16));
+}
+
+static inline LVM_V8 LVM_V8_Halves(LVM_INT16 a, LVM_INT16 b)
+{
+    return _mm_unpacklo_epi64(_mm_set1_epi16(a), _mm_set1_epi16(b));
+}
+
+/* Bits 15 to 30 of the products */
+static inline LVM_V8 LVM_V8_MulQ15(LVM_V8 a, LVM_V8 b)
+{
+    return _mm_or_si128(_mm_slli_epi16(_mm_mulhi_epi16(a, b), 1),
+                        _mm_srli_epi16(_mm_mullo_epi16(a, b), 15));
+}
+
+static inline LVM_V8 LVM_V8_MulQ15Sat(LVM_V8 a, LVM_V8 b)
+{
+    __m128i lo = _mm_mullo_epi16(a, b);
+    __m128i hi = _mm_mulhi_epi16(a, b);
+    return _mm_packs_epi32(_mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 15),
+                           _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 15));
+}
+
+static inline LVM_V8 LVM_V8_MulQ15AddSat(LVM_V8 a, LVM_V8 b, LVM_V8 c, LVM_V8 d)
+{
+    __m128i lo1 = _mm_mullo_epi16(a, b);
+    __m128i hi1 = _mm_mulhi_epi16(a, b);
+    __m128i lo2 = _mm_mullo_epi16(c, d);
+    __m128i hi2 = _mm_mulhi_epi16(c, d);
+    __m128i sum1 = _mm_add_epi32(_mm_srai_epi32(_mm_unpacklo_epi16(lo1, hi1), 15),
+                                 _mm_srai_epi32(_mm_unpacklo_epi16(lo2, hi2), 15));
+    __m128i sum2 = _mm_add_epi32(_mm_srai_epi32(_mm_unpackhi_epi16(lo1, hi1), 15),
+                                 _mm_srai_epi32(_mm_unpackhi_epi16(lo2, hi2), 15));
+    return _mm_packs_epi32(sum1, sum2);
+}
+
+#endif /* LVM_SIMD_SSE2 */
+
+/* The filters use 16-bit multiplies for these coefficients, the SIMD versions are
+   only exact when they really fit in 16 bits */
+#define LVM_FITS_INT16(a)   ((a) >= -32768 && (a) <= 32767)
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _LVM_SIMD_H_ */
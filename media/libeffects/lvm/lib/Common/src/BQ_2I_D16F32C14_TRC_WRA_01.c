@@ -18,6 +18,7 @@
 #include "BIQUAD.h"
 #include "BQ_2I_D16F32Css_TRC_WRA_01_Private.h"
 #include "LVM_Macros.h"
+#include "LVM_Simd.h"
 
 /**************************************************************************
  ASSUMPTIONS:
@@ -37,6 +38,53 @@
  pBiquadState->pDelays[7] is y(n-2)R in Q16 format
 ***************************************************************************/
 
+#ifdef LVM_SIMD
+/* Filters both channels at once, bit-exact with the C version */
+static void BQ_2I_D16F32C14_TRC_WRA_01_Simd(PFilter_State           pBiquadState,
+                                            LVM_INT16               *pDataIn,
+                                            LVM_INT16               *pDataOut,
+                                            LVM_INT16               NrSamples)
+    {
+        LVM_V2 A2 = LVM_V2_Dup(pBiquadState->coefs[0]);
+        LVM_V2 A1 = LVM_V2_Dup(pBiquadState->coefs[1]);
+        LVM_V2 A0 = LVM_V2_Dup(pBiquadState->coefs[2]);
+        LVM_V2 B2 = LVM_V2_Dup(pBiquadState->coefs[3]);
+        LVM_V2 B1 = LVM_V2_Dup(pBiquadState->coefs[4]);
+        LVM_V2 x1 = LVM_V2_Load32(&pBiquadState->pDelays[0]);  /* x(n-1) in Q0 */
+        LVM_V2 x2 = LVM_V2_Load32(&pBiquadState->pDelays[2]);  /* x(n-2) in Q0 */
+        LVM_V2 y1 = LVM_V2_Load32(&pBiquadState->pDelays[4]);  /* y(n-1) in Q16 */
+        LVM_V2 y2 = LVM_V2_Load32(&pBiquadState->pDelays[6]);  /* y(n-2) in Q16 */
+        LVM_V2 x, yn;
+        LVM_INT16 ii;
+
+        for (ii = NrSamples; ii != 0; ii--)
+        {
+            x = LVM_V2_Load16(pDataIn);
+            pDataIn += 2;
+
+            /* yn = A2*x(n-2) + A1*x(n-1) + A0*x(n) + ((-B2*y(n-2) + -B1*y(n-1))>>16) in Q14 */
+            yn = LVM_V2_Mul(A2, x2);
+            yn = LVM_V2_Add(yn, LVM_V2_Mul(A1, x1));
+            yn = LVM_V2_Add(yn, LVM_V2_Mul(A0, x));
+            yn = LVM_V2_Add(yn, LVM_V2_MulShr(y2, B2, 16));
+            yn = LVM_V2_Add(yn, LVM_V2_MulShr(y1, B1, 16));
+
+            y2 = y1;
+            x2 = x1;
+            y1 = LVM_V2_Shl(yn, 2);
+            x1 = x;
+
+            LVM_V2_Store16(pDataOut, LVM_V2_Shr(yn, 14));
+            pDataOut += 2;
+        }
+
+        LVM_V2_Store32(&pBiquadState->pDelays[0], x1);
+        LVM_V2_Store32(&pBiquadState->pDelays[2], x2);
+        LVM_V2_Store32(&pBiquadState->pDelays[4], y1);
+        LVM_V2_Store32(&pBiquadState->pDelays[6], y2);
+    }
+#endif
+
 void BQ_2I_D16F32C14_TRC_WRA_01 (           Biquad_Instance_t       *pInstance,
                                             LVM_INT16                    *pDataIn,
                                             LVM_INT16                    *pDataOut,
@@ -46,6 +94,14 @@ void BQ_2I_D16F32C14_TRC_WRA_01 (           Biquad_Instance_t       *pInstance,
         LVM_INT16 ii;
         PFilter_State pBiquadState = (PFilter_State) pInstance;
 
+#ifdef LVM_SIMD
+        if (LVM_SimdEnabled)
+        {
+            BQ_2I_D16F32C14_TRC_WRA_01_Simd(pBiquadState, pDataIn, pDataOut, NrSamples);
+            return;
+        }
+#endif
+
         for (ii = NrSamples; ii != 0; ii--)
         {
 
@@ -18,6 +18,7 @@
 #include "BIQUAD.h"
 #include "BQ_2I_D32F32Cll_TRC_WRA_01_Private.h"
 #include "LVM_Macros.h"
+#include "LVM_Simd.h"
 
 /**************************************************************************
  ASSUMPTIONS:
@@ -37,6 +38,53 @@
  pBiquadState->pDelays[7] is y(n-2)R in Q0 format
 ***************************************************************************/
 
+#ifdef LVM_SIMD
+/* Filters both channels at once, bit-exact with the C version */
+static void BQ_2I_D32F32C30_TRC_WRA_01_Simd(PFilter_State           pBiquadState,
+                                            LVM_INT32               *pDataIn,
+                                            LVM_INT32               *pDataOut,
+                                            LVM_INT16               NrSamples)
+    {
+        LVM_V2 A2 = LVM_V2_Dup(pBiquadState->coefs[0]);
+        LVM_V2 A1 = LVM_V2_Dup(pBiquadState->coefs[1]);
+        LVM_V2 A0 = LVM_V2_Dup(pBiquadState->coefs[2]);
+        LVM_V2 B2 = LVM_V2_Dup(pBiquadState->coefs[3]);
+        LVM_V2 B1 = LVM_V2_Dup(pBiquadState->coefs[4]);
+        LVM_V2 x1 = LVM_V2_Load32(&pBiquadState->pDelays[0]);
+        LVM_V2 x2 = LVM_V2_Load32(&pBiquadState->pDelays[2]);
+        LVM_V2 y1 = LVM_V2_Load32(&pBiquadState->pDelays[4]);
+        LVM_V2 y2 = LVM_V2_Load32(&pBiquadState->pDelays[6]);
+        LVM_V2 x, yn;
+        LVM_INT16 ii;
+
+        for (ii = NrSamples; ii != 0; ii--)
+        {
+            x = LVM_V2_Load32(pDataIn);
+            pDataIn += 2;
+
+            /* Each product is shifted by 30 on its own, as MUL32x32INTO32 does */
+            yn = LVM_V2_MulShr(A2, x2, 30);
+            yn = LVM_V2_Add(yn, LVM_V2_MulShr(A1, x1, 30));
+            yn = LVM_V2_Add(yn, LVM_V2_MulShr(A0, x, 30));
+            yn = LVM_V2_Add(yn, LVM_V2_MulShr(B2, y2, 30));
+            yn = LVM_V2_Add(yn, LVM_V2_MulShr(B1, y1, 30));
+
+            y2 = y1;
+            x2 = x1;
+            y1 = yn;
+            x1 = x;
+
+            LVM_V2_Store32(pDataOut, yn);
+            pDataOut += 2;
+        }
+
+        LVM_V2_Store32(&pBiquadState->pDelays[0], x1);
+        LVM_V2_Store32(&pBiquadState->pDelays[2], x2);
+        LVM_V2_Store32(&pBiquadState->pDelays[4], y1);
+        LVM_V2_Store32(&pBiquadState->pDelays[6], y2);
+    }
+#endif
+
 void BQ_2I_D32F32C30_TRC_WRA_01 (           Biquad_Instance_t       *pInstance,
                                             LVM_INT32                    *pDataIn,
                                             LVM_INT32                    *pDataOut,
@@ -48,6 +96,14 @@ void BQ_2I_D32F32C30_TRC_WRA_01 (           Biquad_Instance_t       *pInstance,
         LVM_INT16 ii;
         PFilter_State pBiquadState = (PFilter_State) pInstance;
 
+#ifdef LVM_SIMD
+        if (LVM_SimdEnabled)
+        {
+            BQ_2I_D32F32C30_TRC_WRA_01_Simd(pBiquadState, pDataIn, pDataOut, NrSamples);
+            return;
+        }
+#endif
+
          for (ii = NrSamples; ii != 0; ii--)
          {
 
@@ -18,6 +18,7 @@
 #include "BIQUAD.h"
 #include "FO_2I_D16F32Css_LShx_TRC_WRA_01_Private.h"
 #include "LVM_Macros.h"
+#include "LVM_Simd.h"
 
 /**************************************************************************
 ASSUMPTIONS:
@@ -33,6 +34,52 @@ pBiquadState->pDelays[2] is x(n-1)R in Q15 format
 pBiquadState->pDelays[3] is y(n-1)R in Q30 format
 ***************************************************************************/
 
+#ifdef LVM_SIMD
+/* Filters both channels at once, bit-exact with the C version */
+static void FO_2I_D16F32C15_LShx_TRC_WRA_01_Simd(PFilter_State           pBiquadState,
+                                                 LVM_INT16               *pDataIn,
+                                                 LVM_INT16               *pDataOut,
+                                                 LVM_INT16               NrSamples)
+    {
+        LVM_V2 A1 = LVM_V2_Dup(pBiquadState->coefs[0]);
+        LVM_V2 A0 = LVM_V2_Dup(pBiquadState->coefs[1]);
+        LVM_V2 B1 = LVM_V2_Dup(pBiquadState->coefs[2]);
+        LVM_INT16 Shift = (LVM_INT16)(15 - pBiquadState->Shift);
+        LVM_INT32 Delays[2];
+        LVM_V2 x1, y1, x;
+        LVM_INT16 ii;
+
+        /* The delays of each channel are next to each other */
+        Delays[0] = pBiquadState->pDelays[0];
+        Delays[1] = pBiquadState->pDelays[2];
+        x1 = LVM_V2_Load32(Delays);                             /* x(n-1) in Q15 */
+        Delays[0] = pBiquadState->pDelays[1];
+        Delays[1] = pBiquadState->pDelays[3];
+        y1 = LVM_V2_Load32(Delays);                             /* y(n-1) in Q30 */
+
+        for (ii = NrSamples; ii != 0; ii--)
+        {
+            x = LVM_V2_Load16(pDataIn);
+            pDataIn += 2;
+
+            /* yn = A1*x(n-1) + A0*x(n) + ((-B1*y(n-1))>>15) in Q30 */
+            y1 = LVM_V2_Add(LVM_V2_Add(LVM_V2_Mul(A1, x1), LVM_V2_Mul(A0, x)),
+                            LVM_V2_MulShr(y1, B1, 15));
+            x1 = x;
+
+            LVM_V2_Store16Sat(pDataOut, LVM_V2_Shr(y1, Shift));
+            pDataOut += 2;
+        }
+
+        LVM_V2_Store32(Delays, x1);
+        pBiquadState->pDelays[0] = Delays[0];
+        pBiquadState->pDelays[2] = Delays[1];
+        LVM_V2_Store32(Delays, y1);
+        pBiquadState->pDelays[1] = Delays[0];
+        pBiquadState->pDelays[3] = Delays[1];
+    }
+#endif
+
 void FO_2I_D16F32C15_LShx_TRC_WRA_01(Biquad_Instance_t       *pInstance,
                                      LVM_INT16               *pDataIn,
                                      LVM_INT16               *pDataOut,
@@ -45,6 +92,14 @@ void FO_2I_D16F32C15_LShx_TRC_WRA_01(Biquad_Instance_t       *pInstance,
         LVM_INT16   Shift;
         PFilter_State pBiquadState = (PFilter_State) pInstance;
 
+#ifdef LVM_SIMD
+        if (LVM_SimdEnabled)
+        {
+            FO_2I_D16F32C15_LShx_TRC_WRA_01_Simd(pBiquadState, pDataIn, pDataOut, NrSamples);
+            return;
+        }
+#endif
+
         NegSatValue = LVM_MAXINT_16 +1;
         NegSatValue = -NegSatValue;
 
@@ -22,6 +22,7 @@
 #include "LVC_Mixer_Private.h"
 #include "LVM_Macros.h"
 #include "ScalarArithmetic.h"
+#include "LVM_Simd.h"
 
 
 /**********************************************************************************
@@ -45,6 +46,21 @@ void LVC_Core_MixHard_1St_2i_D16C31_SAT( LVMixer3_st        *ptrInstance1,
     Current1Short = (LVM_INT16)(pInstance1->Current >> 16);
     Current2Short = (LVM_INT16)(pInstance2->Current >> 16);
 
+#ifdef LVM_SIMD
+    /* 4 stereo samples at a time, the loop below does the rest */
+    if (LVM_SimdEnabled)
+    {
+        LVM_V8 Gain = LVM_V8_Interleave(Current1Short, Current2Short);
+
+        for (; n >= 4; n -= 4)
+        {
+            LVM_V8_Store(dst, LVM_V8_MulQ15Sat(LVM_V8_Load(src), Gain));
+            src += 8;
+            dst += 8;
+        }
+    }
+#endif
+
     for (ii = n; ii != 0; ii--)
     {
         Temp = ((LVM_INT32)*(src++) * (LVM_INT32)Current1Short)>>15;
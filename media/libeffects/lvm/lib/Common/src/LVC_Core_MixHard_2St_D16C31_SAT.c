@@ -20,6 +20,7 @@
 ***********************************************************************************/
 
 #include "LVC_Mixer_Private.h"
+#include "LVM_Simd.h"
 
 /**********************************************************************************
    FUNCTION LVCore_MIXHARD_2ST_D16C31_SAT
@@ -43,6 +44,21 @@ void LVC_Core_MixHard_2St_D16C31_SAT( LVMixer3_st *ptrInstance1,
     Current1Short = (LVM_INT16)(pInstance1->Current >> 16);
     Current2Short = (LVM_INT16)(pInstance2->Current >> 16);
 
+#ifdef LVM_SIMD
+    /* 8 samples at a time, the loop below does the rest */
+    if (LVM_SimdEnabled){
+        LVM_V8 Gain1 = LVM_V8_Dup(Current1Short);
+        LVM_V8 Gain2 = LVM_V8_Dup(Current2Short);
+
+        for (; n >= 8; n -= 8){
+            LVM_V8_Store(dst, LVM_V8_MulQ15AddSat(LVM_V8_Load(src1), Gain1, LVM_V8_Load(src2), Gain2));
+            src1 += 8;
+            src2 += 8;
+            dst += 8;
+        }
+    }
+#endif
+
     for (ii = n; ii != 0; ii--){
         Temp = (((LVM_INT32)*(src1++) * (LVM_INT32)Current1Short)>>15) +
                (((LVM_INT32)*(src2++) * (LVM_INT32)Current2Short)>>15);
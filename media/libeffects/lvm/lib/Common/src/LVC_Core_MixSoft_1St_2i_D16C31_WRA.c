@@ -22,6 +22,84 @@
 #include "LVC_Mixer_Private.h"
 #include "ScalarArithmetic.h"
 #include "LVM_Macros.h"
+#include "LVM_Simd.h"
+
+#ifdef LVM_SIMD
+/**********************************************************************************
+   FUNCTION LVC_Core_MixSoft_1St_2i_D16C31_WRA_Simd
+
+   Steps both gains exactly like the C version, once every 4 stereo samples, and
+   applies them to the 4 stereo samples at once.
+***********************************************************************************/
+
+static LVM_INT32 LVC_Core_MixSoft_1St_2i_D16C31_WRA_Step(LVM_INT32 Current,
+                                                         LVM_INT32 Delta,
+                                                         LVM_INT32 Target)
+{
+    LVM_INT32   Temp;
+
+    if(Current<Target)
+    {
+        ADD2_SAT_32x32(Current,Delta,Temp);                                          /* Q31 + Q31 into Q31*/
+        Current=Temp;
+        if (Current > Target)
+            Current = Target;
+    }
+    else
+    {
+        Current -= Delta;                                                            /* Q31 + Q31 into Q31*/
+        if (Current < Target)
+            Current = Target;
+    }
+    return Current;
+}
+
+static void LVC_Core_MixSoft_1St_2i_D16C31_WRA_Simd( Mix_Private_st     *pInstanceL,
+                                                     Mix_Private_st     *pInstanceR,
+                                                     const LVM_INT16    *src,
+                                                     LVM_INT16          *dst,
+                                                     LVM_INT16          n)
+{
+    LVM_INT16   OutLoop;
+    LVM_INT16   InLoop;
+    LVM_INT16   CurrentShortL;
+    LVM_INT16   CurrentShortR;
+    LVM_INT32   ii;
+    LVM_INT32   CurrentL=pInstanceL->Current;
+    LVM_INT32   CurrentR=pInstanceR->Current;
+
+    InLoop = (LVM_INT16)(n >> 2); /* Process per 4 samples */
+    OutLoop = (LVM_INT16)(n - (InLoop << 2));
+
+    if (OutLoop)
+    {
+        CurrentL = LVC_Core_MixSoft_1St_2i_D16C31_WRA_Step(CurrentL, pInstanceL->Delta, pInstanceL->Target);
+        CurrentR = LVC_Core_MixSoft_1St_2i_D16C31_WRA_Step(CurrentR, pInstanceR->Delta, pInstanceR->Target);
+        CurrentShortL = (LVM_INT16)(CurrentL>>16);                                   /* From Q31 to Q15*/
+        CurrentShortR = (LVM_INT16)(CurrentR>>16);                                   /* From Q31 to Q15*/
+
+        for (ii = OutLoop*2; ii != 0; ii-=2)
+        {
+            *(dst++) = (LVM_INT16)(((LVM_INT32)*(src++) * (LVM_INT32)CurrentShortL)>>15);    /* Q15*Q15>>15 into Q15 */
+            *(dst++) = (LVM_INT16)(((LVM_INT32)*(src++) * (LVM_INT32)CurrentShortR)>>15);    /* Q15*Q15>>15 into Q15 */
+        }
+    }
+
+    for (ii = InLoop; ii != 0; ii--)
+    {
+        CurrentL = LVC_Core_MixSoft_1St_2i_D16C31_WRA_Step(CurrentL, pInstanceL->Delta, pInstanceL->Target);
+        CurrentR = LVC_Core_MixSoft_1St_2i_D16C31_WRA_Step(CurrentR, pInstanceR->Delta, pInstanceR->Target);
+        CurrentShortL = (LVM_INT16)(CurrentL>>16);
+        CurrentShortR = (LVM_INT16)(CurrentR>>16);
+
+        LVM_V8_Store(dst, LVM_V8_MulQ15(LVM_V8_Load(src), LVM_V8_Interleave(CurrentShortL, CurrentShortR)));
+        src += 8;
+        dst += 8;
+    }
+    pInstanceL->Current=CurrentL;
+    pInstanceR->Current=CurrentR;
+}
+#endif
 
 /**********************************************************************************
    FUNCTION LVC_Core_MixSoft_1St_2i_D16C31_WRA
@@ -51,6 +129,14 @@ void LVC_Core_MixSoft_1St_2i_D16C31_WRA( LVMixer3_st        *ptrInstance1,
 
     LVM_INT32   Temp;
 
+#ifdef LVM_SIMD
+    if (LVM_SimdEnabled)
+    {
+        LVC_Core_MixSoft_1St_2i_D16C31_WRA_Simd(pInstanceL, pInstanceR, src, dst, n);
+        return;
+    }
+#endif
+
     InLoop = (LVM_INT16)(n >> 2); /* Process per 4 samples */
     OutLoop = (LVM_INT16)(n - (InLoop << 2));
 
@@ -22,6 +22,86 @@
 #include "LVC_Mixer_Private.h"
 #include "LVM_Macros.h"
 #include "ScalarArithmetic.h"
+#include "LVM_Simd.h"
+
+#ifdef LVM_SIMD
+/**********************************************************************************
+   FUNCTION LVC_Core_MixSoft_1St_D16C31_WRA_Simd
+
+   Steps the gain exactly like the C version, once every 4 samples, and applies
+   the gains of two steps to 8 samples at a time.
+***********************************************************************************/
+
+static LVM_INT32 LVC_Core_MixSoft_1St_D16C31_WRA_Step(LVM_INT32 Current,
+                                                      LVM_INT32 Delta,
+                                                      LVM_INT32 Target,
+                                                      LVM_INT16 Up)
+{
+    LVM_INT32   Temp;
+
+    if (Up){
+        ADD2_SAT_32x32(Current,Delta,Temp);                                          /* Q31 + Q31 into Q31*/
+        Current=Temp;
+        if (Current > Target)
+            Current = Target;
+    }
+    else{
+        Current -= Delta;                                                            /* Q31 + Q31 into Q31*/
+        if (Current < Target)
+            Current = Target;
+    }
+    return Current;
+}
+
+static void LVC_Core_MixSoft_1St_D16C31_WRA_Simd( Mix_Private_st  *pInstance,
+                                                const LVM_INT16 *src,
+                                                      LVM_INT16 *dst,
+                                                      LVM_INT16 n)
+{
+    LVM_INT16   OutLoop;
+    LVM_INT16   InLoop;
+    LVM_INT16   CurrentShort;
+    LVM_INT16   NextShort;
+    LVM_INT32   ii;
+    LVM_INT32   Delta=pInstance->Delta;
+    LVM_INT32   Current=pInstance->Current;
+    LVM_INT32   Target=pInstance->Target;
+    LVM_INT16   Up=(LVM_INT16)(Current<Target);                                    /* Fixed for the whole call */
+
+    InLoop = (LVM_INT16)(n >> 2); /* Process per 4 samples */
+    OutLoop = (LVM_INT16)(n - (InLoop << 2));
+
+    if (OutLoop){
+        Current = LVC_Core_MixSoft_1St_D16C31_WRA_Step(Current, Delta, Target, Up);
+        CurrentShort = (LVM_INT16)(Current>>16);                                     /* From Q31 to Q15*/
+
+        for (ii = OutLoop; ii != 0; ii--){
+            *(dst++) = (LVM_INT16)(((LVM_INT32)*(src++) * (LVM_INT32)CurrentShort)>>15);    /* Q15*Q15>>15 into Q15 */
+        }
+    }
+
+    for (ii = InLoop >> 1; ii != 0; ii--){
+        Current = LVC_Core_MixSoft_1St_D16C31_WRA_Step(Current, Delta, Target, Up);
+        CurrentShort = (LVM_INT16)(Current>>16);
+        Current = LVC_Core_MixSoft_1St_D16C31_WRA_Step(Current, Delta, Target, Up);
+        NextShort = (LVM_INT16)(Current>>16);
+
+        LVM_V8_Store(dst, LVM_V8_MulQ15(LVM_V8_Load(src), LVM_V8_Halves(CurrentShort, NextShort)));
+        src += 8;
+        dst += 8;
+    }
+
+    if (InLoop & 1){
+        Current = LVC_Core_MixSoft_1St_D16C31_WRA_Step(Current, Delta, Target, Up);
+        CurrentShort = (LVM_INT16)(Current>>16);
+
+        for (ii = 4; ii != 0; ii--){
+            *(dst++) = (LVM_INT16)(((LVM_INT32)*(src++) * (LVM_INT32)CurrentShort)>>15);
+        }
+    }
+    pInstance->Current=Current;
+}
+#endif
 
 /**********************************************************************************
    FUNCTION LVCore_MIXSOFT_1ST_D16C31_WRA
@@ -42,6 +122,13 @@ void LVC_Core_MixSoft_1St_D16C31_WRA( LVMixer3_st *ptrInstance,
     LVM_INT32   Target=pInstance->Target;
     LVM_INT32   Temp;
 
+#ifdef LVM_SIMD
+    if (LVM_SimdEnabled){
+        LVC_Core_MixSoft_1St_D16C31_WRA_Simd(pInstance, src, dst, n);
+        return;
+    }
+#endif
+
     InLoop = (LVM_INT16)(n >> 2); /* Process per 4 samples */
     OutLoop = (LVM_INT16)(n - (InLoop << 2));
 
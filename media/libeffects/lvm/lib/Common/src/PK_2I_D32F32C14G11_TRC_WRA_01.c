@@ -18,6 +18,7 @@
 #include "BIQUAD.h"
 #include "PK_2I_D32F32CssGss_TRC_WRA_01_Private.h"
 #include "LVM_Macros.h"
+#include "LVM_Simd.h"
 
 /**************************************************************************
  ASSUMPTIONS:
@@ -38,6 +39,53 @@
  pBiquadState->pDelays[6] is y(n-2)L in Q0 format
  pBiquadState->pDelays[7] is y(n-2)R in Q0 format
 ***************************************************************************/
+#ifdef LVM_SIMD
+/* Filters both channels at once, bit-exact with the C version */
+static void PK_2I_D32F32C14G11_TRC_WRA_01_Simd(PFilter_State           pBiquadState,
+                                               LVM_INT32               *pDataIn,
+                                               LVM_INT32               *pDataOut,
+                                               LVM_INT16               NrSamples)
+    {
+        LVM_V2 A0 = LVM_V2_Dup(pBiquadState->coefs[0]);
+        LVM_V2 B2 = LVM_V2_Dup(pBiquadState->coefs[1]);
+        LVM_V2 B1 = LVM_V2_Dup(pBiquadState->coefs[2]);
+        LVM_V2 Gain = LVM_V2_Dup(pBiquadState->coefs[3]);
+        LVM_V2 x1 = LVM_V2_Load32(&pBiquadState->pDelays[0]);
+        LVM_V2 x2 = LVM_V2_Load32(&pBiquadState->pDelays[2]);
+        LVM_V2 y1 = LVM_V2_Load32(&pBiquadState->pDelays[4]);
+        LVM_V2 y2 = LVM_V2_Load32(&pBiquadState->pDelays[6]);
+        LVM_V2 x, yn, ynO;
+        LVM_INT16 ii;
+
+        for (ii = NrSamples; ii != 0; ii--)
+        {
+            x = LVM_V2_Load32(pDataIn);
+            pDataIn += 2;
+
+            /* yn = (A0*(x(n) - x(n-2)) + -B2*y(n-2) + -B1*y(n-1)) >> 14 in Q0 */
+            yn = LVM_V2_MulShr(LVM_V2_Sub(x, x2), A0, 14);
+            yn = LVM_V2_Add(yn, LVM_V2_MulShr(y2, B2, 14));
+            yn = LVM_V2_Add(yn, LVM_V2_MulShr(y1, B1, 14));
+
+            /* ynO = ((Gain*yn) >> 11) + x(n) in Q0 */
+            ynO = LVM_V2_Add(LVM_V2_MulShr(yn, Gain, 11), x);
+
+            y2 = y1;
+            x2 = x1;
+            y1 = yn;
+            x1 = x;
+
+            LVM_V2_Store32(pDataOut, ynO);
+            pDataOut += 2;
+        }
+
+        LVM_V2_Store32(&pBiquadState->pDelays[0], x1);
+        LVM_V2_Store32(&pBiquadState->pDelays[2], x2);
+        LVM_V2_Store32(&pBiquadState->pDelays[4], y1);
+        LVM_V2_Store32(&pBiquadState->pDelays[6], y2);
+    }
+#endif
+
 void PK_2I_D32F32C14G11_TRC_WRA_01 ( Biquad_Instance_t       *pInstance,
                                      LVM_INT32               *pDataIn,
                                      LVM_INT32               *pDataOut,
@@ -47,6 +95,16 @@ void PK_2I_D32F32C14G11_TRC_WRA_01 ( Biquad_Instance_t       *pInstance,
         LVM_INT16 ii;
         PFilter_State pBiquadState = (PFilter_State) pInstance;
 
+#ifdef LVM_SIMD
+        if (LVM_SimdEnabled && LVM_FITS_INT16(pBiquadState->coefs[0]) &&
+            LVM_FITS_INT16(pBiquadState->coefs[1]) && LVM_FITS_INT16(pBiquadState->coefs[2]) &&
+            LVM_FITS_INT16(pBiquadState->coefs[3]))
+        {
+            PK_2I_D32F32C14G11_TRC_WRA_01_Simd(pBiquadState, pDataIn, pDataOut, NrSamples);
+            return;
+        }
+#endif
+
          for (ii = NrSamples; ii != 0; ii--)
          {
 
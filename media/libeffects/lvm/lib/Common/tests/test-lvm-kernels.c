@@ -0,0 +1,427 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Runs the LVM filters and mixers that have SIMD versions with random
+// coefficients, states and data, checks that the SIMD and C versions give
+// the same output and state bit for bit, then times both.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "BIQUAD.h"
+#include "LVC_Mixer_Private.h"
+#include "LVM_Simd.h"
+
+#define MAX_FRAMES      512
+#define BENCH_FRAMES    128     /* the bundle processes at most this many frames per call */
+
+static unsigned int sSeed = 1;
+
+static LVM_INT32 random32(void) {
+    unsigned int hi;
+    sSeed = sSeed * 1103515245 + 12345;
+    hi = sSeed >> 16;
+    sSeed = sSeed * 1103515245 + 12345;
+    return (LVM_INT32) ((hi << 16) | (sSeed >> 16));
+}
+
+// Full range 16-bit values, with the extremes more often than chance.
+static LVM_INT16 random16(void) {
+    LVM_INT32 r = random32();
+    switch (r & 0xf) {
+    case 0:
+        return -32768;
+    case 1:
+        return 32767;
+    default:
+        return (LVM_INT16) (r >> 16);
+    }
+}
+
+static int64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// ----------------------------------------------------------------------------
+// Filters
+
+typedef union {
+    BQ_C16_Coefs_t      BQ16;
+    BQ_C32_Coefs_t      BQ32;
+    PK_C16_Coefs_t      PK16;
+    PK_C32_Coefs_t      PK32;
+    FO_C16_LShx_Coefs_t FO16;
+} Coefs_t;
+
+typedef struct {
+    const char *name;
+    void (*randomCoefs)(Coefs_t *pCoefs);
+    void (*init)(Biquad_Instance_t *pInstance, LVM_INT32 *pTaps, Coefs_t *pCoefs);
+    LVM_INT16 numTaps;
+    LVM_INT16 xTaps;            /* mask of the taps holding 16-bit input samples */
+    void (*process16)(Biquad_Instance_t *, LVM_INT16 *, LVM_INT16 *, LVM_INT16);
+    void (*process32)(Biquad_Instance_t *, LVM_INT32 *, LVM_INT32 *, LVM_INT16);
+} Filter;
+
+static void randomBQ16(Coefs_t *pCoefs) {
+    pCoefs->BQ16.A2 = random16();
+    pCoefs->BQ16.A1 = random16();
+    pCoefs->BQ16.A0 = random16();
+    pCoefs->BQ16.B2 = random16();
+    pCoefs->BQ16.B1 = random16();
+}
+
+static void initBQ16(Biquad_Instance_t *pInstance, LVM_INT32 *pTaps, Coefs_t *pCoefs) {
+    BQ_2I_D16F32Css_TRC_WRA_01_Init(pInstance, (Biquad_2I_Order2_Taps_t *) pTaps,
+            &pCoefs->BQ16);
+}
+
+static void randomBQ32(Coefs_t *pCoefs) {
+    pCoefs->BQ32.A2 = random32();
+    pCoefs->BQ32.A1 = random32();
+    pCoefs->BQ32.A0 = random32();
+    pCoefs->BQ32.B2 = random32();
+    pCoefs->BQ32.B1 = random32();
+}
+
+static void initBQ32(Biquad_Instance_t *pInstance, LVM_INT32 *pTaps, Coefs_t *pCoefs) {
+    BQ_2I_D32F32Cll_TRC_WRA_01_Init(pInstance, (Biquad_2I_Order2_Taps_t *) pTaps,
+            &pCoefs->BQ32);
+}
+
+static void randomPK16(Coefs_t *pCoefs) {
+    pCoefs->PK16.A0 = random16();
+    pCoefs->PK16.B2 = random16();
+    pCoefs->PK16.B1 = random16();
+    pCoefs->PK16.G = random16();
+}
+
+static void initPK16(Biquad_Instance_t *pInstance, LVM_INT32 *pTaps, Coefs_t *pCoefs) {
+    PK_2I_D32F32CssGss_TRC_WRA_01_Init(pInstance, (Biquad_2I_Order2_Taps_t *) pTaps,
+            &pCoefs->PK16);
+}
+
+static void randomPK32(Coefs_t *pCoefs) {
+    pCoefs->PK32.A0 = random32();
+    pCoefs->PK32.B2 = random32();
+    pCoefs->PK32.B1 = random32();
+    pCoefs->PK32.G = random16();
+}
+
+static void initPK32(Biquad_Instance_t *pInstance, LVM_INT32 *pTaps, Coefs_t *pCoefs) {
+    PK_2I_D32F32CllGss_TRC_WRA_01_Init(pInstance, (Biquad_2I_Order2_Taps_t *) pTaps,
+            &pCoefs->PK32);
+}
+
+static void randomFO16(Coefs_t *pCoefs) {
+    pCoefs->FO16.A1 = random16();
+    pCoefs->FO16.A0 = random16();
+    pCoefs->FO16.B1 = random16();
+    pCoefs->FO16.Shift = random32() & 0xf;
+}
+
+static void initFO16(Biquad_Instance_t *pInstance, LVM_INT32 *pTaps, Coefs_t *pCoefs) {
+    FO_2I_D16F32Css_LShx_TRC_WRA_01_Init(pInstance, (Biquad_2I_Order1_Taps_t *) pTaps,
+            &pCoefs->FO16);
+}
+
+static const Filter kFilters[] = {
+    { "BQ_2I_D16F32C13_TRC_WRA_01", randomBQ16, initBQ16, 8, 0x0f,
+            BQ_2I_D16F32C13_TRC_WRA_01, NULL },
+    { "BQ_2I_D16F32C14_TRC_WRA_01", randomBQ16, initBQ16, 8, 0x0f,
+            BQ_2I_D16F32C14_TRC_WRA_01, NULL },
+    { "BQ_2I_D16F32C15_TRC_WRA_01", randomBQ16, initBQ16, 8, 0x0f,
+            BQ_2I_D16F32C15_TRC_WRA_01, NULL },
+    { "BQ_2I_D32F32C30_TRC_WRA_01", randomBQ32, initBQ32, 8, 0,
+            NULL, BQ_2I_D32F32C30_TRC_WRA_01 },
+    { "PK_2I_D32F32C14G11_TRC_WRA_01", randomPK16, initPK16, 8, 0,
+            NULL, PK_2I_D32F32C14G11_TRC_WRA_01 },
+    { "PK_2I_D32F32C30G11_TRC_WRA_01", randomPK32, initPK32, 8, 0,
+            NULL, PK_2I_D32F32C30G11_TRC_WRA_01 },
+    { "FO_2I_D16F32C15_LShx_TRC_WRA_01", randomFO16, initFO16, 4, 0x05,
+            FO_2I_D16F32C15_LShx_TRC_WRA_01, NULL },
+};
+
+static LVM_INT16 sIn16[2 * MAX_FRAMES];
+static LVM_INT16 sOut16[2][2 * MAX_FRAMES];
+static LVM_INT32 sIn32[2 * MAX_FRAMES];
+static LVM_INT32 sOut32[2][2 * MAX_FRAMES];
+
+static void randomInput(LVM_INT16 frames) {
+    LVM_INT16 i;
+    for (i = 0; i < 2 * frames; i++) {
+        sIn16[i] = random16();
+        sIn32[i] = random32();
+    }
+}
+
+// Runs the filter on sIn16 or sIn32 into the output buffer of the given path,
+// or in place.
+static void runFilter(const Filter *f, Biquad_Instance_t *pInstance, int path,
+        LVM_INT16 frames, int inPlace) {
+    LVM_SimdEnabled = path;
+    if (f->process16 != NULL) {
+        LVM_INT16 *out = sOut16[path];
+        if (inPlace) {
+            memcpy(out, sIn16, 2 * frames * sizeof(LVM_INT16));
+            f->process16(pInstance, out, out, frames);
+        } else {
+            f->process16(pInstance, sIn16, out, frames);
+        }
+    } else {
+        LVM_INT32 *out = sOut32[path];
+        if (inPlace) {
+            memcpy(out, sIn32, 2 * frames * sizeof(LVM_INT32));
+            f->process32(pInstance, out, out, frames);
+        } else {
+            f->process32(pInstance, sIn32, out, frames);
+        }
+    }
+}
+
+static int checkFilter(const Filter *f, int trials) {
+    int t;
+    for (t = 0; t < trials; t++) {
+        Coefs_t coefs;
+        Biquad_Instance_t instance[2];
+        LVM_INT32 taps[2][8];
+        LVM_INT16 i, frames;
+        int call;
+
+        f->randomCoefs(&coefs);
+        f->init(&instance[0], taps[0], &coefs);
+        f->init(&instance[1], taps[1], &coefs);
+        for (i = 0; i < f->numTaps; i++) {
+            taps[0][i] = (f->xTaps & (1 << i)) ? random16() : random32();
+        }
+        memcpy(taps[1], taps[0], sizeof(taps[0]));
+
+        // a few calls in a row, so that the state carries over
+        for (call = 0; call < 4; call++) {
+            int inPlace = random32() & 1;
+            frames = (LVM_INT16) ((random32() & 0x7fffffff) % (MAX_FRAMES + 1));
+            randomInput(frames);
+            runFilter(f, &instance[0], LVM_FALSE, frames, inPlace);
+            runFilter(f, &instance[1], LVM_TRUE, frames, inPlace);
+
+            if (f->process16 != NULL) {
+                if (memcmp(sOut16[0], sOut16[1], 2 * frames * sizeof(LVM_INT16))) {
+                    fprintf(stderr, "%s: output mismatch, trial %d\n", f->name, t);
+                    return 1;
+                }
+            } else if (memcmp(sOut32[0], sOut32[1], 2 * frames * sizeof(LVM_INT32))) {
+                fprintf(stderr, "%s: output mismatch, trial %d\n", f->name, t);
+                return 1;
+            }
+            if (memcmp(taps[0], taps[1], f->numTaps * sizeof(LVM_INT32))) {
+                fprintf(stderr, "%s: state mismatch, trial %d\n", f->name, t);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static double benchFilter(const Filter *f, int path, int passes) {
+    Coefs_t coefs;
+    Biquad_Instance_t instance;
+    LVM_INT32 taps[8];
+    int64_t start;
+    int p;
+
+    memset(taps, 0, sizeof(taps));
+    f->randomCoefs(&coefs);
+    f->init(&instance, taps, &coefs);
+    randomInput(BENCH_FRAMES);
+    start = nowNs();
+    for (p = 0; p < passes; p++) {
+        runFilter(f, &instance, path, BENCH_FRAMES, LVM_FALSE);
+    }
+    return (double) (nowNs() - start) / ((double) passes * BENCH_FRAMES);
+}
+
+// ----------------------------------------------------------------------------
+// Mixers
+
+typedef struct {
+    const char *name;
+    LVM_INT16 streams;
+    LVM_INT16 channels;         /* samples per frame of src and dst */
+    LVM_INT16 soft;             /* the mixer moves Current towards Target */
+} Mixer;
+
+static const Mixer kMixers[] = {
+    { "LVC_Core_MixSoft_1St_D16C31_WRA", 1, 1, LVM_TRUE },
+    { "LVC_Core_MixSoft_1St_2i_D16C31_WRA", 2, 2, LVM_TRUE },
+    { "LVC_Core_MixHard_2St_D16C31_SAT", 2, 1, LVM_FALSE },
+    { "LVC_Core_MixHard_1St_2i_D16C31_SAT", 2, 2, LVM_FALSE },
+};
+
+static void runMixer(const Mixer *m, LVMixer3_st *pStreams, int path, LVM_INT16 n,
+        int inPlace) {
+    LVM_INT16 *dst = sOut16[path];
+    const LVM_INT16 *src = sIn16;
+
+    LVM_SimdEnabled = path;
+    if (inPlace) {
+        memcpy(dst, sIn16, n * m->channels * sizeof(LVM_INT16));
+        src = dst;
+    }
+    if (m == &kMixers[0]) {
+        LVC_Core_MixSoft_1St_D16C31_WRA(&pStreams[0], src, dst, n);
+    } else if (m == &kMixers[1]) {
+        LVC_Core_MixSoft_1St_2i_D16C31_WRA(&pStreams[0], &pStreams[1], src, dst, n);
+    } else if (m == &kMixers[2]) {
+        LVC_Core_MixHard_2St_D16C31_SAT(&pStreams[0], &pStreams[1], src, sIn16 + MAX_FRAMES,
+                dst, n);
+    } else {
+        LVC_Core_MixHard_1St_2i_D16C31_SAT(&pStreams[0], &pStreams[1], src, dst, n);
+    }
+}
+
+static void randomStreams(const Mixer *m, LVMixer3_st *pStreams) {
+    LVM_INT16 s;
+    memset(pStreams, 0, 2 * sizeof(LVMixer3_st));
+    for (s = 0; s < m->streams; s++) {
+        Mix_Private_st *pInstance = (Mix_Private_st *) pStreams[s].PrivateParams;
+        pInstance->Current = random32();
+        pInstance->Target = random32();
+        // mostly slow ramps, sometimes large enough steps to saturate
+        pInstance->Delta = random32() & ((random32() & 1) ? 0x7fffffff : 0xfffff);
+    }
+}
+
+static int checkMixer(const Mixer *m, int trials) {
+    int t;
+    for (t = 0; t < trials; t++) {
+        LVMixer3_st streams[2][2];
+        LVM_INT16 s, n;
+        int call;
+
+        randomStreams(m, streams[0]);
+        memcpy(streams[1], streams[0], sizeof(streams[0]));
+
+        for (call = 0; call < 4; call++) {
+            int inPlace = random32() & 1;
+            // 2 * MAX_FRAMES samples, sIn16 + MAX_FRAMES is the second source
+            n = (LVM_INT16) ((random32() & 0x7fffffff) % (MAX_FRAMES + 1));
+            randomInput(MAX_FRAMES);
+            runMixer(m, streams[0], LVM_FALSE, n, inPlace);
+            runMixer(m, streams[1], LVM_TRUE, n, inPlace);
+
+            if (memcmp(sOut16[0], sOut16[1], n * m->channels * sizeof(LVM_INT16))) {
+                fprintf(stderr, "%s: output mismatch, trial %d\n", m->name, t);
+                return 1;
+            }
+            for (s = 0; s < m->streams; s++) {
+                if (memcmp(streams[0][s].PrivateParams, streams[1][s].PrivateParams,
+                        sizeof(Mix_Private_st))) {
+                    fprintf(stderr, "%s: state mismatch, trial %d\n", m->name, t);
+                    return 1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static double benchMixer(const Mixer *m, int path, int passes) {
+    LVMixer3_st streams[2];
+    int64_t start;
+    int p;
+
+    randomStreams(m, streams);
+    randomInput(MAX_FRAMES);
+    start = nowNs();
+    for (p = 0; p < passes; p++) {
+        if (m->soft && (p & 63) == 0) {
+            // keep it ramping
+            randomStreams(m, streams);
+        }
+        runMixer(m, streams, path, BENCH_FRAMES, LVM_FALSE);
+    }
+    return (double) (nowNs() - start) / ((double) passes * BENCH_FRAMES);
+}
+
+// ----------------------------------------------------------------------------
+
+static int usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-t trials] [-p passes] [-s seed]\n", name);
+    fprintf(stderr, "    -t    random trials per kernel for the bit-exactness check (default 2000)\n");
+    fprintf(stderr, "    -p    calls of %d frames per kernel for the timing (default 20000)\n",
+            BENCH_FRAMES);
+    fprintf(stderr, "    -s    random seed (default 1)\n");
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    int trials = 2000;
+    int passes = 20000;
+    int failures = 0;
+    size_t i;
+    int ch;
+
+    while ((ch = getopt(argc, argv, "t:p:s:")) != -1) {
+        switch (ch) {
+        case 't':
+            trials = atoi(optarg);
+            break;
+        case 'p':
+            passes = atoi(optarg);
+            break;
+        case 's':
+            sSeed = (unsigned int) atoi(optarg);
+            break;
+        default:
+            return usage(argv[0]);
+        }
+    }
+    if (trials < 0 || passes <= 0) {
+        return usage(argv[0]);
+    }
+
+#ifndef LVM_SIMD
+    printf("no SIMD kernels in this build\n");
+    return 0;
+#endif
+
+    printf("%-36s %6s %10s %10s %8s\n", "kernel", "exact", "C ns/fr", "SIMD ns/fr", "speedup");
+    for (i = 0; i < sizeof(kFilters) / sizeof(kFilters[0]); i++) {
+        const Filter *f = &kFilters[i];
+        int failed = checkFilter(f, trials);
+        double c = benchFilter(f, LVM_FALSE, passes);
+        double simd = benchFilter(f, LVM_TRUE, passes);
+        printf("%-36s %6s %10.2f %10.2f %7.2fx\n", f->name, failed ? "NO" : "yes",
+                c, simd, c / simd);
+        failures += failed;
+    }
+    for (i = 0; i < sizeof(kMixers) / sizeof(kMixers[0]); i++) {
+        const Mixer *m = &kMixers[i];
+        int failed = checkMixer(m, trials);
+        double c = benchMixer(m, LVM_FALSE, passes);
+        double simd = benchMixer(m, LVM_TRUE, passes);
+        printf("%-36s %6s %10.2f %10.2f %7.2fx\n", m->name, failed ? "NO" : "yes",
+                c, simd, c / simd);
+        failures += failed;
+    }
+    LVM_SimdEnabled = LVM_TRUE;
+    return failures ? 1 : 0;
+}
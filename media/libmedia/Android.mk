@@ -49,6 +49,8 @@ LOCAL_SRC_FILES:= \
     Visualizer.cpp \
     MemoryLeakTrackUtil.cpp \
     SoundPool.cpp \
+    SoundPoolCache.cpp \
+    SoundPoolMixer.cpp \
     SoundPoolThread.cpp
 
 LOCAL_SHARED_LIBRARIES := \
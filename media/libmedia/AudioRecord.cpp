@@ -333,7 +333,7 @@ void AudioRecord::stop()
     AutoMutex lock(mLock);
     if (mActive) {
         mActive = false;
-        mCblk->cv.signal();
+        mCblk->wake();
         mAudioRecord->stop();
         // the record head position will reset to 0, so if a marker is set, we need
         // to activate it again
@@ -499,9 +499,15 @@ status_t AudioRecord::obtainBuffer(Buffer* audioBuffer, int32_t waitCount)
                 return WOULD_BLOCK;
             }
             if (!(cblk->flags & CBLK_INVALID_MSK)) {
-                mLock.unlock();
-                result = cblk->cv.waitRelative(cblk->lock, milliseconds(waitTimeMs));
+                // see AudioTrack::obtainBuffer()
+                int32_t sequence = cblk->prepareWaitServer();
+                framesReady = cblk->framesReady();
+                if (framesReady != 0) {
+                    continue;
+                }
                 cblk->lock.unlock();
+                mLock.unlock();
+                result = cblk->waitServer(sequence, waitTimeMs);
                 mLock.lock();
                 if (!mActive) {
                     return status_t(STOPPED);
@@ -759,9 +765,9 @@ status_t AudioRecord::restoreRecord_l(audio_track_cblk_t*& cblk)
 
     if (!(android_atomic_or(CBLK_RESTORING_ON, &cblk->flags) & CBLK_RESTORING_MSK)) {
         ALOGW("dead IAudioRecord, creating a new one");
-        // signal old cblk condition so that other threads waiting for available buffers stop
-        // waiting now
-        cblk->cv.broadcast();
+        // wake up other threads waiting for available buffers on the old cblk so that they
+        // stop waiting now
+        cblk->wake();
         cblk->lock.unlock();
 
         // if the new IAudioRecord is created, openRecord_l() will modify the
@@ -26,6 +26,11 @@
 
 #include <sched.h>
 #include <sys/resource.h>
+#include <time.h>
+
+extern "C" {
+#include "../private/bionic_futex.h"
+}
 
 #include <private/media/AudioTrackShared.h>
 
@@ -439,7 +444,7 @@ void AudioTrack::stop()
     AutoMutex lock(mLock);
     if (mActive) {
         mActive = false;
-        mCblk->cv.signal();
+        mCblk->wake();
         mAudioTrack->stop();
         // Cancel loops (If we are in the middle of a loop, playback
         // would not stop until loopCount reaches 0).
@@ -489,7 +494,7 @@ void AudioTrack::flush_l()
         mAudioTrack->flush();
         // Release AudioTrack callback thread in case it was waiting for new buffers
         // in AudioTrack::obtainBuffer()
-        mCblk->cv.signal();
+        mCblk->wake();
     }
 }
 
@@ -499,7 +504,7 @@ void AudioTrack::pause()
     AutoMutex lock(mLock);
     if (mActive) {
         mActive = false;
-        mCblk->cv.signal();
+        mCblk->wake();
         mAudioTrack->pause();
     }
 }
@@ -963,11 +968,10 @@ status_t AudioTrack::obtainBuffer(Buffer* audioBuffer, int32_t waitCount)
 
     uint32_t framesAvail = cblk->framesAvailable();
 
-    cblk->lock.lock();
     if (cblk->flags & CBLK_INVALID_MSK) {
+        cblk->lock.lock();
         goto create_new_track;
     }
-    cblk->lock.unlock();
 
     if (framesAvail == 0) {
         cblk->lock.lock();
@@ -984,9 +988,16 @@ status_t AudioTrack::obtainBuffer(Buffer* audioBuffer, int32_t waitCount)
                 return WOULD_BLOCK;
             }
             if (!(cblk->flags & CBLK_INVALID_MSK)) {
-                mLock.unlock();
-                result = cblk->cv.waitRelative(cblk->lock, milliseconds(waitTimeMs));
+                // stepServer() no longer takes the cblk lock, so look at the server index
+                // again once the futex is armed in case it moved in the meantime.
+                int32_t sequence = cblk->prepareWaitServer();
+                framesAvail = cblk->framesAvailable_l();
+                if (framesAvail != 0) {
+                    continue;
+                }
                 cblk->lock.unlock();
+                mLock.unlock();
+                result = cblk->waitServer(sequence, waitTimeMs);
                 mLock.lock();
                 if (!mActive) {
                     return status_t(STOPPED);
@@ -1342,9 +1353,9 @@ status_t AudioTrack::restoreTrack_l(audio_track_cblk_t*& cblk, bool fromStart)
         ALOGW("dead IAudioTrack, creating a new one from %s TID %d",
             fromStart ? "start()" : "obtainBuffer()", gettid());
 
-        // signal old cblk condition so that other threads waiting for available buffers stop
-        // waiting now
-        cblk->cv.broadcast();
+        // wake up other threads waiting for available buffers on the old cblk so that they
+        // stop waiting now
+        cblk->wake();
         cblk->lock.unlock();
 
         // refresh the audio configuration cache in this process to make sure we get new
@@ -1517,7 +1528,7 @@ audio_track_cblk_t::audio_track_cblk_t()
     : lock(Mutex::SHARED), cv(Condition::SHARED), user(0), server(0),
     userBase(0), serverBase(0), buffers(NULL), frameCount(0),
     loopStart(UINT_MAX), loopEnd(UINT_MAX), loopCount(0), mVolumeLR(0x10001000),
-    mSendLevel(0), flags(0)
+    mSendLevel(0), flags(0), mFutex(0)
 {
 }
 
@@ -1549,7 +1560,8 @@ uint32_t audio_track_cblk_t::stepUser(uint32_t frameCount)
         userBase += fc;
     }
 
-    user = u;
+    // publish the new index after the data it covers
+    android_atomic_release_store(u, (volatile int32_t *) &user);
 
     // Clear flow control error condition as new data has been written/read to/from buffer.
     if (flags & CBLK_UNDERRUN_MSK) {
@@ -1563,13 +1575,19 @@ bool audio_track_cblk_t::stepServer(uint32_t frameCount)
 {
     ALOGV("stepserver %08x %08x %d", user, server, frameCount);
 
-    if (!tryLock()) {
-        ALOGW("stepServer() could not lock cblk");
-        return false;
+    // The lock is only needed to update the loop parameters shared with the client.
+    // A loop set by the client after this check is taken into account on next step.
+    bool locked = false;
+    if (loopEnd != UINT_MAX) {
+        if (!tryLock()) {
+            ALOGW("stepServer() could not lock cblk");
+            return false;
+        }
+        locked = true;
     }
 
     uint32_t s = server;
-    bool flushed = (s == user);
+    bool flushed = (s == (uint32_t) android_atomic_acquire_load((volatile int32_t *) &user));
 
     s += frameCount;
     if (flags & CBLK_DIRECTION_MSK) {
@@ -1588,7 +1606,7 @@ bool audio_track_cblk_t::stepServer(uint32_t frameCount)
         }
     }
 
-    if (s >= loopEnd) {
+    if (locked && s >= loopEnd) {
         ALOGW_IF(s > loopEnd, "stepServer: s %u > loopEnd %u", s, loopEnd);
         s = loopStart;
         if (--loopCount == 0) {
@@ -1608,12 +1626,15 @@ bool audio_track_cblk_t::stepServer(uint32_t frameCount)
         serverBase += fc;
     }
 
-    server = s;
+    // publish the new index after the data it covers
+    android_atomic_release_store(s, (volatile int32_t *) &server);
 
+    if (locked) {
+        lock.unlock();
+    }
     if (!(flags & CBLK_INVALID_MSK)) {
-        cv.signal();
+        wake();
     }
-    lock.unlock();
     return true;
 }
 
@@ -1624,14 +1645,18 @@ void* audio_track_cblk_t::buffer(uint32_t offset) const
 
 uint32_t audio_track_cblk_t::framesAvailable()
 {
-    Mutex::Autolock _l(lock);
+    // loopStart is only relevant to, and only stable under the lock for, a client with a loop
+    if ((flags & CBLK_DIRECTION_MSK) && loopStart != UINT_MAX) {
+        Mutex::Autolock _l(lock);
+        return framesAvailable_l();
+    }
     return framesAvailable_l();
 }
 
 uint32_t audio_track_cblk_t::framesAvailable_l()
 {
-    uint32_t u = user;
-    uint32_t s = server;
+    uint32_t u = android_atomic_acquire_load((volatile int32_t *) &user);
+    uint32_t s = android_atomic_acquire_load((volatile int32_t *) &server);
 
     if (flags & CBLK_DIRECTION_MSK) {
         uint32_t limit = (s < loopStart) ? s : loopStart;
@@ -1643,8 +1668,8 @@ uint32_t audio_track_cblk_t::framesAvailable_l()
 
 uint32_t audio_track_cblk_t::framesReady()
 {
-    uint32_t u = user;
-    uint32_t s = server;
+    uint32_t u = android_atomic_acquire_load((volatile int32_t *) &user);
+    uint32_t s = android_atomic_acquire_load((volatile int32_t *) &server);
 
     if (flags & CBLK_DIRECTION_MSK) {
         if (u < loopEnd) {
@@ -1686,6 +1711,40 @@ bool audio_track_cblk_t::tryLock()
     return true;
 }
 
+int32_t audio_track_cblk_t::prepareWaitServer()
+{
+    int32_t old;
+    do {
+        old = mFutex;
+    } while (android_atomic_acquire_cas(old, old | CBLK_FUTEX_WAITING, &mFutex) != 0);
+    return old | CBLK_FUTEX_WAITING;
+}
+
+status_t audio_track_cblk_t::waitServer(int32_t sequence, uint32_t waitTimeMs)
+{
+    struct timespec ts;
+    ts.tv_sec = waitTimeMs / 1000;
+    ts.tv_nsec = (waitTimeMs % 1000) * 1000000;
+    // The control block is shared with another process, so no FUTEX_WAIT_PRIVATE.
+    // Returns immediately with -EWOULDBLOCK if wake() was called since prepareWaitServer().
+    int ret = __futex_syscall4(&mFutex, FUTEX_WAIT, sequence, &ts);
+    return ret == -ETIMEDOUT ? TIMED_OUT : NO_ERROR;
+}
+
+void audio_track_cblk_t::wake()
+{
+    int32_t old;
+    do {
+        old = mFutex;
+    } while (android_atomic_release_cas(old,
+            int32_t(uint32_t(old) + CBLK_FUTEX_SEQUENCE) & ~CBLK_FUTEX_WAITING,
+            &mFutex) != 0);
+    // only pay for the system call when somebody is waiting
+    if (old & CBLK_FUTEX_WAITING) {
+        __futex_syscall3(&mFutex, FUTEX_WAKE, INT_MAX);
+    }
+}
+
 // -------------------------------------------------------------------------
 
 }; // namespace android
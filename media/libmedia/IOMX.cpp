@@ -20,6 +20,7 @@
 
 #include <binder/IMemory.h>
 #include <binder/Parcel.h>
+#include <cutils/properties.h>
 #include <media/IOMX.h>
 #include <media/stagefright/foundation/ADebug.h>
 
@@ -49,8 +50,22 @@ enum {
     GET_EXTENSION_INDEX,
     OBSERVER_ON_MSG,
     GET_GRAPHIC_BUFFER_USAGE,
+    SUBMIT_BUFFERS,
+    OBSERVER_ON_MSGS,
 };
 
+// omxbatchbench sets the property to compare both modes.
+// static
+bool IOMX::BufferBatchingEnabled() {
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("debug.stagefright.omx-batching", value, NULL)
+            && (!strcmp(value, "0") || !strcmp(value, "false"))) {
+        return false;
+    }
+
+    return true;
+}
+
 class BpOMX : public BpInterface<IOMX> {
 public:
     BpOMX(const sp<IBinder> &impl)
@@ -398,6 +413,31 @@ public:
 
         return err;
     }
+
+    virtual status_t submitBuffers(
+            node_id node, const Vector<BufferCommand> &commands) {
+        if (commands.size() > kMaxBufferCommands) {
+            return BAD_VALUE;
+        }
+
+        Parcel data, reply;
+        data.writeInterfaceToken(IOMX::getInterfaceDescriptor());
+        data.writeIntPtr((intptr_t)node);
+        data.writeInt32(commands.size());
+        for (size_t i = 0; i < commands.size(); ++i) {
+            const BufferCommand &command = commands[i];
+            data.writeInt32(command.mType);
+            data.writeIntPtr((intptr_t)command.mBuffer);
+            data.writeInt32(command.mRangeOffset);
+            data.writeInt32(command.mRangeLength);
+            data.writeInt32(command.mFlags);
+            data.writeInt64(command.mTimestamp);
+        }
+
+        remote()->transact(SUBMIT_BUFFERS, data, &reply);
+
+        return reply.readInt32();
+    }
 };
 
 IMPLEMENT_META_INTERFACE(OMX, "android.hardware.IOMX");
@@ -721,6 +761,38 @@ status_t BnOMX::onTransact(
             return NO_ERROR;
         }
 
+        case SUBMIT_BUFFERS:
+        {
+            CHECK_INTERFACE(IOMX, data, reply);
+
+            node_id node = (void*)data.readIntPtr();
+            size_t count = data.readInt32();
+            if (count > kMaxBufferCommands) {
+                reply->writeInt32(BAD_VALUE);
+                return NO_ERROR;
+            }
+
+            Vector<BufferCommand> commands;
+            commands.setCapacity(count);
+            for (size_t i = 0; i < count; ++i) {
+                BufferCommand command;
+                command.mType =
+                    (data.readInt32() == BufferCommand::EMPTY_BUFFER)
+                        ? BufferCommand::EMPTY_BUFFER
+                        : BufferCommand::FILL_BUFFER;
+                command.mBuffer = (void*)data.readIntPtr();
+                command.mRangeOffset = data.readInt32();
+                command.mRangeLength = data.readInt32();
+                command.mFlags = data.readInt32();
+                command.mTimestamp = data.readInt64();
+                commands.push(command);
+            }
+
+            reply->writeInt32(submitBuffers(node, commands));
+
+            return NO_ERROR;
+        }
+
         case GET_EXTENSION_INDEX:
         {
             CHECK_INTERFACE(IOMX, data, reply);
@@ -760,10 +832,36 @@ public:
 
         remote()->transact(OBSERVER_ON_MSG, data, &reply, IBinder::FLAG_ONEWAY);
     }
+
+    virtual void onMessages(const List<omx_message> &messages) {
+        Parcel data, reply;
+        data.writeInterfaceToken(IOMXObserver::getInterfaceDescriptor());
+
+        int32_t count = 0;
+        for (List<omx_message>::const_iterator it = messages.begin();
+             it != messages.end(); ++it) {
+            ++count;
+        }
+
+        data.writeInt32(count);
+        for (List<omx_message>::const_iterator it = messages.begin();
+             it != messages.end(); ++it) {
+            data.write(&*it, sizeof(omx_message));
+        }
+
+        remote()->transact(OBSERVER_ON_MSGS, data, &reply, IBinder::FLAG_ONEWAY);
+    }
 };
 
 IMPLEMENT_META_INTERFACE(OMXObserver, "android.hardware.IOMXObserver");
 
+void IOMXObserver::onMessages(const List<omx_message> &messages) {
+    for (List<omx_message>::const_iterator it = messages.begin();
+         it != messages.end(); ++it) {
+        onMessage(*it);
+    }
+}
+
 status_t BnOMXObserver::onTransact(
     uint32_t code, const Parcel &data, Parcel *reply, uint32_t flags) {
     switch (code) {
@@ -780,6 +878,26 @@ status_t BnOMXObserver::onTransact(
             return NO_ERROR;
         }
 
+        case OBSERVER_ON_MSGS:
+        {
+            CHECK_INTERFACE(IOMXObserver, data, reply);
+
+            int32_t count = data.readInt32();
+
+            List<omx_message> messages;
+            for (int32_t i = 0; i < count; ++i) {
+                omx_message msg;
+                if (data.read(&msg, sizeof(msg)) != OK) {
+                    break;
+                }
+                messages.push_back(msg);
+            }
+
+            onMessages(messages);
+
+            return NO_ERROR;
+        }
+
         default:
             return BBinder::onTransact(code, data, reply, flags);
     }
@@ -26,9 +26,12 @@
 #include <media/AudioTrack.h>
 #include <media/mediaplayer.h>
 
+#include <cutils/properties.h>
 #include <system/audio.h>
 
 #include <media/SoundPool.h>
+#include "SoundPoolCache.h"
+#include "SoundPoolMixer.h"
 #include "SoundPoolThread.h"
 
 namespace android
@@ -39,10 +42,11 @@ uint32_t kMaxSampleRate = 48000;
 uint32_t kDefaultSampleRate = 44100;
 uint32_t kDefaultFrameCount = 1200;
 
-SoundPool::SoundPool(int maxChannels, audio_stream_type_t streamType, int srcQuality)
+SoundPool::SoundPool(int maxChannels, audio_stream_type_t streamType, int srcQuality,
+        bool useMixer)
 {
-    ALOGV("SoundPool constructor: maxChannels=%d, streamType=%d, srcQuality=%d",
-            maxChannels, streamType, srcQuality);
+    ALOGV("SoundPool constructor: maxChannels=%d, streamType=%d, srcQuality=%d, useMixer=%d",
+            maxChannels, streamType, srcQuality, useMixer);
 
     // check limits
     mMaxChannels = maxChannels;
@@ -62,6 +66,14 @@ SoundPool::SoundPool(int maxChannels, audio_stream_type_t streamType, int srcQua
     mNextSampleID = 0;
     mNextChannelID = 0;
 
+    mMixer = NULL;
+    mMixerStopRequested = false;
+
+    mLatencyCount = 0;
+    mLatencySum = 0;
+    mLatencyMin = 0;
+    mLatencyMax = 0;
+
     mCallback = 0;
     mUserData = 0;
 
@@ -71,6 +83,19 @@ SoundPool::SoundPool(int maxChannels, audio_stream_type_t streamType, int srcQua
         mChannels.push_back(&mChannelPool[i]);
     }
 
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.soundpool.mixer", value, NULL) > 0) {
+        useMixer = !strcmp(value, "1") || !strcasecmp(value, "true");
+    }
+    if (useMixer) {
+        mMixer = new SoundPoolMixer(this);
+        if (mMixer->initCheck() != NO_ERROR) {
+            ALOGW("Mixer not available, using a track per channel");
+            delete mMixer;
+            mMixer = NULL;
+        }
+    }
+
     // start decode thread
     startThreads();
 }
@@ -81,8 +106,17 @@ SoundPool::~SoundPool()
     mDecodeThread->quit();
     quit();
 
+    // the mixer track callback uses the channels
+    delete mMixer;
+
     Mutex::Autolock lock(&mLock);
 
+    if (mLatencyCount != 0) {
+        ALOGD("trigger to output latency over %u plays: avg %lld ms, min %lld ms, max %lld ms",
+                mLatencyCount, ns2ms(mLatencySum / mLatencyCount),
+                ns2ms(mLatencyMin), ns2ms(mLatencyMax));
+    }
+
     mChannels.clear();
     if (mChannelPool)
         delete [] mChannelPool;
@@ -112,6 +146,15 @@ void SoundPool::addToStopList(SoundChannel* channel)
     }
 }
 
+void SoundPool::requestMixerStop()
+{
+    Mutex::Autolock lock(&mRestartLock);
+    if (!mQuit) {
+        mMixerStopRequested = true;
+        mCondition.signal();
+    }
+}
+
 int SoundPool::beginThread(void* arg)
 {
     SoundPool* p = (SoundPool*)arg;
@@ -135,7 +178,23 @@ int SoundPool::run()
             mRestartLock.unlock();
             if (channel != 0) {
                 Mutex::Autolock lock(&mLock);
-                channel->stop();
+                if (mMixer != NULL) {
+                    channel->mixerDone();
+                } else {
+                    channel->stop();
+                }
+            }
+            mRestartLock.lock();
+            if (mQuit) break;
+        }
+
+        // after the stop list, so that voices that have ended are idle
+        if (mMixerStopRequested) {
+            mMixerStopRequested = false;
+            mRestartLock.unlock();
+            {
+                Mutex::Autolock lock(&mLock);
+                mMixer->stopIfIdle();
             }
             mRestartLock.lock();
             if (mQuit) break;
@@ -342,8 +401,8 @@ void SoundPool::resume(int channelID)
     ALOGV("resume(%d)", channelID);
     Mutex::Autolock lock(&mLock);
     SoundChannel* channel = findChannel(channelID);
-    if (channel) {
-        channel->resume();
+    if (channel && channel->resume() && mMixer != NULL) {
+        mMixer->start();
     }
 }
 
@@ -351,9 +410,15 @@ void SoundPool::autoResume()
 {
     ALOGV("autoResume()");
     Mutex::Autolock lock(&mLock);
+    bool resumed = false;
     for (int i = 0; i < mMaxChannels; ++i) {
         SoundChannel* channel = &mChannelPool[i];
-        channel->autoResume();
+        if (channel->autoResume()) {
+            resumed = true;
+        }
+    }
+    if (resumed && mMixer != NULL) {
+        mMixer->start();
     }
 }
 
@@ -427,6 +492,37 @@ void SoundPool::done_l(SoundChannel* channel)
     }
 }
 
+void SoundPool::reportLatency(nsecs_t latency)
+{
+    ALOGV("trigger to output latency %lld us", ns2us(latency));
+    Mutex::Autolock lock(&mLatencyLock);
+    if (mLatencyCount == 0 || latency < mLatencyMin) {
+        mLatencyMin = latency;
+    }
+    if (latency > mLatencyMax) {
+        mLatencyMax = latency;
+    }
+    mLatencySum += latency;
+    mLatencyCount++;
+}
+
+void SoundPool::setCacheDirectory(const char* directory)
+{
+    ALOGV("setCacheDirectory(%s)", directory);
+    Mutex::Autolock lock(&mCacheLock);
+    if (directory != NULL) {
+        mCache = new SoundPoolCache(directory);
+    } else {
+        mCache.clear();
+    }
+}
+
+sp<SoundPoolCache> SoundPool::cache()
+{
+    Mutex::Autolock lock(&mCacheLock);
+    return mCache;
+}
+
 void SoundPool::setCallback(SoundPoolCallback* callback, void* user)
 {
     Mutex::Autolock lock(&mCallbackLock);
@@ -492,17 +588,34 @@ Sample::~Sample()
     delete mUrl;
 }
 
-status_t Sample::doLoad()
+status_t Sample::doLoad(const sp<SoundPoolCache>& cache)
 {
     uint32_t sampleRate;
     int numChannels;
     audio_format_t format;
     sp<IMemory> p;
-    ALOGV("Start decode");
-    if (mUrl) {
-        p = MediaPlayer::decode(mUrl, &sampleRate, &numChannels, &format);
-    } else {
-        p = MediaPlayer::decode(mFd, mOffset, mLength, &sampleRate, &numChannels, &format);
+    SoundPoolCache::Key key;
+    bool cacheable = false;
+    bool cached = false;
+
+    if (cache != 0) {
+        cacheable = mUrl ? SoundPoolCache::makeKey(mUrl, &key) :
+                SoundPoolCache::makeKey(mFd, mOffset, mLength, &key);
+        if (cacheable) {
+            p = cache->load(key, &sampleRate, &numChannels, &format);
+            cached = (p != 0);
+        }
+    }
+
+    if (!cached) {
+        ALOGV("Start decode");
+        if (mUrl) {
+            p = MediaPlayer::decode(mUrl, &sampleRate, &numChannels, &format);
+        } else {
+            p = MediaPlayer::decode(mFd, mOffset, mLength, &sampleRate, &numChannels, &format);
+        }
+    }
+    if (!mUrl) {
         ALOGV("close(%d)", mFd);
         ::close(mFd);
         mFd = -1;
@@ -528,6 +641,10 @@ status_t Sample::doLoad()
     uint8_t* q = static_cast<uint8_t*>(p->pointer()) + p->size() - 10;
     //_dumpBuffer(q, 10, 10, false);
 
+    if (cacheable && !cached) {
+        cache->store(key, p, sampleRate, numChannels, format);
+    }
+
     mData = p;
     mSize = p->size();
     mSampleRate = sampleRate;
@@ -551,6 +668,19 @@ void SoundChannel::play(const sp<Sample>& sample, int nextChannelID, float leftV
     AudioTrack* newTrack;
     status_t status;
 
+    if (mSoundPool->mMixer != NULL) {
+        {
+            Mutex::Autolock lock(&mLock);
+            ALOGV("SoundChannel::play %p (mixer): sampleID=%d, channelID=%d", this,
+                    sample->sampleID(), nextChannelID);
+            // voices are cheap in the mixer, a stolen one is replaced right away
+            doStop_l();
+            startVoice_l(sample, nextChannelID, leftVolume, rightVolume, priority, loop, rate);
+        }
+        mSoundPool->mMixer->start();
+        return;
+    }
+
     { // scope for the lock
         Mutex::Autolock lock(&mLock);
 
@@ -638,6 +768,7 @@ void SoundChannel::play(const sp<Sample>& sample, int nextChannelID, float leftV
         mRate = rate;
         clearNextEvent();
         mState = PLAYING;
+        mTriggerTime = systemTime();
         mAudioTrack->start();
         mAudioBufferSize = newTrack->frameCount()*newTrack->frameSize();
     }
@@ -651,6 +782,87 @@ exit:
     }
 }
 
+// call with lock held
+void SoundChannel::startVoice_l(const sp<Sample>& sample, int nextChannelID, float leftVolume,
+        float rightVolume, int priority, int loop, float rate)
+{
+    mSample = sample;
+    mChannelID = nextChannelID;
+    mPriority = priority;
+    mLoop = loop;
+    mLeftVolume = leftVolume;
+    mRightVolume = rightVolume;
+    mNumChannels = sample->numChannels();
+    mRate = rate;
+    clearNextEvent();
+    setPhaseIncrement_l(rate);
+    mPhase = 0;
+    mLoopsRemaining = loop;
+    mMixerDone = false;
+    mTriggerTime = systemTime();
+    mState = PLAYING;
+}
+
+// call with lock held
+void SoundChannel::setPhaseIncrement_l(float rate)
+{
+    float ratio = float(mSample->sampleRate()) * rate / mSoundPool->mMixer->sampleRate();
+    mPhaseIncrement = uint32_t(ratio * 65536 + 0.5);
+}
+
+static inline int32_t gain(float volume)
+{
+    if (volume <= 0) {
+        return 0;
+    }
+    if (volume >= 1.0f) {
+        return 0x1000;
+    }
+    return int32_t(volume * 0x1000 + 0.5f);
+}
+
+// Mixes the voice into the stereo buffer out, returns true if the voice is playing
+bool SoundChannel::mix(int32_t* out, size_t frameCount)
+{
+    Mutex::Autolock lock(&mLock);
+
+    if (mState != PLAYING || mMixerDone || mSample == 0) {
+        return false;
+    }
+
+    if (mTriggerTime != 0) {
+        mSoundPool->reportLatency(systemTime() - mTriggerTime +
+                ms2ns(mSoundPool->mMixer->latency()));
+        mTriggerTime = 0;
+    }
+
+    size_t mixed = SoundPoolMixer::mixVoice(out, frameCount, mSample, &mPhase, mPhaseIncrement,
+            gain(mLeftVolume), gain(mRightVolume), &mLoopsRemaining);
+    if (mixed < frameCount) {
+        ALOGV("mix %p channel %d end of sample", this, mChannelID);
+        mMixerDone = true;
+        mSoundPool->addToStopList(this);
+    }
+    return true;
+}
+
+// call with sound pool lock held
+void SoundChannel::mixerDone()
+{
+    bool stopped = false;
+    {
+        Mutex::Autolock lock(&mLock);
+        // the channel may have been played again since it was put on the stop list
+        if (mMixerDone) {
+            stopped = doStop_l();
+        }
+    }
+
+    if (stopped) {
+        mSoundPool->done_l(this);
+    }
+}
+
 void SoundChannel::nextEvent()
 {
     sp<Sample> sample;
@@ -723,6 +935,12 @@ void SoundChannel::process(int event, void *info, unsigned long toggle)
         }
 
         if (sample != 0) {
+            if (mTriggerTime != 0) {
+                mSoundPool->reportLatency(systemTime() - mTriggerTime +
+                        ms2ns(mAudioTrack->latency()));
+                mTriggerTime = 0;
+            }
+
             // fill buffer
             uint8_t* q = (uint8_t*) b->i8;
             size_t count = 0;
@@ -763,8 +981,11 @@ bool SoundChannel::doStop_l()
     if (mState != IDLE) {
         setVolume_l(0, 0);
         ALOGV("stop");
-        mAudioTrack->stop();
+        if (mAudioTrack != NULL) {
+            mAudioTrack->stop();
+        }
         mSample.clear();
+        mMixerDone = false;
         mState = IDLE;
         mPriority = IDLE_PRIORITY;
         return true;
@@ -801,7 +1022,9 @@ void SoundChannel::pause()
     if (mState == PLAYING) {
         ALOGV("pause track");
         mState = PAUSED;
-        mAudioTrack->pause();
+        if (mAudioTrack != NULL) {
+            mAudioTrack->pause();
+        }
     }
 }
 
@@ -812,36 +1035,49 @@ void SoundChannel::autoPause()
         ALOGV("pause track");
         mState = PAUSED;
         mAutoPaused = true;
-        mAudioTrack->pause();
+        if (mAudioTrack != NULL) {
+            mAudioTrack->pause();
+        }
     }
 }
 
-void SoundChannel::resume()
+bool SoundChannel::resume()
 {
     Mutex::Autolock lock(&mLock);
     if (mState == PAUSED) {
         ALOGV("resume track");
         mState = PLAYING;
         mAutoPaused = false;
-        mAudioTrack->start();
+        if (mAudioTrack != NULL) {
+            mAudioTrack->start();
+        }
+        return true;
     }
+    return false;
 }
 
-void SoundChannel::autoResume()
+bool SoundChannel::autoResume()
 {
     Mutex::Autolock lock(&mLock);
     if (mAutoPaused && (mState == PAUSED)) {
         ALOGV("resume track");
         mState = PLAYING;
         mAutoPaused = false;
-        mAudioTrack->start();
+        if (mAudioTrack != NULL) {
+            mAudioTrack->start();
+        }
+        return true;
     }
+    return false;
 }
 
 void SoundChannel::setRate(float rate)
 {
     Mutex::Autolock lock(&mLock);
-    if (mAudioTrack != NULL && mSample != 0) {
+    if (mSoundPool->mMixer != NULL && mSample != 0) {
+        setPhaseIncrement_l(rate);
+        mRate = rate;
+    } else if (mAudioTrack != NULL && mSample != 0) {
         uint32_t sampleRate = uint32_t(float(mSample->sampleRate()) * rate + 0.5);
         mAudioTrack->setSampleRate(sampleRate);
         mRate = rate;
@@ -866,7 +1102,10 @@ void SoundChannel::setVolume(float leftVolume, float rightVolume)
 void SoundChannel::setLoop(int loop)
 {
     Mutex::Autolock lock(&mLock);
-    if (mAudioTrack != NULL && mSample != 0) {
+    if (mSoundPool->mMixer != NULL && mSample != 0) {
+        mLoopsRemaining = loop;
+        mLoop = loop;
+    } else if (mAudioTrack != NULL && mSample != 0) {
         uint32_t loopEnd = mSample->size()/mNumChannels/
             ((mSample->format() == AUDIO_FORMAT_PCM_16_BIT) ? sizeof(int16_t) : sizeof(uint8_t));
         mAudioTrack->setLoop(0, loopEnd, loop);
@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SoundPoolCache"
+#include <utils/Log.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <utils/Vector.h>
+
+#include <binder/MemoryBase.h>
+#include <binder/MemoryHeapBase.h>
+
+#include "SoundPoolCache.h"
+
+namespace android {
+
+SoundPoolCache::SoundPoolCache(const char* directory, size_t maxBytes)
+    : mDirectory(directory),
+      mMaxBytes(maxBytes)
+{
+}
+
+static void keyFromStat(const struct stat& st, int64_t offset, int64_t length,
+        SoundPoolCache::Key* key)
+{
+    memset(key, 0, sizeof(*key));
+    key->device = st.st_dev;
+    key->inode = st.st_ino;
+    key->fileSize = st.st_size;
+    key->mtime = st.st_mtime;
+    key->offset = offset;
+    key->length = length;
+}
+
+bool SoundPoolCache::makeKey(int fd, int64_t offset, int64_t length, Key* key)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    keyFromStat(st, offset, length, key);
+    return true;
+}
+
+bool SoundPoolCache::makeKey(const char* url, Key* key)
+{
+    // only local files can be identified
+    struct stat st;
+    if (url == NULL || url[0] != '/' || stat(url, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    keyFromStat(st, 0, st.st_size, key);
+    return true;
+}
+
+String8 SoundPoolCache::pathFor(const Key& key) const
+{
+    // 64-bit FNV-1a of the key, collisions are caught by the key in the header
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&key);
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < sizeof(key); ++i) {
+        hash = (hash ^ p[i]) * 0x100000001b3ULL;
+    }
+    String8 path(mDirectory);
+    path.appendFormat("/%016llx.pcm", (unsigned long long)hash);
+    return path;
+}
+
+sp<IMemory> SoundPoolCache::load(const Key& key, uint32_t* sampleRate, int* numChannels,
+        audio_format_t* format)
+{
+    String8 path = pathFor(key);
+    int fd = open(path.string(), O_RDONLY);
+    if (fd < 0) {
+        ALOGV("no cache entry %s", path.string());
+        return 0;
+    }
+
+    sp<IMemory> data;
+    Header header;
+    struct stat st;
+    if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)
+            || header.magic != kMagic || header.version != kVersion
+            || memcmp(&header.key, &key, sizeof(key)) != 0
+            || fstat(fd, &st) != 0
+            || st.st_size < (off_t)(kDataOffset + header.size)
+            || header.size == 0) {
+        ALOGW("ignoring stale or invalid cache entry %s", path.string());
+    } else {
+        // The data ends up shared with mediaserver as a static track buffer. It is
+        // copied to anonymous memory, as the file is the app's to truncate or rewrite.
+        sp<MemoryHeapBase> heap = new MemoryHeapBase(header.size, 0, "SoundPoolCache");
+        if (heap->getHeapID() < 0 || heap->getBase() == MAP_FAILED) {
+            ALOGE("failed to allocate %u bytes for %s", header.size, path.string());
+        } else if (pread(fd, heap->getBase(), header.size, kDataOffset)
+                != (ssize_t)header.size) {
+            ALOGW("short read from cache entry %s", path.string());
+        } else {
+            data = new MemoryBase(heap, 0, header.size);
+            *sampleRate = header.sampleRate;
+            *numChannels = header.numChannels;
+            *format = (audio_format_t)header.format;
+            ALOGV("cache hit %s: %u bytes", path.string(), header.size);
+            // the modification time orders the entries for eviction
+            utimes(path.string(), NULL);
+        }
+    }
+
+    close(fd);
+    return data;
+}
+
+void SoundPoolCache::store(const Key& key, const sp<IMemory>& data, uint32_t sampleRate,
+        int numChannels, audio_format_t format)
+{
+    if (kDataOffset + data->size() > mMaxBytes) {
+        ALOGV("not caching %u bytes", data->size());
+        return;
+    }
+
+    String8 path = pathFor(key);
+    // written aside and renamed, loads never see a partial entry
+    String8 tmpPath(path);
+    tmpPath.appendFormat(".%d", gettid());
+
+    int fd = open(tmpPath.string(), O_CREAT | O_TRUNC | O_WRONLY, 0600);
+    if (fd < 0) {
+        ALOGW("can't create %s: %s", tmpPath.string(), strerror(errno));
+        return;
+    }
+
+    uint8_t page[kDataOffset];
+    memset(page, 0, sizeof(page));
+    Header* header = reinterpret_cast<Header*>(page);
+    header->magic = kMagic;
+    header->version = kVersion;
+    header->key = key;
+    header->sampleRate = sampleRate;
+    header->numChannels = numChannels;
+    header->format = format;
+    header->size = data->size();
+
+    bool ok = write(fd, page, sizeof(page)) == (ssize_t)sizeof(page)
+            && write(fd, data->pointer(), data->size()) == (ssize_t)data->size();
+    close(fd);
+
+    if (!ok || rename(tmpPath.string(), path.string()) != 0) {
+        ALOGW("can't write cache entry %s: %s", path.string(), strerror(errno));
+        unlink(tmpPath.string());
+        return;
+    }
+    ALOGV("cached %s: %u bytes", path.string(), data->size());
+
+    trim();
+}
+
+struct CacheEntry {
+    String8     path;
+    time_t      mtime;
+    off_t       size;
+};
+
+static int compareEntries(const CacheEntry* a, const CacheEntry* b)
+{
+    return a->mtime < b->mtime ? -1 : (a->mtime > b->mtime ? 1 : 0);
+}
+
+void SoundPoolCache::trim()
+{
+    Mutex::Autolock lock(&mTrimLock);
+
+    DIR* dir = opendir(mDirectory.string());
+    if (dir == NULL) {
+        return;
+    }
+
+    Vector<CacheEntry> entries;
+    size_t total = 0;
+    struct dirent* ent;
+    while ((ent = readdir(dir)) != NULL) {
+        size_t len = strlen(ent->d_name);
+        // skips entries that are still being written, they end with the writer's tid
+        if (len < 4 || strcmp(ent->d_name + len - 4, ".pcm") != 0) {
+            continue;
+        }
+        CacheEntry entry;
+        entry.path = mDirectory;
+        entry.path.appendFormat("/%s", ent->d_name);
+        struct stat st;
+        if (stat(entry.path.string(), &st) != 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+        entry.mtime = st.st_mtime;
+        entry.size = st.st_size;
+        total += st.st_size;
+        entries.add(entry);
+    }
+    closedir(dir);
+
+    if (total <= mMaxBytes) {
+        return;
+    }
+
+    entries.sort(compareEntries);
+    for (size_t i = 0; i < entries.size() && total > mMaxBytes; ++i) {
+        const CacheEntry& entry = entries[i];
+        ALOGV("evicting %s", entry.path.string());
+        if (unlink(entry.path.string()) == 0 || errno == ENOENT) {
+            total -= entry.size;
+        }
+    }
+}
+
+} // end namespace android
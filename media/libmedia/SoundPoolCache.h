@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SOUNDPOOLCACHE_H_
+#define SOUNDPOOLCACHE_H_
+
+#include <binder/IMemory.h>
+#include <system/audio.h>
+#include <utils/RefBase.h>
+#include <utils/String8.h>
+#include <utils/threads.h>
+
+namespace android {
+
+/*
+ * On-disk cache of decoded samples. Each entry is a file in the cache directory
+ * holding a header and the PCM data at a page aligned offset, so that a cached
+ * sample is read back instead of decoded. Entries are keyed by the identity and
+ * modification time of the source file and the range of the sample within it.
+ * The entries are bounded in total size, the least recently used go first.
+ */
+class SoundPoolCache : public RefBase {
+public:
+    struct Key {
+        uint64_t    device;
+        uint64_t    inode;
+        uint64_t    fileSize;
+        int64_t     mtime;
+        int64_t     offset;
+        int64_t     length;
+    };
+
+    SoundPoolCache(const char* directory, size_t maxBytes = kDefaultMaxBytes);
+
+    // Returns false if the source can't be identified, the sample isn't cached then.
+    static bool makeKey(int fd, int64_t offset, int64_t length, Key* key);
+    static bool makeKey(const char* url, Key* key);
+
+    // Returns the cached PCM data, or 0 if the sample isn't in the cache.
+    sp<IMemory> load(const Key& key, uint32_t* sampleRate, int* numChannels,
+            audio_format_t* format);
+
+    void store(const Key& key, const sp<IMemory>& data, uint32_t sampleRate,
+            int numChannels, audio_format_t format);
+
+private:
+    static const uint32_t kMagic = 0x4d435053;     // 'SPCM'
+    static const uint32_t kVersion = 1;
+    static const uint32_t kDataOffset = 4096;
+    static const size_t kDefaultMaxBytes = 16 * 1024 * 1024;
+
+    struct Header {
+        uint32_t    magic;
+        uint32_t    version;
+        Key         key;
+        uint32_t    sampleRate;
+        uint32_t    numChannels;
+        uint32_t    format;
+        uint32_t    size;
+    };
+
+    String8 pathFor(const Key& key) const;
+
+    // removes the least recently used entries until they fit in mMaxBytes
+    void trim();
+
+    String8     mDirectory;
+    size_t      mMaxBytes;
+    Mutex       mTrimLock;
+};
+
+} // end namespace android
+
+#endif /*SOUNDPOOLCACHE_H_*/
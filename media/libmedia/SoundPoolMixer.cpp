@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SoundPoolMixer"
+#include <utils/Log.h>
+
+#include <audio_utils/primitives.h>
+#include <system/audio.h>
+
+#include "SoundPoolMixer.h"
+
+namespace android {
+
+SoundPoolMixer::SoundPoolMixer(SoundPool* soundPool)
+    : mSoundPool(soundPool),
+      mAudioTrack(NULL),
+      mStatus(NO_INIT),
+      mSampleRate(0),
+      mStarted(false),
+      mIdleFrames(0),
+      mStopRequested(false)
+{
+    int afSampleRate;
+    audio_stream_type_t streamType = soundPool->streamType();
+    if (AudioSystem::getOutputSamplingRate(&afSampleRate, streamType) != NO_ERROR) {
+        ALOGE("Unable to get the output sample rate");
+        return;
+    }
+
+    // let AudioFlinger size the buffer of the fast track
+    mAudioTrack = new AudioTrack(streamType, afSampleRate, AUDIO_FORMAT_PCM_16_BIT,
+            AUDIO_CHANNEL_OUT_STEREO, 0, AUDIO_OUTPUT_FLAG_FAST, callback, this);
+    mStatus = mAudioTrack->initCheck();
+    if (mStatus != NO_ERROR) {
+        ALOGE("Error creating AudioTrack");
+        return;
+    }
+    mSampleRate = mAudioTrack->getSampleRate();
+    ALOGV("mixer track: sampleRate=%u, frameCount=%u, latency=%u",
+            mSampleRate, mAudioTrack->frameCount(), mAudioTrack->latency());
+}
+
+SoundPoolMixer::~SoundPoolMixer()
+{
+    // waits for the callback thread, so the channels must not be gone yet
+    delete mAudioTrack;
+}
+
+// call with sound pool lock held
+void SoundPoolMixer::start()
+{
+    if (!mStarted) {
+        ALOGV("start mixer track");
+        // the callback isn't running while the track is stopped
+        mIdleFrames = 0;
+        mStopRequested = false;
+        mAudioTrack->start();
+        mStarted = true;
+    }
+}
+
+// call with sound pool lock held
+void SoundPoolMixer::stopIfIdle()
+{
+    if (!mStarted) {
+        return;
+    }
+    for (int i = 0; i < mSoundPool->mMaxChannels; ++i) {
+        if (mSoundPool->mChannelPool[i].state() == SoundChannel::PLAYING) {
+            return;
+        }
+    }
+    ALOGV("stop idle mixer track");
+    mAudioTrack->stop();
+    mStarted = false;
+}
+
+void SoundPoolMixer::callback(int event, void* user, void *info)
+{
+    static_cast<SoundPoolMixer*>(user)->process(event, info);
+}
+
+void SoundPoolMixer::process(int event, void *info)
+{
+    if (event != AudioTrack::EVENT_MORE_DATA) {
+        return;
+    }
+
+    AudioTrack::Buffer* b = static_cast<AudioTrack::Buffer *>(info);
+    int16_t* q = b->i16;
+    size_t frames = b->frameCount;
+    bool active = false;
+
+    while (frames > 0) {
+        size_t count = frames < kMaxMixFrames ? frames : kMaxMixFrames;
+        memset(mMixBuffer, 0, count * 2 * sizeof(int32_t));
+        for (int i = 0; i < mSoundPool->mMaxChannels; ++i) {
+            if (mSoundPool->mChannelPool[i].mix(mMixBuffer, count)) {
+                active = true;
+            }
+        }
+        for (size_t i = 0; i < count * 2; ++i) {
+            *q++ = clamp16(mMixBuffer[i] >> 12);
+        }
+        frames -= count;
+    }
+
+    if (active) {
+        mIdleFrames = 0;
+        mStopRequested = false;
+    } else if (!mStopRequested) {
+        mIdleFrames += b->frameCount;
+        if (mIdleFrames >= mSampleRate / 1000 * kIdleTimeMs) {
+            mStopRequested = true;
+            mSoundPool->requestMixerStop();
+        }
+    }
+}
+
+static inline int32_t pcm16(int16_t s)
+{
+    return s;
+}
+
+static inline int32_t pcm16(uint8_t s)
+{
+    return (int32_t(s) - 0x80) << 8;
+}
+
+template <int CHANNELS, typename T>
+static size_t mixFrames(int32_t* out, size_t frameCount, const T* in, size_t inFrames,
+        uint64_t* phase, uint32_t phaseIncrement, int32_t leftGain, int32_t rightGain,
+        int* loopsRemaining)
+{
+    uint64_t pos = *phase;
+    size_t i = 0;
+
+    if (inFrames == 0) {
+        return 0;
+    }
+    for (; i < frameCount; ++i) {
+        size_t index = pos >> 16;
+        if (index >= inFrames) {
+            if (*loopsRemaining == 0) {
+                break;
+            }
+            if (*loopsRemaining > 0) {
+                (*loopsRemaining)--;
+            }
+            pos -= uint64_t(inFrames) << 16;
+            index = pos >> 16;
+            if (index >= inFrames) {
+                // more than a whole sample per output frame
+                pos = 0;
+                index = 0;
+            }
+        }
+
+        // interpolate towards the next frame, the first one if looping
+        size_t next = index + 1;
+        if (next == inFrames) {
+            next = (*loopsRemaining != 0) ? 0 : index;
+        }
+        int32_t frac = int32_t(pos & 0xFFFF) >> 1;
+        int32_t l0 = pcm16(in[index * CHANNELS]);
+        int32_t l1 = pcm16(in[next * CHANNELS]);
+        int32_t l = l0 + (((l1 - l0) * frac) >> 15);
+        int32_t r = l;
+        if (CHANNELS == 2) {
+            int32_t r0 = pcm16(in[index * CHANNELS + 1]);
+            int32_t r1 = pcm16(in[next * CHANNELS + 1]);
+            r = r0 + (((r1 - r0) * frac) >> 15);
+        }
+        out[i * 2] += l * leftGain;
+        out[i * 2 + 1] += r * rightGain;
+        pos += phaseIncrement;
+    }
+
+    *phase = pos;
+    return i;
+}
+
+size_t SoundPoolMixer::mixVoice(int32_t* out, size_t frameCount, const sp<Sample>& sample,
+        uint64_t* phase, uint32_t phaseIncrement, int32_t leftGain, int32_t rightGain,
+        int* loopsRemaining)
+{
+    const void* data = sample->data();
+    if (sample->format() == AUDIO_FORMAT_PCM_16_BIT) {
+        size_t inFrames = sample->size() / sample->numChannels() / sizeof(int16_t);
+        if (sample->numChannels() == 2) {
+            return mixFrames<2>(out, frameCount, static_cast<const int16_t*>(data), inFrames,
+                    phase, phaseIncrement, leftGain, rightGain, loopsRemaining);
+        }
+        return mixFrames<1>(out, frameCount, static_cast<const int16_t*>(data), inFrames,
+                phase, phaseIncrement, leftGain, rightGain, loopsRemaining);
+    }
+    size_t inFrames = sample->size() / sample->numChannels();
+    if (sample->numChannels() == 2) {
+        return mixFrames<2>(out, frameCount, static_cast<const uint8_t*>(data), inFrames,
+                phase, phaseIncrement, leftGain, rightGain, loopsRemaining);
+    }
+    return mixFrames<1>(out, frameCount, static_cast<const uint8_t*>(data), inFrames,
+            phase, phaseIncrement, leftGain, rightGain, loopsRemaining);
+}
+
+} // end namespace android
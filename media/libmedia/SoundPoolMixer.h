@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SOUNDPOOLMIXER_H_
+#define SOUNDPOOLMIXER_H_
+
+#include <utils/threads.h>
+#include <media/AudioTrack.h>
+
+#include <media/SoundPool.h>
+
+namespace android {
+
+/*
+ * Mixes the channels of a SoundPool into a single low latency AudioTrack that
+ * lives as long as the pool, so that playing a sound does not create a track.
+ * The track is stopped by the SoundPool thread after a while without sound.
+ * Volumes are 4.12 fixed point and samples are resampled by linear
+ * interpolation, as the AudioMixer does for its tracks.
+ */
+class SoundPoolMixer {
+public:
+    SoundPoolMixer(SoundPool* soundPool);
+    ~SoundPoolMixer();
+    status_t initCheck() const { return mStatus; }
+    uint32_t sampleRate() const { return mSampleRate; }
+    // estimated time in ms from the mixing of a buffer to its output
+    uint32_t latency() const { return mAudioTrack->latency(); }
+
+    // call with sound pool lock held
+    void start();
+    void stopIfIdle();
+
+    // Mixes the sample at phase into the stereo buffer out with the given 4.12 gains.
+    // Returns the number of frames mixed, less than frameCount if the end of the
+    // sample was reached.
+    static size_t mixVoice(int32_t* out, size_t frameCount, const sp<Sample>& sample,
+            uint64_t* phase, uint32_t phaseIncrement, int32_t leftGain, int32_t rightGain,
+            int* loopsRemaining);
+
+private:
+    static const uint32_t kMaxMixFrames = 512;
+    static const uint32_t kIdleTimeMs = 1000;
+
+    static void callback(int event, void* user, void *info);
+    void process(int event, void *info);
+
+    SoundPool*          mSoundPool;
+    AudioTrack*         mAudioTrack;
+    status_t            mStatus;
+    uint32_t            mSampleRate;
+    bool                mStarted;
+    int32_t             mMixBuffer[kMaxMixFrames * 2];
+
+    // only used by the AudioTrack thread
+    uint32_t            mIdleFrames;
+    bool                mStopRequested;
+};
+
+} // end namespace android
+
+#endif /*SOUNDPOOLMIXER_H_*/
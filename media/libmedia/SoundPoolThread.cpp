@@ -18,6 +18,8 @@
 #define LOG_TAG "SoundPoolThread"
 #include "utils/Log.h"
 
+#include <unistd.h>
+
 #include "SoundPoolThread.h"
 
 namespace android {
@@ -31,7 +33,7 @@ void SoundPoolThread::write(SoundPoolMsg msg) {
     // if thread is quitting, don't add to queue
     if (mRunning) {
         mMsgQueue.push(msg);
-        mCondition.signal();
+        mCondition.broadcast();
     }
 }
 
@@ -42,7 +44,7 @@ const SoundPoolMsg SoundPoolThread::read() {
     }
     SoundPoolMsg msg = mMsgQueue[0];
     mMsgQueue.removeAt(0);
-    mCondition.signal();
+    mCondition.broadcast();
     return msg;
 }
 
@@ -51,20 +53,35 @@ void SoundPoolThread::quit() {
     if (mRunning) {
         mRunning = false;
         mMsgQueue.clear();
-        mMsgQueue.push(SoundPoolMsg(SoundPoolMsg::KILL, 0));
-        mCondition.signal();
-        mCondition.wait(mLock);
+        for (int i = 0; i < mNumThreads; ++i) {
+            mMsgQueue.push(SoundPoolMsg(SoundPoolMsg::KILL, 0));
+        }
+        mCondition.broadcast();
+        while (mNumThreads > 0) {
+            mCondition.wait(mLock);
+        }
     }
     ALOGV("return from quit");
 }
 
 SoundPoolThread::SoundPoolThread(SoundPool* soundPool) :
-    mSoundPool(soundPool)
+    mSoundPool(soundPool), mRunning(false), mNumThreads(0)
 {
     mMsgQueue.setCapacity(maxMessages);
-    if (createThreadEtc(beginThread, this, "SoundPoolThread")) {
-        mRunning = true;
+
+    // decoding is mostly done by the media server, one thread per core keeps it busy
+    long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int numThreads = (numCpus < 1) ? 1 : (numCpus > maxThreads) ? maxThreads : numCpus;
+
+    Mutex::Autolock lock(&mLock);
+    for (int i = 0; i < numThreads; ++i) {
+        if (!createThreadEtc(beginThread, this, "SoundPoolThread")) {
+            break;
+        }
+        mNumThreads++;
     }
+    ALOGV("started %d loader threads", mNumThreads);
+    mRunning = (mNumThreads > 0);
 }
 
 SoundPoolThread::~SoundPoolThread()
@@ -84,9 +101,13 @@ int SoundPoolThread::run() {
         SoundPoolMsg msg = read();
         ALOGV("Got message m=%d, mData=%d", msg.mMessageType, msg.mData);
         switch (msg.mMessageType) {
-        case SoundPoolMsg::KILL:
+        case SoundPoolMsg::KILL: {
             ALOGV("goodbye");
+            Mutex::Autolock lock(&mLock);
+            mNumThreads--;
+            mCondition.broadcast();
             return NO_ERROR;
+        }
         case SoundPoolMsg::LOAD_SAMPLE:
             doLoadSample(msg.mData);
             break;
@@ -106,7 +127,7 @@ void SoundPoolThread::doLoadSample(int sampleID) {
     sp <Sample> sample = mSoundPool->findSample(sampleID);
     status_t status = -1;
     if (sample != 0) {
-        status = sample->doLoad();
+        status = sample->doLoad(mSoundPool->cache());
     }
     mSoundPool->notify(SoundPoolEvent(SoundPoolEvent::SAMPLE_LOADED, sampleID, status));
 }
@@ -36,7 +36,8 @@ public:
 };
 
 /*
- * This class handles background requests from the SoundPool
+ * This class handles background requests from the SoundPool. Samples are
+ * decoded by a pool of threads reading the same message queue.
  */
 class SoundPoolThread {
 public:
@@ -48,6 +49,7 @@ public:
 
 private:
     static const size_t maxMessages = 5;
+    static const int maxThreads = 4;
 
     static int beginThread(void* arg);
     int run();
@@ -59,6 +61,7 @@ private:
     Vector<SoundPoolMsg>    mMsgQueue;
     SoundPool*              mSoundPool;
     bool                    mRunning;
+    int                     mNumThreads;
 };
 
 } // end namespace android
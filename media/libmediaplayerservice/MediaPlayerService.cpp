@@ -396,6 +396,12 @@ status_t MediaPlayerService::dump(int fd, const Vector<String16>& args)
             }
         }
 
+        if (mOMX != NULL) {
+            write(fd, result.string(), result.size());
+            result = "\n";
+            mOMX->asBinder()->dump(fd, args);
+        }
+
         result.append(" Files opened and/or mapped:\n");
         snprintf(buffer, SIZE, "/proc/%d/maps", gettid());
         FILE *f = fopen(buffer, "r");
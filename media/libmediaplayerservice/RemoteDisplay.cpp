@@ -57,4 +57,8 @@ status_t RemoteDisplay::dispose() {
     return OK;
 }
 
+status_t RemoteDisplay::dump(int fd, const Vector<String16> &args) {
+    return mNetSession->dump(fd, args);
+}
+
 }  // namespace android
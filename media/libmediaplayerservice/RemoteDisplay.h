@@ -37,6 +37,8 @@ struct RemoteDisplay : public BnRemoteDisplay {
     virtual status_t resume();
     virtual status_t dispose();
 
+    virtual status_t dump(int fd, const Vector<String16> &args);
+
 protected:
     virtual ~RemoteDisplay();
 
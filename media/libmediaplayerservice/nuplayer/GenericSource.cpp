@@ -20,6 +20,7 @@
 
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/FileSource.h>
@@ -31,13 +32,21 @@
 
 namespace android {
 
+// How far ahead of the decoders each track is read.
+static const int64_t kPrefetchDurationUs = 1000000ll;
+
+// Extractor buffers stay with us while they are queued, ask the extractor
+// for a few so that it can keep reading ahead.
+static const int32_t kNumReadAheadBuffers = 4;
+
 NuPlayer::GenericSource::GenericSource(
         const char *url,
         const KeyedVector<String8, String8> *headers,
         bool uidValid,
         uid_t uid)
     : mDurationUs(0ll),
-      mAudioIsVorbis(false) {
+      mAudioIsVorbis(false),
+      mGeneration(0) {
     DataSource::RegisterDefaultSniffers();
 
     sp<DataSource> dataSource =
@@ -50,7 +59,8 @@ NuPlayer::GenericSource::GenericSource(
 NuPlayer::GenericSource::GenericSource(
         int fd, int64_t offset, int64_t length)
     : mDurationUs(0ll),
-      mAudioIsVorbis(false) {
+      mAudioIsVorbis(false),
+      mGeneration(0) {
     DataSource::RegisterDefaultSniffers();
 
     sp<DataSource> dataSource = new FileSource(dup(fd), offset, length);
@@ -60,6 +70,11 @@ NuPlayer::GenericSource::GenericSource(
 
 void NuPlayer::GenericSource::initFromDataSource(
         const sp<DataSource> &dataSource) {
+    mAudioTrack.mReadPending = false;
+    mVideoTrack.mReadPending = false;
+    mAudioTrack.mPassThrough = false;
+    mVideoTrack.mPassThrough = false;
+
     sp<MediaExtractor> extractor = MediaExtractor::Create(dataSource);
 
     CHECK(extractor != NULL);
@@ -100,28 +115,82 @@ void NuPlayer::GenericSource::initFromDataSource(
 }
 
 NuPlayer::GenericSource::~GenericSource() {
+    stop();
+}
+
+// Most extractors have a single buffer and block in read() until it comes
+// back, so their buffers can only be queued as they are if they said they
+// allocated the read-ahead buffers asked for.
+static bool honoursReadAhead(const sp<MediaSource> &source) {
+    int32_t numBuffers;
+    return source->getFormat()->findInt32(kKeyNumReadAheadBuffers, &numBuffers)
+            && numBuffers >= kNumReadAheadBuffers;
 }
 
 void NuPlayer::GenericSource::start() {
     ALOGI("start");
 
+    sp<MetaData> params = new MetaData;
+    params->setInt32(kKeyNumReadAheadBuffers, kNumReadAheadBuffers);
+
     if (mAudioTrack.mSource != NULL) {
-        CHECK_EQ(mAudioTrack.mSource->start(), (status_t)OK);
+        CHECK_EQ(mAudioTrack.mSource->start(params.get()), (status_t)OK);
 
+        mAudioTrack.mPassThrough = honoursReadAhead(mAudioTrack.mSource);
         mAudioTrack.mPackets =
             new AnotherPacketSource(mAudioTrack.mSource->getFormat());
-
-        readBuffer(true /* audio */);
     }
 
     if (mVideoTrack.mSource != NULL) {
-        CHECK_EQ(mVideoTrack.mSource->start(), (status_t)OK);
+        CHECK_EQ(mVideoTrack.mSource->start(params.get()), (status_t)OK);
 
+        mVideoTrack.mPassThrough = honoursReadAhead(mVideoTrack.mSource);
         mVideoTrack.mPackets =
             new AnotherPacketSource(mVideoTrack.mSource->getFormat());
+    }
+
+    mLooper = new ALooper;
+    mLooper->setName("generic_source");
+    mLooper->start();
 
-        readBuffer(false /* audio */);
+    mReflector = new AHandlerReflector<GenericSource>(this);
+    mLooper->registerHandler(mReflector);
+
+    Mutex::Autolock autoLock(mLock);
+    postReadBuffer_l(true /* audio */);
+    postReadBuffer_l(false /* audio */);
+}
+
+void NuPlayer::GenericSource::stop() {
+    sp<ALooper> looper;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        looper = mLooper;
+        mLooper.clear();
+
+        ++mGeneration;
+    }
+
+    if (looper == NULL) {
+        return;
     }
+
+    // Whatever was read ahead may hold on to the extractor's buffers, which
+    // a pending read could be waiting for, so drop it before waiting for
+    // the looper.
+    if (mAudioTrack.mPackets != NULL) {
+        mAudioTrack.mPackets->clear();
+    }
+
+    if (mVideoTrack.mPackets != NULL) {
+        mVideoTrack.mPackets->clear();
+    }
+
+    looper->unregisterHandler(mReflector->id());
+    looper->stop();
+
+    mReflector.clear();
 }
 
 status_t NuPlayer::GenericSource::feedMoreTSData() {
@@ -153,7 +222,8 @@ status_t NuPlayer::GenericSource::dequeueAccessUnit(
 
     status_t result = track->mPackets->dequeueAccessUnit(accessUnit);
 
-    readBuffer(audio, -1ll);
+    Mutex::Autolock autoLock(mLock);
+    postReadBuffer_l(audio);
 
     return result;
 }
@@ -164,22 +234,130 @@ status_t NuPlayer::GenericSource::getDuration(int64_t *durationUs) {
 }
 
 status_t NuPlayer::GenericSource::seekTo(int64_t seekTimeUs) {
-    if (mVideoTrack.mSource != NULL) {
-        int64_t actualTimeUs;
-        readBuffer(false /* audio */, seekTimeUs, &actualTimeUs);
+    if (mLooper == NULL) {
+        return INVALID_OPERATION;
+    }
 
-        seekTimeUs = actualTimeUs;
+    int32_t generation;
+    {
+        Mutex::Autolock autoLock(mLock);
+        generation = ++mGeneration;
+
+        mAudioTrack.mReadPending = false;
+        mVideoTrack.mReadPending = false;
     }
 
-    if (mAudioTrack.mSource != NULL) {
-        readBuffer(true /* audio */, seekTimeUs);
+    // Anything read ahead is stale now. Dropping it also returns its
+    // buffers to the extractor, in case a pending read is waiting for one.
+    if (mAudioTrack.mPackets != NULL) {
+        mAudioTrack.mPackets->clear();
     }
 
-    return OK;
+    if (mVideoTrack.mPackets != NULL) {
+        mVideoTrack.mPackets->clear();
+    }
+
+    sp<AMessage> msg = new AMessage(kWhatSeek, mReflector->id());
+    msg->setInt64("seekTimeUs", seekTimeUs);
+    msg->setInt32("generation", generation);
+
+    sp<AMessage> response;
+    return msg->postAndAwaitResponse(&response);
+}
+
+void NuPlayer::GenericSource::onMessageReceived(const sp<AMessage> &msg) {
+    switch (msg->what()) {
+        case kWhatReadBuffer:
+        {
+            int32_t audio, generation;
+            CHECK(msg->findInt32("audio", &audio));
+            CHECK(msg->findInt32("generation", &generation));
+
+            {
+                Mutex::Autolock autoLock(mLock);
+                if (generation != mGeneration) {
+                    break;
+                }
+            }
+
+            readBuffer(audio, generation);
+
+            Mutex::Autolock autoLock(mLock);
+            if (generation != mGeneration) {
+                break;
+            }
+
+            Track *track = audio ? &mAudioTrack : &mVideoTrack;
+            track->mReadPending = false;
+
+            postReadBuffer_l(audio);
+            break;
+        }
+
+        case kWhatSeek:
+        {
+            int64_t seekTimeUs;
+            CHECK(msg->findInt64("seekTimeUs", &seekTimeUs));
+
+            int32_t generation;
+            CHECK(msg->findInt32("generation", &generation));
+
+            if (mVideoTrack.mSource != NULL) {
+                int64_t actualTimeUs;
+                readBuffer(
+                        false /* audio */, generation,
+                        seekTimeUs, &actualTimeUs);
+
+                seekTimeUs = actualTimeUs;
+            }
+
+            if (mAudioTrack.mSource != NULL) {
+                readBuffer(true /* audio */, generation, seekTimeUs);
+            }
+
+            uint32_t replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+            (new AMessage)->postReply(replyID);
+
+            Mutex::Autolock autoLock(mLock);
+            if (generation == mGeneration) {
+                postReadBuffer_l(true /* audio */);
+                postReadBuffer_l(false /* audio */);
+            }
+            break;
+        }
+
+        default:
+            TRESPASS();
+            break;
+    }
+}
+
+void NuPlayer::GenericSource::postReadBuffer_l(bool audio) {
+    Track *track = audio ? &mAudioTrack : &mVideoTrack;
+
+    if (mLooper == NULL || track->mSource == NULL || track->mReadPending) {
+        return;
+    }
+
+    status_t finalResult;
+    if (track->mPackets->getBufferedDurationUs(&finalResult)
+                >= kPrefetchDurationUs
+            || finalResult != OK) {
+        return;
+    }
+
+    track->mReadPending = true;
+
+    sp<AMessage> msg = new AMessage(kWhatReadBuffer, mReflector->id());
+    msg->setInt32("audio", audio);
+    msg->setInt32("generation", mGeneration);
+    msg->post();
 }
 
 void NuPlayer::GenericSource::readBuffer(
-        bool audio, int64_t seekTimeUs, int64_t *actualTimeUs) {
+        bool audio, int32_t generation,
+        int64_t seekTimeUs, int64_t *actualTimeUs) {
     Track *track = audio ? &mAudioTrack : &mVideoTrack;
     CHECK(track->mSource != NULL);
 
@@ -203,19 +381,24 @@ void NuPlayer::GenericSource::readBuffer(
         options.clearSeekTo();
 
         if (err == OK) {
-            size_t outLength = mbuf->range_length();
+            int64_t timeUs;
+            CHECK(mbuf->meta_data()->findInt64(kKeyTime, &timeUs));
 
-            if (audio && mAudioIsVorbis) {
-                outLength += sizeof(int32_t);
+            if (actualTimeUs) {
+                *actualTimeUs = timeUs;
             }
 
-            sp<ABuffer> buffer = new ABuffer(outLength);
-
-            memcpy(buffer->data(),
-                   (const uint8_t *)mbuf->data() + mbuf->range_offset(),
-                   mbuf->range_length());
+            sp<ABuffer> buffer;
 
             if (audio && mAudioIsVorbis) {
+                // The vorbis decoder wants the number of valid samples in
+                // the page appended to the data, so this one is copied.
+                buffer = new ABuffer(mbuf->range_length() + sizeof(int32_t));
+
+                memcpy(buffer->data(),
+                       (const uint8_t *)mbuf->data() + mbuf->range_offset(),
+                       mbuf->range_length());
+
                 int32_t numPageSamples;
                 if (!mbuf->meta_data()->findInt32(
                             kKeyValidSamples, &numPageSamples)) {
@@ -225,20 +408,37 @@ void NuPlayer::GenericSource::readBuffer(
                 memcpy(buffer->data() + mbuf->range_length(),
                        &numPageSamples,
                        sizeof(numPageSamples));
-            }
 
-            int64_t timeUs;
-            CHECK(mbuf->meta_data()->findInt64(kKeyTime, &timeUs));
+                mbuf->release();
+            } else if (!track->mPassThrough) {
+                // The extractor wants its only buffer back before it can
+                // read the next sample.
+                buffer = new ABuffer(mbuf->range_length());
+
+                memcpy(buffer->data(),
+                       (const uint8_t *)mbuf->data() + mbuf->range_offset(),
+                       mbuf->range_length());
+
+                mbuf->release();
+            } else {
+                // Pass the extractor's buffer on as is, it is returned to
+                // the extractor once the decoder is done with the data.
+                buffer = new ABuffer(
+                        (uint8_t *)mbuf->data() + mbuf->range_offset(),
+                        mbuf->range_length());
+
+                buffer->setMediaBufferBase(mbuf);
+            }
+            mbuf = NULL;
 
             buffer->meta()->setInt64("timeUs", timeUs);
 
-            if (actualTimeUs) {
-                *actualTimeUs = timeUs;
+            Mutex::Autolock autoLock(mLock);
+            if (generation != mGeneration) {
+                // Seeked or stopped while reading.
+                break;
             }
 
-            mbuf->release();
-            mbuf = NULL;
-
             if (seeking) {
                 track->mPackets->queueDiscontinuity(
                         ATSParser::DISCONTINUITY_SEEK, NULL);
@@ -252,7 +452,10 @@ void NuPlayer::GenericSource::readBuffer(
                     ATSParser::DISCONTINUITY_FORMATCHANGE, NULL);
 #endif
         } else {
-            track->mPackets->signalEOS(err);
+            Mutex::Autolock autoLock(mLock);
+            if (generation == mGeneration) {
+                track->mPackets->signalEOS(err);
+            }
             break;
         }
     }
@@ -23,8 +23,11 @@
 
 #include "ATSParser.h"
 
+#include <media/stagefright/foundation/AHandlerReflector.h>
+
 namespace android {
 
+struct ALooper;
 struct AnotherPacketSource;
 struct ARTSPController;
 struct DataSource;
@@ -40,6 +43,7 @@ struct NuPlayer::GenericSource : public NuPlayer::Source {
     GenericSource(int fd, int64_t offset, int64_t length);
 
     virtual void start();
+    virtual void stop();
 
     virtual status_t feedMoreTSData();
 
@@ -56,9 +60,18 @@ protected:
     virtual sp<MetaData> getFormatMeta(bool audio);
 
 private:
+    friend struct AHandlerReflector<GenericSource>;
+
+    enum {
+        kWhatReadBuffer = 'read',
+        kWhatSeek       = 'seek',
+    };
+
     struct Track {
         sp<MediaSource> mSource;
         sp<AnotherPacketSource> mPackets;
+        bool mReadPending;
+        bool mPassThrough;
     };
 
     Track mAudioTrack;
@@ -67,10 +80,23 @@ private:
     int64_t mDurationUs;
     bool mAudioIsVorbis;
 
+    // The tracks are read ahead on their own looper, so dequeueAccessUnit
+    // never blocks NuPlayer's looper on MediaSource::read. seekTo still
+    // waits for the seek reads, and for any read already in flight.
+    sp<ALooper> mLooper;
+    sp<AHandlerReflector<GenericSource> > mReflector;
+
+    Mutex mLock;
+    int32_t mGeneration;
+
     void initFromDataSource(const sp<DataSource> &dataSource);
 
+    void onMessageReceived(const sp<AMessage> &msg);
+
+    void postReadBuffer_l(bool audio);
+
     void readBuffer(
-            bool audio,
+            bool audio, int32_t generation,
             int64_t seekTimeUs = -1ll, int64_t *actualTimeUs = NULL);
 
     DISALLOW_EVIL_CONSTRUCTORS(GenericSource);
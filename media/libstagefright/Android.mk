@@ -17,6 +17,7 @@ LOCAL_SRC_FILES:=                         \
         DataSource.cpp                    \
         DRMExtractor.cpp                  \
         ESDS.cpp                          \
+        FileSink.cpp                      \
         FileSource.cpp                    \
         FLACExtractor.cpp                 \
         FragmentedMP4Extractor.cpp        \
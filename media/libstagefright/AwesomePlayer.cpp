@@ -227,18 +227,18 @@ AwesomePlayer::~AwesomePlayer() {
 }
 
 void AwesomePlayer::cancelPlayerEvents(bool keepNotifications) {
-    mQueue.cancelEvent(mVideoEvent->eventID());
+    mQueue.cancelEvent(mVideoEvent);
     mVideoEventPending = false;
-    mQueue.cancelEvent(mVideoLagEvent->eventID());
+    mQueue.cancelEvent(mVideoLagEvent);
     mVideoLagEventPending = false;
 
     if (!keepNotifications) {
-        mQueue.cancelEvent(mStreamDoneEvent->eventID());
+        mQueue.cancelEvent(mStreamDoneEvent);
         mStreamDoneEventPending = false;
-        mQueue.cancelEvent(mCheckAudioStatusEvent->eventID());
+        mQueue.cancelEvent(mCheckAudioStatusEvent);
         mAudioStatusEventPending = false;
 
-        mQueue.cancelEvent(mBufferingEvent->eventID());
+        mQueue.cancelEvent(mBufferingEvent);
         mBufferingEventPending = false;
     }
 }
@@ -2586,6 +2586,12 @@ bool AwesomePlayer::isStreamingHTTP() const {
 }
 
 status_t AwesomePlayer::dump(int fd, const Vector<String16> &args) const {
+    sp<NuCachedSource2> cachedSource;
+    {
+        Mutex::Autolock autoLock(mLock);
+        cachedSource = mCachedSource;
+    }
+
     Mutex::Autolock autoLock(mStatsLock);
 
     FILE *out = fdopen(dup(fd), "w");
@@ -2629,6 +2635,12 @@ status_t AwesomePlayer::dump(int fd, const Vector<String16> &args) const {
         }
     }
 
+    if (cachedSource != NULL) {
+        String8 cacheStats;
+        cachedSource->dump(&cacheStats);
+        fprintf(out, "%s", cacheStats.string());
+    }
+
     fclose(out);
     out = NULL;
 
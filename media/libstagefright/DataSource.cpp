@@ -36,11 +36,13 @@
 
 #include "matroska/MatroskaExtractor.h"
 
+#include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/FileSource.h>
 #include <media/stagefright/MediaErrors.h>
 #include <utils/String8.h>
+#include <utils/Vector.h>
 
 #include <cutils/properties.h>
 
@@ -67,8 +69,144 @@ status_t DataSource::getSize(off64_t *size) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Number of bytes at the start of the source that sniffers share. This
+// covers what all of the built-in sniffers look at for ordinary content.
+static const size_t kProbeWindowSize = 32768;
+
+// Serves reads from a single prefetched copy of the beginning of "source",
+// so that sniffers probing the same header bytes don't each go back to the
+// (possibly remote) source. Reads outside of the window are passed through.
+struct ProbeSource : public DataSource {
+    ProbeSource(const sp<DataSource> &source)
+        : mSource(source),
+          mData(NULL),
+          mSize(0),
+          mReachedEOS(false),
+          mFetched(false) {
+    }
+
+    virtual status_t initCheck() const {
+        return mSource->initCheck();
+    }
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size) {
+        fetch();
+
+        if (offset < 0 || offset >= (off64_t)mSize) {
+            if (mReachedEOS && offset >= (off64_t)mSize) {
+                return 0;
+            }
+            return mSource->readAt(offset, data, size);
+        }
+
+        size_t avail = mSize - offset;
+        if (size > avail) {
+            if (!mReachedEOS) {
+                return mSource->readAt(offset, data, size);
+            }
+            size = avail;
+        }
+
+        memcpy(data, mData + offset, size);
+
+        return size;
+    }
+
+    virtual status_t getSize(off64_t *size) {
+        return mSource->getSize(size);
+    }
+
+    virtual uint32_t flags() {
+        return mSource->flags();
+    }
+
+    virtual status_t reconnectAtOffset(off64_t offset) {
+        return mSource->reconnectAtOffset(offset);
+    }
+
+    virtual sp<DecryptHandle> DrmInitialization(const char *mime) {
+        return mSource->DrmInitialization(mime);
+    }
+
+    virtual void getDrmInfo(sp<DecryptHandle> &handle, DrmManagerClient **client) {
+        mSource->getDrmInfo(handle, client);
+    }
+
+    virtual String8 getUri() {
+        return mSource->getUri();
+    }
+
+    virtual String8 getMIMEType() const {
+        return mSource->getMIMEType();
+    }
+
+protected:
+    virtual ~ProbeSource() {
+        delete[] mData;
+        mData = NULL;
+    }
+
+private:
+    sp<DataSource> mSource;
+    uint8_t *mData;
+    size_t mSize;
+    bool mReachedEOS;
+    bool mFetched;
+
+    void fetch() {
+        if (mFetched) {
+            return;
+        }
+        mFetched = true;
+
+        mData = new uint8_t[kProbeWindowSize];
+
+        ssize_t n = mSource->readAt(0, mData, kProbeWindowSize);
+        if (n < 0) {
+            // Leave the window empty, every read goes to the source and
+            // reports its error.
+            return;
+        }
+
+        mSize = n;
+        mReachedEOS = (size_t)n < kProbeWindowSize;
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(ProbeSource);
+};
+
+struct DataSource::SnifferList : public RefBase {
+    struct Sniffer {
+        SnifferFunc mFunc;
+
+        // Negative if the sniffer didn't declare an upper bound.
+        float mMaxConfidence;
+
+        // Registration order, the earlier sniffer wins a tie.
+        size_t mIndex;
+    };
+
+    // Sniffers without a bound come first, then by decreasing bound.
+    Vector<Sniffer> mSniffers;
+
+    static bool RanksBefore(const Sniffer &a, const Sniffer &b) {
+        bool aBounded = a.mMaxConfidence >= 0.0f;
+        bool bBounded = b.mMaxConfidence >= 0.0f;
+
+        if (aBounded != bBounded) {
+            return !aBounded;
+        }
+
+        if (aBounded && a.mMaxConfidence != b.mMaxConfidence) {
+            return a.mMaxConfidence > b.mMaxConfidence;
+        }
+
+        return a.mIndex < b.mIndex;
+    }
+};
+
 Mutex DataSource::gSnifferMutex;
-List<DataSource::SnifferFunc> DataSource::gSniffers;
+sp<DataSource::SnifferList> DataSource::gSniffers;
 
 bool DataSource::sniff(
         String8 *mimeType, float *confidence, sp<AMessage> *meta) {
@@ -76,17 +214,51 @@ bool DataSource::sniff(
     *confidence = 0.0f;
     meta->clear();
 
-    Mutex::Autolock autoLock(gSnifferMutex);
-    for (List<SnifferFunc>::iterator it = gSniffers.begin();
-         it != gSniffers.end(); ++it) {
+    sp<SnifferList> sniffers;
+    {
+        Mutex::Autolock autoLock(gSnifferMutex);
+        sniffers = gSniffers;
+    }
+
+    if (sniffers == NULL) {
+        return false;
+    }
+
+    // The result is the same as running every sniffer in registration order
+    // and keeping the first one with the highest confidence, but sniffers
+    // that cannot beat the current best are never run.
+    sp<DataSource> probe;
+    size_t bestIndex = 0;
+    for (size_t i = 0; i < sniffers->mSniffers.size(); ++i) {
+        const SnifferList::Sniffer &sniffer = sniffers->mSniffers.itemAt(i);
+
+        bool bounded = sniffer.mMaxConfidence >= 0.0f;
+        if (bounded && *confidence > 0.0f
+                && (sniffer.mMaxConfidence < *confidence
+                    || (sniffer.mMaxConfidence == *confidence
+                        && sniffer.mIndex > bestIndex))) {
+            continue;
+        }
+
+        sp<DataSource> source = this;
+        if (bounded) {
+            if (probe == NULL) {
+                probe = new ProbeSource(this);
+            }
+            source = probe;
+        }
+
         String8 newMimeType;
         float newConfidence;
         sp<AMessage> newMeta;
-        if ((*it)(this, &newMimeType, &newConfidence, &newMeta)) {
-            if (newConfidence > *confidence) {
+        if ((*sniffer.mFunc)(source, &newMimeType, &newConfidence, &newMeta)) {
+            if (newConfidence > *confidence
+                    || (newConfidence == *confidence && *confidence > 0.0f
+                        && sniffer.mIndex < bestIndex)) {
                 *mimeType = newMimeType;
                 *confidence = newConfidence;
                 *meta = newMeta;
+                bestIndex = sniffer.mIndex;
             }
         }
     }
@@ -95,32 +267,56 @@ bool DataSource::sniff(
 }
 
 // static
-void DataSource::RegisterSniffer(SnifferFunc func) {
+void DataSource::RegisterSniffer(SnifferFunc func, float maxConfidence) {
     Mutex::Autolock autoLock(gSnifferMutex);
 
-    for (List<SnifferFunc>::iterator it = gSniffers.begin();
-         it != gSniffers.end(); ++it) {
-        if (*it == func) {
-            return;
+    size_t numSniffers = 0;
+    if (gSniffers != NULL) {
+        numSniffers = gSniffers->mSniffers.size();
+        for (size_t i = 0; i < numSniffers; ++i) {
+            if (gSniffers->mSniffers.itemAt(i).mFunc == func) {
+                return;
+            }
         }
     }
 
-    gSniffers.push_back(func);
+    SnifferList::Sniffer sniffer;
+    sniffer.mFunc = func;
+    sniffer.mMaxConfidence = maxConfidence;
+    sniffer.mIndex = numSniffers;
+
+    // sniff() may still be using the current list, build a new one.
+    sp<SnifferList> sniffers = new SnifferList;
+    if (gSniffers != NULL) {
+        sniffers->mSniffers = gSniffers->mSniffers;
+    }
+
+    size_t pos = 0;
+    while (pos < numSniffers
+            && SnifferList::RanksBefore(sniffers->mSniffers.itemAt(pos), sniffer)) {
+        ++pos;
+    }
+    sniffers->mSniffers.insertAt(sniffer, pos);
+
+    gSniffers = sniffers;
 }
 
 // static
 void DataSource::RegisterDefaultSniffers() {
-    RegisterSniffer(SniffMPEG4);
-    RegisterSniffer(SniffFragmentedMP4);
-    RegisterSniffer(SniffMatroska);
-    RegisterSniffer(SniffOgg);
-    RegisterSniffer(SniffWAV);
-    RegisterSniffer(SniffFLAC);
-    RegisterSniffer(SniffAMR);
-    RegisterSniffer(SniffMPEG2TS);
-    RegisterSniffer(SniffMP3);
-    RegisterSniffer(SniffAAC);
-    RegisterSniffer(SniffMPEG2PS);
+    // The bounds are the highest confidence each sniffer ever reports.
+    RegisterSniffer(SniffMPEG4, 0.4f);
+    RegisterSniffer(SniffFragmentedMP4, 0.5f);
+    RegisterSniffer(SniffMatroska, 0.6f);
+    RegisterSniffer(SniffOgg, 0.2f);
+    RegisterSniffer(SniffWAV, 0.3f);
+    RegisterSniffer(SniffFLAC, 0.5f);
+    RegisterSniffer(SniffAMR, 0.5f);
+    RegisterSniffer(SniffMPEG2TS, 0.1f);
+    RegisterSniffer(SniffMP3, 0.2f);
+    RegisterSniffer(SniffAAC, 0.2f);
+    RegisterSniffer(SniffMPEG2PS, 0.25f);
+
+    // These hand the source to DRM plugins, which get the real thing.
     RegisterSniffer(SniffWVM);
 
     char value[PROPERTY_VALUE_MAX];
@@ -0,0 +1,460 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "FileSink"
+#include <utils/Log.h>
+
+#include "include/FileSink.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef FALLOC_FL_KEEP_SIZE
+#define FALLOC_FL_KEEP_SIZE 0x01
+#endif
+
+namespace android {
+
+static const size_t kBlockAlignment = 4096;
+
+// Reserves storage for [offset, offset + length) without changing the
+// file size.
+static int allocateFileRange(int fd, off64_t offset, off64_t length) {
+#if defined(__GLIBC__)
+    return fallocate64(fd, FALLOC_FL_KEEP_SIZE, offset, length);
+#elif defined(__NR_fallocate) && defined(__LP64__)
+    return syscall(__NR_fallocate, fd, FALLOC_FL_KEEP_SIZE, offset, length);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+ssize_t FileSink::write(const void *data, size_t size) {
+    struct iovec iov;
+    iov.iov_base = const_cast<void *>(data);
+    iov.iov_len = size;
+
+    return writev(&iov, 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+DirectFileSink::DirectFileSink(int fd)
+    : mFd(fd),
+      mPosition(0),
+      mError(OK) {
+    mPosition = lseek64(mFd, 0, SEEK_CUR);
+    if (mPosition < 0) {
+        mPosition = 0;
+    }
+}
+
+DirectFileSink::~DirectFileSink() {
+}
+
+status_t DirectFileSink::initCheck() const {
+    return mFd >= 0 ? OK : NO_INIT;
+}
+
+ssize_t DirectFileSink::writev(const struct iovec *iov, int iovcnt) {
+    ssize_t n;
+    do {
+        n = ::writev(mFd, iov, iovcnt);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+        if (mError == OK) {
+            mError = -errno;
+        }
+        return n;
+    }
+
+    mPosition += n;
+
+    return n;
+}
+
+status_t DirectFileSink::seek(off64_t offset) {
+    if (lseek64(mFd, offset, SEEK_SET) < 0) {
+        return -errno;
+    }
+
+    mPosition = offset;
+
+    return OK;
+}
+
+off64_t DirectFileSink::position() const {
+    return mPosition;
+}
+
+status_t DirectFileSink::flush() {
+    return mError;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+WriteBehindFileSink::WriteBehindFileSink(
+        int fd, size_t blockSize, size_t numBlocks)
+    : mFd(fd),
+      mBlockSize(blockSize),
+      mInitCheck(NO_INIT),
+      mNumBlocksInFlight(0),
+      mCurrentBlock(NULL),
+      mPosition(0),
+      mDone(false),
+      mThreadStarted(false),
+      mError(OK),
+      mInitialFileSize(0),
+      mHighestOffset(0),
+      mPreallocationWindow(0),
+      mPreallocatedSize(0),
+      mNumBytesWritten(0),
+      mNumWriteCalls(0),
+      mNumCallerStalls(0),
+      mTotalStallTimeUs(0) {
+    CHECK_GT(mBlockSize, 0u);
+    CHECK_GT(numBlocks, 1u);
+
+    if (mFd < 0) {
+        return;
+    }
+
+    mPosition = lseek64(mFd, 0, SEEK_CUR);
+    if (mPosition < 0) {
+        mPosition = 0;
+    }
+
+    struct stat64 st;
+    if (fstat64(mFd, &st) == 0) {
+        mInitialFileSize = st.st_size;
+    }
+    mPreallocatedSize = mInitialFileSize;
+
+    for (size_t i = 0; i < numBlocks; ++i) {
+        Block *block = new Block;
+        block->mData = (uint8_t *)memalign(kBlockAlignment, mBlockSize);
+        block->mSize = 0;
+        block->mOffset = 0;
+
+        if (block->mData == NULL) {
+            ALOGE("Failed to allocate %d byte write-behind block", mBlockSize);
+            delete block;
+            return;
+        }
+
+        mBlocks.push(block);
+        mFreeBlocks.push_back(block);
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+    int err = pthread_create(&mThread, &attr, ThreadWrapper, this);
+    pthread_attr_destroy(&attr);
+
+    if (err != 0) {
+        ALOGE("Failed to start write-behind thread (%s)", strerror(err));
+        return;
+    }
+
+    mThreadStarted = true;
+    mInitCheck = OK;
+}
+
+WriteBehindFileSink::~WriteBehindFileSink() {
+    if (mThreadStarted) {
+        flush();
+
+        {
+            Mutex::Autolock autoLock(mLock);
+            mDone = true;
+            mBlockQueued.signal();
+        }
+
+        void *dummy;
+        pthread_join(mThread, &dummy);
+        mThreadStarted = false;
+    }
+
+    // Release storage reserved beyond what we actually ended up writing.
+    off64_t fileSize =
+        mHighestOffset > mInitialFileSize ? mHighestOffset : mInitialFileSize;
+    if (mPreallocatedSize > fileSize) {
+        ftruncate64(mFd, fileSize);
+    }
+
+    for (size_t i = 0; i < mBlocks.size(); ++i) {
+        free(mBlocks[i]->mData);
+        delete mBlocks[i];
+    }
+    mBlocks.clear();
+}
+
+status_t WriteBehindFileSink::initCheck() const {
+    return mInitCheck;
+}
+
+WriteBehindFileSink::Block *WriteBehindFileSink::acquireBlock_l() {
+    if (mFreeBlocks.empty()) {
+        int64_t startUs = ALooper::GetNowUs();
+
+        while (mFreeBlocks.empty()) {
+            mBlockWritten.wait(mLock);
+        }
+
+        ++mNumCallerStalls;
+        mTotalStallTimeUs += ALooper::GetNowUs() - startUs;
+    }
+
+    Block *block = *mFreeBlocks.begin();
+    mFreeBlocks.erase(mFreeBlocks.begin());
+
+    block->mSize = 0;
+    block->mOffset = mPosition;
+
+    return block;
+}
+
+void WriteBehindFileSink::queueCurrentBlock() {
+    if (mCurrentBlock == NULL) {
+        return;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+
+    if (mCurrentBlock->mSize == 0) {
+        mFreeBlocks.push_back(mCurrentBlock);
+    } else {
+        mQueuedBlocks.push_back(mCurrentBlock);
+        mBlockQueued.signal();
+    }
+
+    mCurrentBlock = NULL;
+}
+
+ssize_t WriteBehindFileSink::writev(const struct iovec *iov, int iovcnt) {
+    CHECK_EQ(mInitCheck, (status_t)OK);
+
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        const uint8_t *data = (const uint8_t *)iov[i].iov_base;
+        size_t size = iov[i].iov_len;
+
+        while (size > 0) {
+            if (mCurrentBlock == NULL) {
+                Mutex::Autolock autoLock(mLock);
+                mCurrentBlock = acquireBlock_l();
+            }
+
+            size_t copy = mBlockSize - mCurrentBlock->mSize;
+            if (copy > size) {
+                copy = size;
+            }
+
+            memcpy(mCurrentBlock->mData + mCurrentBlock->mSize, data, copy);
+            mCurrentBlock->mSize += copy;
+
+            data += copy;
+            size -= copy;
+            total += copy;
+            mPosition += copy;
+
+            if (mCurrentBlock->mSize == mBlockSize) {
+                queueCurrentBlock();
+            }
+        }
+    }
+
+    if (mPosition > mHighestOffset) {
+        mHighestOffset = mPosition;
+    }
+
+    return total;
+}
+
+status_t WriteBehindFileSink::seek(off64_t offset) {
+    if (offset < 0) {
+        return BAD_VALUE;
+    }
+
+    if (offset == mPosition) {
+        return OK;
+    }
+
+    // The pending block covers a contiguous range ending at the old
+    // position, hand it off and start a new one at the new position.
+    queueCurrentBlock();
+    mPosition = offset;
+
+    return OK;
+}
+
+off64_t WriteBehindFileSink::position() const {
+    return mPosition;
+}
+
+void WriteBehindFileSink::setPreallocationWindow(off64_t window) {
+    Mutex::Autolock autoLock(mLock);
+    mPreallocationWindow = window;
+}
+
+status_t WriteBehindFileSink::flush() {
+    if (mInitCheck != OK) {
+        return mInitCheck;
+    }
+
+    queueCurrentBlock();
+
+    Mutex::Autolock autoLock(mLock);
+    while (!mQueuedBlocks.empty() || mNumBlocksInFlight > 0) {
+        mBlockWritten.wait(mLock);
+    }
+
+    return mError;
+}
+
+void WriteBehindFileSink::dump(String8 *result) const {
+    Mutex::Autolock autoLock(mLock);
+
+    const size_t SIZE = 256;
+    char buffer[SIZE];
+    snprintf(buffer, SIZE,
+            "     write-behind: %lld bytes in %lld writes, "
+            "%lld stalls (%lld us), %d/%d blocks queued\n",
+            mNumBytesWritten, mNumWriteCalls,
+            mNumCallerStalls, mTotalStallTimeUs,
+            mQueuedBlocks.size() + mNumBlocksInFlight, mBlocks.size());
+    result->append(buffer);
+    snprintf(buffer, SIZE,
+            "     preallocated: %lld bytes, status: %d\n",
+            mPreallocatedSize, mError);
+    result->append(buffer);
+}
+
+// Called by the flush thread without mLock held, the window can be changed
+// and the preallocated size dumped concurrently.
+void WriteBehindFileSink::preallocate(off64_t end) {
+    off64_t window;
+    off64_t preallocatedSize;
+    {
+        Mutex::Autolock autoLock(mLock);
+        window = mPreallocationWindow;
+        preallocatedSize = mPreallocatedSize;
+    }
+
+    if (window <= 0 || end <= preallocatedSize) {
+        return;
+    }
+
+    off64_t newSize = end + window;
+    int err = allocateFileRange(
+            mFd, preallocatedSize, newSize - preallocatedSize) < 0 ? errno : 0;
+
+    Mutex::Autolock autoLock(mLock);
+    if (err != 0) {
+        // Not supported by the filesystem (or we're out of space, in
+        // which case the next write will tell), stop trying.
+        ALOGV("preallocation disabled (%s)", strerror(err));
+        mPreallocationWindow = 0;
+        return;
+    }
+
+    mPreallocatedSize = newSize;
+}
+
+status_t WriteBehindFileSink::writeBlock(const Block *block) {
+    const uint8_t *data = block->mData;
+    size_t size = block->mSize;
+    off64_t offset = block->mOffset;
+
+    while (size > 0) {
+        ssize_t n = pwrite64(mFd, data, size, offset);
+        ++mNumWriteCalls;
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            ALOGE("write-behind of %d bytes at offset %lld failed (%s)",
+                  size, offset, strerror(errno));
+
+            return -errno;
+        }
+
+        data += n;
+        size -= n;
+        offset += n;
+        mNumBytesWritten += n;
+    }
+
+    return OK;
+}
+
+// static
+void *WriteBehindFileSink::ThreadWrapper(void *me) {
+    static_cast<WriteBehindFileSink *>(me)->threadFunc();
+    return NULL;
+}
+
+void WriteBehindFileSink::threadFunc() {
+    prctl(PR_SET_NAME, (unsigned long)"WriteBehind", 0, 0, 0);
+
+    Mutex::Autolock autoLock(mLock);
+    for (;;) {
+        while (mQueuedBlocks.empty() && !mDone) {
+            mBlockQueued.wait(mLock);
+        }
+
+        if (mQueuedBlocks.empty()) {
+            break;
+        }
+
+        Block *block = *mQueuedBlocks.begin();
+        mQueuedBlocks.erase(mQueuedBlocks.begin());
+        ++mNumBlocksInFlight;
+
+        // Blocks may overlap (box sizes are patched up after the fact),
+        // so they must reach the file in the order they were queued.
+        mLock.unlock();
+
+        preallocate(block->mOffset + block->mSize);
+        status_t err = writeBlock(block);
+
+        mLock.lock();
+
+        if (err != OK && mError == OK) {
+            mError = err;
+        }
+
+        --mNumBlocksInFlight;
+        mFreeBlocks.push_back(block);
+        mBlockWritten.broadcast();
+    }
+}
+
+}  // namespace android
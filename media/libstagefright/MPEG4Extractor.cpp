@@ -63,6 +63,10 @@ protected:
     virtual ~MPEG4Source();
 
 private:
+    enum {
+        kMaxNumBuffers = 8,
+    };
+
     Mutex mLock;
 
     sp<MetaData> mFormat;
@@ -1960,7 +1964,20 @@ status_t MPEG4Source::start(MetaData *params) {
     int32_t max_size;
     CHECK(mFormat->findInt32(kKeyMaxInputSize, &max_size));
 
-    mGroup->add_buffer(new MediaBuffer(max_size));
+    // Only clients that hold on to the samples they have read until they
+    // are decoded (NuPlayer::GenericSource) ask for more than one buffer.
+    int32_t numBuffers;
+    if (!params || !params->findInt32(kKeyNumReadAheadBuffers, &numBuffers)
+            || numBuffers < 1) {
+        numBuffers = 1;
+    } else if (numBuffers > kMaxNumBuffers) {
+        numBuffers = kMaxNumBuffers;
+    }
+
+    for (int32_t i = 0; i < numBuffers; ++i) {
+        mGroup->add_buffer(new MediaBuffer(max_size));
+    }
+    mFormat->setInt32(kKeyNumReadAheadBuffers, numBuffers);
 
     mSrcBuffer = new uint8_t[max_size];
 
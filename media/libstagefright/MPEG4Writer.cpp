@@ -39,6 +39,7 @@
 #include <unistd.h>
 
 #include "include/ESDS.h"
+#include "include/FileSink.h"
 
 namespace android {
 
@@ -396,6 +397,9 @@ status_t MPEG4Writer::dump(
     result.append(buffer);
     snprintf(buffer, SIZE, "     mStarted: %s\n", mStarted? "true": "false");
     result.append(buffer);
+    if (mSink != NULL) {
+        mSink->dump(&result);
+    }
     ::write(fd, result.string(), result.size());
     for (List<Track *>::iterator it = mTracks.begin();
          it != mTracks.end(); ++it) {
@@ -510,6 +514,28 @@ int64_t MPEG4Writer::estimateMoovBoxSize(int32_t bitRate) {
     return factor * size;
 }
 
+int64_t MPEG4Writer::estimatePreallocationWindow(int32_t bitRate) {
+    // Reserve storage a few seconds of media data ahead of the writes
+    // so that the filesystem can hand out contiguous extents, but never
+    // more than the file is allowed to grow to.
+    static const int64_t MIN_WINDOW_SIZE = 4 * 1024 * 1024;  // 4 MB
+    static const int64_t WINDOW_DURATION_US = 4000000;
+    int64_t size = MIN_WINDOW_SIZE;
+
+    if (bitRate > 0) {
+        int64_t size2 = WINDOW_DURATION_US * bitRate / 8000000;
+        if (size2 > size) {
+            size = size2;
+        }
+    }
+
+    if (mMaxFileSizeLimitBytes != 0 && size > mMaxFileSizeLimitBytes) {
+        size = mMaxFileSizeLimitBytes;
+    }
+
+    return size;
+}
+
 status_t MPEG4Writer::start(MetaData *param) {
     if (mInitCheck != OK) {
         return UNKNOWN_ERROR;
@@ -585,21 +611,30 @@ status_t MPEG4Writer::start(MetaData *param) {
     mMoovBoxBuffer = NULL;
     mMoovBoxBufferOffset = 0;
 
+    // Samples and box fields are staged in large blocks that a separate
+    // thread writes out, fall back to plain writes if that's not possible.
+    mSink = new WriteBehindFileSink(mFd);
+    if (mSink->initCheck() != OK) {
+        ALOGW("Write-behind unavailable, writing directly to the file.");
+        mSink = new DirectFileSink(mFd);
+    }
+
     writeFtypBox(param);
 
     mFreeBoxOffset = mOffset;
 
+    int32_t bitRate = -1;
+    if (param) {
+        param->findInt32(kKeyBitRate, &bitRate);
+    }
+
     if (mEstimatedMoovBoxSize == 0) {
-        int32_t bitRate = -1;
-        if (param) {
-            param->findInt32(kKeyBitRate, &bitRate);
-        }
         mEstimatedMoovBoxSize = estimateMoovBoxSize(bitRate);
     }
     CHECK_GE(mEstimatedMoovBoxSize, 8);
     if (mStreamableFile) {
         // Reserve a 'free' box only for streamable file
-        lseek64(mFd, mFreeBoxOffset, SEEK_SET);
+        mSink->seek(mFreeBoxOffset);
         writeInt32(mEstimatedMoovBoxSize);
         write("free", 4);
         mMdatOffset = mFreeBoxOffset + mEstimatedMoovBoxSize;
@@ -607,8 +642,10 @@ status_t MPEG4Writer::start(MetaData *param) {
         mMdatOffset = mOffset;
     }
 
+    mSink->setPreallocationWindow(estimatePreallocationWindow(bitRate));
+
     mOffset = mMdatOffset;
-    lseek64(mFd, mMdatOffset, SEEK_SET);
+    mSink->seek(mMdatOffset);
     if (mUse32BitOffset) {
         write("????mdat", 8);
     } else {
@@ -721,6 +758,14 @@ void MPEG4Writer::writeCompositionMatrix(int degrees) {
 }
 
 void MPEG4Writer::release() {
+    if (mSink != NULL) {
+        status_t err = mSink->flush();
+        if (err != OK) {
+            ALOGE("Failed to write out recorded data (%d)", err);
+        }
+        mSink.clear();
+    }
+
     close(mFd);
     mFd = -1;
     mInitCheck = NO_INIT;
@@ -775,16 +820,16 @@ status_t MPEG4Writer::reset() {
 
     // Fix up the size of the 'mdat' chunk.
     if (mUse32BitOffset) {
-        lseek64(mFd, mMdatOffset, SEEK_SET);
+        mSink->seek(mMdatOffset);
         int32_t size = htonl(static_cast<int32_t>(mOffset - mMdatOffset));
-        ::write(mFd, &size, 4);
+        mSink->write(&size, 4);
     } else {
-        lseek64(mFd, mMdatOffset + 8, SEEK_SET);
+        mSink->seek(mMdatOffset + 8);
         int64_t size = mOffset - mMdatOffset;
         size = hton64(size);
-        ::write(mFd, &size, 8);
+        mSink->write(&size, 8);
     }
-    lseek64(mFd, mOffset, SEEK_SET);
+    mSink->seek(mOffset);
 
     const off64_t moovOffset = mOffset;
     mWriteMoovBoxToMemory = mStreamableFile;
@@ -798,12 +843,12 @@ status_t MPEG4Writer::reset() {
         CHECK_LE(mMoovBoxBufferOffset + 8, mEstimatedMoovBoxSize);
 
         // Moov box
-        lseek64(mFd, mFreeBoxOffset, SEEK_SET);
+        mSink->seek(mFreeBoxOffset);
         mOffset = mFreeBoxOffset;
         write(mMoovBoxBuffer, 1, mMoovBoxBufferOffset);
 
         // Free box
-        lseek64(mFd, mOffset, SEEK_SET);
+        mSink->seek(mOffset);
         writeInt32(mEstimatedMoovBoxSize - mMoovBoxBufferOffset);
         write("free", 4);
 
@@ -932,7 +977,7 @@ void MPEG4Writer::unlock() {
 off64_t MPEG4Writer::addSample_l(MediaBuffer *buffer) {
     off64_t old_offset = mOffset;
 
-    ::write(mFd,
+    mSink->write(
           (const uint8_t *)buffer->data() + buffer->range_offset(),
           buffer->range_length());
 
@@ -960,32 +1005,30 @@ off64_t MPEG4Writer::addLengthPrefixedSample_l(MediaBuffer *buffer) {
 
     size_t length = buffer->range_length();
 
+    // Length prefix and NAL unit are handed to the sink as one vector.
+    uint8_t prefix[4];
+    struct iovec iov[2];
+    iov[0].iov_base = prefix;
+    iov[1].iov_base = (uint8_t *)buffer->data() + buffer->range_offset();
+    iov[1].iov_len = length;
+
     if (mUse4ByteNalLength) {
-        uint8_t x = length >> 24;
-        ::write(mFd, &x, 1);
-        x = (length >> 16) & 0xff;
-        ::write(mFd, &x, 1);
-        x = (length >> 8) & 0xff;
-        ::write(mFd, &x, 1);
-        x = length & 0xff;
-        ::write(mFd, &x, 1);
-
-        ::write(mFd,
-              (const uint8_t *)buffer->data() + buffer->range_offset(),
-              length);
-
-        mOffset += length + 4;
+        prefix[0] = length >> 24;
+        prefix[1] = (length >> 16) & 0xff;
+        prefix[2] = (length >> 8) & 0xff;
+        prefix[3] = length & 0xff;
+        iov[0].iov_len = 4;
     } else {
         CHECK_LT(length, 65536);
 
-        uint8_t x = length >> 8;
-        ::write(mFd, &x, 1);
-        x = length & 0xff;
-        ::write(mFd, &x, 1);
-        ::write(mFd, (const uint8_t *)buffer->data() + buffer->range_offset(), length);
-        mOffset += length + 2;
+        prefix[0] = length >> 8;
+        prefix[1] = length & 0xff;
+        iov[0].iov_len = 2;
     }
 
+    mSink->writev(iov, 2);
+    mOffset += length + iov[0].iov_len;
+
     return old_offset;
 }
 
@@ -1002,9 +1045,9 @@ size_t MPEG4Writer::write(
                  it != mBoxes.end(); ++it) {
                 (*it) += mOffset;
             }
-            lseek64(mFd, mOffset, SEEK_SET);
-            ::write(mFd, mMoovBoxBuffer, mMoovBoxBufferOffset);
-            ::write(mFd, ptr, size * nmemb);
+            mSink->seek(mOffset);
+            mSink->write(mMoovBoxBuffer, mMoovBoxBufferOffset);
+            mSink->write(ptr, size * nmemb);
             mOffset += (bytes + mMoovBoxBufferOffset);
             free(mMoovBoxBuffer);
             mMoovBoxBuffer = NULL;
@@ -1016,7 +1059,7 @@ size_t MPEG4Writer::write(
             mMoovBoxBufferOffset += bytes;
         }
     } else {
-        ::write(mFd, ptr, size * nmemb);
+        mSink->write(ptr, size * nmemb);
         mOffset += bytes;
     }
     return bytes;
@@ -1042,10 +1085,10 @@ void MPEG4Writer::endBox() {
        int32_t x = htonl(mMoovBoxBufferOffset - offset);
        memcpy(mMoovBoxBuffer + offset, &x, 4);
     } else {
-        lseek64(mFd, offset, SEEK_SET);
+        mSink->seek(offset);
         writeInt32(mOffset - offset);
         mOffset -= 4;
-        lseek64(mFd, mOffset, SEEK_SET);
+        mSink->seek(mOffset);
     }
 }
 
@@ -28,6 +28,15 @@
 
 namespace android {
 
+// The water marks are chosen to hold this much playback time, based on how
+// fast the reader consumes data.
+static const int64_t kLowWaterDurationUs = 10000000ll;
+static const int64_t kHighWaterDurationUs = 60000000ll;
+static const int64_t kRateSampleIntervalUs = 1000000ll;
+
+// The pages of the current window, a contiguous range of the source that
+// the prefetcher extends at its end, plus ranges fetched earlier that are
+// retained until the reader seeks back into one of them or they're evicted.
 struct PageCache {
     PageCache(size_t pageSize);
     ~PageCache();
@@ -49,26 +58,80 @@ struct PageCache {
 
     void copy(size_t from, void *data, size_t size);
 
+    // Moves whole pages from the start of the window, which begins at
+    // "offset", into the retained ranges. Returns the number of bytes moved.
+    size_t retainFromStart(off64_t offset, size_t maxBytes);
+
+    // The window must be empty. If a retained range contains "offset" (or
+    // ends right at it), it becomes the new window starting at *rangeOffset.
+    bool restoreRange(off64_t offset, off64_t *rangeOffset);
+
+    // Appends the retained range starting at "offset", the end of the
+    // window, to the window.
+    bool mergeRange(off64_t offset);
+
+    // Returns the start of the first retained range after "offset", or -1.
+    off64_t nextRangeOffset(off64_t offset) const;
+
+    bool copyRetained(off64_t offset, void *data, size_t size);
+
+    // Evicts the least recently used retained data until no more than
+    // "maxBytes" remain.
+    void trimRetained(size_t maxBytes);
+
+    size_t retainedSize() const {
+        return mRetainedSize;
+    }
+
+    size_t numRetainedRanges() const {
+        return mRanges.size();
+    }
+
 private:
+    struct Range {
+        List<Page *> mPages;
+        size_t mSize;
+        uint32_t mLastUse;
+    };
+
     size_t mPageSize;
     size_t mTotalSize;
+    size_t mRetainedSize;
+    uint32_t mUseCounter;
 
     List<Page *> mActivePages;
     List<Page *> mFreePages;
 
+    // Retained ranges by start offset, they never overlap each other or
+    // the window.
+    KeyedVector<off64_t, Range *> mRanges;
+
     void freePages(List<Page *> *list);
+    ssize_t findRange(off64_t offset) const;
+
+    static void CopyPages(
+            const List<Page *> &pages, size_t from, void *data, size_t size);
 
     DISALLOW_EVIL_CONSTRUCTORS(PageCache);
 };
 
 PageCache::PageCache(size_t pageSize)
     : mPageSize(pageSize),
-      mTotalSize(0) {
+      mTotalSize(0),
+      mRetainedSize(0),
+      mUseCounter(0) {
 }
 
 PageCache::~PageCache() {
     freePages(&mActivePages);
     freePages(&mFreePages);
+
+    for (size_t i = 0; i < mRanges.size(); ++i) {
+        Range *range = mRanges.valueAt(i);
+        freePages(&range->mPages);
+        delete range;
+    }
+    mRanges.clear();
 }
 
 void PageCache::freePages(List<Page *> *list) {
@@ -143,8 +206,14 @@ void PageCache::copy(size_t from, void *data, size_t size) {
 
     CHECK_LE(from + size, mTotalSize);
 
+    CopyPages(mActivePages, from, data, size);
+}
+
+// static
+void PageCache::CopyPages(
+        const List<Page *> &pages, size_t from, void *data, size_t size) {
     size_t offset = 0;
-    List<Page *>::iterator it = mActivePages.begin();
+    List<Page *>::const_iterator it = pages.begin();
     while (from >= offset + (*it)->mSize) {
         offset += (*it)->mSize;
         ++it;
@@ -175,6 +244,182 @@ void PageCache::copy(size_t from, void *data, size_t size) {
     }
 }
 
+// Returns the index of the last retained range starting at or before
+// "offset", or -1.
+ssize_t PageCache::findRange(off64_t offset) const {
+    ssize_t lo = 0;
+    ssize_t hi = (ssize_t)mRanges.size() - 1;
+    ssize_t index = -1;
+
+    while (lo <= hi) {
+        ssize_t mid = (lo + hi) / 2;
+        if (mRanges.keyAt(mid) <= offset) {
+            index = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    return index;
+}
+
+size_t PageCache::retainFromStart(off64_t offset, size_t maxBytes) {
+    if (mActivePages.empty()) {
+        return 0;
+    }
+
+    Range *range = NULL;
+    ssize_t index = findRange(offset - 1);
+    if (index >= 0) {
+        Range *prev = mRanges.valueAt(index);
+        if (mRanges.keyAt(index) + (off64_t)prev->mSize == offset) {
+            // Extends the range that ends where the window starts.
+            range = prev;
+        }
+    }
+
+    size_t bytesRetained = 0;
+    while (!mActivePages.empty()) {
+        List<Page *>::iterator it = mActivePages.begin();
+        Page *page = *it;
+
+        if (maxBytes < page->mSize) {
+            break;
+        }
+
+        if (range == NULL) {
+            range = new Range;
+            range->mSize = 0;
+            mRanges.add(offset, range);
+        }
+
+        mActivePages.erase(it);
+        range->mPages.push_back(page);
+        range->mSize += page->mSize;
+
+        maxBytes -= page->mSize;
+        bytesRetained += page->mSize;
+    }
+
+    if (range != NULL) {
+        range->mLastUse = ++mUseCounter;
+    }
+
+    mTotalSize -= bytesRetained;
+    mRetainedSize += bytesRetained;
+
+    return bytesRetained;
+}
+
+bool PageCache::restoreRange(off64_t offset, off64_t *rangeOffset) {
+    CHECK(mActivePages.empty());
+
+    ssize_t index = findRange(offset);
+    if (index < 0) {
+        return false;
+    }
+
+    Range *range = mRanges.valueAt(index);
+    off64_t start = mRanges.keyAt(index);
+    if (offset > start + (off64_t)range->mSize) {
+        return false;
+    }
+
+    mActivePages = range->mPages;
+    mTotalSize = range->mSize;
+    mRetainedSize -= range->mSize;
+
+    delete range;
+    mRanges.removeItemsAt(index);
+
+    *rangeOffset = start;
+
+    return true;
+}
+
+bool PageCache::mergeRange(off64_t offset) {
+    ssize_t index = mRanges.indexOfKey(offset);
+    if (index < 0) {
+        return false;
+    }
+
+    Range *range = mRanges.valueAt(index);
+    for (List<Page *>::iterator it = range->mPages.begin();
+         it != range->mPages.end(); ++it) {
+        mActivePages.push_back(*it);
+    }
+
+    mTotalSize += range->mSize;
+    mRetainedSize -= range->mSize;
+
+    delete range;
+    mRanges.removeItemsAt(index);
+
+    return true;
+}
+
+off64_t PageCache::nextRangeOffset(off64_t offset) const {
+    ssize_t index = findRange(offset) + 1;
+    if (index >= (ssize_t)mRanges.size()) {
+        return -1;
+    }
+
+    return mRanges.keyAt(index);
+}
+
+bool PageCache::copyRetained(off64_t offset, void *data, size_t size) {
+    ssize_t index = findRange(offset);
+    if (index < 0) {
+        return false;
+    }
+
+    Range *range = mRanges.valueAt(index);
+    off64_t start = mRanges.keyAt(index);
+    if (offset + (off64_t)size > start + (off64_t)range->mSize) {
+        return false;
+    }
+
+    if (size > 0) {
+        CopyPages(range->mPages, offset - start, data, size);
+    }
+    range->mLastUse = ++mUseCounter;
+
+    return true;
+}
+
+void PageCache::trimRetained(size_t maxBytes) {
+    while (mRetainedSize > maxBytes) {
+        size_t lru = 0;
+        for (size_t i = 1; i < mRanges.size(); ++i) {
+            // Unsigned difference, so that this survives wrap-around.
+            if (mUseCounter - mRanges.valueAt(i)->mLastUse
+                    > mUseCounter - mRanges.valueAt(lru)->mLastUse) {
+                lru = i;
+            }
+        }
+
+        // Evict from the end of the range so that its start offset, the
+        // key, stays the same.
+        Range *range = mRanges.valueAt(lru);
+        while (mRetainedSize > maxBytes && !range->mPages.empty()) {
+            List<Page *>::iterator it = --range->mPages.end();
+            Page *page = *it;
+            range->mPages.erase(it);
+
+            range->mSize -= page->mSize;
+            mRetainedSize -= page->mSize;
+
+            releasePage(page);
+        }
+
+        if (range->mPages.empty()) {
+            delete range;
+            mRanges.removeItemsAt(lru);
+        }
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 NuCachedSource2::NuCachedSource2(
@@ -194,7 +439,19 @@ NuCachedSource2::NuCachedSource2(
       mHighwaterThresholdBytes(kDefaultHighWaterThreshold),
       mLowwaterThresholdBytes(kDefaultLowWaterThreshold),
       mKeepAliveIntervalUs(kDefaultKeepAliveIntervalUs),
-      mDisconnectAtHighwatermark(disconnectAtHighwatermark) {
+      mDisconnectAtHighwatermark(disconnectAtHighwatermark),
+      mRetainedThresholdBytes(kDefaultRetainedThreshold),
+      mRetainedReadPos(-1),
+      mRetainedReadContinued(false),
+      mAdaptiveThresholds(true),
+      mReadBytesPerSec(0),
+      mFetchBytesPerSec(0),
+      mLastRateSampleTimeUs(-1),
+      mLastRateSamplePos(0),
+      mNumReads(0),
+      mNumCacheHits(0),
+      mNumBytesFetched(0),
+      mNumBytesRefetched(0) {
     // We are NOT going to support disconnect-at-highwatermark indefinitely
     // and we are not guaranteeing support for client-specified cache
     // parameters. Both of these are temporary measures to solve a specific
@@ -311,10 +568,31 @@ void NuCachedSource2::fetchInternal() {
         }
     }
 
-    PageCache::Page *page = mCache->acquirePage();
+    off64_t offset;
+    size_t size = kPageSize;
+    PageCache::Page *page;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        // Data we fetched before may already be waiting right ahead of the
+        // window, don't fetch it again and don't fetch into it.
+        while (mCache->mergeRange(mCacheOffset + mCache->totalSize())) {
+        }
+
+        offset = mCacheOffset + mCache->totalSize();
 
-    ssize_t n = mSource->readAt(
-            mCacheOffset + mCache->totalSize(), page->mData, kPageSize);
+        off64_t nextOffset = mCache->nextRangeOffset(offset);
+        if (nextOffset >= 0 && nextOffset - offset < (off64_t)size) {
+            size = nextOffset - offset;
+        }
+
+        page = mCache->acquirePage();
+    }
+
+    int64_t startUs = ALooper::GetNowUs();
+    ssize_t n = mSource->readAt(offset, page->mData, size);
+    int64_t delayUs = ALooper::GetNowUs() - startUs;
 
     Mutex::Autolock autoLock(mLock);
 
@@ -344,6 +622,118 @@ void NuCachedSource2::fetchInternal() {
 
         page->mSize = n;
         mCache->appendPage(page);
+
+        addFetchedRange_l(offset, n);
+
+        if (delayUs > 0) {
+            int64_t bytesPerSec = n * 1000000ll / delayUs;
+            mFetchBytesPerSec = (mFetchBytesPerSec == 0)
+                ? bytesPerSec : (mFetchBytesPerSec * 7 + bytesPerSec) / 8;
+        }
+    }
+}
+
+void NuCachedSource2::addFetchedRange_l(off64_t offset, size_t size) {
+    off64_t start = offset;
+    off64_t end = offset + size;
+
+    mNumBytesFetched += size;
+
+    // Merge with every range that overlaps or touches the new one, counting
+    // the overlap as data we had already fetched once.
+    size_t i = 0;
+    while (i < mFetchedRanges.size()) {
+        off64_t rangeStart = mFetchedRanges.keyAt(i);
+        off64_t rangeEnd = mFetchedRanges.valueAt(i);
+
+        if (rangeEnd < start || rangeStart > end) {
+            ++i;
+            continue;
+        }
+
+        off64_t overlapStart = rangeStart > offset ? rangeStart : offset;
+        off64_t overlapEnd = rangeEnd < offset + (off64_t)size
+            ? rangeEnd : offset + (off64_t)size;
+        if (overlapEnd > overlapStart) {
+            mNumBytesRefetched += overlapEnd - overlapStart;
+        }
+
+        if (rangeStart < start) {
+            start = rangeStart;
+        }
+        if (rangeEnd > end) {
+            end = rangeEnd;
+        }
+
+        mFetchedRanges.removeItemsAt(i);
+    }
+
+    mFetchedRanges.add(start, end);
+}
+
+void NuCachedSource2::updateThresholds_l() {
+    int64_t nowUs = ALooper::GetNowUs();
+
+    if (mLastRateSampleTimeUs < 0) {
+        mLastRateSampleTimeUs = nowUs;
+        mLastRateSamplePos = mLastAccessPos;
+        return;
+    }
+
+    int64_t elapsedUs = nowUs - mLastRateSampleTimeUs;
+    if (elapsedUs < kRateSampleIntervalUs) {
+        return;
+    }
+
+    off64_t delta = mLastAccessPos - mLastRateSamplePos;
+    mLastRateSampleTimeUs = nowUs;
+    mLastRateSamplePos = mLastAccessPos;
+
+    if (delta < 0 || delta > (off64_t)mHighwaterThresholdBytes) {
+        // A seek, not playback.
+        return;
+    }
+
+    int64_t bytesPerSec = delta * 1000000ll / elapsedUs;
+    if (bytesPerSec == 0) {
+        // Paused, keep what we've got.
+        return;
+    }
+
+    mReadBytesPerSec = (mReadBytesPerSec == 0)
+        ? bytesPerSec : (mReadBytesPerSec * 3 + bytesPerSec) / 4;
+
+    if (!mAdaptiveThresholds) {
+        return;
+    }
+
+    int64_t lowwater = mReadBytesPerSec * kLowWaterDurationUs / 1000000ll;
+    if (mFetchBytesPerSec < 2 * mReadBytesPerSec) {
+        // The network barely keeps up, start refilling earlier.
+        lowwater *= 2;
+    }
+
+    if (lowwater < kMinLowWaterThreshold) {
+        lowwater = kMinLowWaterThreshold;
+    } else if (lowwater > kMaxLowWaterThreshold) {
+        lowwater = kMaxLowWaterThreshold;
+    }
+
+    int64_t highwater = mReadBytesPerSec * kHighWaterDurationUs / 1000000ll;
+    if (highwater < lowwater + kMinPrefetchBytes) {
+        highwater = lowwater + kMinPrefetchBytes;
+    } else if (highwater > kDefaultHighWaterThreshold) {
+        highwater = kDefaultHighWaterThreshold;
+    }
+
+    if ((size_t)lowwater != mLowwaterThresholdBytes
+            || (size_t)highwater != mHighwaterThresholdBytes) {
+        ALOGV("reading %lld bytes/sec, fetching %lld bytes/sec, "
+              "lowwater = %lld bytes, highwater = %lld bytes",
+              mReadBytesPerSec, mFetchBytesPerSec, lowwater, highwater);
+
+        mLowwaterThresholdBytes = lowwater;
+        mHighwaterThresholdBytes = highwater;
     }
 }
 
@@ -361,6 +751,11 @@ void NuCachedSource2::onFetch() {
             && mKeepAliveIntervalUs > 0
             && ALooper::GetNowUs() >= mLastFetchTimeUs + mKeepAliveIntervalUs;
 
+    {
+        Mutex::Autolock autoLock(mLock);
+        updateThresholds_l();
+    }
+
     if (mFetching || keepAlive) {
         if (keepAlive) {
             ALOGI("Keep alive");
@@ -383,6 +778,13 @@ void NuCachedSource2::onFetch() {
         }
     } else {
         Mutex::Autolock autoLock(mLock);
+
+        if (mRetainedReadPos >= 0 && mRetainedReadContinued) {
+            // The reader is streaming through data we had kept around,
+            // continue prefetching from where it is.
+            seekInternal_l(mRetainedReadPos);
+        }
+
         restartPrefetcherIfNecessary_l();
     }
 
@@ -454,8 +856,10 @@ void NuCachedSource2::restartPrefetcherIfNecessary_l(
         maxBytes -= kGrayArea;
     }
 
-    size_t actualBytes = mCache->releaseFromStart(maxBytes);
+    // Keep what the reader has moved past around for backward seeks.
+    size_t actualBytes = mCache->retainFromStart(mCacheOffset, maxBytes);
     mCacheOffset += actualBytes;
+    mCache->trimRetained(mRetainedThresholdBytes);
 
     ALOGI("restarting prefetcher, totalSize = %d", mCache->totalSize());
     mFetching = true;
@@ -468,6 +872,8 @@ ssize_t NuCachedSource2::readAt(off64_t offset, void *data, size_t size) {
 
     Mutex::Autolock autoLock(mLock);
 
+    ++mNumReads;
+
     // If the request can be completely satisfied from the cache, do so.
 
     if (offset >= mCacheOffset
@@ -476,6 +882,21 @@ ssize_t NuCachedSource2::readAt(off64_t offset, void *data, size_t size) {
         mCache->copy(delta, data, size);
 
         mLastAccessPos = offset + size;
+        mRetainedReadPos = -1;
+        mRetainedReadContinued = false;
+        ++mNumCacheHits;
+
+        return size;
+    }
+
+    // Reads outside of the window, e.g. of an index at the end of the file,
+    // don't move the window as long as the data is still around.
+    if (mCache->copyRetained(offset, data, size)) {
+        // A single lazy read, e.g. of an index, doesn't move the window,
+        // only a read that continues where the previous one ended does.
+        mRetainedReadContinued = (offset == mRetainedReadPos);
+        mRetainedReadPos = offset + size;
+        ++mNumCacheHits;
 
         return size;
     }
@@ -501,6 +922,9 @@ ssize_t NuCachedSource2::readAt(off64_t offset, void *data, size_t size) {
         mLastAccessPos = offset + result;
     }
 
+    mRetainedReadPos = -1;
+    mRetainedReadContinued = false;
+
     return (ssize_t)result;
 }
 
@@ -543,7 +967,12 @@ ssize_t NuCachedSource2::readInternal(off64_t offset, void *data, size_t size) {
                 true); // force
     }
 
-    if (offset < mCacheOffset
+    if ((offset < mCacheOffset
+            || offset >= (off64_t)(mCacheOffset + mCache->totalSize()))
+            && mCache->copyRetained(offset, NULL, 0)) {
+        // Continue from the retained range that holds the data.
+        seekInternal_l(offset);
+    } else if (offset < mCacheOffset
             || offset >= (off64_t)(mCacheOffset + mCache->totalSize())) {
         static const off64_t kPadding = 256 * 1024;
 
@@ -587,18 +1016,33 @@ ssize_t NuCachedSource2::readInternal(off64_t offset, void *data, size_t size) {
 
 status_t NuCachedSource2::seekInternal_l(off64_t offset) {
     mLastAccessPos = offset;
+    mRetainedReadPos = -1;
+    mRetainedReadContinued = false;
 
     if (offset >= mCacheOffset
             && offset <= (off64_t)(mCacheOffset + mCache->totalSize())) {
         return OK;
     }
 
-    ALOGI("new range: offset= %lld", offset);
+    size_t totalSize = mCache->totalSize();
+    CHECK_EQ(mCache->retainFromStart(mCacheOffset, totalSize), totalSize);
 
-    mCacheOffset = offset;
+    off64_t rangeOffset;
+    if (mCache->restoreRange(offset, &rangeOffset)) {
+        ALOGI("new range: offset= %lld, resuming cached range at %lld",
+              offset, rangeOffset);
 
-    size_t totalSize = mCache->totalSize();
-    CHECK_EQ(mCache->releaseFromStart(totalSize), totalSize);
+        mCacheOffset = rangeOffset;
+    } else {
+        ALOGI("new range: offset= %lld", offset);
+
+        mCacheOffset = offset;
+    }
+
+    while (mCache->mergeRange(mCacheOffset + mCache->totalSize())) {
+    }
+
+    mCache->trimRetained(mRetainedThresholdBytes);
 
     mNumRetriesLeft = kMaxNumRetries;
     mFetching = true;
@@ -647,6 +1091,8 @@ void NuCachedSource2::updateCacheParamsFromString(const char *s) {
         return;
     }
 
+    mAdaptiveThresholds = false;
+
     if (lowwaterMarkKb >= 0) {
         mLowwaterThresholdBytes = lowwaterMarkKb * 1024;
     } else {
@@ -678,6 +1124,37 @@ void NuCachedSource2::updateCacheParamsFromString(const char *s) {
          mKeepAliveIntervalUs);
 }
 
+void NuCachedSource2::dump(String8 *result) const {
+    Mutex::Autolock autoLock(mLock);
+
+    const size_t SIZE = 256;
+    char buffer[SIZE];
+    snprintf(buffer, SIZE,
+            "  Cache: window %lld+%d bytes, %d bytes retained in %d ranges, "
+            "reader at %lld\n",
+            mCacheOffset, mCache->totalSize(), mCache->retainedSize(),
+            mCache->numRetainedRanges(), mLastAccessPos);
+    result->append(buffer);
+    snprintf(buffer, SIZE,
+            "   hits %lld/%lld reads (%.1f%%), "
+            "fetched %lld bytes, refetched %lld bytes\n",
+            mNumCacheHits, mNumReads,
+            mNumReads > 0 ? 100.0 * mNumCacheHits / mNumReads : 0.0,
+            mNumBytesFetched, mNumBytesRefetched);
+    result->append(buffer);
+    snprintf(buffer, SIZE,
+            "   lowwater %d bytes, highwater %d bytes (%s), "
+            "reading %lld bytes/sec, fetching %lld bytes/sec\n",
+            mLowwaterThresholdBytes, mHighwaterThresholdBytes,
+            mAdaptiveThresholds ? "adaptive" : "fixed",
+            mReadBytesPerSec, mFetchBytesPerSec);
+    result->append(buffer);
+    snprintf(buffer, SIZE,
+            "   fetching %d, status %d, %d retries left\n",
+            mFetching, mFinalStatus, mNumRetriesLeft);
+    result->append(buffer);
+}
+
 // static
 void NuCachedSource2::RemoveCacheSpecificHeaders(
         KeyedVector<String8, String8> *headers,
@@ -107,6 +107,9 @@ struct MuxOMX : public IOMX {
             const char *parameter_name,
             OMX_INDEXTYPE *index);
 
+    virtual status_t submitBuffers(
+            node_id node, const Vector<BufferCommand> &commands);
+
 private:
     mutable Mutex mLock;
 
@@ -313,6 +316,11 @@ status_t MuxOMX::getExtensionIndex(
     return getOMX(node)->getExtensionIndex(node, parameter_name, index);
 }
 
+status_t MuxOMX::submitBuffers(
+        node_id node, const Vector<BufferCommand> &commands) {
+    return getOMX(node)->submitBuffers(node, commands);
+}
+
 OMXClient::OMXClient() {
 }
 
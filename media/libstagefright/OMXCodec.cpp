@@ -39,6 +39,7 @@
 #include <media/stagefright/Utils.h>
 #include <media/stagefright/SkipCutBuffer.h>
 #include <utils/Vector.h>
+#include <cutils/properties.h>
 
 #include <OMX_Audio.h>
 #include <OMX_Component.h>
@@ -114,6 +115,32 @@ struct OMXCodecObserver : public BnOMXObserver {
         }
     }
 
+    virtual void onMessages(const List<omx_message> &messages) {
+        sp<OMXCodec> codec = mTarget.promote();
+
+        if (codec.get() != NULL) {
+            Mutex::Autolock autoLock(codec->mLock);
+
+            // The buffers returned by these messages go back to the
+            // component together.
+            codec->beginBufferCommands();
+            for (List<omx_message>::const_iterator it = messages.begin();
+                 it != messages.end(); ++it) {
+                if ((*it).type == omx_message::EVENT) {
+                    // Events may send commands, keep them in order with
+                    // the buffers.
+                    codec->endBufferCommands();
+                    codec->on_message(*it);
+                    codec->beginBufferCommands();
+                } else {
+                    codec->on_message(*it);
+                }
+            }
+            codec->endBufferCommands();
+            codec.clear();
+        }
+    }
+
 protected:
     virtual ~OMXCodecObserver() {}
 
@@ -1343,7 +1370,9 @@ OMXCodec::OMXCodec(
       mNativeWindow(
               (!strncmp(componentName, "OMX.google.", 11)
               || !strcmp(componentName, "OMX.Nvidia.mpeg2v.decode"))
-                        ? NULL : nativeWindow) {
+                        ? NULL : nativeWindow),
+      mBufferBatchingEnabled(IOMX::BufferBatchingEnabled()),
+      mBatchBufferCommands(false) {
     mPortStatus[kPortIndexInput] = ENABLED;
     mPortStatus[kPortIndexOutput] = ENABLED;
 
@@ -2916,6 +2945,8 @@ void OMXCodec::fillOutputBuffers() {
         return;
     }
 
+    bool batch = beginBufferCommands();
+
     Vector<BufferInfo> *buffers = &mPortBuffers[kPortIndexOutput];
     for (size_t i = 0; i < buffers->size(); ++i) {
         BufferInfo *info = &buffers->editItemAt(i);
@@ -2923,11 +2954,17 @@ void OMXCodec::fillOutputBuffers() {
             fillOutputBuffer(&buffers->editItemAt(i));
         }
     }
+
+    if (batch) {
+        endBufferCommands();
+    }
 }
 
 void OMXCodec::drainInputBuffers() {
     CHECK(mState == EXECUTING || mState == RECONFIGURING);
 
+    bool batch = beginBufferCommands();
+
     if (mFlags & kUseSecureInputBuffers) {
         Vector<BufferInfo> *buffers = &mPortBuffers[kPortIndexInput];
         for (size_t i = 0; i < buffers->size(); ++i) {
@@ -2954,6 +2991,86 @@ void OMXCodec::drainInputBuffers() {
             }
         }
     }
+
+    if (batch) {
+        endBufferCommands();
+    }
+}
+
+bool OMXCodec::beginBufferCommands() {
+    if (!mBufferBatchingEnabled || mBatchBufferCommands) {
+        return false;
+    }
+
+    mBatchBufferCommands = true;
+    return true;
+}
+
+void OMXCodec::flushBufferCommands() {
+    if (mBufferCommands.isEmpty()) {
+        return;
+    }
+
+    CODEC_LOGV("submitting %d buffers", mBufferCommands.size());
+    status_t err = mOMX->submitBuffers(mNode, mBufferCommands);
+    mBufferCommands.clear();
+
+    if (err != OK) {
+        CODEC_LOGE("submitBuffers failed w/ error 0x%08x", err);
+
+        setState(ERROR);
+    }
+}
+
+void OMXCodec::endBufferCommands() {
+    flushBufferCommands();
+    mBatchBufferCommands = false;
+}
+
+status_t OMXCodec::submitFillBuffer(IOMX::buffer_id buffer) {
+    if (!mBatchBufferCommands) {
+        return mOMX->fillBuffer(mNode, buffer);
+    }
+
+    IOMX::BufferCommand command;
+    command.mType = IOMX::BufferCommand::FILL_BUFFER;
+    command.mBuffer = buffer;
+    command.mRangeOffset = 0;
+    command.mRangeLength = 0;
+    command.mFlags = 0;
+    command.mTimestamp = 0;
+    mBufferCommands.push(command);
+
+    if (mBufferCommands.size() == IOMX::kMaxBufferCommands) {
+        flushBufferCommands();
+    }
+
+    return OK;
+}
+
+status_t OMXCodec::submitEmptyBuffer(
+        IOMX::buffer_id buffer,
+        OMX_U32 rangeOffset, OMX_U32 rangeLength,
+        OMX_U32 flags, OMX_TICKS timestamp) {
+    if (!mBatchBufferCommands) {
+        return mOMX->emptyBuffer(
+                mNode, buffer, rangeOffset, rangeLength, flags, timestamp);
+    }
+
+    IOMX::BufferCommand command;
+    command.mType = IOMX::BufferCommand::EMPTY_BUFFER;
+    command.mBuffer = buffer;
+    command.mRangeOffset = rangeOffset;
+    command.mRangeLength = rangeLength;
+    command.mFlags = flags;
+    command.mTimestamp = timestamp;
+    mBufferCommands.push(command);
+
+    if (mBufferCommands.size() == IOMX::kMaxBufferCommands) {
+        flushBufferCommands();
+    }
+
+    return OK;
 }
 
 bool OMXCodec::drainAnyInputBuffer() {
@@ -3029,8 +3146,8 @@ bool OMXCodec::drainInputBuffer(BufferInfo *info) {
 
         CODEC_LOGV("calling emptyBuffer with codec specific data");
 
-        status_t err = mOMX->emptyBuffer(
-                mNode, info->mBuffer, 0, size,
+        status_t err = submitEmptyBuffer(
+                info->mBuffer, 0, size,
                 OMX_BUFFERFLAG_ENDOFFRAME | OMX_BUFFERFLAG_CODECCONFIG,
                 0);
         CHECK_EQ(err, (status_t)OK);
@@ -3069,6 +3186,9 @@ bool OMXCodec::drainInputBuffer(BufferInfo *info) {
             mSeekMode = ReadOptions::SEEK_CLOSEST_SYNC;
             mBufferFilled.signal();
 
+            // The read may block, don't hold back the buffers already
+            // batched meanwhile.
+            flushBufferCommands();
             err = mSource->read(&srcBuffer, &options);
 
             if (err == OK) {
@@ -3088,6 +3208,7 @@ bool OMXCodec::drainInputBuffer(BufferInfo *info) {
 
             err = OK;
         } else {
+            flushBufferCommands();
             err = mSource->read(&srcBuffer);
         }
 
@@ -3221,8 +3342,8 @@ bool OMXCodec::drainInputBuffer(BufferInfo *info) {
                info->mBuffer, offset,
                timestampUs, timestampUs / 1E6);
 
-    err = mOMX->emptyBuffer(
-            mNode, info->mBuffer, 0, offset,
+    err = submitEmptyBuffer(
+            info->mBuffer, 0, offset,
             flags, timestampUs);
 
     if (err != OK) {
@@ -3245,7 +3366,7 @@ void OMXCodec::fillOutputBuffer(BufferInfo *info) {
     }
 
     CODEC_LOGV("Calling fillBuffer on buffer %p", info->mBuffer);
-    status_t err = mOMX->fillBuffer(mNode, info->mBuffer);
+    status_t err = submitFillBuffer(info->mBuffer);
 
     if (err != OK) {
         CODEC_LOGE("fillBuffer failed w/ error 0x%08x", err);
@@ -124,13 +124,6 @@ status_t SampleIterator::seekTo(uint32_t sampleIndex) {
     }
 
     mCurrentSampleSize = mCurrentChunkSampleSizes[chunkRelativeSampleIndex];
-    if (sampleIndex < mTTSSampleIndex) {
-        mTimeToSampleIndex = 0;
-        mTTSSampleIndex = 0;
-        mTTSSampleTime = 0;
-        mTTSCount = 0;
-        mTTSDuration = 0;
-    }
 
     status_t err;
     if ((err = findSampleTime(sampleIndex, &mCurrentSampleTime)) != OK) {
@@ -186,6 +179,10 @@ status_t SampleIterator::getChunkOffset(uint32_t chunk, off64_t *offset) {
         return ERROR_OUT_OF_RANGE;
     }
 
+    if (mTable->getIndexedChunkOffset_l(chunk, offset)) {
+        return OK;
+    }
+
     if (mTable->mChunkOffsetType == SampleTable::kChunkOffsetType32) {
         uint32_t offset32;
 
@@ -227,6 +224,10 @@ status_t SampleIterator::getSampleSizeDirect(
         return OK;
     }
 
+    if (mTable->getIndexedSampleSize_l(sampleIndex, size)) {
+        return OK;
+    }
+
     switch (mTable->mSampleSizeFieldSize) {
         case 32:
         {
@@ -291,18 +292,19 @@ status_t SampleIterator::findSampleTime(
         return ERROR_OUT_OF_RANGE;
     }
 
-    while (sampleIndex >= mTTSSampleIndex + mTTSCount) {
-        if (mTimeToSampleIndex == mTable->mTimeToSampleCount) {
+    if (sampleIndex < mTTSSampleIndex
+            || sampleIndex >= mTTSSampleIndex + mTTSCount) {
+        uint32_t i = mTable->findTimeToSampleEntry(sampleIndex);
+        if (i == mTable->mTimeToSampleCount) {
             return ERROR_OUT_OF_RANGE;
         }
 
-        mTTSSampleIndex += mTTSCount;
-        mTTSSampleTime += mTTSCount * mTTSDuration;
-
-        mTTSCount = mTable->mTimeToSample[2 * mTimeToSampleIndex];
-        mTTSDuration = mTable->mTimeToSample[2 * mTimeToSampleIndex + 1];
+        mTTSSampleIndex = mTable->mTimeToSampleFirstSample[i];
+        mTTSSampleTime = mTable->mTimeToSampleFirstTime[i];
+        mTTSCount = mTable->mTimeToSample[2 * i];
+        mTTSDuration = mTable->mTimeToSample[2 * i + 1];
 
-        ++mTimeToSampleIndex;
+        mTimeToSampleIndex = i + 1;
     }
 
     *time = mTTSSampleTime + mTTSDuration * (sampleIndex - mTTSSampleIndex);
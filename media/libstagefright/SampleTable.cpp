@@ -24,6 +24,7 @@
 #include <arpa/inet.h>
 
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/Utils.h>
 
@@ -38,10 +39,194 @@ const uint32_t SampleTable::kSampleSizeType32 = FOURCC('s', 't', 's', 'z');
 // static
 const uint32_t SampleTable::kSampleSizeTypeCompact = FOURCC('s', 't', 'z', '2');
 
+// static
+size_t SampleTable::sIndexMemoryBudget = 2 * 1024 * 1024;
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Stores a sequence of unsigned integers in blocks of kBlockSize entries,
+// each block is encoded as the smallest value in the block followed by the
+// differences to that value using just as many bits as the largest
+// difference needs. Chunk offsets grow slowly and sample sizes tend to be
+// similar within a block, so both pack tightly while retaining O(1)
+// random access.
+struct SampleTable::PackedArray {
+    PackedArray();
+    ~PackedArray();
+
+    void append(uint64_t value);
+    void finish();
+
+    uint64_t get(size_t index) const;
+
+    size_t count() const { return mCount; }
+    size_t memoryUsage() const;
+
+private:
+    enum {
+        kBlockShift = 6,
+        kBlockSize  = 1 << kBlockShift,
+    };
+
+    struct Block {
+        uint64_t mBase;
+        size_t mBitOffset;
+        uint32_t mBitWidth;
+    };
+
+    Block *mBlocks;
+    size_t mNumBlocks;
+    size_t mBlocksAllocated;
+
+    uint64_t *mBits;
+    size_t mNumBits;
+    size_t mWordsAllocated;
+
+    uint64_t mPending[kBlockSize];
+    size_t mNumPending;
+
+    size_t mCount;
+
+    void flushBlock();
+
+    DISALLOW_EVIL_CONSTRUCTORS(PackedArray);
+};
+
+SampleTable::PackedArray::PackedArray()
+    : mBlocks(NULL),
+      mNumBlocks(0),
+      mBlocksAllocated(0),
+      mBits(NULL),
+      mNumBits(0),
+      mWordsAllocated(0),
+      mNumPending(0),
+      mCount(0) {
+}
+
+SampleTable::PackedArray::~PackedArray() {
+    free(mBlocks);
+    mBlocks = NULL;
+
+    free(mBits);
+    mBits = NULL;
+}
+
+void SampleTable::PackedArray::append(uint64_t value) {
+    mPending[mNumPending++] = value;
+    ++mCount;
+
+    if (mNumPending == kBlockSize) {
+        flushBlock();
+    }
+}
+
+void SampleTable::PackedArray::finish() {
+    if (mNumPending > 0) {
+        flushBlock();
+    }
+}
+
+void SampleTable::PackedArray::flushBlock() {
+    uint64_t base = mPending[0];
+    uint64_t maxValue = mPending[0];
+    for (size_t i = 1; i < mNumPending; ++i) {
+        if (mPending[i] < base) {
+            base = mPending[i];
+        }
+        if (mPending[i] > maxValue) {
+            maxValue = mPending[i];
+        }
+    }
+
+    uint32_t bitWidth = 0;
+    for (uint64_t range = maxValue - base; range > 0; range >>= 1) {
+        ++bitWidth;
+    }
+
+    if (mNumBlocks == mBlocksAllocated) {
+        mBlocksAllocated = mBlocksAllocated ? 2 * mBlocksAllocated : 16;
+        mBlocks = (Block *)realloc(mBlocks, mBlocksAllocated * sizeof(Block));
+        CHECK(mBlocks != NULL);
+    }
+
+    Block *block = &mBlocks[mNumBlocks++];
+    block->mBase = base;
+    block->mBitOffset = mNumBits;
+    block->mBitWidth = bitWidth;
+
+    // One spare word so that get() may always look at the next word.
+    size_t wordsNeeded = (mNumBits + bitWidth * kBlockSize + 63) / 64 + 1;
+    if (wordsNeeded > mWordsAllocated) {
+        size_t newSize = mWordsAllocated ? 2 * mWordsAllocated : 16;
+        if (newSize < wordsNeeded) {
+            newSize = wordsNeeded;
+        }
+
+        mBits = (uint64_t *)realloc(mBits, newSize * sizeof(uint64_t));
+        CHECK(mBits != NULL);
+
+        memset(&mBits[mWordsAllocated], 0,
+               (newSize - mWordsAllocated) * sizeof(uint64_t));
+        mWordsAllocated = newSize;
+    }
+
+    if (bitWidth > 0) {
+        for (size_t i = 0; i < mNumPending; ++i) {
+            uint64_t delta = mPending[i] - base;
+
+            size_t word = mNumBits >> 6;
+            size_t shift = mNumBits & 63;
+
+            mBits[word] |= delta << shift;
+            if (shift + bitWidth > 64) {
+                mBits[word + 1] |= delta >> (64 - shift);
+            }
+
+            mNumBits += bitWidth;
+        }
+    }
+
+    mNumPending = 0;
+}
+
+uint64_t SampleTable::PackedArray::get(size_t index) const {
+    CHECK_LT(index, mCount);
+    CHECK_EQ(mNumPending, 0u);
+
+    const Block &block = mBlocks[index >> kBlockShift];
+    if (block.mBitWidth == 0) {
+        return block.mBase;
+    }
+
+    size_t bitOffset =
+        block.mBitOffset + (index & (kBlockSize - 1)) * block.mBitWidth;
+
+    size_t word = bitOffset >> 6;
+    size_t shift = bitOffset & 63;
+
+    uint64_t delta = mBits[word] >> shift;
+    if (shift + block.mBitWidth > 64) {
+        delta |= mBits[word + 1] << (64 - shift);
+    }
+
+    if (block.mBitWidth < 64) {
+        delta &= (1ull << block.mBitWidth) - 1;
+    }
+
+    return block.mBase + delta;
+}
+
+size_t SampleTable::PackedArray::memoryUsage() const {
+    return sizeof(*this)
+        + mBlocksAllocated * sizeof(Block)
+        + mWordsAllocated * sizeof(uint64_t);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 struct SampleTable::CompositionDeltaLookup {
     CompositionDeltaLookup();
+    ~CompositionDeltaLookup();
 
     void setEntries(
             const uint32_t *deltaEntries, size_t numDeltaEntries);
@@ -54,6 +239,9 @@ private:
     const uint32_t *mDeltaEntries;
     size_t mNumDeltaEntries;
 
+    // Index of the first sample covered by each delta entry.
+    uint64_t *mFirstSampleIndices;
+
     size_t mCurrentDeltaEntry;
     size_t mCurrentEntrySampleIndex;
 
@@ -63,10 +251,16 @@ private:
 SampleTable::CompositionDeltaLookup::CompositionDeltaLookup()
     : mDeltaEntries(NULL),
       mNumDeltaEntries(0),
+      mFirstSampleIndices(NULL),
       mCurrentDeltaEntry(0),
       mCurrentEntrySampleIndex(0) {
 }
 
+SampleTable::CompositionDeltaLookup::~CompositionDeltaLookup() {
+    delete[] mFirstSampleIndices;
+    mFirstSampleIndices = NULL;
+}
+
 void SampleTable::CompositionDeltaLookup::setEntries(
         const uint32_t *deltaEntries, size_t numDeltaEntries) {
     Mutex::Autolock autolock(mLock);
@@ -75,6 +269,15 @@ void SampleTable::CompositionDeltaLookup::setEntries(
     mNumDeltaEntries = numDeltaEntries;
     mCurrentDeltaEntry = 0;
     mCurrentEntrySampleIndex = 0;
+
+    delete[] mFirstSampleIndices;
+    mFirstSampleIndices = new uint64_t[numDeltaEntries];
+
+    uint64_t sampleIndex = 0;
+    for (size_t i = 0; i < numDeltaEntries; ++i) {
+        mFirstSampleIndices[i] = sampleIndex;
+        sampleIndex += deltaEntries[2 * i];
+    }
 }
 
 uint32_t SampleTable::CompositionDeltaLookup::getCompositionTimeOffset(
@@ -86,8 +289,21 @@ uint32_t SampleTable::CompositionDeltaLookup::getCompositionTimeOffset(
     }
 
     if (sampleIndex < mCurrentEntrySampleIndex) {
-        mCurrentDeltaEntry = 0;
-        mCurrentEntrySampleIndex = 0;
+        // Seeking backwards, find the last entry starting at or before
+        // the requested sample instead of rescanning from the start.
+        size_t left = 0;
+        size_t right = mCurrentDeltaEntry;
+        while (left + 1 < right) {
+            size_t center = left + (right - left) / 2;
+            if (mFirstSampleIndices[center] <= sampleIndex) {
+                left = center;
+            } else {
+                right = center;
+            }
+        }
+
+        mCurrentDeltaEntry = left;
+        mCurrentEntrySampleIndex = mFirstSampleIndices[left];
     }
 
     while (mCurrentDeltaEntry < mNumDeltaEntries) {
@@ -118,6 +334,8 @@ SampleTable::SampleTable(const sp<DataSource> &source)
       mNumSampleSizes(0),
       mTimeToSampleCount(0),
       mTimeToSample(NULL),
+      mTimeToSampleFirstSample(NULL),
+      mTimeToSampleFirstTime(NULL),
       mSampleTimeEntries(NULL),
       mCompositionTimeDeltaEntries(NULL),
       mNumCompositionTimeDeltaEntries(0),
@@ -126,11 +344,21 @@ SampleTable::SampleTable(const sp<DataSource> &source)
       mNumSyncSamples(0),
       mSyncSamples(NULL),
       mLastSyncSampleIndex(0),
-      mSampleToChunkEntries(NULL) {
+      mSampleToChunkEntries(NULL),
+      mIndexMemoryBudget(sIndexMemoryBudget),
+      mIndexBuilt(false),
+      mChunkOffsetIndex(NULL),
+      mSampleSizeIndex(NULL) {
     mSampleIterator = new SampleIterator(this);
 }
 
 SampleTable::~SampleTable() {
+    delete mChunkOffsetIndex;
+    mChunkOffsetIndex = NULL;
+
+    delete mSampleSizeIndex;
+    mSampleSizeIndex = NULL;
+
     delete[] mSampleToChunkEntries;
     mSampleToChunkEntries = NULL;
 
@@ -149,6 +377,12 @@ SampleTable::~SampleTable() {
     delete[] mTimeToSample;
     mTimeToSample = NULL;
 
+    delete[] mTimeToSampleFirstSample;
+    mTimeToSampleFirstSample = NULL;
+
+    delete[] mTimeToSampleFirstTime;
+    mTimeToSampleFirstTime = NULL;
+
     delete mSampleIterator;
     mSampleIterator = NULL;
 }
@@ -342,9 +576,46 @@ status_t SampleTable::setTimeToSampleParams(
         mTimeToSample[i] = ntohl(mTimeToSample[i]);
     }
 
+    mTimeToSampleFirstSample = new uint64_t[mTimeToSampleCount];
+    mTimeToSampleFirstTime = new uint32_t[mTimeToSampleCount];
+
+    uint64_t sampleIndex = 0;
+    uint32_t sampleTime = 0;
+    for (uint32_t i = 0; i < mTimeToSampleCount; ++i) {
+        mTimeToSampleFirstSample[i] = sampleIndex;
+        mTimeToSampleFirstTime[i] = sampleTime;
+
+        sampleIndex += mTimeToSample[2 * i];
+        sampleTime += mTimeToSample[2 * i] * mTimeToSample[2 * i + 1];
+    }
+
     return OK;
 }
 
+uint32_t SampleTable::findTimeToSampleEntry(uint32_t sampleIndex) const {
+    if (mTimeToSampleCount == 0 || sampleIndex < mTimeToSampleFirstSample[0]) {
+        return mTimeToSampleCount;
+    }
+
+    // Find the last entry starting at or before sampleIndex.
+    uint32_t left = 0;
+    uint32_t right = mTimeToSampleCount;
+    while (left + 1 < right) {
+        uint32_t center = left + (right - left) / 2;
+        if (mTimeToSampleFirstSample[center] <= sampleIndex) {
+            left = center;
+        } else {
+            right = center;
+        }
+    }
+
+    if (sampleIndex >= mTimeToSampleFirstSample[left] + mTimeToSample[2 * left]) {
+        return mTimeToSampleCount;
+    }
+
+    return left;
+}
+
 status_t SampleTable::setCompositionTimeToSampleParams(
         off64_t data_offset, size_t data_size) {
     ALOGI("There are reordered frames present.");
@@ -773,6 +1044,161 @@ status_t SampleTable::getSampleSize_l(
             sampleIndex, sampleSize);
 }
 
+// static
+void SampleTable::SetIndexMemoryBudget(size_t bytes) {
+    sIndexMemoryBudget = bytes;
+}
+
+bool SampleTable::getIndexedChunkOffset_l(uint32_t chunk, off64_t *offset) {
+    buildIndex_l();
+
+    if (mChunkOffsetIndex == NULL) {
+        return false;
+    }
+
+    *offset = mChunkOffsetIndex->get(chunk);
+
+    return true;
+}
+
+bool SampleTable::getIndexedSampleSize_l(uint32_t sampleIndex, size_t *size) {
+    buildIndex_l();
+
+    if (mSampleSizeIndex == NULL) {
+        return false;
+    }
+
+    *size = mSampleSizeIndex->get(sampleIndex);
+
+    return true;
+}
+
+void SampleTable::buildIndex_l() {
+    if (mIndexBuilt) {
+        return;
+    }
+
+    mIndexBuilt = true;
+
+    if (mIndexMemoryBudget == 0) {
+        return;
+    }
+
+    int64_t startUs = ALooper::GetNowUs();
+    size_t budget = mIndexMemoryBudget;
+
+    if (mDefaultSampleSize == 0 && mSampleSizeOffset >= 0) {
+        mSampleSizeIndex = buildPackedArray(
+                mSampleSizeOffset + 12, mNumSampleSizes,
+                mSampleSizeFieldSize, budget);
+
+        if (mSampleSizeIndex != NULL) {
+            size_t usage = mSampleSizeIndex->memoryUsage();
+            budget = usage >= budget ? 0 : budget - usage;
+        }
+    }
+
+    if (mChunkOffsetOffset >= 0 && budget > 0) {
+        mChunkOffsetIndex = buildPackedArray(
+                mChunkOffsetOffset + 8, mNumChunkOffsets,
+                mChunkOffsetType == kChunkOffsetType32 ? 32 : 64, budget);
+    }
+
+    ALOGV("built sample index in %lld us, %d bytes for %d chunk offsets, "
+          "%d bytes for %d sample sizes",
+          ALooper::GetNowUs() - startUs,
+          mChunkOffsetIndex != NULL ? mChunkOffsetIndex->memoryUsage() : 0,
+          mNumChunkOffsets,
+          mSampleSizeIndex != NULL ? mSampleSizeIndex->memoryUsage() : 0,
+          mNumSampleSizes);
+}
+
+SampleTable::PackedArray *SampleTable::buildPackedArray(
+        off64_t offset, uint32_t count, uint32_t fieldBits, size_t budget) {
+    static const size_t kReadSize = 16384;
+
+    uint8_t *buffer = new uint8_t[kReadSize];
+    PackedArray *array = new PackedArray;
+
+    uint64_t totalBytes = ((uint64_t)count * fieldBits + 7) / 8;
+    uint64_t bytesRead = 0;
+
+    while (bytesRead < totalBytes && array->count() < count) {
+        size_t n = kReadSize;
+        if (n > totalBytes - bytesRead) {
+            n = totalBytes - bytesRead;
+        }
+
+        if (mDataSource->readAt(offset + bytesRead, buffer, n) < (ssize_t)n) {
+            // Leave it to the on demand path to report the error.
+            delete array;
+            array = NULL;
+            break;
+        }
+
+        bytesRead += n;
+
+        switch (fieldBits) {
+            case 64:
+                for (size_t i = 0; i < n; i += 8) {
+                    array->append(U64_AT(&buffer[i]));
+                }
+                break;
+
+            case 32:
+                for (size_t i = 0; i < n; i += 4) {
+                    array->append(U32_AT(&buffer[i]));
+                }
+                break;
+
+            case 16:
+                for (size_t i = 0; i < n; i += 2) {
+                    array->append(U16_AT(&buffer[i]));
+                }
+                break;
+
+            case 8:
+                for (size_t i = 0; i < n; ++i) {
+                    array->append(buffer[i]);
+                }
+                break;
+
+            default:
+            {
+                CHECK_EQ(fieldBits, 4u);
+
+                for (size_t i = 0; i < n; ++i) {
+                    array->append(buffer[i] >> 4);
+                    if (array->count() < count) {
+                        array->append(buffer[i] & 0x0f);
+                    }
+                }
+                break;
+            }
+        }
+
+        if (array->memoryUsage() > budget) {
+            break;
+        }
+    }
+
+    delete[] buffer;
+    buffer = NULL;
+
+    if (array != NULL) {
+        // Flushing the last block may still grow the array.
+        array->finish();
+
+        if (array->memoryUsage() > budget) {
+            ALOGV("sample index exceeds memory budget of %zu bytes", budget);
+            delete array;
+            array = NULL;
+        }
+    }
+
+    return array;
+}
+
 status_t SampleTable::getMetaDataForSample(
         uint32_t sampleIndex,
         off64_t *offset,
@@ -36,6 +36,8 @@ namespace android {
 
 TimedEventQueue::TimedEventQueue()
     : mNextEventID(1),
+      mNextSequence(0),
+      mWakeupTimeUs(INT64_MIN),
       mRunning(false),
       mStopped(false) {
 }
@@ -76,6 +78,12 @@ void TimedEventQueue::stop(bool flush) {
     void *dummy;
     pthread_join(mThread, &dummy);
 
+    for (size_t i = 0; i < mQueue.size(); ++i) {
+        const QueueItem &item = mQueue.itemAt(i);
+        if (item.event->eventID() == item.id) {
+            item.event->setEventID(0);
+        }
+    }
     mQueue.clear();
 
     mRunning = false;
@@ -104,51 +112,74 @@ TimedEventQueue::event_id TimedEventQueue::postTimedEvent(
 
     event->setEventID(mNextEventID++);
 
-    List<QueueItem>::iterator it = mQueue.begin();
-    while (it != mQueue.end() && realtime_us >= (*it).realtime_us) {
-        ++it;
-    }
-
     QueueItem item;
     item.event = event;
     item.realtime_us = realtime_us;
+    item.sequence = mNextSequence++;
+    item.id = event->eventID();
 
-    if (it == mQueue.begin()) {
-        mQueueHeadChangedCondition.signal();
-    }
+    mQueue.push(item);
+    event->mQueueIndex = mQueue.size() - 1;
+    siftUp_l(mQueue.size() - 1);
 
-    mQueue.insert(it, item);
+    if (mQueue.size() == 1) {
+        mQueueNotEmptyCondition.signal();
+    }
 
-    mQueueNotEmptyCondition.signal();
+    // The thread may still be waiting for an earlier head that has since
+    // been cancelled, so this is checked even if the queue was empty.
+    bool immediate = realtime_us < 0 || realtime_us == INT64_MAX;
+    if (event->mQueueIndex == 0
+            && mWakeupTimeUs != INT64_MIN
+            && (immediate || realtime_us < mWakeupTimeUs - kWakeupSlackUs)) {
+        // The thread would otherwise sleep past this event.
+        mQueueHeadChangedCondition.signal();
+    }
 
     return event->eventID();
 }
 
-static bool MatchesEventID(
-        void *cookie, const sp<TimedEventQueue::Event> &event) {
-    TimedEventQueue::event_id *id =
-        static_cast<TimedEventQueue::event_id *>(cookie);
-
-    if (event->eventID() != *id) {
+bool TimedEventQueue::cancelEvent(event_id id) {
+    if (id == 0) {
         return false;
     }
 
-    *id = 0;
+    Mutex::Autolock autoLock(mLock);
 
-    return true;
+    for (size_t i = 0; i < mQueue.size(); ++i) {
+        const QueueItem &item = mQueue.itemAt(i);
+        if (item.id == id && item.event->eventID() == id) {
+            ALOGV("cancelling event %d", id);
+
+            removeItem_l(i);
+            return true;
+        }
+    }
+
+    return false;
 }
 
-bool TimedEventQueue::cancelEvent(event_id id) {
+bool TimedEventQueue::cancelEvent(const sp<Event> &event) {
+    Mutex::Autolock autoLock(mLock);
+
+    event_id id = event->eventID();
     if (id == 0) {
         return false;
     }
 
-    cancelEvents(&MatchesEventID, &id, true /* stopAfterFirstMatch */);
+    // The event may also be queued elsewhere.
+    size_t index = event->mQueueIndex;
+    if (index >= mQueue.size()
+            || mQueue.itemAt(index).event != event
+            || mQueue.itemAt(index).id != id) {
+        return false;
+    }
+
+    ALOGV("cancelling event %d", id);
 
-    // if MatchesEventID found a match, it will have set id to 0
-    // (which is not a valid event_id).
+    removeItem_l(index);
 
-    return id == 0;
+    return true;
 }
 
 void TimedEventQueue::cancelEvents(
@@ -157,21 +188,20 @@ void TimedEventQueue::cancelEvents(
         bool stopAfterFirstMatch) {
     Mutex::Autolock autoLock(mLock);
 
-    List<QueueItem>::iterator it = mQueue.begin();
-    while (it != mQueue.end()) {
-        if (!(*predicate)(cookie, (*it).event)) {
-            ++it;
-            continue;
-        }
+    Vector<QueueItem> items = mQueue;
+    items.sort(CompareItems);
 
-        if (it == mQueue.begin()) {
-            mQueueHeadChangedCondition.signal();
+    for (size_t i = 0; i < items.size(); ++i) {
+        const QueueItem &item = items.itemAt(i);
+        if (!(*predicate)(cookie, item.event)) {
+            continue;
         }
 
-        ALOGV("cancelling event %d", (*it).event->eventID());
+        ALOGV("cancelling event %d", item.id);
 
-        (*it).event->setEventID(0);
-        it = mQueue.erase(it);
+        ssize_t index = findItem_l(item);
+        CHECK_GE(index, 0);
+        removeItem_l(index);
 
         if (stopAfterFirstMatch) {
             return;
@@ -179,6 +209,110 @@ void TimedEventQueue::cancelEvents(
     }
 }
 
+// static
+bool TimedEventQueue::IsEarlier(const QueueItem &a, const QueueItem &b) {
+    if (a.realtime_us != b.realtime_us) {
+        return a.realtime_us < b.realtime_us;
+    }
+
+    return a.sequence < b.sequence;
+}
+
+// static
+int TimedEventQueue::CompareItems(const QueueItem *a, const QueueItem *b) {
+    return IsEarlier(*a, *b) ? -1 : (IsEarlier(*b, *a) ? 1 : 0);
+}
+
+void TimedEventQueue::setItem_l(size_t index, const QueueItem &item) {
+    mQueue.editItemAt(index) = item;
+
+    if (item.event->eventID() == item.id) {
+        item.event->mQueueIndex = index;
+    }
+}
+
+void TimedEventQueue::siftUp_l(size_t index) {
+    QueueItem item = mQueue.itemAt(index);
+
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!IsEarlier(item, mQueue.itemAt(parent))) {
+            break;
+        }
+
+        setItem_l(index, mQueue.itemAt(parent));
+        index = parent;
+    }
+
+    setItem_l(index, item);
+}
+
+void TimedEventQueue::siftDown_l(size_t index) {
+    QueueItem item = mQueue.itemAt(index);
+    size_t size = mQueue.size();
+
+    for (;;) {
+        size_t child = 2 * index + 1;
+        if (child >= size) {
+            break;
+        }
+
+        if (child + 1 < size
+                && IsEarlier(mQueue.itemAt(child + 1), mQueue.itemAt(child))) {
+            ++child;
+        }
+
+        if (!IsEarlier(mQueue.itemAt(child), item)) {
+            break;
+        }
+
+        setItem_l(index, mQueue.itemAt(child));
+        index = child;
+    }
+
+    setItem_l(index, item);
+}
+
+sp<TimedEventQueue::Event> TimedEventQueue::removeItem_l(size_t index) {
+    QueueItem item = mQueue.itemAt(index);
+
+    size_t last = mQueue.size() - 1;
+    if (index < last) {
+        setItem_l(index, mQueue.itemAt(last));
+        mQueue.removeAt(last);
+
+        if (index > 0 && IsEarlier(mQueue.itemAt(index),
+                                   mQueue.itemAt((index - 1) / 2))) {
+            siftUp_l(index);
+        } else {
+            siftDown_l(index);
+        }
+    } else {
+        mQueue.removeAt(last);
+    }
+
+    if (item.event->eventID() == item.id) {
+        item.event->setEventID(0);
+    }
+
+    return item.event;
+}
+
+ssize_t TimedEventQueue::findItem_l(const QueueItem &item) const {
+    if (item.event->eventID() == item.id) {
+        return item.event->mQueueIndex;
+    }
+
+    // An older posting of an event that has been posted again.
+    for (size_t i = 0; i < mQueue.size(); ++i) {
+        if (mQueue.itemAt(i).sequence == item.sequence) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
 // static
 void *TimedEventQueue::ThreadWrapper(void *me) {
 
@@ -207,7 +341,6 @@ void TimedEventQueue::threadEntry() {
                 mQueueNotEmptyCondition.wait(mLock);
             }
 
-            event_id eventID = 0;
             for (;;) {
                 if (mQueue.empty()) {
                     // The only event in the queue could have been cancelled
@@ -215,11 +348,8 @@ void TimedEventQueue::threadEntry() {
                     break;
                 }
 
-                List<QueueItem>::iterator it = mQueue.begin();
-                eventID = (*it).event->eventID();
-
                 now_us = ALooper::GetNowUs();
-                int64_t when_us = (*it).realtime_us;
+                int64_t when_us = mQueue.itemAt(0).realtime_us;
 
                 int64_t delay_us;
                 if (when_us < 0 || when_us == INT64_MAX) {
@@ -228,12 +358,14 @@ void TimedEventQueue::threadEntry() {
                     delay_us = when_us - now_us;
                 }
 
-                if (delay_us <= 0) {
+                if (delay_us <= kWakeupSlackUs) {
+                    // The event is removed from the queue, it can no
+                    // longer be cancelled.
+                    event = removeItem_l(0);
                     break;
                 }
 
                 static int64_t kMaxTimeoutUs = 10000000ll;  // 10 secs
-                bool timeoutCapped = false;
                 if (delay_us > kMaxTimeoutUs) {
                     ALOGW("delay_us exceeds max timeout: %lld us", delay_us);
 
@@ -242,26 +374,16 @@ void TimedEventQueue::threadEntry() {
                     // 10 secs at a time. This will also avoid overflow
                     // when converting from us to ns.
                     delay_us = kMaxTimeoutUs;
-                    timeoutCapped = true;
                 }
 
-                status_t err = mQueueHeadChangedCondition.waitRelative(
+                // Cancelling the head doesn't wake us up, the next event
+                // can only be due later. postTimedEvent wakes us up for
+                // any new head that is due before mWakeupTimeUs.
+                mWakeupTimeUs = now_us + delay_us;
+                mQueueHeadChangedCondition.waitRelative(
                         mLock, delay_us * 1000ll);
-
-                if (!timeoutCapped && err == -ETIMEDOUT) {
-                    // We finally hit the time this event is supposed to
-                    // trigger.
-                    now_us = ALooper::GetNowUs();
-                    break;
-                }
+                mWakeupTimeUs = INT64_MIN;
             }
-
-            // The event w/ this id may have been cancelled while we're
-            // waiting for its trigger-time, in that case
-            // removeEventFromQueue_l will return NULL.
-            // Otherwise, the QueueItem will be removed
-            // from the queue and the referenced event returned.
-            event = removeEventFromQueue_l(eventID);
         }
 
         if (event != NULL) {
@@ -271,24 +393,4 @@ void TimedEventQueue::threadEntry() {
     }
 }
 
-sp<TimedEventQueue::Event> TimedEventQueue::removeEventFromQueue_l(
-        event_id id) {
-    for (List<QueueItem>::iterator it = mQueue.begin();
-         it != mQueue.end(); ++it) {
-        if ((*it).event->eventID() == id) {
-            sp<Event> event = (*it).event;
-            event->setEventID(0);
-
-            mQueue.erase(it);
-
-            return event;
-        }
-    }
-
-    ALOGW("Event %d was not found in the queue, already cancelled?", id);
-
-    return NULL;
-}
-
 }  // namespace android
-
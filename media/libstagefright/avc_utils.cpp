@@ -26,6 +26,12 @@
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/MetaData.h>
 
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace android {
 
 unsigned parseUE(ABitReader *br) {
@@ -131,6 +137,65 @@ void FindAVCDimensions(
     }
 }
 
+ssize_t FindStartCode(const uint8_t *data, size_t size) {
+    size_t offset = 0;
+
+    // Tests 16 candidate positions at a time, a position matches if it and
+    // the next byte are 0x00 and the byte after that is 0x01.
+#if defined(__ARM_NEON__)
+    const uint8x16_t zero = vdupq_n_u8(0x00);
+    const uint8x16_t one = vdupq_n_u8(0x01);
+    while (offset + 18 <= size) {
+        uint8x16_t match = vandq_u8(
+                vandq_u8(vceqq_u8(vld1q_u8(&data[offset]), zero),
+                         vceqq_u8(vld1q_u8(&data[offset + 1]), zero)),
+                vceqq_u8(vld1q_u8(&data[offset + 2]), one));
+
+        uint8x8_t any = vorr_u8(vget_low_u8(match), vget_high_u8(match));
+        any = vpmax_u8(any, any);
+        if (vget_lane_u32(vreinterpret_u32_u8(any), 0) != 0) {
+            // The scalar loop below locates it within this block.
+            break;
+        }
+
+        offset += 16;
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(0x01);
+    while (offset + 18 <= size) {
+        __m128i match = _mm_and_si128(
+                _mm_and_si128(
+                    _mm_cmpeq_epi8(
+                        _mm_loadu_si128((const __m128i *)&data[offset]),
+                        zero),
+                    _mm_cmpeq_epi8(
+                        _mm_loadu_si128((const __m128i *)&data[offset + 1]),
+                        zero)),
+                _mm_cmpeq_epi8(
+                    _mm_loadu_si128((const __m128i *)&data[offset + 2]),
+                    one));
+
+        int mask = _mm_movemask_epi8(match);
+        if (mask != 0) {
+            return offset + __builtin_ctz(mask);
+        }
+
+        offset += 16;
+    }
+#endif
+
+    for (; offset + 2 < size; ++offset) {
+        if (data[offset] == 0x00
+                && data[offset + 1] == 0x00
+                && data[offset + 2] == 0x01) {
+            return offset;
+        }
+    }
+
+    return -1;
+}
+
 status_t getNextNALUnit(
         const uint8_t **_data, size_t *_size,
         const uint8_t **nalStart, size_t *nalSize,
@@ -166,25 +231,20 @@ status_t getNextNALUnit(
 
     size_t startOffset = offset;
 
-    for (;;) {
-        while (offset < size && data[offset] != 0x01) {
-            ++offset;
-        }
-
-        if (offset == size) {
-            if (startCodeFollows) {
-                offset = size + 2;
-                break;
-            }
+    // "offset" ends up pointing at the 0x01 of the next startcode. The two
+    // bytes preceding startOffset are "0x00 0x01", so no startcode found
+    // from there can begin before startOffset.
+    ssize_t next = FindStartCode(
+            &data[startOffset - 2], size - startOffset + 2);
 
+    if (next < 0) {
+        if (!startCodeFollows) {
             return -EAGAIN;
         }
 
-        if (data[offset - 1] == 0x00 && data[offset - 2] == 0x00) {
-            break;
-        }
-
-        ++offset;
+        offset = size + 2;
+    } else {
+        offset = startOffset + next;
     }
 
     size_t endOffset = offset - 2;
@@ -11,6 +11,7 @@ LOCAL_SRC_FILES := \
     src/intra_est.cpp \
     src/motion_comp.cpp \
     src/motion_est.cpp \
+    src/motion_est_threads.cpp \
     src/rate_control.cpp \
     src/residual.cpp \
     src/sad.cpp \
@@ -30,12 +31,46 @@ LOCAL_C_INCLUDES := \
 LOCAL_CFLAGS := \
     -DOSCL_IMPORT_REF= -DOSCL_UNUSED_ARG= -DOSCL_EXPORT_REF=
 
+ifeq ($(TARGET_ARCH),x86)
+LOCAL_CFLAGS += -msse2
+endif
+
 include $(BUILD_STATIC_LIBRARY)
 
 ################################################################################
 
 include $(CLEAR_VARS)
 
+LOCAL_SRC_FILES := \
+    tests/test-avcenc-kernels.cpp
+
+LOCAL_MODULE := test-avcenc-kernels
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/src \
+    $(LOCAL_PATH)/../common/include
+
+LOCAL_CFLAGS := \
+    -DOSCL_IMPORT_REF= -DOSCL_UNUSED_ARG= -DOSCL_EXPORT_REF=
+
+ifeq ($(TARGET_ARCH),x86)
+LOCAL_CFLAGS += -msse2
+endif
+
+LOCAL_STATIC_LIBRARIES := \
+    libstagefright_avcenc
+
+LOCAL_SHARED_LIBRARIES := \
+    libstagefright_avc_common
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
 LOCAL_SRC_FILES := \
         SoftAVCEncoder.cpp
 
@@ -180,6 +180,7 @@ SoftAVCEncoder::SoftAVCEncoder(
       mVideoColorFormat(OMX_COLOR_FormatYUV420Planar),
       mStoreMetaDataInBuffers(false),
       mIDRFrameRefreshIntervalInSec(1),
+      mNumThreads(1),
       mAVCEncProfile(AVC_BASELINE),
       mAVCEncLevel(AVC_LEVEL2),
       mNumInputFrames(-1),
@@ -253,6 +254,7 @@ OMX_ERRORTYPE SoftAVCEncoder::initEncParams() {
     mEncParams->bidir_pred = AVC_OFF;
 
     mEncParams->use_overrun_buffer = AVC_OFF;
+    mEncParams->num_threads = mNumThreads;
 
     if (mVideoColorFormat == OMX_COLOR_FormatYUV420SemiPlanar) {
         // Color conversion is needed.
@@ -427,7 +429,9 @@ void SoftAVCEncoder::initPorts() {
 
 OMX_ERRORTYPE SoftAVCEncoder::internalGetParameter(
         OMX_INDEXTYPE index, OMX_PTR params) {
-    switch (index) {
+    int32_t indexFull = index;
+
+    switch (indexFull) {
         case OMX_IndexParamVideoErrorCorrection:
         {
             return OMX_ErrorNotImplemented;
@@ -532,6 +536,14 @@ OMX_ERRORTYPE SoftAVCEncoder::internalGetParameter(
             return OMX_ErrorNone;
         }
 
+        case kEncoderThreadsExtensionIndex:
+        {
+            OMX_PARAM_U32TYPE *threadParams = (OMX_PARAM_U32TYPE *)params;
+
+            threadParams->nU32 = mNumThreads;
+            return OMX_ErrorNone;
+        }
+
         default:
             return SimpleSoftOMXComponent::internalGetParameter(index, params);
     }
@@ -706,6 +718,26 @@ OMX_ERRORTYPE SoftAVCEncoder::internalSetParameter(
             return OMX_ErrorNone;
         }
 
+        case kEncoderThreadsExtensionIndex:
+        {
+            const OMX_PARAM_U32TYPE *threadParams =
+                (const OMX_PARAM_U32TYPE *)params;
+
+            // The motion search runs its rows on nU32 threads, the
+            // bitstream does not depend on the thread count.
+            if (threadParams->nU32 == 0) {
+                return OMX_ErrorBadParameter;
+            }
+
+            if (mStarted) {
+                return OMX_ErrorIncorrectStateOperation;
+            }
+
+            ALOGV("motion search with %ld threads", threadParams->nU32);
+            mNumThreads = threadParams->nU32;
+            return OMX_ErrorNone;
+        }
+
         default:
             return SimpleSoftOMXComponent::internalSetParameter(index, params);
     }
@@ -956,6 +988,10 @@ OMX_ERRORTYPE SoftAVCEncoder::getExtensionIndex(
         *(int32_t*)index = kStoreMetaDataExtensionIndex;
         return OMX_ErrorNone;
     }
+    if (!strcmp(name, "OMX.google.android.index.encoderThreads")) {
+        *(int32_t*)index = kEncoderThreadsExtensionIndex;
+        return OMX_ErrorNone;
+    }
     return OMX_ErrorUndefined;
 }
 
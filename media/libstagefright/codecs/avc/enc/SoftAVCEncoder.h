@@ -68,7 +68,8 @@ private:
     };
 
     enum {
-        kStoreMetaDataExtensionIndex = OMX_IndexVendorStartUnused + 1
+        kStoreMetaDataExtensionIndex = OMX_IndexVendorStartUnused + 1,
+        kEncoderThreadsExtensionIndex = OMX_IndexVendorStartUnused + 2
     };
 
     // OMX input buffer's timestamp and flags
@@ -84,6 +85,7 @@ private:
     int32_t  mVideoColorFormat;
     bool     mStoreMetaDataInBuffers;
     int32_t  mIDRFrameRefreshIntervalInSec;
+    int32_t  mNumThreads;
     AVCProfile mAVCEncProfile;
     AVCLevel   mAVCEncLevel;
 
@@ -82,6 +82,8 @@ OSCL_EXPORT_REF AVCEnc_Status PVAVCEncInitialize(AVCHandle *avcHandle, AVCEncPar
 
     encvid->avcHandle = avcHandle;
 
+    encvid->meThreads = NULL;
+
     encvid->common = (AVCCommonObj*) avcHandle->CBAVC_Malloc(userData, sizeof(AVCCommonObj), DEFAULT_ATTR);
     if (encvid->common == NULL)
     {
@@ -206,6 +208,11 @@ OSCL_EXPORT_REF AVCEnc_Status PVAVCEncInitialize(AVCHandle *avcHandle, AVCEncPar
         return AVCENC_MEMORY_FAIL;
     }
 
+    if (AVCENC_SUCCESS != InitMotionSearchThreads(avcHandle, encParam->num_threads))
+    {
+        return AVCENC_MEMORY_FAIL;
+    }
+
     if (AVCENC_SUCCESS != InitRateControlModule(avcHandle))
     {
         return AVCENC_MEMORY_FAIL;
@@ -596,6 +603,8 @@ OSCL_EXPORT_REF void    PVAVCCleanUpEncoder(AVCHandle *avcHandle)
 
     if (encvid != NULL)
     {
+        CleanMotionSearchThreads(avcHandle);
+
         CleanMotionSearchModule(avcHandle);
 
         CleanupRateControlModule(avcHandle);
@@ -158,6 +158,9 @@ typedef struct tagAVCEncParam
 
     AVCFlag use_overrun_buffer;  /* do not throw away the frame if output buffer is not big enough.
                                     copy excess bits to the overrun buffer */
+
+    int num_threads; /* number of threads for the motion search, 0 or 1 keeps it on the encoding thread.
+                        The output does not depend on it. */
 } AVCEncParams;
 
 
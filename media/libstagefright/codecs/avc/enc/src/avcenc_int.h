@@ -440,6 +440,7 @@ typedef struct tagEncObject
 
     /* encoding complexity control */
     uint fullsearch_enable; /* flag to enable full-pel full-search */
+    struct tagMEThreads *meThreads; /* worker threads for the motion search, NULL if none */
 
     /* misc.*/
     bool outOfBandParamSet; /* flag to enable out-of-band param set */
@@ -504,6 +504,50 @@ extern "C"
     */
     void AVCMotionEstimation(AVCEncObject *encvid);
 
+    /**
+    This function performs the motion estimation of a single macroblock, see AVCMotionEstimation.
+    \param "encvid" "Pointer to AVCEncObject."
+    \param "i" "MB column."
+    \param "j" "MB row."
+    \param "type_pred" "Candidate selection, 0: first pass, 1: second pass, 2: no SCD."
+    \param "totalSAD" "Accumulated SAD for rate control."
+    \param "NumIntraSearch" "Accumulated number of MBs to be intra searched."
+    \return "void"
+    */
+    void AVCMBMotionEstimation(AVCEncObject *encvid, int i, int j, int type_pred,
+                               int *totalSAD, int *NumIntraSearch);
+
+    /*-------------- motion_est_threads.c ---------------*/
+
+    /**
+    Start the worker threads for the motion estimation.
+    \param "avcHandle" "Pointer to AVCHandle."
+    \param "numThreads" "Total number of threads including the encoding thread."
+    \return "AVCENC_SUCCESS or AVCENC_MEMORY_FAIL."
+    */
+    AVCEnc_Status InitMotionSearchThreads(AVCHandle *avcHandle, int numThreads);
+
+    /**
+    Stop the worker threads started in InitMotionSearchThreads.
+    \param "avcHandle" "Pointer to AVCHandle."
+    \return "void."
+    */
+    void CleanMotionSearchThreads(AVCHandle *avcHandle);
+
+    /**
+    This function performs one pass of AVCMotionEstimation with the rows split among
+    the worker threads and the calling thread. The result is the same as the sequential loop.
+    \param "encvid" "Pointer to AVCEncObject."
+    \param "start_i" "Start column toggle of the sequential loop."
+    \param "incr_i" "1, or 2 for the scene change detection passes."
+    \param "type_pred" "Candidate selection, see AVCMBMotionEstimation."
+    \param "totalSAD" "Accumulated SAD for rate control."
+    \param "NumIntraSearch" "Accumulated number of MBs to be intra searched."
+    \return "void"
+    */
+    void AVCMotionEstimationThreads(AVCEncObject *encvid, int start_i, int incr_i, int type_pred,
+                                    int *totalSAD, int *NumIntraSearch);
+
     /**
     This function performs repetitive edge padding to the reference picture by adding 16 pixels
     around the luma and 8 pixels around the chromas.
@@ -16,6 +16,10 @@
  * -------------------------------------------------------------------
  */
 #include "avcenc_lib.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 /* 3/29/01 fast half-pel search based on neighboring guess */
 /* value ranging from 0 to 4, high complexity (more accurate) to
    low complexity (less accurate) */
@@ -139,6 +143,55 @@ int AVCFindHalfPelMB(AVCEncObject *encvid, uint8 *cur, AVCMV *mot, uint8 *ncand,
 
 
 
+#if defined(__SSE2__)
+/* 6-tap filter a + f - 5 * (b + e) + 20 * (c + d) on 16 consecutive pixels */
+static inline void HorzInterp6Tap(uint8 *ref, __m128i *lo, __m128i *hi)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i k5 = _mm_set1_epi16(5);
+    const __m128i k20 = _mm_set1_epi16(20);
+    __m128i a = _mm_loadu_si128((__m128i*)ref);
+    __m128i b = _mm_loadu_si128((__m128i*)(ref + 1));
+    __m128i c = _mm_loadu_si128((__m128i*)(ref + 2));
+    __m128i d = _mm_loadu_si128((__m128i*)(ref + 3));
+    __m128i e = _mm_loadu_si128((__m128i*)(ref + 4));
+    __m128i f = _mm_loadu_si128((__m128i*)(ref + 5));
+    __m128i af, be, cd;
+
+    af = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(f, zero));
+    be = _mm_add_epi16(_mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(e, zero));
+    cd = _mm_add_epi16(_mm_unpacklo_epi8(c, zero), _mm_unpacklo_epi8(d, zero));
+    *lo = _mm_add_epi16(_mm_sub_epi16(af, _mm_mullo_epi16(be, k5)), _mm_mullo_epi16(cd, k20));
+
+    af = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(f, zero));
+    be = _mm_add_epi16(_mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(e, zero));
+    cd = _mm_add_epi16(_mm_unpackhi_epi8(c, zero), _mm_unpackhi_epi8(d, zero));
+    *hi = _mm_add_epi16(_mm_sub_epi16(af, _mm_mullo_epi16(be, k5)), _mm_mullo_epi16(cd, k20));
+}
+
+/* same filter on 8 columns of the 16-bit horizontal result, rounded by
+   (x + 512) >> 10, the sum needs 32 bits */
+static inline __m128i VertInterp6Tap16(int16 *src)
+{
+    const __m128i coef = _mm_set_epi16(-5, 20, -5, 20, -5, 20, -5, 20);
+    const __m128i round = _mm_set1_epi32(512);
+    __m128i af, be, cd, lo, hi;
+
+    af = _mm_add_epi16(_mm_loadu_si128((__m128i*)src), _mm_loadu_si128((__m128i*)(src + 90)));
+    be = _mm_add_epi16(_mm_loadu_si128((__m128i*)(src + 18)), _mm_loadu_si128((__m128i*)(src + 72)));
+    cd = _mm_add_epi16(_mm_loadu_si128((__m128i*)(src + 36)), _mm_loadu_si128((__m128i*)(src + 54)));
+
+    lo = _mm_madd_epi16(_mm_unpacklo_epi16(cd, be), coef);
+    hi = _mm_madd_epi16(_mm_unpackhi_epi16(cd, be), coef);
+    lo = _mm_add_epi32(lo, _mm_srai_epi32(_mm_unpacklo_epi16(af, af), 16));
+    hi = _mm_add_epi32(hi, _mm_srai_epi32(_mm_unpackhi_epi16(af, af), 16));
+    lo = _mm_srai_epi32(_mm_add_epi32(lo, round), 10);
+    hi = _mm_srai_epi32(_mm_add_epi32(hi, round), 10);
+
+    return _mm_packs_epi32(lo, hi);
+}
+#endif
+
 /** This function generates sub-pel prediction around the full-pel candidate.
 Each sub-pel position array is 20 pixel wide (for word-alignment) and 17 pixel tall. */
 /** The sub-pel position is labeled in spiral manner from the center. */
@@ -179,6 +232,63 @@ void GenerateHalfPelPred(uint8* subpel_pred, uint8 *ncand, int lx)
         ref += (lx - 24);
     }
 
+#if defined(__SSE2__)
+    /* horizontal interp of all 22 lines, lines 2 to 19 also go to
+       the 14th array 17x18 */
+    ref = subpel_pred;
+    dst_16 = tmp_horz;
+    dst = subpel_pred + V0Q_H2Q * SUBPEL_PRED_BLK_SIZE;
+
+    for (j = 0; j < 22; j++)
+    {
+        __m128i lo, hi;
+
+        HorzInterp6Tap(ref, &lo, &hi);
+        _mm_storeu_si128((__m128i*)dst_16, lo);
+        _mm_storeu_si128((__m128i*)(dst_16 + 8), hi);
+
+        /* do the 17th column here */
+        a = ref[16] + ref[21] - 5 * (ref[17] + ref[20]) + 20 * (ref[18] + ref[19]);
+        dst_16[16] = a;
+
+        if (j >= 2 && j < 20)
+        {
+            const __m128i round = _mm_set1_epi16(16);
+
+            lo = _mm_srai_epi16(_mm_add_epi16(lo, round), 5);
+            hi = _mm_srai_epi16(_mm_add_epi16(hi, round), 5);
+            _mm_storeu_si128((__m128i*)dst, _mm_packus_epi16(lo, hi));
+
+            tmp32 = (a + 16) >> 5;
+            CLIP_RESULT(tmp32)
+            dst[16] = tmp32;
+            dst += 24;
+        }
+
+        dst_16 += 18; /* stride for tmp_horz is 18 */
+        ref += 24;  /* stride for ref is 24 */
+    }
+
+    /* Do middle point filtering*/
+    src_16 = tmp_horz; /* 17 x 22 */
+    dst = subpel_pred + V2Q_H2Q * SUBPEL_PRED_BLK_SIZE; /* 12th array 17x17*/
+
+    for (j = 0; j < 17; j++)
+    {
+        _mm_storeu_si128((__m128i*)dst, _mm_packus_epi16(VertInterp6Tap16(src_16),
+                         VertInterp6Tap16(src_16 + 8)));
+
+        /* do the 17th column here */
+        tmp32 = src_16[16] + src_16[106] - 5 * (src_16[34] + src_16[88]) +
+                20 * (src_16[52] + src_16[70]);
+        tmp32 = (tmp32 + 512) >> 10;
+        CLIP_RESULT(tmp32)
+        dst[16] = tmp32;
+
+        src_16 += 18;
+        dst += 24;
+    }
+#else
     /* from the first array, we do horizontal interp */
     ref = subpel_pred + 2;
     dst_16 = tmp_horz; /* 17 x 22 */
@@ -322,6 +432,7 @@ void GenerateHalfPelPred(uint8* subpel_pred, uint8 *ncand, int lx)
         src_16 -= ((18 << 4) - 1);
         dst -= ((24 << 4) - 1);
     }
+#endif
 
     /* do vertical interpolation */
     ref = subpel_pred + 2;
@@ -518,13 +629,69 @@ void VertInterpWClip(uint8 *dst, uint8 *ref)
 void GenerateQuartPelPred(uint8 **bilin_base, uint8 *qpel_cand, int hpel_pos)
 {
     // for even value of hpel_pos, start with pattern 1, otherwise, start with pattern 2
-    int i, j;
+    int j;
 
     uint8 *c1 = qpel_cand;
     uint8 *tl = bilin_base[0];
     uint8 *tr = bilin_base[1];
     uint8 *bl = bilin_base[2];
     uint8 *br = bilin_base[3];
+#if defined(__SSE2__)
+    __m128i a, b, c, d;
+
+    if (!(hpel_pos&1)) // diamond pattern
+    {
+        for (j = 0; j < 16; j++)
+        {
+            a = _mm_loadu_si128((__m128i*)tr);
+            b = _mm_loadu_si128((__m128i*)(bl + 1));
+            c = _mm_loadu_si128((__m128i*)br);
+            d = _mm_loadu_si128((__m128i*)(tr + 24));
+
+            _mm_storeu_si128((__m128i*)c1, _mm_avg_epu8(c, a));
+            _mm_storeu_si128((__m128i*)(c1 + 384), _mm_avg_epu8(b, a)); /* c2 */
+            _mm_storeu_si128((__m128i*)(c1 + 384 * 2), _mm_avg_epu8(b, c)); /* c3 */
+            _mm_storeu_si128((__m128i*)(c1 + 384 * 3), _mm_avg_epu8(b, d)); /* c4 */
+
+            b = _mm_loadu_si128((__m128i*)bl);
+
+            _mm_storeu_si128((__m128i*)(c1 + 384 * 4), _mm_avg_epu8(c, d)); /* c5 */
+            _mm_storeu_si128((__m128i*)(c1 + 384 * 5), _mm_avg_epu8(b, d)); /* c6 */
+            _mm_storeu_si128((__m128i*)(c1 + 384 * 6), _mm_avg_epu8(b, c)); /* c7 */
+            _mm_storeu_si128((__m128i*)(c1 + 384 * 7), _mm_avg_epu8(b, a)); /* c8 */
+
+            // advance to the next line, pitch is 24
+            tr += 24;
+            bl += 24;
+            br += 24;
+            c1 += 24;
+        }
+    }
+    else // star pattern
+    {
+        for (j = 0; j < 16; j++)
+        {
+            a = _mm_loadu_si128((__m128i*)br);
+
+            _mm_storeu_si128((__m128i*)c1, _mm_avg_epu8(a, _mm_loadu_si128((__m128i*)tr)));
+            _mm_storeu_si128((__m128i*)(c1 + 384), _mm_avg_epu8(a, _mm_loadu_si128((__m128i*)(tl + 1)))); /* c2 */
+            _mm_storeu_si128((__m128i*)(c1 + 384 * 2), _mm_avg_epu8(a, _mm_loadu_si128((__m128i*)(bl + 1)))); /* c3 */
+            _mm_storeu_si128((__m128i*)(c1 + 384 * 3), _mm_avg_epu8(a, _mm_loadu_si128((__m128i*)(tl + 25)))); /* c4 */
+            _mm_storeu_si128((__m128i*)(c1 + 384 * 4), _mm_avg_epu8(a, _mm_loadu_si128((__m128i*)(tr + 24)))); /* c5 */
+            _mm_storeu_si128((__m128i*)(c1 + 384 * 5), _mm_avg_epu8(a, _mm_loadu_si128((__m128i*)(tl + 24)))); /* c6 */
+            _mm_storeu_si128((__m128i*)(c1 + 384 * 6), _mm_avg_epu8(a, _mm_loadu_si128((__m128i*)bl))); /* c7 */
+            _mm_storeu_si128((__m128i*)(c1 + 384 * 7), _mm_avg_epu8(a, _mm_loadu_si128((__m128i*)tl))); /* c8 */
+
+            // advance to the next line, pitch is 24
+            tl += 24;
+            tr += 24;
+            bl += 24;
+            br += 24;
+            c1 += 24;
+        }
+    }
+#else
+    int i;
     int a, b, c, d;
     int offset = 1 - (384 * 7);
 
@@ -599,6 +766,7 @@ void GenerateQuartPelPred(uint8 **bilin_base, uint8 *qpel_cand, int hpel_pos)
             c1 += 8;
         }
     }
+#endif
 
     return ;
 }
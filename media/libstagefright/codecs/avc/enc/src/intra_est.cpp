@@ -17,6 +17,10 @@
  */
 #include "avcenc_lib.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #define TH_I4  0  /* threshold biasing toward I16 mode instead of I4 mode */
 #define TH_Intra  0 /* threshold biasing toward INTER mode instead of intra mode */
 
@@ -28,6 +32,39 @@
 #define CLIP_RESULT(x)      if((uint)x > 0xFF){ \
                  x = 0xFF & (~(x>>31));}
 
+#if defined(__SSE2__)
+/* 4-point horizontal Hadamard on each group of 4 residues. The outputs are
+   [m0+m1, m0-m1, -(m2+m3), m3-m2], i.e. the columns of the C version in a
+   different order and sign, which does not change the sum of absolute values.
+   The DC term stays in the first column. */
+static inline __m128i hadamard4_horz(__m128i x)
+{
+    const __m128i neg_hi = _mm_set_epi16(-1, -1, 0, 0, -1, -1, 0, 0);
+    const __m128i neg_odd = _mm_set_epi16(-1, 0, -1, 0, -1, 0, -1, 0);
+    __m128i y;
+
+    y = _mm_shufflelo_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+    y = _mm_shufflehi_epi16(y, _MM_SHUFFLE(0, 1, 2, 3));
+    x = _mm_add_epi16(x, _mm_sub_epi16(_mm_xor_si128(y, neg_hi), neg_hi));
+
+    y = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+    y = _mm_shufflehi_epi16(y, _MM_SHUFFLE(2, 3, 0, 1));
+    return _mm_add_epi16(y, _mm_sub_epi16(_mm_xor_si128(x, neg_odd), neg_odd));
+}
+
+static inline __m128i abs_epi16(__m128i x)
+{
+    return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+static inline int hsum_epi32(__m128i x)
+{
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(x);
+}
+#endif
+
 
 bool IntraDecisionABE(AVCEncObject *encvid, int min_cost, uint8 *curL, int picPitch)
 {
@@ -497,6 +534,54 @@ int cost_i16(uint8 *org, int org_pitch, uint8 *pred, int min_cost)
     int16 res[256], *pres; // residue
     int m0, m1, m2, m3;
 
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i no_dc = _mm_set_epi16(-1, -1, -1, 0, -1, -1, -1, 0);
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i row[4][2], v0, v1, v2, v3, sum, acc = zero;
+    int i;
+
+    /* same transform and early drop out as below, one 4x16 strip at a time;
+       only the DC row of each strip is kept for the DC Hadamard. */
+    cost = 0;
+    for (j = 0; j < 4; j++)
+    {
+        for (k = 0; k < 4; k++)
+        {
+            v0 = _mm_loadu_si128((__m128i*)org);
+            v1 = _mm_loadu_si128((__m128i*)pred);
+            row[k][0] = hadamard4_horz(_mm_sub_epi16(_mm_unpacklo_epi8(v0, zero),
+                                       _mm_unpacklo_epi8(v1, zero)));
+            row[k][1] = hadamard4_horz(_mm_sub_epi16(_mm_unpackhi_epi8(v0, zero),
+                                       _mm_unpackhi_epi8(v1, zero)));
+            org += org_pitch;
+            pred += 16;
+        }
+
+        for (i = 0; i < 2; i++)
+        {
+            v0 = _mm_add_epi16(row[0][i], row[3][i]);
+            v3 = _mm_sub_epi16(row[0][i], row[3][i]);
+            v1 = _mm_add_epi16(row[1][i], row[2][i]);
+            v2 = _mm_sub_epi16(row[1][i], row[2][i]);
+
+            sum = _mm_add_epi16(v0, v1);
+            _mm_storeu_si128((__m128i*)(res + (j << 6) + (i << 3)), sum);
+
+            sum = abs_epi16(_mm_and_si128(sum, no_dc));
+            sum = _mm_add_epi16(sum, abs_epi16(_mm_sub_epi16(v0, v1)));
+            sum = _mm_add_epi16(sum, abs_epi16(_mm_add_epi16(v3, v2)));
+            sum = _mm_add_epi16(sum, abs_epi16(_mm_sub_epi16(v3, v2)));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(sum, ones));
+        }
+
+        cost = hsum_epi32(acc);
+        if ((cost >> 1) > min_cost) /* early drop out */
+        {
+            return (cost >> 1);
+        }
+    }
+#else
     // calculate SATD
     org_pitch -= 16;
     pres = res;
@@ -564,6 +649,7 @@ int cost_i16(uint8 *org, int org_pitch, uint8 *pred, int min_cost)
             return (cost >> 1);
         }
     }
+#endif
 
     /* Hadamard of the DC coefficient */
     pres = res;
@@ -1288,6 +1374,37 @@ PRED_RESULT_READY:
 
 void cost_i4(uint8 *org, int org_pitch, uint8 *pred, uint16 *cost)
 {
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    __m128i r01, r23, s, d, t;
+    int satd;
+
+    /* rows 0,1 and rows 2,3 side by side */
+    r01 = _mm_unpacklo_epi32(_mm_cvtsi32_si128(*((uint32*)org)),
+                             _mm_cvtsi32_si128(*((uint32*)(org + org_pitch))));
+    r23 = _mm_unpacklo_epi32(_mm_cvtsi32_si128(*((uint32*)(org + (org_pitch << 1)))),
+                             _mm_cvtsi32_si128(*((uint32*)(org + (org_pitch << 1) + org_pitch))));
+    t = _mm_loadu_si128((__m128i*)pred);
+    r01 = hadamard4_horz(_mm_sub_epi16(_mm_unpacklo_epi8(r01, zero), _mm_unpacklo_epi8(t, zero)));
+    r23 = hadamard4_horz(_mm_sub_epi16(_mm_unpacklo_epi8(r23, zero), _mm_unpackhi_epi8(t, zero)));
+
+    /* vertical transform, [r0 r1] +/- [r3 r2] gives [m0 m1] and [m3 m2];
+       butterflying each with its swapped halves produces every output
+       coefficient twice, so the sum is halved at the end. */
+    r23 = _mm_shuffle_epi32(r23, _MM_SHUFFLE(1, 0, 3, 2));
+    s = _mm_add_epi16(r01, r23);
+    d = _mm_sub_epi16(r01, r23);
+    t = _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2));
+    r01 = _mm_add_epi16(abs_epi16(_mm_add_epi16(s, t)), abs_epi16(_mm_sub_epi16(s, t)));
+    t = _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+    r23 = _mm_add_epi16(abs_epi16(_mm_add_epi16(d, t)), abs_epi16(_mm_sub_epi16(d, t)));
+    satd = hsum_epi32(_mm_madd_epi16(_mm_add_epi16(r01, r23), _mm_set1_epi16(1))) >> 1;
+
+    satd = (satd + 1) >> 1;
+    *cost += satd;
+
+    return ;
+#else
     int k;
     int16 res[16], *pres;
     int m0, m1, m2, m3, tmp1;
@@ -1358,6 +1475,7 @@ void cost_i4(uint8 *org, int org_pitch, uint8 *pred, uint16 *cost)
     *cost += satd;
 
     return ;
+#endif
 }
 
 void chroma_intra_search(AVCEncObject *encvid)
@@ -0,0 +1,346 @@
+/* ------------------------------------------------------------------
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+#include "avcenc_lib.h"
+
+#include <pthread.h>
+
+#define MAX_ME_THREADS  8
+
+typedef struct tagMEWorker
+{
+    struct tagMEThreads *threads;
+    pthread_t thread;
+    AVCEncObject *encvid;   /* private copy, owns its own scratch memory */
+    AVCCommonObj *common;
+} AVCMEWorker;
+
+typedef struct tagMEThreads
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t startCond;       /* a new pass is ready */
+    pthread_cond_t doneCond;        /* a worker has finished the pass */
+    pthread_cond_t progressCond;    /* a row has made progress */
+
+    AVCMEWorker worker[MAX_ME_THREADS-1];
+    int numWorkers;
+    bool quit;
+    uint pass;                      /* incremented to start a pass */
+
+    /* current pass */
+    int start_i;
+    int incr_i;
+    int type_pred;
+    int nextRow;                    /* next row to be picked up */
+    int numBusy;                    /* workers still in the pass */
+    int *rowProgress;               /* MB columns done in each row */
+    int totalSAD;
+    int numIntraSearch;
+} AVCMEThreads;
+
+/*===============================================================================
+    Function:   MotionSearchRows
+    Purpose:    Pick up rows of the current pass until none is left. MB (i, j)
+                looks at the motion of (i+1, j-1) for its candidates, so it waits
+                until the row above has done column i+1. The bottom and right
+                neighbors still hold the previous frame at that point, as they
+                would in the sequential loop.
+===============================================================================*/
+static void MotionSearchRows(AVCMEThreads *threads, AVCEncObject *encvid)
+{
+    AVCCommonObj *video = encvid->common;
+    int mbwidth = video->PicWidthInMbs;
+    int mbheight = video->PicHeightInMbs;
+    int incr_i = threads->incr_i;
+    int totalSAD = 0, numIntraSearch = 0;
+    int i, j, above, need;
+
+    pthread_mutex_lock(&threads->mutex);
+
+    while ((j = threads->nextRow) < mbheight)
+    {
+        threads->nextRow++;
+        above = (j > 0) ? threads->rowProgress[j-1] : mbwidth;
+        pthread_mutex_unlock(&threads->mutex);
+
+        /* same start column as the toggle in AVCMotionEstimation */
+        i = (incr_i > 1) ? ((j + threads->start_i + 1) & 1) : 0;
+
+        for (; i < mbwidth; i += incr_i)
+        {
+            need = AVC_MIN(i + 2, mbwidth);
+            if (above < need)
+            {
+                pthread_mutex_lock(&threads->mutex);
+                while ((above = threads->rowProgress[j-1]) < need)
+                {
+                    pthread_cond_wait(&threads->progressCond, &threads->mutex);
+                }
+                pthread_mutex_unlock(&threads->mutex);
+            }
+
+            AVCMBMotionEstimation(encvid, i, j, threads->type_pred, &totalSAD, &numIntraSearch);
+
+            pthread_mutex_lock(&threads->mutex);
+            threads->rowProgress[j] = i + 1;
+            pthread_cond_broadcast(&threads->progressCond);
+            pthread_mutex_unlock(&threads->mutex);
+        }
+
+        pthread_mutex_lock(&threads->mutex);
+        threads->rowProgress[j] = mbwidth;
+        pthread_cond_broadcast(&threads->progressCond);
+    }
+
+    threads->totalSAD += totalSAD;
+    threads->numIntraSearch += numIntraSearch;
+
+    pthread_mutex_unlock(&threads->mutex);
+
+    return ;
+}
+
+static void *MotionSearchThread(void *arg)
+{
+    AVCMEWorker *worker = (AVCMEWorker*) arg;
+    AVCMEThreads *threads = worker->threads;
+    uint pass;
+
+    pthread_mutex_lock(&threads->mutex);
+    pass = threads->pass;
+
+    for (;;)
+    {
+        while (!threads->quit && threads->pass == pass)
+        {
+            pthread_cond_wait(&threads->startCond, &threads->mutex);
+        }
+        if (threads->quit)
+        {
+            break;
+        }
+        pass = threads->pass;
+        pthread_mutex_unlock(&threads->mutex);
+
+        MotionSearchRows(threads, worker->encvid);
+
+        pthread_mutex_lock(&threads->mutex);
+        if (--threads->numBusy == 0)
+        {
+            pthread_cond_signal(&threads->doneCond);
+        }
+    }
+
+    pthread_mutex_unlock(&threads->mutex);
+
+    return NULL;
+}
+
+/* Give the worker the state of the frame being encoded, keeping its own
+   scratch memory for the current MB and the sub-pel candidates. */
+static void PrepareWorker(AVCEncObject *encvid, AVCMEWorker *worker)
+{
+    AVCEncObject *wencvid = worker->encvid;
+    uint8 *subpel_pred = (uint8*) encvid->subpel_pred;
+    uint8 *wsubpel_pred = (uint8*) wencvid->subpel_pred;
+    int k, l;
+
+    *(worker->common) = *(encvid->common);
+    *wencvid = *encvid;
+    wencvid->common = worker->common;
+
+    for (k = 0; k < 9; k++)
+    {
+        wencvid->hpel_cand[k] = wsubpel_pred + (encvid->hpel_cand[k] - subpel_pred);
+        for (l = 0; l < 4; l++)
+        {
+            wencvid->bilin_base[k][l] = wsubpel_pred + (encvid->bilin_base[k][l] - subpel_pred);
+        }
+    }
+
+    return ;
+}
+
+/* ======================================================================== */
+/*  Function : AVCMotionEstimationThreads()                                 */
+/*  Purpose  : Run one pass of the motion estimation on the calling thread  */
+/*             and the workers, rows are handed out in order.               */
+/*  In/out   : totalSAD and NumIntraSearch are accumulated.                 */
+/* ======================================================================== */
+void AVCMotionEstimationThreads(AVCEncObject *encvid, int start_i, int incr_i, int type_pred,
+                                int *totalSAD, int *NumIntraSearch)
+{
+    AVCMEThreads *threads = encvid->meThreads;
+    int k;
+
+    for (k = 0; k < threads->numWorkers; k++)
+    {
+        PrepareWorker(encvid, &(threads->worker[k]));
+    }
+
+    pthread_mutex_lock(&threads->mutex);
+    threads->start_i = start_i;
+    threads->incr_i = incr_i;
+    threads->type_pred = type_pred;
+    threads->nextRow = 0;
+    threads->numBusy = threads->numWorkers;
+    threads->totalSAD = 0;
+    threads->numIntraSearch = 0;
+    memset(threads->rowProgress, 0, sizeof(int) * encvid->common->PicHeightInMbs);
+    threads->pass++;
+    pthread_cond_broadcast(&threads->startCond);
+    pthread_mutex_unlock(&threads->mutex);
+
+    MotionSearchRows(threads, encvid);
+
+    pthread_mutex_lock(&threads->mutex);
+    while (threads->numBusy)
+    {
+        pthread_cond_wait(&threads->doneCond, &threads->mutex);
+    }
+    *totalSAD += threads->totalSAD;
+    *NumIntraSearch += threads->numIntraSearch;
+    pthread_mutex_unlock(&threads->mutex);
+
+    return ;
+}
+
+/* ======================================================================== */
+/*  Function : InitMotionSearchThreads()                                    */
+/*  Purpose  : Start numThreads - 1 workers for the motion estimation, the  */
+/*             encoding thread is the remaining one.                        */
+/*  Return   : AVCENC_SUCCESS, also when it falls back to a single thread.  */
+/* ======================================================================== */
+AVCEnc_Status InitMotionSearchThreads(AVCHandle *avcHandle, int numThreads)
+{
+    AVCEncObject *encvid = (AVCEncObject*) avcHandle->AVCObject;
+    void *userData = avcHandle->userData;
+    AVCMEThreads *threads;
+    AVCMEWorker *worker;
+    int k;
+
+    encvid->meThreads = NULL;
+
+#ifdef HTFM
+    /* the HTFM statistics are collected in coding order */
+    numThreads = 1;
+#endif
+
+    if (numThreads <= 1)
+    {
+        return AVCENC_SUCCESS;
+    }
+    if (numThreads > MAX_ME_THREADS)
+    {
+        numThreads = MAX_ME_THREADS;
+    }
+
+    threads = (AVCMEThreads*) avcHandle->CBAVC_Malloc(userData, sizeof(AVCMEThreads), DEFAULT_ATTR);
+    if (threads == NULL)
+    {
+        return AVCENC_MEMORY_FAIL;
+    }
+    memset(threads, 0, sizeof(AVCMEThreads));
+
+    threads->rowProgress = (int*) avcHandle->CBAVC_Malloc(userData,
+                           sizeof(int) * encvid->common->PicHeightInMbs, DEFAULT_ATTR);
+    if (threads->rowProgress == NULL)
+    {
+        avcHandle->CBAVC_Free(userData, threads);
+        return AVCENC_MEMORY_FAIL;
+    }
+
+    pthread_mutex_init(&threads->mutex, NULL);
+    pthread_cond_init(&threads->startCond, NULL);
+    pthread_cond_init(&threads->doneCond, NULL);
+    pthread_cond_init(&threads->progressCond, NULL);
+
+    encvid->meThreads = threads;
+
+    for (k = 0; k < numThreads - 1; k++)
+    {
+        worker = &(threads->worker[k]);
+        worker->threads = threads;
+        worker->encvid = (AVCEncObject*) avcHandle->CBAVC_Malloc(userData, sizeof(AVCEncObject), DEFAULT_ATTR);
+        worker->common = (AVCCommonObj*) avcHandle->CBAVC_Malloc(userData, sizeof(AVCCommonObj), DEFAULT_ATTR);
+
+        if (worker->encvid == NULL || worker->common == NULL ||
+                pthread_create(&worker->thread, NULL, MotionSearchThread, worker) != 0)
+        {
+            if (worker->encvid)
+            {
+                avcHandle->CBAVC_Free(userData, worker->encvid);
+            }
+            if (worker->common)
+            {
+                avcHandle->CBAVC_Free(userData, worker->common);
+            }
+            break;
+        }
+        threads->numWorkers++;
+    }
+
+    if (threads->numWorkers == 0)
+    {
+        CleanMotionSearchThreads(avcHandle);
+    }
+
+    return AVCENC_SUCCESS;
+}
+
+/* ======================================================================== */
+/*  Function : CleanMotionSearchThreads()                                   */
+/*  Purpose  : Stop the workers and free what InitMotionSearchThreads()     */
+/*             allocated.                                                   */
+/* ======================================================================== */
+void CleanMotionSearchThreads(AVCHandle *avcHandle)
+{
+    AVCEncObject *encvid = (AVCEncObject*) avcHandle->AVCObject;
+    void *userData = avcHandle->userData;
+    AVCMEThreads *threads = encvid->meThreads;
+    AVCMEWorker *worker;
+    int k;
+
+    if (threads == NULL)
+    {
+        return ;
+    }
+
+    pthread_mutex_lock(&threads->mutex);
+    threads->quit = true;
+    pthread_cond_broadcast(&threads->startCond);
+    pthread_mutex_unlock(&threads->mutex);
+
+    for (k = 0; k < threads->numWorkers; k++)
+    {
+        worker = &(threads->worker[k]);
+        pthread_join(worker->thread, NULL);
+        avcHandle->CBAVC_Free(userData, worker->encvid);
+        avcHandle->CBAVC_Free(userData, worker->common);
+    }
+
+    pthread_cond_destroy(&threads->progressCond);
+    pthread_cond_destroy(&threads->doneCond);
+    pthread_cond_destroy(&threads->startCond);
+    pthread_mutex_destroy(&threads->mutex);
+
+    avcHandle->CBAVC_Free(userData, threads->rowProgress);
+    avcHandle->CBAVC_Free(userData, threads);
+    encvid->meThreads = NULL;
+
+    return ;
+}
@@ -18,6 +18,10 @@
 #ifndef _SAD_INLINE_H_
 #define _SAD_INLINE_H_
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -76,6 +80,31 @@ extern "C"
 #include "sad_mb_offset.h"
 
 
+#if defined(__SSE2__)
+
+    /* psadbw version, same early dropout after every row as the C version
+       below so that the search takes the same decisions. */
+    __inline int32 simd_sad_mb(uint8 *ref, uint8 *blk, int dmin, int lx)
+    {
+        __m128i sad = _mm_setzero_si128();
+        int32 x10;
+        int x8 = 16;
+
+        do
+        {
+            sad = _mm_add_epi32(sad, _mm_sad_epu8(_mm_loadu_si128((__m128i*)ref),
+                                                  _mm_loadu_si128((__m128i*)blk)));
+            x10 = _mm_cvtsi128_si32(sad) + _mm_cvtsi128_si32(_mm_srli_si128(sad, 8));
+            ref += lx;
+            blk += 16;
+        }
+        while (x10 <= dmin && --x8);
+
+        return x10;
+    }
+
+#else
+
     __inline int32 simd_sad_mb(uint8 *ref, uint8 *blk, int dmin, int lx)
     {
         int32 x4, x5, x6, x8, x9, x10, x11, x12, x14;
@@ -169,6 +198,8 @@ SadMBOffset1:
 
     }
 
+#endif /* __SSE2__ */
+
 #elif defined(__CC_ARM)  /* only work with arm v5 */
 
     __inline int32 SUB_SAD(int32 sad, int32 tmp, int32 tmp2)
@@ -0,0 +1,431 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Runs the AVC encoder kernels that have SSE2 versions on random blocks,
+// checks that they give the same result bit for bit as the plain C
+// reference versions below, then times both.  The references follow the
+// definitions rather than the unrolled C in the library, so the test also
+// holds for a build without SSE2.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "avcenc_lib.h"
+
+#define LX              64      /* pitch of the random frame */
+#define FRAME_SIZE      (LX * LX)
+#define PLANE_SIZE      (24 * 18)
+
+static unsigned int sSeed = 1;
+
+static uint8 sFrame[FRAME_SIZE];
+static uint8 sBlock[256];
+static uint8 sPlanes[4][PLANE_SIZE];
+static uint8 sOut[2][SUBPEL_PRED_BLK_SIZE * 8];
+
+static uint32 random32() {
+    unsigned int hi;
+    sSeed = sSeed * 1103515245 + 12345;
+    hi = sSeed >> 16;
+    sSeed = sSeed * 1103515245 + 12345;
+    return (hi << 16) | (sSeed >> 16);
+}
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static inline int clip255(int x) {
+    return x < 0 ? 0 : (x > 255 ? 255 : x);
+}
+
+// Half the time the block is the frame plus a little noise, so that the
+// costs come out small and the early drop outs are exercised, otherwise
+// both are noise with the extremes more often than chance.
+static void randomData() {
+    int i;
+    for (i = 0; i < FRAME_SIZE; i++) {
+        uint32 r = random32();
+        sFrame[i] = (r & 0x7) == 0 ? 0 : ((r & 0x7) == 1 ? 255 : r >> 24);
+    }
+    for (i = 0; i < 4 * PLANE_SIZE; i++) {
+        sPlanes[0][i] = random32() >> 24;
+    }
+    bool similar = random32() & 1;
+    for (i = 0; i < 256; i++) {
+        uint32 r = random32();
+        sBlock[i] = similar ? clip255(sFrame[(i >> 4) * LX + (i & 15)] + (int) (r >> 29) - 4)
+                : r >> 24;
+    }
+}
+
+static uint8 *randomPosition() {
+    return sFrame + (random32() % (LX - 16 - 3)) * LX + random32() % (LX - 16 - 3);
+}
+
+// ----------------------------------------------------------------------------
+// References
+
+static int refSad(uint8 *ref, uint8 *blk, int dmin, int lx) {
+    int sad = 0;
+    for (int j = 0; j < 16; j++) {
+        for (int i = 0; i < 16; i++) {
+            sad += abs(ref[j * lx + i] - blk[j * 16 + i]);
+        }
+        if (sad > dmin) {
+            break;
+        }
+    }
+    return sad;
+}
+
+// unnormalized 4x4 Hadamard transform of org - pred, returns the sum of the
+// absolute values of the coefficients and the DC one in *dc
+static int hadamard4x4(const uint8 *org, int orgPitch, const uint8 *pred, int predPitch,
+        int *dc) {
+    int m[4][4], t[4][4];
+    int sum = 0;
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) {
+            m[j][i] = org[j * orgPitch + i] - pred[j * predPitch + i];
+        }
+    }
+    for (int j = 0; j < 4; j++) {
+        int s03 = m[j][0] + m[j][3], d03 = m[j][0] - m[j][3];
+        int s12 = m[j][1] + m[j][2], d12 = m[j][1] - m[j][2];
+        t[j][0] = s03 + s12;
+        t[j][1] = d03 + d12;
+        t[j][2] = s03 - s12;
+        t[j][3] = d03 - d12;
+    }
+    for (int i = 0; i < 4; i++) {
+        int s03 = t[0][i] + t[3][i], d03 = t[0][i] - t[3][i];
+        int s12 = t[1][i] + t[2][i], d12 = t[1][i] - t[2][i];
+        if (i == 0) {
+            *dc = s03 + s12;
+        }
+        sum += abs(s03 + s12) + abs(d03 + d12) + abs(s03 - s12) + abs(d03 - d12);
+    }
+    return sum;
+}
+
+static int refCostI16(uint8 *org, int orgPitch, uint8 *pred, int minCost) {
+    int dc[4][4], t[4][4];
+    int cost = 0;
+
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) {
+            cost += hadamard4x4(org + (j * orgPitch + i) * 4, orgPitch, pred + j * 64 + i * 4,
+                    16, &dc[j][i]);
+            cost -= abs(dc[j][i]);
+        }
+        if ((cost >> 1) > minCost) {
+            return cost >> 1;
+        }
+    }
+
+    // the DC Hadamard scales the rows down as it goes, like the library
+    for (int j = 0; j < 4; j++) {
+        int m0 = (dc[j][0] >> 2) + (dc[j][3] >> 2);
+        int m3 = m0 - (dc[j][3] >> 1);
+        int m1 = (dc[j][1] >> 2) + (dc[j][2] >> 2);
+        int m2 = m1 - (dc[j][2] >> 1);
+        t[j][0] = m0 + m1;
+        t[j][1] = m2 + m3;
+        t[j][2] = m0 - m1;
+        t[j][3] = m3 - m2;
+    }
+    for (int i = 0; i < 4; i++) {
+        int s03 = t[0][i] + t[3][i], d03 = t[0][i] - t[3][i];
+        int s12 = t[1][i] + t[2][i], d12 = t[1][i] - t[2][i];
+        cost += abs(s03 + s12) + abs(d03 + d12) + abs(s03 - s12) + abs(d03 - d12);
+        if ((cost >> 1) > minCost) {
+            break;
+        }
+    }
+    return cost >> 1;
+}
+
+static void refCostI4(uint8 *org, int orgPitch, uint8 *pred, uint16 *cost) {
+    int dc;
+    *cost += (hadamard4x4(org, orgPitch, pred, 4, &dc) + 1) >> 1;
+}
+
+static inline int tap6(int a, int b, int c, int d, int e, int f) {
+    return a + f - 5 * (b + e) + 20 * (c + d);
+}
+
+// only the horizontal and the middle half-pel arrays, the others have no
+// SSE2 version
+static void refHalfPel(uint8 *subpelPred, uint8 *ncand, int lx) {
+    int horz[22][17];
+    uint8 *ref = ncand - 3 - 3 * lx;
+
+    for (int j = 0; j < 22; j++) {
+        uint8 *p = ref + j * lx;
+        for (int i = 0; i < 17; i++) {
+            horz[j][i] = tap6(p[i], p[i + 1], p[i + 2], p[i + 3], p[i + 4], p[i + 5]);
+        }
+    }
+    for (int j = 0; j < 18; j++) {
+        uint8 *dst = subpelPred + V0Q_H2Q * SUBPEL_PRED_BLK_SIZE + j * 24;
+        for (int i = 0; i < 17; i++) {
+            dst[i] = clip255((horz[j + 2][i] + 16) >> 5);
+        }
+    }
+    for (int j = 0; j < 17; j++) {
+        uint8 *dst = subpelPred + V2Q_H2Q * SUBPEL_PRED_BLK_SIZE + j * 24;
+        for (int i = 0; i < 17; i++) {
+            dst[i] = clip255((tap6(horz[j][i], horz[j + 1][i], horz[j + 2][i], horz[j + 3][i],
+                    horz[j + 4][i], horz[j + 5][i]) + 512) >> 10);
+        }
+    }
+}
+
+static inline uint8 avg(int a, int b) {
+    return (a + b + 1) >> 1;
+}
+
+static void refQuartPel(uint8 **bilinBase, uint8 *qpelCand, int hpelPos) {
+    uint8 *tl = bilinBase[0];
+    uint8 *tr = bilinBase[1];
+    uint8 *bl = bilinBase[2];
+    uint8 *br = bilinBase[3];
+
+    for (int j = 0; j < 16; j++) {
+        for (int i = 0; i < 16; i++) {
+            int p = j * 24 + i;
+            uint8 *c = qpelCand + p;
+            if (!(hpelPos & 1)) {
+                // diamond pattern
+                c[0] = avg(br[p], tr[p]);
+                c[384] = avg(bl[p + 1], tr[p]);
+                c[384 * 2] = avg(bl[p + 1], br[p]);
+                c[384 * 3] = avg(bl[p + 1], tr[p + 24]);
+                c[384 * 4] = avg(br[p], tr[p + 24]);
+                c[384 * 5] = avg(bl[p], tr[p + 24]);
+                c[384 * 6] = avg(bl[p], br[p]);
+                c[384 * 7] = avg(bl[p], tr[p]);
+            } else {
+                // star pattern
+                c[0] = avg(br[p], tr[p]);
+                c[384] = avg(br[p], tl[p + 1]);
+                c[384 * 2] = avg(br[p], bl[p + 1]);
+                c[384 * 3] = avg(br[p], tl[p + 25]);
+                c[384 * 4] = avg(br[p], tr[p + 24]);
+                c[384 * 5] = avg(br[p], tl[p + 24]);
+                c[384 * 6] = avg(br[p], bl[p]);
+                c[384 * 7] = avg(br[p], tl[p]);
+            }
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Kernels, path 0 is the reference and path 1 the library
+
+static int sDmin;
+static uint8 *sRef;
+static uint8 *sBilinBase[4];
+static int sHpelPos;
+
+static void setupSad() {
+    // all four alignments of the reference, the C version has a loop for each
+    sRef = randomPosition();
+    sDmin = (random32() & 1) ? 65535 : random32() % 4096;
+}
+
+static int runSad(int path) {
+    if (path) {
+        return AVCSAD_Macroblock_C(sRef, sBlock, (sDmin << 16) | LX, NULL);
+    }
+    return refSad(sRef, sBlock, sDmin, LX);
+}
+
+static void setupCost() {
+    sRef = randomPosition();
+    sDmin = (random32() & 1) ? 0x7fffffff : random32() % 8192;
+}
+
+static int runCostI16(int path) {
+    if (path) {
+        return cost_i16(sRef, LX, sBlock, sDmin);
+    }
+    return refCostI16(sRef, LX, sBlock, sDmin);
+}
+
+static int runCostI4(int path) {
+    uint16 cost = sDmin & 0xff;
+    if (path) {
+        cost_i4(sRef, LX, sBlock, &cost);
+    } else {
+        refCostI4(sRef, LX, sBlock, &cost);
+    }
+    return cost;
+}
+
+static void setupHalfPel() {
+    sRef = sFrame + (3 + random32() % (LX - 24 - 2)) * LX + 3 + random32() % (LX - 24);
+}
+
+static int runHalfPel(int path) {
+    if (path) {
+        GenerateHalfPelPred(sOut[1], sRef, LX);
+    } else {
+        refHalfPel(sOut[0], sRef, LX);
+    }
+    return 0;
+}
+
+static int compareHalfPel() {
+    static const int kArrays[2][2] = {{V0Q_H2Q, 18}, {V2Q_H2Q, 17}};
+    for (int a = 0; a < 2; a++) {
+        for (int j = 0; j < kArrays[a][1]; j++) {
+            int offset = kArrays[a][0] * SUBPEL_PRED_BLK_SIZE + j * 24;
+            if (memcmp(sOut[0] + offset, sOut[1] + offset, 17)) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static void setupQuartPel() {
+    for (int i = 0; i < 4; i++) {
+        sBilinBase[i] = sPlanes[i];
+    }
+    sHpelPos = random32() % 9;
+}
+
+static int runQuartPel(int path) {
+    if (path) {
+        GenerateQuartPelPred(sBilinBase, sOut[1], sHpelPos);
+    } else {
+        refQuartPel(sBilinBase, sOut[0], sHpelPos);
+    }
+    return 0;
+}
+
+static int compareQuartPel() {
+    return memcmp(sOut[0], sOut[1], 8 * 384) != 0;
+}
+
+typedef struct {
+    const char *name;
+    void (*setup)();
+    int (*run)(int path);
+    int (*compare)();           /* for the kernels that write their result */
+} Kernel;
+
+static const Kernel kKernels[] = {
+    { "AVCSAD_Macroblock_C",    setupSad,       runSad,         NULL },
+    { "cost_i16",               setupCost,      runCostI16,     NULL },
+    { "cost_i4",                setupCost,      runCostI4,      NULL },
+    { "GenerateHalfPelPred",    setupHalfPel,   runHalfPel,     compareHalfPel },
+    { "GenerateQuartPelPred",   setupQuartPel,  runQuartPel,    compareQuartPel },
+};
+
+static int checkKernel(const Kernel *k, int trials) {
+    for (int t = 0; t < trials; t++) {
+        randomData();
+        k->setup();
+        memset(sOut, 0, sizeof(sOut));
+        int expected = k->run(0);
+        int actual = k->run(1);
+        if (expected != actual || (k->compare != NULL && k->compare())) {
+            fprintf(stderr, "%s: mismatch, trial %d (%d != %d)\n", k->name, t,
+                    actual, expected);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static volatile int sSink;
+
+static double benchKernel(const Kernel *k, int path, int passes) {
+    // through a volatile pointer so that the compiler cannot hoist the
+    // reference out of the loop
+    int (* volatile run)(int) = k->run;
+    int64_t start;
+    int sum = 0;
+
+    randomData();
+    k->setup();
+    start = nowNs();
+    for (int p = 0; p < passes; p++) {
+        sum += run(path);
+    }
+    sSink = sum;
+    return (double) (nowNs() - start) / passes;
+}
+
+// ----------------------------------------------------------------------------
+
+static int usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-t trials] [-p passes] [-s seed]\n", name);
+    fprintf(stderr, "    -t    random trials per kernel for the bit-exactness check (default 20000)\n");
+    fprintf(stderr, "    -p    calls per kernel for the timing (default 200000)\n");
+    fprintf(stderr, "    -s    random seed (default 1)\n");
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    int trials = 20000;
+    int passes = 200000;
+    int failures = 0;
+    int ch;
+
+    while ((ch = getopt(argc, argv, "t:p:s:")) != -1) {
+        switch (ch) {
+        case 't':
+            trials = atoi(optarg);
+            break;
+        case 'p':
+            passes = atoi(optarg);
+            break;
+        case 's':
+            sSeed = (unsigned int) atoi(optarg);
+            break;
+        default:
+            return usage(argv[0]);
+        }
+    }
+    if (trials < 0 || passes <= 0) {
+        return usage(argv[0]);
+    }
+
+#if !defined(__SSE2__)
+    printf("no SSE2 kernels in this build, checking the C versions\n");
+#endif
+
+    printf("%-24s %6s %10s %10s %8s\n", "kernel", "exact", "ref ns", "lib ns", "speedup");
+    for (size_t i = 0; i < sizeof(kKernels) / sizeof(kKernels[0]); i++) {
+        const Kernel *k = &kKernels[i];
+        int failed = checkKernel(k, trials);
+        double ref = benchKernel(k, 0, passes);
+        double lib = benchKernel(k, 1, passes);
+        printf("%-24s %6s %10.2f %10.2f %7.2fx\n", k->name, failed ? "NO" : "yes",
+                ref, lib, ref / lib);
+        failures += failed;
+    }
+    return failures ? 1 : 0;
+}
@@ -26,6 +26,7 @@ LOCAL_SRC_FILES := \
 	./source/h264bsd_dpb.c \
 	./source/h264bsd_image.c \
 	./source/h264bsd_deblocking.c \
+	./source/h264bsd_filter_threads.c \
 	./source/h264bsd_conceal.c \
 	./source/h264bsd_vui.c \
 	./source/h264bsd_pic_order_cnt.c \
@@ -96,6 +97,12 @@ ifeq ($(ARCH_ARM_HAVE_NEON),true)
                         $(LOCAL_PATH)/./omxdl/arm_neon/vc/m4p10/api
 endif
 
+# SSE2 luma interpolation and horizontal edge luma deblocking, the other
+# kernels are plain C on x86.
+ifneq ($(filter x86 x86_64,$(TARGET_ARCH)),)
+    LOCAL_CFLAGS     += -DH264DEC_SSE2 -msse2
+endif
+
 LOCAL_SHARED_LIBRARIES := \
 	libstagefright libstagefright_omx libstagefright_foundation libutils \
 
@@ -125,3 +132,20 @@ LOCAL_MODULE := decoder
 
 include $(BUILD_EXECUTABLE)
 
+
+#####################################################################
+# test utility: multiple decoder instances, thread scaling
+#####################################################################
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := ./source/TestBenchMultipleInstance.c
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/inc
+
+LOCAL_SHARED_LIBRARIES := libstagefright_soft_h264dec
+
+LOCAL_MODULE_TAGS := debug
+
+LOCAL_MODULE := decoder_multi
+
+include $(BUILD_EXECUTABLE)
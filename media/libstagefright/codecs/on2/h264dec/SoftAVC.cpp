@@ -63,6 +63,7 @@ SoftAVC::SoftAVC(
         OMX_COMPONENTTYPE **component)
     : SimpleSoftOMXComponent(name, callbacks, appData, component),
       mHandle(NULL),
+      mNumThreads(1),
       mInputBufferCount(0),
       mWidth(320),
       mHeight(240),
@@ -169,7 +170,9 @@ status_t SoftAVC::initDecoder() {
 
 OMX_ERRORTYPE SoftAVC::internalGetParameter(
         OMX_INDEXTYPE index, OMX_PTR params) {
-    switch (index) {
+    int32_t indexFull = index;
+
+    switch (indexFull) {
         case OMX_IndexParamVideoPortFormat:
         {
             OMX_VIDEO_PARAM_PORTFORMATTYPE *formatParams =
@@ -220,6 +223,14 @@ OMX_ERRORTYPE SoftAVC::internalGetParameter(
             return OMX_ErrorNone;
         }
 
+        case kDecoderThreadsExtensionIndex:
+        {
+            OMX_PARAM_U32TYPE *threadParams = (OMX_PARAM_U32TYPE *)params;
+
+            threadParams->nU32 = mNumThreads;
+            return OMX_ErrorNone;
+        }
+
         default:
             return SimpleSoftOMXComponent::internalGetParameter(index, params);
     }
@@ -227,7 +238,9 @@ OMX_ERRORTYPE SoftAVC::internalGetParameter(
 
 OMX_ERRORTYPE SoftAVC::internalSetParameter(
         OMX_INDEXTYPE index, const OMX_PTR params) {
-    switch (index) {
+    int32_t indexFull = index;
+
+    switch (indexFull) {
         case OMX_IndexParamStandardComponentRole:
         {
             const OMX_PARAM_COMPONENTROLETYPE *roleParams =
@@ -258,6 +271,23 @@ OMX_ERRORTYPE SoftAVC::internalSetParameter(
             return OMX_ErrorNone;
         }
 
+        case kDecoderThreadsExtensionIndex:
+        {
+            const OMX_PARAM_U32TYPE *threadParams =
+                (const OMX_PARAM_U32TYPE *)params;
+
+            // Deblocking runs on nU32 - 1 extra threads, the output does
+            // not depend on the thread count.
+            if (H264SwDecSetNumThreads(mHandle, threadParams->nU32)
+                    != H264SWDEC_OK) {
+                return OMX_ErrorBadParameter;
+            }
+
+            ALOGV("decoding with %ld threads", threadParams->nU32);
+            mNumThreads = threadParams->nU32;
+            return OMX_ErrorNone;
+        }
+
         default:
             return SimpleSoftOMXComponent::internalSetParameter(index, params);
     }
@@ -287,6 +317,15 @@ OMX_ERRORTYPE SoftAVC::getConfig(
     }
 }
 
+OMX_ERRORTYPE SoftAVC::getExtensionIndex(
+        const char *name, OMX_INDEXTYPE *index) {
+    if (!strcmp(name, "OMX.google.android.index.decoderThreads")) {
+        *(int32_t*)index = kDecoderThreadsExtensionIndex;
+        return OMX_ErrorNone;
+    }
+    return OMX_ErrorUndefined;
+}
+
 void SoftAVC::onQueueFilled(OMX_U32 portIndex) {
     if (mSignalledError || mOutputPortSettingsChange != NONE) {
         return;
@@ -43,6 +43,9 @@ protected:
 
     virtual OMX_ERRORTYPE getConfig(OMX_INDEXTYPE index, OMX_PTR params);
 
+    virtual OMX_ERRORTYPE getExtensionIndex(
+            const char *name, OMX_INDEXTYPE *index);
+
     virtual void onQueueFilled(OMX_U32 portIndex);
     virtual void onPortFlushCompleted(OMX_U32 portIndex);
     virtual void onPortEnableCompleted(OMX_U32 portIndex, bool enabled);
@@ -55,6 +58,11 @@ private:
         kNumOutputBuffers = 2,
     };
 
+    enum {
+        // OMX_PARAM_U32TYPE, nU32 is the number of decoder threads.
+        kDecoderThreadsExtensionIndex = OMX_IndexVendorStartUnused + 1
+    };
+
     enum EOSStatus {
         INPUT_DATA_AVAILABLE,
         INPUT_EOS_SEEN,
@@ -62,6 +70,7 @@ private:
     };
 
     void *mHandle;
+    uint32_t mNumThreads;
 
     size_t mInputBufferCount;
 
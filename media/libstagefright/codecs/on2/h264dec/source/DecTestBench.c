@@ -18,6 +18,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 /*------------------------------------------------------------------------------
     Module defines
@@ -40,6 +41,7 @@ void WriteOutput(char *filename, u8 *data, u32 picSize);
 u32 NextPacket(u8 **pStrm);
 u32 CropPicture(u8 *pOutImage, u8 *pInImage,
     u32 picWidth, u32 picHeight, CropParams *pCropParams);
+double GetTime(void);
 
 /* Global variables for stream handling */
 u8 *streamStop = NULL;
@@ -102,6 +104,9 @@ int main(int argc, char **argv)
     u32 numErrors = 0;
     u32 cropDisplay = 0;
     u32 disableOutputReordering = 0;
+    u32 numThreads = 1;
+    double decodeTime = 0;
+    double startTime;
 
     FILE *finput;
 
@@ -123,7 +128,7 @@ int main(int argc, char **argv)
     if (argc < 2)
     {
         DEBUG((
-            "Usage: %s [-Nn] [-Ooutfile] [-P] [-U] [-C] [-R] [-T] file.h264\n",
+            "Usage: %s [-Nn] [-Ooutfile] [-P] [-U] [-C] [-R] [-Mn] [-T] file.h264\n",
             argv[0]));
         DEBUG(("\t-Nn forces decoding to stop after n pictures\n"));
 #if defined(_NO_OUT)
@@ -136,6 +141,7 @@ int main(int argc, char **argv)
         DEBUG(("\t-U NAL unit stream mode\n"));
         DEBUG(("\t-C display cropped image (default decoded image)\n"));
         DEBUG(("\t-R disable DPB output reordering\n"));
+        DEBUG(("\t-Mn decode using n threads (default 1)\n"));
         DEBUG(("\t-T to print tag name and exit\n"));
         return 0;
     }
@@ -167,6 +173,10 @@ int main(int argc, char **argv)
         {
             disableOutputReordering = 1;
         }
+        else if ( strncmp(argv[i], "-M", 2) == 0 )
+        {
+            numThreads = (u32)atoi(argv[i]+2);
+        }
     }
 
     /* open input file for reading, file name given by user. If file open
@@ -204,6 +214,15 @@ int main(int argc, char **argv)
         return -1;
     }
 
+    ret = H264SwDecSetNumThreads(decInst, numThreads);
+    if (ret != H264SWDEC_OK)
+    {
+        DEBUG(("INVALID NUMBER OF THREADS\n"));
+        H264SwDecRelease(decInst);
+        free(byteStrmStart);
+        return -1;
+    }
+
     /* initialize H264SwDecDecode() input structure */
     streamStop = byteStrmStart + strmLen;
     decInput.pStream = byteStrmStart;
@@ -222,8 +241,11 @@ int main(int argc, char **argv)
         /* Picture ID is the picture number in decoding order */
         decInput.picId = picDecodeNumber;
 
-        /* call API function to perform decoding */
+        /* call API function to perform decoding, only the time spent in
+         * the decoder counts towards the reported frame rate */
+        startTime = GetTime();
         ret = H264SwDecDecode(decInst, &decInput, &decOutput);
+        decodeTime += GetTime() - startTime;
 
         switch(ret)
         {
@@ -421,6 +443,12 @@ int main(int argc, char **argv)
     DEBUG(("Output file: %s\n", outFileName));
 
     DEBUG(("DECODING DONE\n"));
+    if (decodeTime > 0)
+    {
+        DEBUG(("%d pictures decoded in %.3f s, %.2f fps, %d thread(s)\n",
+            picDecodeNumber - 1, decodeTime,
+            (picDecodeNumber - 1) / decodeTime, numThreads));
+    }
     if (numErrors || picDecodeNumber == 1)
     {
         DEBUG(("ERRORS FOUND\n"));
@@ -464,6 +492,24 @@ void WriteOutput(char *filename, u8 *data, u32 picSize)
         fwrite(data, 1, picSize, foutput);
 }
 
+/*------------------------------------------------------------------------------
+
+    Function name:  GetTime
+
+    Purpose:
+        Return a monotonic timestamp in seconds, used to measure the
+        decoding speed.
+
+------------------------------------------------------------------------------*/
+double GetTime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
 /*------------------------------------------------------------------------------
 
     Function name: NextPacket
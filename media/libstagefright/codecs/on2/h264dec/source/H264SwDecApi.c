@@ -29,6 +29,7 @@
           H264SwDecDecode
           H264SwDecGetAPIVersion
           H264SwDecNextPicture
+          H264SwDecSetNumThreads
 
 ------------------------------------------------------------------------------*/
 
@@ -47,7 +48,7 @@
 ------------------------------------------------------------------------------*/
 
 #define H264SWDEC_MAJOR_VERSION 2
-#define H264SWDEC_MINOR_VERSION 3
+#define H264SWDEC_MINOR_VERSION 4
 
 /*------------------------------------------------------------------------------
     2. External compiler flags
@@ -564,4 +565,55 @@ H264SwDecRet H264SwDecNextPicture(H264SwDecInst decInst,
 
 }
 
+/*------------------------------------------------------------------------------
+
+    Function: H264SwDecSetNumThreads
+
+        Functional description:
+            Set the number of threads the decoder may use. The calling thread
+            decodes the stream and numThreads - 1 worker threads perform
+            deblocking filtering of the macroblock rows already reconstructed.
+            Decoded pictures are identical for any number of threads. The
+            setting takes effect from the next picture started, values above
+            the supported maximum are clamped.
+
+        Input:
+            decInst     decoder instance
+            numThreads  number of threads, 1 disables the worker threads
+
+        Returns:
+            H264SWDEC_OK            success
+            H264SWDEC_PARAM_ERR     invalid parameters
+
+------------------------------------------------------------------------------*/
+
+H264SwDecRet H264SwDecSetNumThreads(H264SwDecInst decInst, u32 numThreads)
+{
+
+    decContainer_t *pDecCont;
+
+    DEC_API_TRC("H264SwDecSetNumThreads#");
+
+    if (decInst == NULL || numThreads == 0)
+    {
+        DEC_API_TRC("H264SwDecSetNumThreads# ERROR: decInst == NULL or "
+                    "numThreads == 0");
+        return(H264SWDEC_PARAM_ERR);
+    }
+
+    pDecCont = (decContainer_t*)decInst;
+
+#ifdef H264DEC_TRACE
+    sprintf(pDecCont->str, "H264SwDecSetNumThreads# decInst %p numThreads %d",
+            decInst, numThreads);
+    DEC_API_TRC(pDecCont->str);
+#endif
+
+    pDecCont->storage.numThreads = MIN(numThreads, MAX_NUM_THREADS);
+
+    DEC_API_TRC("H264SwDecSetNumThreads# OK");
+
+    return(H264SWDEC_OK);
+
+}
 
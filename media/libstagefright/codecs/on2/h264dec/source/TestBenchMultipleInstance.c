@@ -21,6 +21,7 @@ const char tagName[256] = "$Name: FIRST_ANDROID_COPYRIGHT $";
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #define DEBUG(argv) printf argv
 
@@ -40,6 +41,8 @@ u32 CropPicture(u8 *pOutImage, u8 *pInImage,
 void CropWriteOutput(FILE *fid, u8 *imageData, u32 cropDisplay,
         H264SwDecInfo *decInfo);
 
+double GetTime(void);
+
 typedef struct
 {
     H264SwDecInst decInst;
@@ -68,6 +71,9 @@ int main(int argc, char **argv)
     u32 numErrors = 0;
     u32 cropDisplay = 0;
     u32 disableOutputReordering = 0;
+    u32 numThreads = 1;
+    u32 totalPics = 0;
+    double startTime;
     FILE *finput;
     Decoder **decoder;
     char outFileName[256] = "out.yuv";
@@ -82,7 +88,7 @@ int main(int argc, char **argv)
     if (argc < 2)
     {
         DEBUG((
-            "Usage: %s [-Nn] [-Ooutfile] [-P] [-U] [-C] [-R] [-T] file1.264 [file2.264] .. [fileN.264]\n",
+            "Usage: %s [-Nn] [-Ooutfile] [-P] [-U] [-C] [-R] [-Mn] [-T] file1.264 [file2.264] .. [fileN.264]\n",
             argv[0]));
         DEBUG(("\t-Nn forces decoding to stop after n pictures\n"));
 #if defined(_NO_OUT)
@@ -93,6 +99,7 @@ int main(int argc, char **argv)
 #endif
         DEBUG(("\t-C display cropped image (default decoded image)\n"));
         DEBUG(("\t-R disable DPB output reordering\n"));
+        DEBUG(("\t-Mn decode each stream using n threads (default 1)\n"));
         DEBUG(("\t-T to print tag name and exit\n"));
         exit(100);
     }
@@ -123,6 +130,11 @@ int main(int argc, char **argv)
             disableOutputReordering = 1;
             instCount--;
         }
+        else if ( strncmp(argv[i], "-M", 2) == 0 )
+        {
+            numThreads = (u32)atoi(argv[i]+2);
+            instCount--;
+        }
     }
 
     if (instCount < 1)
@@ -192,12 +204,21 @@ int main(int argc, char **argv)
             exit(100);
         }
 
+        ret = H264SwDecSetNumThreads(decoder[i]->decInst, numThreads);
+        if (ret != H264SWDEC_OK)
+        {
+            DEBUG(("Invalid number of threads %d\n", numThreads));
+            exit(100);
+        }
+
         decoder[i]->decInput.pStream = decoder[i]->byteStrmStart;
         decoder[i]->decInput.dataLen = strmLen;
         decoder[i]->decInput.intraConcealmentMethod = 0;
 
     }
 
+    startTime = GetTime();
+
     /* main decoding loop */
     do
     {
@@ -328,6 +349,8 @@ int main(int argc, char **argv)
 
         H264SwDecRelease(decoder[i]->decInst);
 
+        totalPics += decoder[i]->picNumber;
+
         if (decoder[i]->foutput)
             fclose(decoder[i]->foutput);
 
@@ -338,6 +361,10 @@ int main(int argc, char **argv)
 
     free(decoder);
 
+    startTime = GetTime() - startTime;
+    DEBUG(("%d streams, %d pictures in %.3f s, %.2f fps, %d thread(s) each\n",
+        instCount, totalPics, startTime, totalPics / startTime, numThreads));
+
     if (numErrors)
         return 1;
     else
@@ -529,3 +556,21 @@ u32 CropPicture(u8 *pOutImage, u8 *pInImage,
 
 }
 
+
+/*------------------------------------------------------------------------------
+
+    Function name:  GetTime
+
+    Purpose:
+        Return a monotonic timestamp in seconds, used to measure the
+        decoding speed.
+
+------------------------------------------------------------------------------*/
+double GetTime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -42,6 +42,8 @@
 #define MAX_NUM_SLICE_GROUPS 8
 #define MAX_NUM_SEQ_PARAM_SETS 32
 #define MAX_NUM_PIC_PARAM_SETS 256
+/* decoding thread and deblocking filter threads */
+#define MAX_NUM_THREADS 8
 
 /*------------------------------------------------------------------------------
     3. Data types
@@ -24,6 +24,7 @@
      4. Local function prototypes
      5. Functions
           h264bsdFilterPicture
+          h264bsdFilterMacroblocks
           FilterVerLumaEdge
           FilterHorLumaEdge
           FilterHorLuma
@@ -59,6 +60,10 @@
 #include "armVC.h"
 #endif /* H264DEC_OMXDL */
 
+#ifdef H264DEC_SSE2
+#include <emmintrin.h>
+#endif /* H264DEC_SSE2 */
+
 /*------------------------------------------------------------------------------
     2. External compiler flags
 --------------------------------------------------------------------------------
@@ -178,10 +183,17 @@ static void FilterChroma(u8 *cb, u8 *cr, bS_t *bS, edgeThreshold_t *thresholds,
 
 static void FilterVerLumaEdge( u8 *data, u32 bS, edgeThreshold_t *thresholds,
         u32 imageWidth);
+#ifdef H264DEC_SSE2
+static void FilterLuma8Sse2(__m128i *pix, u32 bS0, u32 bS1,
+        edgeThreshold_t *thresholds);
+static void FilterHorLumaSse2(u8 *data, bS_t *bS, edgeThreshold_t *thresholds,
+        i32 imageWidth);
+#else
 static void FilterHorLumaEdge( u8 *data, u32 bS, edgeThreshold_t *thresholds,
         i32 imageWidth);
 static void FilterHorLuma( u8 *data, u32 bS, edgeThreshold_t *thresholds,
         i32 imageWidth);
+#endif /* H264DEC_SSE2 */
 
 static void FilterVerChromaEdge( u8 *data, u32 bS, edgeThreshold_t *thresholds,
   u32 imageWidth);
@@ -570,12 +582,55 @@ u32 EdgeBoundaryStrengthLeft(mbStorage_t *mb1, mbStorage_t *mb2)
           none
 
 ------------------------------------------------------------------------------*/
-#ifndef H264DEC_OMXDL
+
 void h264bsdFilterPicture(
   image_t *image,
   mbStorage_t *mb)
 {
 
+/* Variables */
+
+/* Code */
+
+    ASSERT(image);
+
+    h264bsdFilterMacroblocks(image, mb, 0, image->width * image->height);
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: h264bsdFilterMacroblocks
+
+        Functional description:
+          Perform deblocking filtering for a range of macroblocks of a
+          picture, in raster scan order. Filtering a macroblock changes the
+          pixels of the macroblock itself, three columns of the macroblock on
+          the left and three rows of the macroblock above, the caller has to
+          take care that those are not accessed by anybody else meanwhile.
+
+        Inputs:
+          image         pointer to image to be filtered
+          mb            pointer to macroblock data structure of the top-left
+                        macroblock of the picture
+          firstMb       raster scan address of the first macroblock to filter
+          numMbs        number of macroblocks to filter
+
+        Outputs:
+          image         filtered image stored here
+
+        Returns:
+          none
+
+------------------------------------------------------------------------------*/
+#ifndef H264DEC_OMXDL
+void h264bsdFilterMacroblocks(
+  image_t *image,
+  mbStorage_t *mb,
+  u32 firstMb,
+  u32 numMbs)
+{
+
 /* Variables */
 
     u32 flags;
@@ -598,9 +653,13 @@ void h264bsdFilterPicture(
     data = image->data;
     picSizeInMbs = picWidthInMbs * image->height;
 
-    pMb = mb;
+    ASSERT(firstMb + numMbs <= picSizeInMbs);
+
+    pMb = mb + firstMb;
+    mbRow = firstMb / picWidthInMbs;
+    mbCol = firstMb - mbRow * picWidthInMbs;
 
-    for (mbRow = 0, mbCol = 0; mbRow < image->height; pMb++)
+    for ( ; numMbs; numMbs--, pMb++)
     {
         flags = GetMbFilteringFlags(pMb);
 
@@ -749,6 +808,7 @@ void FilterVerLumaEdge(
 
 }
 
+#ifndef H264DEC_SSE2
 /*------------------------------------------------------------------------------
 
     Function: FilterHorLumaEdge
@@ -931,6 +991,199 @@ void FilterHorLuma(
 
 }
 
+#else /* H264DEC_SSE2 */
+/* per-lane helpers for the SSE2 luma filter */
+static __m128i SelectSse2(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static __m128i AbsDiffSse2(__m128i a, __m128i b)
+{
+    return _mm_max_epi16(_mm_sub_epi16(a, b), _mm_sub_epi16(b, a));
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: FilterLuma8Sse2
+
+        Functional description:
+            Filter eight columns across a horizontal luma edge. pix holds
+            the rows p3, p2, p1, p0, q0, q1, q2 and q3 as 16-bit values,
+            bS0 applies to the first four columns and bS1 to the last four.
+            Rows p2 to q2 are replaced by the filtered values.
+
+------------------------------------------------------------------------------*/
+void FilterLuma8Sse2(
+  __m128i *pix,
+  u32 bS0,
+  u32 bS1,
+  edgeThreshold_t *thresholds)
+{
+
+/* Variables */
+
+    __m128i p3 = pix[0], p2 = pix[1], p1 = pix[2], p0 = pix[3];
+    __m128i q0 = pix[4], q1 = pix[5], q2 = pix[6], q3 = pix[7];
+    __m128i alpha, beta, tc, normal, strong, filter, ap, aq, small;
+    __m128i tmp, delta, np1, nq1, np0, nq0, sp2, sp1, sp0, sq0, sq1, sq2;
+    i16 tc0 = 0, tc1 = 0;
+
+/* Code */
+
+    ASSERT(bS0 <= 4 && bS1 <= 4);
+
+    if (bS0 && bS0 < 4)
+        tc0 = (i16)thresholds->tc0[bS0-1];
+    if (bS1 && bS1 < 4)
+        tc1 = (i16)thresholds->tc0[bS1-1];
+    tc = _mm_set_epi16(tc1, tc1, tc1, tc1, tc0, tc0, tc0, tc0);
+
+    normal = _mm_set_epi16(
+        bS1 && bS1 < 4 ? -1 : 0, bS1 && bS1 < 4 ? -1 : 0,
+        bS1 && bS1 < 4 ? -1 : 0, bS1 && bS1 < 4 ? -1 : 0,
+        bS0 && bS0 < 4 ? -1 : 0, bS0 && bS0 < 4 ? -1 : 0,
+        bS0 && bS0 < 4 ? -1 : 0, bS0 && bS0 < 4 ? -1 : 0);
+    strong = _mm_set_epi16(
+        bS1 == 4 ? -1 : 0, bS1 == 4 ? -1 : 0,
+        bS1 == 4 ? -1 : 0, bS1 == 4 ? -1 : 0,
+        bS0 == 4 ? -1 : 0, bS0 == 4 ? -1 : 0,
+        bS0 == 4 ? -1 : 0, bS0 == 4 ? -1 : 0);
+
+    alpha = _mm_set1_epi16((i16)thresholds->alpha);
+    beta = _mm_set1_epi16((i16)thresholds->beta);
+
+    filter = _mm_and_si128(
+        _mm_cmplt_epi16(AbsDiffSse2(p0, q0), alpha),
+        _mm_and_si128(_mm_cmplt_epi16(AbsDiffSse2(p1, p0), beta),
+                      _mm_cmplt_epi16(AbsDiffSse2(q1, q0), beta)));
+    normal = _mm_and_si128(normal, filter);
+    strong = _mm_and_si128(strong, filter);
+    if (!_mm_movemask_epi8(_mm_or_si128(normal, strong)))
+        return;
+
+    ap = _mm_cmplt_epi16(AbsDiffSse2(p2, p0), beta);
+    aq = _mm_cmplt_epi16(AbsDiffSse2(q2, q0), beta);
+
+    /* bS < 4 */
+    tmp = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(p0, q0),
+                                       _mm_set1_epi16(1)), 1);
+    np1 = _mm_srai_epi16(_mm_sub_epi16(_mm_add_epi16(p2, tmp),
+                                       _mm_slli_epi16(p1, 1)), 1);
+    np1 = _mm_min_epi16(_mm_max_epi16(np1, _mm_sub_epi16(_mm_setzero_si128(),
+                tc)), tc);
+    np1 = _mm_add_epi16(p1, _mm_and_si128(np1, ap));
+    nq1 = _mm_srai_epi16(_mm_sub_epi16(_mm_add_epi16(q2, tmp),
+                                       _mm_slli_epi16(q1, 1)), 1);
+    nq1 = _mm_min_epi16(_mm_max_epi16(nq1, _mm_sub_epi16(_mm_setzero_si128(),
+                tc)), tc);
+    nq1 = _mm_add_epi16(q1, _mm_and_si128(nq1, aq));
+
+    /* each applied p1/q1 filter widens the clipping range by one */
+    tc = _mm_sub_epi16(_mm_sub_epi16(tc, ap), aq);
+    delta = _mm_add_epi16(_mm_slli_epi16(_mm_sub_epi16(q0, p0), 2),
+                          _mm_sub_epi16(p1, q1));
+    delta = _mm_srai_epi16(_mm_add_epi16(delta, _mm_set1_epi16(4)), 3);
+    delta = _mm_min_epi16(_mm_max_epi16(delta, _mm_sub_epi16(
+                _mm_setzero_si128(), tc)), tc);
+    np0 = _mm_add_epi16(p0, delta);
+    nq0 = _mm_sub_epi16(q0, delta);
+
+    /* bS == 4 */
+    small = _mm_cmplt_epi16(AbsDiffSse2(p0, q0),
+        _mm_set1_epi16((i16)((thresholds->alpha >> 2) + 2)));
+    ap = _mm_and_si128(ap, small);
+    aq = _mm_and_si128(aq, small);
+
+    tmp = _mm_add_epi16(_mm_add_epi16(p1, p0), q0);
+    sp0 = _mm_add_epi16(_mm_add_epi16(p2, _mm_slli_epi16(tmp, 1)),
+                        _mm_add_epi16(q1, _mm_set1_epi16(4)));
+    sp0 = _mm_srai_epi16(sp0, 3);
+    sp1 = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(p2, tmp),
+                                       _mm_set1_epi16(2)), 2);
+    sp2 = _mm_add_epi16(_mm_slli_epi16(p3, 1),
+                        _mm_add_epi16(_mm_add_epi16(p2, _mm_slli_epi16(p2, 1)),
+                                      _mm_add_epi16(tmp, _mm_set1_epi16(4))));
+    sp2 = _mm_srai_epi16(sp2, 3);
+    tmp = _mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(p1, 1), p0),
+                        _mm_add_epi16(q1, _mm_set1_epi16(2)));
+    sp0 = SelectSse2(ap, sp0, _mm_srai_epi16(tmp, 2));
+    sp1 = SelectSse2(ap, sp1, p1);
+    sp2 = SelectSse2(ap, sp2, p2);
+
+    tmp = _mm_add_epi16(_mm_add_epi16(p0, q0), q1);
+    sq0 = _mm_add_epi16(_mm_add_epi16(p1, _mm_slli_epi16(tmp, 1)),
+                        _mm_add_epi16(q2, _mm_set1_epi16(4)));
+    sq0 = _mm_srai_epi16(sq0, 3);
+    sq1 = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(q2, tmp),
+                                       _mm_set1_epi16(2)), 2);
+    sq2 = _mm_add_epi16(_mm_slli_epi16(q3, 1),
+                        _mm_add_epi16(_mm_add_epi16(q2, _mm_slli_epi16(q2, 1)),
+                                      _mm_add_epi16(tmp, _mm_set1_epi16(4))));
+    sq2 = _mm_srai_epi16(sq2, 3);
+    tmp = _mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(q1, 1), q0),
+                        _mm_add_epi16(p1, _mm_set1_epi16(2)));
+    sq0 = SelectSse2(aq, sq0, _mm_srai_epi16(tmp, 2));
+    sq1 = SelectSse2(aq, sq1, q1);
+    sq2 = SelectSse2(aq, sq2, q2);
+
+    pix[1] = SelectSse2(strong, sp2, p2);
+    pix[2] = SelectSse2(normal, np1, SelectSse2(strong, sp1, p1));
+    pix[3] = SelectSse2(normal, np0, SelectSse2(strong, sp0, p0));
+    pix[4] = SelectSse2(normal, nq0, SelectSse2(strong, sq0, q0));
+    pix[5] = SelectSse2(normal, nq1, SelectSse2(strong, sq1, q1));
+    pix[6] = SelectSse2(strong, sq2, q2);
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: FilterHorLumaSse2
+
+        Functional description:
+            Filter the four horizontal 4-pixel luma edges of a row of 4x4
+            blocks at once. bS may differ between the edges, edges with zero
+            bS are left as they are. Replaces FilterHorLuma and
+            FilterHorLumaEdge when SSE2 is available.
+
+------------------------------------------------------------------------------*/
+void FilterHorLumaSse2(
+  u8 *data,
+  bS_t *bS,
+  edgeThreshold_t *thresholds,
+  i32 imageWidth)
+{
+
+/* Variables */
+
+    __m128i lo[8], hi[8], row;
+    i32 i;
+
+/* Code */
+
+    ASSERT(data);
+    ASSERT(bS);
+    ASSERT(thresholds);
+
+    /* rows p3 to q3 */
+    for (i = 0; i < 8; i++)
+    {
+        row = _mm_loadu_si128((const __m128i*)(data + (i-4)*imageWidth));
+        lo[i] = _mm_unpacklo_epi8(row, _mm_setzero_si128());
+        hi[i] = _mm_unpackhi_epi8(row, _mm_setzero_si128());
+    }
+
+    FilterLuma8Sse2(lo, bS[0].top, bS[1].top, thresholds);
+    FilterLuma8Sse2(hi, bS[2].top, bS[3].top, thresholds);
+
+    /* rows p2 to q2 */
+    for (i = 1; i < 7; i++)
+        _mm_storeu_si128((__m128i*)(data + (i-4)*imageWidth),
+            _mm_packus_epi16(lo[i], hi[i]));
+
+}
+#endif /* H264DEC_SSE2 */
+
 /*------------------------------------------------------------------------------
 
     Function: FilterVerChromaEdge
@@ -1580,6 +1833,13 @@ void FilterLuma(
         if (tmp[3].left)
             FilterVerLumaEdge(ptr+12, tmp[3].left, thresholds + INNER, width);
 
+#ifdef H264DEC_SSE2
+        /* all four horizontal edges of the row are filtered together, the
+         * offset variable indicates top macroblock edge on the first loop
+         * round, inner edge for the other rounds */
+        if (tmp[0].top || tmp[1].top || tmp[2].top || tmp[3].top)
+            FilterHorLumaSse2(ptr, tmp, thresholds + offset, (i32)width);
+#else
         /* if bS is equal for all horizontal edges of the row -> perform
          * filtering with FilterHorLuma, otherwise use FilterHorLumaEdge for
          * each edge separately. offset variable indicates top macroblock edge
@@ -1605,6 +1865,7 @@ void FilterLuma(
                 FilterHorLumaEdge(ptr+12, tmp[3].top, thresholds+offset,
                     (i32)width);
         }
+#endif /* H264DEC_SSE2 */
 
         /* four pixel rows ahead, i.e. next row of 4x4-blocks */
         ptr += width*4;
@@ -1739,20 +2000,21 @@ void FilterChroma(
 
 /*------------------------------------------------------------------------------
 
-    Function: h264bsdFilterPicture
+    Function: h264bsdFilterMacroblocks
 
         Functional description:
-          Perform deblocking filtering for a picture. Filter does not copy
-          the original picture anywhere but filtering is performed directly
-          on the original image. Parameters controlling the filtering process
-          are computed based on information in macroblock structures of the
-          filtered macroblock, macroblock above and macroblock on the left of
-          the filtered one.
+          Perform deblocking filtering for a range of macroblocks of a
+          picture, in raster scan order. Filtering a macroblock changes the
+          pixels of the macroblock itself, three columns of the macroblock on
+          the left and three rows of the macroblock above, the caller has to
+          take care that those are not accessed by anybody else meanwhile.
 
         Inputs:
           image         pointer to image to be filtered
           mb            pointer to macroblock data structure of the top-left
                         macroblock of the picture
+          firstMb       raster scan address of the first macroblock to filter
+          numMbs        number of macroblocks to filter
 
         Outputs:
           image         filtered image stored here
@@ -1763,9 +2025,11 @@ void FilterChroma(
 ------------------------------------------------------------------------------*/
 
 /*lint --e{550} Symbol not accessed */
-void h264bsdFilterPicture(
+void h264bsdFilterMacroblocks(
   image_t *image,
-  mbStorage_t *mb)
+  mbStorage_t *mb,
+  u32 firstMb,
+  u32 numMbs)
 {
 
 /* Variables */
@@ -1794,9 +2058,13 @@ void h264bsdFilterPicture(
     data = image->data;
     picSizeInMbs = picWidthInMbs * image->height;
 
-    pMb = mb;
+    ASSERT(firstMb + numMbs <= picSizeInMbs);
+
+    pMb = mb + firstMb;
+    mbRow = firstMb / picWidthInMbs;
+    mbCol = firstMb - mbRow * picWidthInMbs;
 
-    for (mbRow = 0, mbCol = 0; mbRow < image->height; pMb++)
+    for ( ; numMbs; numMbs--, pMb++)
     {
         flags = GetMbFilteringFlags(pMb);
 
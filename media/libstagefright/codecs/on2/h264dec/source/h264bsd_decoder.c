@@ -53,6 +53,7 @@
 #include "h264bsd_util.h"
 #include "h264bsd_dpb.h"
 #include "h264bsd_deblocking.h"
+#include "h264bsd_filter_threads.h"
 #include "h264bsd_conceal.h"
 
 /*------------------------------------------------------------------------------
@@ -238,6 +239,10 @@ u32 h264bsdDecode(storage_t *pStorage, u8 *byteStrm, u32 len, u32 picId,
                 return (H264BSD_ERROR);
             }
 
+            /* concealment rewrites macroblocks, keep deblocking threads
+             * away from the picture */
+            h264bsdPausePictureFiltering(pStorage);
+
             if (!pStorage->validSliceInAccessUnit)
             {
                 pStorage->currImage->data =
@@ -420,6 +425,7 @@ u32 h264bsdDecode(storage_t *pStorage, u8 *byteStrm, u32 len, u32 picId,
                     }
                     pStorage->currImage->data =
                         h264bsdAllocateDpbImage(pStorage->dpb);
+                    h264bsdStartPictureFiltering(pStorage);
                 }
 
                 /* store slice header to storage if successfully decoded */
@@ -448,11 +454,14 @@ u32 h264bsdDecode(storage_t *pStorage, u8 *byteStrm, u32 len, u32 picId,
                 if (tmp != HANTRO_OK)
                 {
                     EPRINT("SLICE_DATA");
+                    h264bsdPausePictureFiltering(pStorage);
                     h264bsdMarkSliceCorrupted(pStorage,
                         pStorage->sliceHeader->firstMbInSlice);
                     return(H264BSD_ERROR);
                 }
 
+                h264bsdUpdatePictureFiltering(pStorage);
+
                 if (h264bsdIsEndOfPicture(pStorage))
                 {
                     picReady = HANTRO_TRUE;
@@ -471,7 +480,7 @@ u32 h264bsdDecode(storage_t *pStorage, u8 *byteStrm, u32 len, u32 picId,
 
     if (picReady)
     {
-        h264bsdFilterPicture(pStorage->currImage, pStorage->mb);
+        h264bsdFinishPictureFiltering(pStorage);
 
         h264bsdResetStorage(pStorage);
 
@@ -541,6 +550,8 @@ void h264bsdShutdown(storage_t *pStorage)
 
     ASSERT(pStorage);
 
+    h264bsdFreeFilterThreads(pStorage);
+
     for (i = 0; i < MAX_NUM_SEQ_PARAM_SETS; i++)
     {
         if (pStorage->sps[i])
@@ -0,0 +1,604 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*------------------------------------------------------------------------------
+
+    Table of contents
+
+     1. Include headers
+     2. External compiler flags
+     3. Module defines
+     4. Local function prototypes
+     5. Functions
+          h264bsdStartPictureFiltering
+          h264bsdUpdatePictureFiltering
+          h264bsdPausePictureFiltering
+          h264bsdFinishPictureFiltering
+          h264bsdFreeFilterThreads
+          CreateFilterThreads
+          StartFiltering
+          AvailableMbs
+          FilterThread
+
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+    1. Include headers
+------------------------------------------------------------------------------*/
+
+#include <pthread.h>
+
+#include "h264bsd_filter_threads.h"
+#include "h264bsd_deblocking.h"
+#include "h264bsd_util.h"
+
+/*------------------------------------------------------------------------------
+    2. External compiler flags
+--------------------------------------------------------------------------------
+
+--------------------------------------------------------------------------------
+    3. Module defines
+------------------------------------------------------------------------------*/
+
+/* a worker filters at least this many macroblocks of a row at a time (unless
+ * it reaches the end of the row) to keep the locking overhead small */
+#define MIN_FILTER_BATCH 4
+
+/* Deblocking of a picture is done by worker threads while the decoding thread
+ * reconstructs the following macroblock rows. Each worker takes one
+ * macroblock row at a time and filters it from left to right as far as the
+ * following rules allow:
+ *   - intra prediction uses unfiltered pixels of the macroblocks on the left,
+ *     above, above-left and above-right -> macroblock (row, col) may be
+ *     filtered only when macroblock (row+1, col+1) has been reconstructed
+ *   - filtering changes three pixel columns of the macroblock on the left and
+ *     three pixel rows of the macroblock above -> macroblock (row, col) may be
+ *     filtered only when macroblock (row-1, col+1) has been filtered
+ * Reconstruction progress is tracked as the number of macroblocks, in raster
+ * scan order, that are decoded without gaps. The result is identical to
+ * filtering the whole picture at once. */
+struct filterThreads
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t progressCond;    /* decoding or filtering went forward */
+    pthread_cond_t idleCond;        /* a worker finished filtering a batch */
+    pthread_t thread[MAX_NUM_THREADS];
+    u32 numWorkers;
+    u32 quit;
+
+    /* picture being filtered, data and dimensions only */
+    image_t image;
+    mbStorage_t *mb;
+    u32 picNum;
+    u32 active;
+    u32 paused;
+    u32 numDecodedMbs;
+    u32 nextRow;
+    u32 numFilteredRows;
+    u32 numBusy;
+
+    /* number of filtered macroblocks of each macroblock row */
+    u32 *rowProgress;
+    u32 rowCapacity;
+};
+
+/*------------------------------------------------------------------------------
+    4. Local function prototypes
+------------------------------------------------------------------------------*/
+
+static struct filterThreads *CreateFilterThreads(u32 numWorkers);
+static u32 StartFiltering(struct filterThreads *pThreads, image_t *image,
+    mbStorage_t *mb);
+static u32 AvailableMbs(struct filterThreads *pThreads, u32 row);
+static void *FilterThread(void *arg);
+
+/*------------------------------------------------------------------------------
+
+    Function: h264bsdStartPictureFiltering
+
+        Functional description:
+            Prepare deblocking of a new picture. Starts or stops worker threads
+            if the number of threads requested by the application has changed
+            since the previous picture. Nothing is filtered before
+            h264bsdUpdatePictureFiltering reports decoded macroblocks.
+
+        Inputs:
+            pStorage    pointer to storage structure, currImage and mb of the
+                        new picture have been set up
+
+        Outputs:
+            pStorage    filterThreads updated
+
+        Returns:
+            none
+
+------------------------------------------------------------------------------*/
+
+void h264bsdStartPictureFiltering(storage_t *pStorage)
+{
+
+/* Variables */
+
+    u32 numWorkers;
+
+/* Code */
+
+    ASSERT(pStorage);
+
+    numWorkers = pStorage->numThreads > 1 ? pStorage->numThreads - 1 : 0;
+
+    if (pStorage->filterThreads &&
+        pStorage->filterThreads->numWorkers != numWorkers)
+    {
+        h264bsdFreeFilterThreads(pStorage);
+    }
+
+    if (!pStorage->filterThreads && numWorkers)
+        pStorage->filterThreads = CreateFilterThreads(numWorkers);
+
+    if (pStorage->filterThreads)
+        (void)StartFiltering(pStorage->filterThreads, pStorage->currImage,
+            pStorage->mb);
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: h264bsdUpdatePictureFiltering
+
+        Functional description:
+            Let the worker threads filter newly reconstructed macroblocks.
+            Called by the decoding thread after each macroblock row and after
+            each slice.
+
+        Inputs:
+            pStorage    pointer to storage structure
+
+        Outputs:
+            none
+
+        Returns:
+            none
+
+------------------------------------------------------------------------------*/
+
+void h264bsdUpdatePictureFiltering(storage_t *pStorage)
+{
+
+/* Variables */
+
+    u32 numDecodedMbs, picSizeInMbs;
+    struct filterThreads *pThreads;
+
+/* Code */
+
+    ASSERT(pStorage);
+
+    pThreads = pStorage->filterThreads;
+
+    /* only the decoding thread changes active, paused and numDecodedMbs, no
+     * need to lock for reading them here */
+    if (!pThreads || !pThreads->active || pThreads->paused)
+        return;
+
+    picSizeInMbs = pThreads->image.width * pThreads->image.height;
+    numDecodedMbs = pThreads->numDecodedMbs;
+    while (numDecodedMbs < picSizeInMbs && pStorage->mb[numDecodedMbs].decoded)
+        numDecodedMbs++;
+
+    if (numDecodedMbs != pThreads->numDecodedMbs)
+    {
+        pthread_mutex_lock(&pThreads->mutex);
+        pThreads->numDecodedMbs = numDecodedMbs;
+        pthread_cond_broadcast(&pThreads->progressCond);
+        pthread_mutex_unlock(&pThreads->mutex);
+    }
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: h264bsdPausePictureFiltering
+
+        Functional description:
+            Stop filtering of the current picture until
+            h264bsdFinishPictureFiltering is called. Used when a slice turns
+            out to be corrupted: the macroblocks reported so far are no longer
+            known to be valid and concealment will rewrite some of them.
+            Returns when no worker accesses the picture anymore. Macroblocks
+            already filtered are not filtered again after concealment.
+
+        Inputs:
+            pStorage    pointer to storage structure
+
+        Outputs:
+            none
+
+        Returns:
+            none
+
+------------------------------------------------------------------------------*/
+
+void h264bsdPausePictureFiltering(storage_t *pStorage)
+{
+
+/* Variables */
+
+    struct filterThreads *pThreads;
+
+/* Code */
+
+    ASSERT(pStorage);
+
+    pThreads = pStorage->filterThreads;
+
+    if (!pThreads || !pThreads->active)
+        return;
+
+    pthread_mutex_lock(&pThreads->mutex);
+    pThreads->paused = HANTRO_TRUE;
+    while (pThreads->numBusy)
+        pthread_cond_wait(&pThreads->idleCond, &pThreads->mutex);
+    pthread_mutex_unlock(&pThreads->mutex);
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: h264bsdFinishPictureFiltering
+
+        Functional description:
+            Complete deblocking of the current picture. All macroblocks not
+            yet filtered are handed to the worker threads and the function
+            returns when the whole picture has been filtered. Without worker
+            threads the picture is filtered by the calling thread.
+
+        Inputs:
+            pStorage    pointer to storage structure
+
+        Outputs:
+            pStorage    currImage filtered
+
+        Returns:
+            none
+
+------------------------------------------------------------------------------*/
+
+void h264bsdFinishPictureFiltering(storage_t *pStorage)
+{
+
+/* Variables */
+
+    struct filterThreads *pThreads;
+
+/* Code */
+
+    ASSERT(pStorage);
+
+    pThreads = pStorage->filterThreads;
+
+    /* picture not started by h264bsdStartPictureFiltering (only concealed)
+     * -> filter all of it in the worker threads */
+    if (pThreads && !pThreads->active &&
+        StartFiltering(pThreads, pStorage->currImage, pStorage->mb) !=
+            HANTRO_OK)
+    {
+        pThreads = NULL;
+    }
+
+    if (!pThreads)
+    {
+        h264bsdFilterPicture(pStorage->currImage, pStorage->mb);
+        return;
+    }
+
+    pthread_mutex_lock(&pThreads->mutex);
+    pThreads->paused = HANTRO_FALSE;
+    pThreads->numDecodedMbs = pThreads->image.width * pThreads->image.height;
+    pthread_cond_broadcast(&pThreads->progressCond);
+    while (pThreads->numFilteredRows < pThreads->image.height)
+        pthread_cond_wait(&pThreads->idleCond, &pThreads->mutex);
+    pThreads->active = HANTRO_FALSE;
+    pthread_mutex_unlock(&pThreads->mutex);
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: h264bsdFreeFilterThreads
+
+        Functional description:
+            Stop the worker threads and free the memory allocated for them.
+            Filtering of a picture in progress is abandoned.
+
+        Inputs:
+            pStorage    pointer to storage structure
+
+        Outputs:
+            pStorage    filterThreads set to NULL
+
+        Returns:
+            none
+
+------------------------------------------------------------------------------*/
+
+void h264bsdFreeFilterThreads(storage_t *pStorage)
+{
+
+/* Variables */
+
+    u32 i;
+    struct filterThreads *pThreads;
+
+/* Code */
+
+    ASSERT(pStorage);
+
+    pThreads = pStorage->filterThreads;
+
+    if (!pThreads)
+        return;
+
+    pthread_mutex_lock(&pThreads->mutex);
+    pThreads->quit = HANTRO_TRUE;
+    pthread_cond_broadcast(&pThreads->progressCond);
+    pthread_mutex_unlock(&pThreads->mutex);
+
+    for (i = 0; i < pThreads->numWorkers; i++)
+        pthread_join(pThreads->thread[i], NULL);
+
+    pthread_cond_destroy(&pThreads->idleCond);
+    pthread_cond_destroy(&pThreads->progressCond);
+    pthread_mutex_destroy(&pThreads->mutex);
+
+    FREE(pThreads->rowProgress);
+    FREE(pStorage->filterThreads);
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: CreateFilterThreads
+
+        Functional description:
+            Allocate the filtering state and start the worker threads.
+            Returns NULL if not a single worker could be started.
+
+------------------------------------------------------------------------------*/
+
+struct filterThreads *CreateFilterThreads(u32 numWorkers)
+{
+
+/* Variables */
+
+    u32 i;
+    struct filterThreads *pThreads;
+
+/* Code */
+
+    ASSERT(numWorkers);
+
+    numWorkers = MIN(numWorkers, MAX_NUM_THREADS - 1);
+
+    ALLOCATE(pThreads, 1, struct filterThreads);
+    if (pThreads == NULL)
+        return(NULL);
+
+    H264SwDecMemset(pThreads, 0, sizeof(struct filterThreads));
+
+    pthread_mutex_init(&pThreads->mutex, NULL);
+    pthread_cond_init(&pThreads->progressCond, NULL);
+    pthread_cond_init(&pThreads->idleCond, NULL);
+
+    for (i = 0; i < numWorkers; i++)
+    {
+        if (pthread_create(&pThreads->thread[i], NULL, FilterThread, pThreads))
+            break;
+        pThreads->numWorkers++;
+    }
+
+    if (!pThreads->numWorkers)
+    {
+        pthread_cond_destroy(&pThreads->idleCond);
+        pthread_cond_destroy(&pThreads->progressCond);
+        pthread_mutex_destroy(&pThreads->mutex);
+        FREE(pThreads);
+    }
+
+    return(pThreads);
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: StartFiltering
+
+        Functional description:
+            Reset the filtering state for a new picture, no macroblocks
+            decoded yet.
+
+        Returns:
+            HANTRO_OK       success
+            HANTRO_NOK      memory allocation failed, picture has to be
+                            filtered without the worker threads
+
+------------------------------------------------------------------------------*/
+
+u32 StartFiltering(struct filterThreads *pThreads, image_t *image,
+    mbStorage_t *mb)
+{
+
+/* Variables */
+
+/* Code */
+
+    ASSERT(pThreads);
+    ASSERT(image);
+    ASSERT(mb);
+
+    pthread_mutex_lock(&pThreads->mutex);
+
+    /* previous picture was abandoned before it was finished -> wait until
+     * nobody touches it anymore, picNum tells the workers to drop their rows */
+    pThreads->paused = HANTRO_TRUE;
+    while (pThreads->numBusy)
+        pthread_cond_wait(&pThreads->idleCond, &pThreads->mutex);
+
+    if (image->height > pThreads->rowCapacity)
+    {
+        FREE(pThreads->rowProgress);
+        pThreads->rowCapacity = 0;
+        ALLOCATE(pThreads->rowProgress, image->height, u32);
+        if (pThreads->rowProgress == NULL)
+        {
+            pthread_mutex_unlock(&pThreads->mutex);
+            return(HANTRO_NOK);
+        }
+        pThreads->rowCapacity = image->height;
+    }
+
+    H264SwDecMemset(pThreads->rowProgress, 0, image->height * sizeof(u32));
+
+    pThreads->image = *image;
+    pThreads->mb = mb;
+    pThreads->picNum++;
+    pThreads->paused = HANTRO_FALSE;
+    pThreads->numDecodedMbs = 0;
+    pThreads->nextRow = 0;
+    pThreads->numFilteredRows = 0;
+    pThreads->active = HANTRO_TRUE;
+
+    pthread_mutex_unlock(&pThreads->mutex);
+
+    return(HANTRO_OK);
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: AvailableMbs
+
+        Functional description:
+            Number of macroblocks from the beginning of the row that can be
+            filtered at the moment, see the rules above. Called with the mutex
+            held.
+
+------------------------------------------------------------------------------*/
+
+u32 AvailableMbs(struct filterThreads *pThreads, u32 row)
+{
+
+/* Variables */
+
+    u32 width, nextRow, progress, avail;
+
+/* Code */
+
+    width = pThreads->image.width;
+
+    /* the last row only waits for itself */
+    nextRow = MIN(row + 1, pThreads->image.height - 1);
+
+    if (pThreads->numDecodedMbs >= (nextRow + 1) * width)
+        avail = width;
+    else if (pThreads->numDecodedMbs > nextRow * width)
+        avail = pThreads->numDecodedMbs - nextRow * width - 1;
+    else
+        avail = 0;
+
+    if (row)
+    {
+        progress = pThreads->rowProgress[row - 1];
+        if (progress < width)
+            avail = MIN(avail, progress ? progress - 1 : 0);
+    }
+
+    return(avail);
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: FilterThread
+
+        Functional description:
+            Worker thread main loop. Takes macroblock rows in order and
+            filters them in batches as reconstruction and filtering of the
+            row above proceed.
+
+------------------------------------------------------------------------------*/
+
+void *FilterThread(void *arg)
+{
+
+/* Variables */
+
+    u32 row, col, avail, width, picNum;
+    struct filterThreads *pThreads;
+
+/* Code */
+
+    pThreads = (struct filterThreads *)arg;
+
+    pthread_mutex_lock(&pThreads->mutex);
+
+    while (!pThreads->quit)
+    {
+        if (!pThreads->active || pThreads->paused ||
+            pThreads->nextRow == pThreads->image.height)
+        {
+            pthread_cond_wait(&pThreads->progressCond, &pThreads->mutex);
+            continue;
+        }
+
+        row = pThreads->nextRow++;
+        width = pThreads->image.width;
+        picNum = pThreads->picNum;
+        col = 0;
+
+        while (col < width && !pThreads->quit && picNum == pThreads->picNum)
+        {
+            avail = AvailableMbs(pThreads, row);
+            if (pThreads->paused || avail == col ||
+                (avail < width && avail - col < MIN_FILTER_BATCH))
+            {
+                pthread_cond_wait(&pThreads->progressCond, &pThreads->mutex);
+                continue;
+            }
+
+            pThreads->numBusy++;
+            pthread_mutex_unlock(&pThreads->mutex);
+
+            h264bsdFilterMacroblocks(&pThreads->image, pThreads->mb,
+                row * width + col, avail - col);
+
+            pthread_mutex_lock(&pThreads->mutex);
+            pThreads->numBusy--;
+            col = avail;
+            pThreads->rowProgress[row] = col;
+            if (col == width)
+                pThreads->numFilteredRows++;
+
+            pthread_cond_broadcast(&pThreads->progressCond);
+            pthread_cond_broadcast(&pThreads->idleCond);
+        }
+    }
+
+    pthread_mutex_unlock(&pThreads->mutex);
+
+    return(NULL);
+
+}
@@ -42,6 +42,10 @@
 #include "armVC.h"
 #endif /* H264DEC_OMXDL */
 
+#ifdef H264DEC_SSE2
+#include <emmintrin.h>
+#endif /* H264DEC_SSE2 */
+
 /*------------------------------------------------------------------------------
     2. External compiler flags
 --------------------------------------------------------------------------------
@@ -1788,6 +1792,225 @@ void h264bsdInterpolateMidHorQuarter(
 
 }
 
+#ifdef H264DEC_SSE2
+/*------------------------------------------------------------------------------
+
+    Function: HorTaps8Sse2, VerTaps8Sse2, MidTaps8Sse2
+
+        Functional description:
+          6-tap filter (1,-5,20,20,-5,1) of eight neighbouring pixels without
+          rounding. HorTaps8Sse2 and VerTaps8Sse2 read thirteen samples
+          starting from the left-most or top-most tap, MidTaps8Sse2 filters
+          vertically six rows of 16-bit intermediate values with the stride
+          of 16 and returns the rounded and clipped 'j' samples.
+
+------------------------------------------------------------------------------*/
+
+static __m128i Taps8Sse2(
+  __m128i a,
+  __m128i b,
+  __m128i c,
+  __m128i d,
+  __m128i e,
+  __m128i f)
+{
+    /* results stay within [-2550, 10710] so 16 bits are enough */
+    __m128i sum = _mm_add_epi16(a, f);
+    sum = _mm_add_epi16(sum,
+            _mm_mullo_epi16(_mm_add_epi16(c, d), _mm_set1_epi16(20)));
+    sum = _mm_sub_epi16(sum,
+            _mm_mullo_epi16(_mm_add_epi16(b, e), _mm_set1_epi16(5)));
+    return sum;
+}
+
+static __m128i Load8Sse2(const u8 *ptr)
+{
+    return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)ptr),
+                             _mm_setzero_si128());
+}
+
+static __m128i HorTaps8Sse2(const u8 *ptr)
+{
+    return Taps8Sse2(Load8Sse2(ptr), Load8Sse2(ptr+1), Load8Sse2(ptr+2),
+                     Load8Sse2(ptr+3), Load8Sse2(ptr+4), Load8Sse2(ptr+5));
+}
+
+static __m128i VerTaps8Sse2(const u8 *ptr, u32 width)
+{
+    return Taps8Sse2(Load8Sse2(ptr), Load8Sse2(ptr+width),
+                     Load8Sse2(ptr+2*width), Load8Sse2(ptr+3*width),
+                     Load8Sse2(ptr+4*width), Load8Sse2(ptr+5*width));
+}
+
+/* rounds and clips 16-bit taps, result in the low 8 bytes */
+static __m128i Round8Sse2(__m128i taps)
+{
+    taps = _mm_srai_epi16(_mm_add_epi16(taps, _mm_set1_epi16(16)), 5);
+    return _mm_packus_epi16(taps, taps);
+}
+
+static __m128i MidTaps8Sse2(const i16 *ptr)
+{
+    __m128i r0 = _mm_loadu_si128((const __m128i*)(ptr));
+    __m128i r1 = _mm_loadu_si128((const __m128i*)(ptr+16));
+    __m128i r2 = _mm_loadu_si128((const __m128i*)(ptr+32));
+    __m128i r3 = _mm_loadu_si128((const __m128i*)(ptr+48));
+    __m128i r4 = _mm_loadu_si128((const __m128i*)(ptr+64));
+    __m128i r5 = _mm_loadu_si128((const __m128i*)(ptr+80));
+    /* pair sums of the intermediate values still fit in 16 bits, the
+     * weighted sum needs 32 */
+    __m128i outer = _mm_add_epi16(r0, r5);
+    __m128i inner = _mm_add_epi16(r2, r3);
+    __m128i middle = _mm_add_epi16(r1, r4);
+    __m128i coeffs = _mm_set_epi16(-5, 20, -5, 20, -5, 20, -5, 20);
+    __m128i lo, hi;
+
+    lo = _mm_madd_epi16(_mm_unpacklo_epi16(inner, middle), coeffs);
+    hi = _mm_madd_epi16(_mm_unpackhi_epi16(inner, middle), coeffs);
+    lo = _mm_add_epi32(lo, _mm_srai_epi32(_mm_unpacklo_epi16(outer, outer), 16));
+    hi = _mm_add_epi32(hi, _mm_srai_epi32(_mm_unpackhi_epi16(outer, outer), 16));
+    lo = _mm_srai_epi32(_mm_add_epi32(lo, _mm_set1_epi32(512)), 10);
+    hi = _mm_srai_epi32(_mm_add_epi32(hi, _mm_set1_epi32(512)), 10);
+    lo = _mm_packs_epi32(lo, hi);
+    return _mm_packus_epi16(lo, lo);
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: InterpolateLumaSse2
+
+        Functional description:
+          SSE2 version of the luma interpolation done by the
+          h264bsdInterpolate* functions, for partitions 8 or 16 pixels wide.
+          Produces the same output for all fractional sample positions.
+          Overfilling is done if the 6-tap window of the partition does not
+          fit in the reference picture.
+
+------------------------------------------------------------------------------*/
+
+static void InterpolateLumaSse2(
+  u8 *ref,
+  u8 *mb,
+  i32 xInt,
+  i32 yInt,
+  u32 width,
+  u32 height,
+  u32 partWidth,
+  u32 partHeight,
+  u32 xFrac,
+  u32 yFrac)
+{
+    u8 p1[21*21];
+    i16 table[21*16];
+    u32 x, y;
+    i32 x0 = xInt - 2;
+    i32 y0 = yInt - 2;
+    u8 *ptr;
+    __m128i pred, avg;
+
+    /* Code */
+
+    ASSERT(ref);
+    ASSERT(mb);
+    ASSERT(partWidth == 8 || partWidth == 16);
+
+    if ((x0 < 0) || ((u32)x0+partWidth+5 > width) ||
+        (y0 < 0) || ((u32)y0+partHeight+5 > height))
+    {
+        h264bsdFillBlock(ref, p1, x0, y0, width, height,
+                partWidth+5, partHeight+5, partWidth+5);
+
+        x0 = 0;
+        y0 = 0;
+        ref = p1;
+        width = partWidth+5;
+    }
+
+    /* ref points to G + (-2, -2) */
+    ref += (u32)y0 * width + (u32)x0;
+
+    /* 'j' and the positions averaged with it need the horizontal
+     * intermediate values of every row of the 6-tap window */
+    if (xFrac && yFrac && (xFrac == 2 || yFrac == 2))
+    {
+        for (y = 0; y < partHeight + 5; y++)
+        {
+            for (x = 0; x < partWidth; x += 8)
+                _mm_storeu_si128((__m128i*)(table + 16*y + x),
+                    HorTaps8Sse2(ref + y*width + x));
+        }
+    }
+
+    for (y = 0; y < partHeight; y++)
+    {
+        /* ptr points to G of the current row */
+        ptr = ref + (y+2)*width + 2;
+
+        for (x = 0; x < partWidth; x += 8)
+        {
+            if (yFrac == 0)
+            {
+                if (xFrac == 0) /* G */
+                    pred = _mm_loadl_epi64((const __m128i*)(ptr+x));
+                else
+                {
+                    /* a, b, c */
+                    pred = Round8Sse2(HorTaps8Sse2(ptr+x-2));
+                    if (xFrac != 2)
+                    {
+                        avg = _mm_loadl_epi64(
+                            (const __m128i*)(ptr+x+(xFrac>>1)));
+                        pred = _mm_avg_epu8(pred, avg);
+                    }
+                }
+            }
+            else if (xFrac == 0)
+            {
+                /* d, h, n */
+                pred = Round8Sse2(VerTaps8Sse2(ptr+x-2*width, width));
+                if (yFrac != 2)
+                {
+                    avg = _mm_loadl_epi64(
+                        (const __m128i*)(ptr+x+(yFrac>>1)*width));
+                    pred = _mm_avg_epu8(pred, avg);
+                }
+            }
+            else if (xFrac == 2)
+            {
+                /* f, j, q */
+                pred = MidTaps8Sse2(table + 16*y + x);
+                if (yFrac != 2)
+                {
+                    avg = Round8Sse2(_mm_loadu_si128((const __m128i*)
+                        (table + 16*(y+2+(yFrac>>1)) + x)));
+                    pred = _mm_avg_epu8(pred, avg);
+                }
+            }
+            else if (yFrac == 2)
+            {
+                /* i, k */
+                pred = MidTaps8Sse2(table + 16*y + x);
+                avg = Round8Sse2(VerTaps8Sse2(
+                    ptr+x+(xFrac>>1)-2*width, width));
+                pred = _mm_avg_epu8(pred, avg);
+            }
+            else
+            {
+                /* e, g, p, r */
+                pred = Round8Sse2(HorTaps8Sse2(ptr+x-2+(yFrac>>1)*width));
+                avg = Round8Sse2(VerTaps8Sse2(
+                    ptr+x+(xFrac>>1)-2*width, width));
+                pred = _mm_avg_epu8(pred, avg);
+            }
+
+            _mm_storel_epi64((__m128i*)(mb + x), pred);
+        }
+        mb += 16;
+    }
+
+}
+#endif /* H264DEC_SSE2 */
+
 
 /*------------------------------------------------------------------------------
 
@@ -1858,6 +2081,12 @@ void h264bsdPredictSamples(
 
     ASSERT(lumaFracPos[xFrac][yFrac] < 16);
 
+#ifdef H264DEC_SSE2
+    if (partWidth >= 8)
+        InterpolateLumaSse2(refPic->data, lumaPartData, xInt, yInt,
+                width, height, partWidth, partHeight, xFrac, yFrac);
+    else
+#endif /* H264DEC_SSE2 */
     switch (lumaFracPos[xFrac][yFrac])
     {
         case 0: /* G */
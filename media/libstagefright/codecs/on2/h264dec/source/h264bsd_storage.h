@@ -146,6 +146,11 @@ typedef struct
                               HEADERS_RDY to the user */
     u32 intraConcealmentFlag; /* 0 gray picture for corrupted intra
                                  1 previous frame used if available */
+
+    /* number of threads set by the application, deblocking is done in
+     * numThreads - 1 worker threads (h264bsd_filter_threads.c) */
+    u32 numThreads;
+    struct filterThreads *filterThreads;
 } storage_t;
 
 /*------------------------------------------------------------------------------
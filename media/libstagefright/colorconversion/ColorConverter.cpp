@@ -21,17 +21,52 @@
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/ColorConverter.h>
 #include <media/stagefright/MediaErrors.h>
+#include <utils/threads.h>
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace android {
 
+// Describes where to find the pixels of every row of the crop rectangle
+// for the 4:2:0 formats, rows 2n and 2n + 1 share a chroma row.
+struct ColorConverter::YUV420Rows {
+    const uint8_t *mY;
+    size_t mYStride;
+
+    const uint8_t *mU;
+    const uint8_t *mV;
+    size_t mChromaStride;
+    size_t mChromaStep;  // 1 for planar, 2 for interleaved chroma
+
+    uint16_t *mDst;
+    size_t mDstStride;
+
+    size_t mWidth;
+    bool mSwapRB;
+    const uint8_t *mClip;
+};
+
 ColorConverter::ColorConverter(
         OMX_COLOR_FORMATTYPE from, OMX_COLOR_FORMATTYPE to)
     : mSrcFormat(from),
       mDstFormat(to),
-      mClip(NULL) {
+      mClip(NULL),
+      mMaxThreads(0),
+      mWorkers(NULL) {
 }
 
 ColorConverter::~ColorConverter() {
+    delete mWorkers;
+    mWorkers = NULL;
+
     delete[] mClip;
     mClip = NULL;
 }
@@ -204,95 +239,63 @@ status_t ColorConverter::convertYUV420Planar(
         return ERROR_UNSUPPORTED;
     }
 
-    uint8_t *kAdjustedClip = initClip();
-
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
-
-    const uint8_t *src_y =
+    YUV420Rows rows;
+    rows.mY =
         (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
+    rows.mYStride = src.mWidth;
 
-    const uint8_t *src_u =
-        (const uint8_t *)src_y + src.mWidth * src.mHeight
+    rows.mU =
+        rows.mY + src.mWidth * src.mHeight
         + src.mCropTop * (src.mWidth / 2) + src.mCropLeft / 2;
+    rows.mV = rows.mU + (src.mWidth / 2) * (src.mHeight / 2);
+    rows.mChromaStride = src.mWidth / 2;
+    rows.mChromaStep = 1;
 
-    const uint8_t *src_v =
-        src_u + (src.mWidth / 2) * (src.mHeight / 2);
+    rows.mDst = (uint16_t *)dst.mBits + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+    rows.mDstStride = dst.mWidth;
+    rows.mWidth = src.cropWidth();
+    rows.mSwapRB = false;
+    rows.mClip = initClip();
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            // B = 1.164 * (Y - 16) + 2.018 * (U - 128)
-            // G = 1.164 * (Y - 16) - 0.813 * (V - 128) - 0.391 * (U - 128)
-            // R = 1.164 * (Y - 16) + 1.596 * (V - 128)
-
-            // B = 298/256 * (Y - 16) + 517/256 * (U - 128)
-            // G = .................. - 208/256 * (V - 128) - 100/256 * (U - 128)
-            // R = .................. + 409/256 * (V - 128)
-
-            // min_B = (298 * (- 16) + 517 * (- 128)) / 256 = -277
-            // min_G = (298 * (- 16) - 208 * (255 - 128) - 100 * (255 - 128)) / 256 = -172
-            // min_R = (298 * (- 16) + 409 * (- 128)) / 256 = -223
-
-            // max_B = (298 * (255 - 16) + 517 * (255 - 128)) / 256 = 534
-            // max_G = (298 * (255 - 16) - 208 * (- 128) - 100 * (- 128)) / 256 = 432
-            // max_R = (298 * (255 - 16) + 409 * (255 - 128)) / 256 = 481
-
-            // clip range -278 .. 535
+    convertRowBands(rows, src.cropHeight());
 
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed u = (signed)src_u[x / 2] - 128;
-            signed v = (signed)src_v[x / 2] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[r1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[b1] >> 3);
+    return OK;
+}
 
-            uint32_t rgb2 =
-                ((kAdjustedClip[r2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[b2] >> 3);
+status_t ColorConverter::convertQCOMYUV420SemiPlanar(
+        const BitmapParams &src, const BitmapParams &dst) {
+    if (!((src.mCropLeft & 1) == 0
+            && src.cropWidth() == dst.cropWidth()
+            && src.cropHeight() == dst.cropHeight())) {
+        return ERROR_UNSUPPORTED;
+    }
 
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
+    YUV420Rows rows;
+    rows.mY =
+        (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
+    rows.mYStride = src.mWidth;
 
-        src_y += src.mWidth;
+    rows.mU =
+        rows.mY + src.mWidth * src.mHeight
+        + src.mCropTop * src.mWidth + src.mCropLeft;
+    rows.mV = rows.mU + 1;
+    rows.mChromaStride = src.mWidth;
+    rows.mChromaStep = 2;
 
-        if (y & 1) {
-            src_u += src.mWidth / 2;
-            src_v += src.mWidth / 2;
-        }
+    rows.mDst = (uint16_t *)dst.mBits + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+    rows.mDstStride = dst.mWidth;
+    rows.mWidth = src.cropWidth();
+    rows.mSwapRB = true;
+    rows.mClip = initClip();
 
-        dst_ptr += dst.mWidth;
-    }
+    convertRowBands(rows, src.cropHeight());
 
     return OK;
 }
 
-status_t ColorConverter::convertQCOMYUV420SemiPlanar(
+status_t ColorConverter::convertYUV420SemiPlanar(
         const BitmapParams &src, const BitmapParams &dst) {
-    uint8_t *kAdjustedClip = initClip();
+    // XXX Untested
 
     if (!((src.mCropLeft & 1) == 0
             && src.cropWidth() == dst.cropWidth()
@@ -300,97 +303,96 @@ status_t ColorConverter::convertQCOMYUV420SemiPlanar(
         return ERROR_UNSUPPORTED;
     }
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
-
-    const uint8_t *src_y =
+    YUV420Rows rows;
+    rows.mY =
         (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
+    rows.mYStride = src.mWidth;
 
-    const uint8_t *src_u =
-        (const uint8_t *)src_y + src.mWidth * src.mHeight
+    rows.mV =
+        rows.mY + src.mWidth * src.mHeight
         + src.mCropTop * src.mWidth + src.mCropLeft;
+    rows.mU = rows.mV + 1;
+    rows.mChromaStride = src.mWidth;
+    rows.mChromaStep = 2;
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
+    rows.mDst = (uint16_t *)dst.mBits + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+    rows.mDstStride = dst.mWidth;
+    rows.mWidth = src.cropWidth();
+    rows.mSwapRB = true;
+    rows.mClip = initClip();
 
-            signed u = (signed)src_u[x & ~1] - 128;
-            signed v = (signed)src_u[(x & ~1) + 1] - 128;
+    convertRowBands(rows, src.cropHeight());
 
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[b1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[r1] >> 3);
+    return OK;
+}
 
-            uint32_t rgb2 =
-                ((kAdjustedClip[b2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[r2] >> 3);
+status_t ColorConverter::convertTIYUV420PackedSemiPlanar(
+        const BitmapParams &src, const BitmapParams &dst) {
+    if (!((src.mCropLeft & 1) == 0
+            && src.cropWidth() == dst.cropWidth()
+            && src.cropHeight() == dst.cropHeight())) {
+        return ERROR_UNSUPPORTED;
+    }
 
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
+    YUV420Rows rows;
+    rows.mY = (const uint8_t *)src.mBits;
+    rows.mYStride = src.mWidth;
 
-        src_y += src.mWidth;
+    rows.mU = rows.mY + src.mWidth * (src.mHeight - src.mCropTop / 2);
+    rows.mV = rows.mU + 1;
+    rows.mChromaStride = src.mWidth;
+    rows.mChromaStep = 2;
 
-        if (y & 1) {
-            src_u += src.mWidth;
-        }
+    rows.mDst = (uint16_t *)dst.mBits + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+    rows.mDstStride = dst.mWidth;
+    rows.mWidth = src.cropWidth();
+    rows.mSwapRB = false;
+    rows.mClip = initClip();
 
-        dst_ptr += dst.mWidth;
-    }
+    convertRowBands(rows, src.cropHeight());
 
     return OK;
 }
 
-status_t ColorConverter::convertYUV420SemiPlanar(
-        const BitmapParams &src, const BitmapParams &dst) {
-    // XXX Untested
+// static
+void ColorConverter::convertRows(
+        const YUV420Rows &rows, size_t rowBegin, size_t rowEnd) {
+    for (size_t y = rowBegin; y < rowEnd; ++y) {
+        const uint8_t *src_y = rows.mY + y * rows.mYStride;
+        const uint8_t *src_u = rows.mU + (y / 2) * rows.mChromaStride;
+        const uint8_t *src_v = rows.mV + (y / 2) * rows.mChromaStride;
+        uint16_t *dst_ptr = rows.mDst + y * rows.mDstStride;
 
-    uint8_t *kAdjustedClip = initClip();
+        size_t x = convertRowVector(
+                src_y, src_u, src_v, rows.mChromaStep, rows.mSwapRB,
+                dst_ptr, rows.mWidth);
 
-    if (!((src.mCropLeft & 1) == 0
-            && src.cropWidth() == dst.cropWidth()
-            && src.cropHeight() == dst.cropHeight())) {
-        return ERROR_UNSUPPORTED;
-    }
+        const uint8_t *kAdjustedClip = rows.mClip;
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+        for (; x < rows.mWidth; x += 2) {
+            // B = 1.164 * (Y - 16) + 2.018 * (U - 128)
+            // G = 1.164 * (Y - 16) - 0.813 * (V - 128) - 0.391 * (U - 128)
+            // R = 1.164 * (Y - 16) + 1.596 * (V - 128)
 
-    const uint8_t *src_y =
-        (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
+            // B = 298/256 * (Y - 16) + 517/256 * (U - 128)
+            // G = .................. - 208/256 * (V - 128) - 100/256 * (U - 128)
+            // R = .................. + 409/256 * (V - 128)
 
-    const uint8_t *src_u =
-        (const uint8_t *)src_y + src.mWidth * src.mHeight
-        + src.mCropTop * src.mWidth + src.mCropLeft;
+            // min_B = (298 * (- 16) + 517 * (- 128)) / 256 = -277
+            // min_G = (298 * (- 16) - 208 * (255 - 128) - 100 * (255 - 128)) / 256 = -172
+            // min_R = (298 * (- 16) + 409 * (- 128)) / 256 = -223
+
+            // max_B = (298 * (255 - 16) + 517 * (255 - 128)) / 256 = 534
+            // max_G = (298 * (255 - 16) - 208 * (- 128) - 100 * (- 128)) / 256 = 432
+            // max_R = (298 * (255 - 16) + 409 * (255 - 128)) / 256 = 481
+
+            // clip range -278 .. 535
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
             signed y1 = (signed)src_y[x] - 16;
             signed y2 = (signed)src_y[x + 1] - 16;
 
-            signed v = (signed)src_u[x & ~1] - 128;
-            signed u = (signed)src_u[(x & ~1) + 1] - 128;
+            signed u = (signed)src_u[(x / 2) * rows.mChromaStep] - 128;
+            signed v = (signed)src_v[(x / 2) * rows.mChromaStep] - 128;
 
             signed u_b = u * 517;
             signed u_g = -u * 100;
@@ -407,103 +409,363 @@ status_t ColorConverter::convertYUV420SemiPlanar(
             signed g2 = (tmp2 + v_g + u_g) / 256;
             signed r2 = (tmp2 + v_r) / 256;
 
+            if (rows.mSwapRB) {
+                signed tmp = r1;
+                r1 = b1;
+                b1 = tmp;
+
+                tmp = r2;
+                r2 = b2;
+                b2 = tmp;
+            }
+
             uint32_t rgb1 =
-                ((kAdjustedClip[b1] >> 3) << 11)
+                ((kAdjustedClip[r1] >> 3) << 11)
                 | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[r1] >> 3);
+                | (kAdjustedClip[b1] >> 3);
 
             uint32_t rgb2 =
-                ((kAdjustedClip[b2] >> 3) << 11)
+                ((kAdjustedClip[r2] >> 3) << 11)
                 | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[r2] >> 3);
+                | (kAdjustedClip[b2] >> 3);
 
-            if (x + 1 < src.cropWidth()) {
+            if (x + 1 < rows.mWidth) {
                 *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
             } else {
                 dst_ptr[x] = rgb1;
             }
         }
+    }
+}
 
-        src_y += src.mWidth;
+// Converts the longest prefix of the row that is a multiple of 8 pixels
+// and returns its length. Results are identical to the scalar loop: the
+// vector code rounds towards -infinity instead of zero before clipping,
+// which only differs for values that clip to 0 anyway.
+// static
+size_t ColorConverter::convertRowVector(
+        const uint8_t *src_y, const uint8_t *src_u, const uint8_t *src_v,
+        size_t chromaStep, bool swapRB, uint16_t *dst_ptr, size_t width) {
+    size_t x = 0;
+
+#if defined(__ARM_NEON__)
+    const uint8_t *src_uv = src_u < src_v ? src_u : src_v;
+    const bool vFirst = src_v < src_u;
+
+    for (; x + 8 <= width; x += 8) {
+        int16x8_t y = vreinterpretq_s16_u16(
+                vsubl_u8(vld1_u8(src_y + x), vdup_n_u8(16)));
+
+        int16x4_t u4, v4;
+        if (chromaStep == 1) {
+            uint32_t u32, v32;
+            memcpy(&u32, src_u + x / 2, sizeof(u32));
+            memcpy(&v32, src_v + x / 2, sizeof(v32));
+            u4 = vget_low_s16(vreinterpretq_s16_u16(vsubl_u8(
+                    vreinterpret_u8_u32(vdup_n_u32(u32)), vdup_n_u8(128))));
+            v4 = vget_low_s16(vreinterpretq_s16_u16(vsubl_u8(
+                    vreinterpret_u8_u32(vdup_n_u32(v32)), vdup_n_u8(128))));
+        } else {
+            uint16x4_t uv = vreinterpret_u16_u8(vld1_u8(src_uv + x));
+            int16x4_t lo = vsub_s16(vreinterpret_s16_u16(
+                    vand_u16(uv, vdup_n_u16(0xff))), vdup_n_s16(128));
+            int16x4_t hi = vsub_s16(vreinterpret_s16_u16(
+                    vshr_n_u16(uv, 8)), vdup_n_s16(128));
+            u4 = vFirst ? hi : lo;
+            v4 = vFirst ? lo : hi;
+        }
 
-        if (y & 1) {
-            src_u += src.mWidth;
+        // Each chroma sample covers two horizontally adjacent pixels.
+        int16x4x2_t uu = vzip_s16(u4, u4);
+        int16x4x2_t vv = vzip_s16(v4, v4);
+
+        int32x4_t tmp_lo = vmull_n_s16(vget_low_s16(y), 298);
+        int32x4_t tmp_hi = vmull_n_s16(vget_high_s16(y), 298);
+
+        int32x4_t b_lo = vmlal_n_s16(tmp_lo, uu.val[0], 517);
+        int32x4_t b_hi = vmlal_n_s16(tmp_hi, uu.val[1], 517);
+        int32x4_t g_lo = vmlal_n_s16(
+                vmlal_n_s16(tmp_lo, uu.val[0], -100), vv.val[0], -208);
+        int32x4_t g_hi = vmlal_n_s16(
+                vmlal_n_s16(tmp_hi, uu.val[1], -100), vv.val[1], -208);
+        int32x4_t r_lo = vmlal_n_s16(tmp_lo, vv.val[0], 409);
+        int32x4_t r_hi = vmlal_n_s16(tmp_hi, vv.val[1], 409);
+
+        uint8x8_t b = vqmovun_s16(vcombine_s16(
+                vshrn_n_s32(b_lo, 8), vshrn_n_s32(b_hi, 8)));
+        uint8x8_t g = vqmovun_s16(vcombine_s16(
+                vshrn_n_s32(g_lo, 8), vshrn_n_s32(g_hi, 8)));
+        uint8x8_t r = vqmovun_s16(vcombine_s16(
+                vshrn_n_s32(r_lo, 8), vshrn_n_s32(r_hi, 8)));
+
+        uint16x8_t rgb = vshll_n_u8(swapRB ? b : r, 8);
+        rgb = vsriq_n_u16(rgb, vshll_n_u8(g, 8), 5);
+        rgb = vsriq_n_u16(rgb, vshll_n_u8(swapRB ? r : b, 8), 11);
+
+        vst1q_u16(dst_ptr + x, rgb);
+    }
+#elif defined(__SSE2__)
+    const uint8_t *src_uv = src_u < src_v ? src_u : src_v;
+    const bool vFirst = src_v < src_u;
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i max = _mm_set1_epi16(255);
+    const __m128i kB = _mm_set_epi16(517, 298, 517, 298, 517, 298, 517, 298);
+    const __m128i kG = _mm_set_epi16(2, 298, 2, 298, 2, 298, 2, 298);
+    const __m128i kR = _mm_set_epi16(409, 298, 409, 298, 409, 298, 409, 298);
+
+    for (; x + 8 <= width; x += 8) {
+        __m128i y = _mm_sub_epi16(
+                _mm_unpacklo_epi8(
+                    _mm_loadl_epi64((const __m128i *)(src_y + x)), zero),
+                _mm_set1_epi16(16));
+
+        __m128i u, v;
+        if (chromaStep == 1) {
+            uint32_t u32, v32;
+            memcpy(&u32, src_u + x / 2, sizeof(u32));
+            memcpy(&v32, src_v + x / 2, sizeof(v32));
+            u = _mm_unpacklo_epi8(_mm_cvtsi32_si128(u32), zero);
+            v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(v32), zero);
+        } else {
+            __m128i uv = _mm_loadl_epi64((const __m128i *)(src_uv + x));
+            __m128i lo = _mm_and_si128(uv, _mm_set1_epi16(0xff));
+            __m128i hi = _mm_srli_epi16(uv, 8);
+            u = vFirst ? hi : lo;
+            v = vFirst ? lo : hi;
         }
 
-        dst_ptr += dst.mWidth;
+        // Each chroma sample covers two horizontally adjacent pixels.
+        u = _mm_sub_epi16(_mm_unpacklo_epi16(u, u), _mm_set1_epi16(128));
+        v = _mm_sub_epi16(_mm_unpacklo_epi16(v, v), _mm_set1_epi16(128));
+
+        // G's chroma term is halved to fit in 16 bits and doubled in madd.
+        __m128i c = _mm_add_epi16(
+                _mm_mullo_epi16(u, _mm_set1_epi16(-50)),
+                _mm_mullo_epi16(v, _mm_set1_epi16(-104)));
+
+        __m128i b = _mm_packs_epi32(
+                _mm_srai_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(y, u), kB), 8),
+                _mm_srai_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(y, u), kB), 8));
+        __m128i g = _mm_packs_epi32(
+                _mm_srai_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(y, c), kG), 8),
+                _mm_srai_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(y, c), kG), 8));
+        __m128i r = _mm_packs_epi32(
+                _mm_srai_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(y, v), kR), 8),
+                _mm_srai_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(y, v), kR), 8));
+
+        b = _mm_min_epi16(_mm_max_epi16(b, zero), max);
+        g = _mm_min_epi16(_mm_max_epi16(g, zero), max);
+        r = _mm_min_epi16(_mm_max_epi16(r, zero), max);
+
+        __m128i rgb = _mm_or_si128(
+                _mm_or_si128(
+                    _mm_slli_epi16(_mm_srli_epi16(swapRB ? b : r, 3), 11),
+                    _mm_slli_epi16(_mm_srli_epi16(g, 2), 5)),
+                _mm_srli_epi16(swapRB ? r : b, 3));
+
+        _mm_storeu_si128((__m128i *)(dst_ptr + x), rgb);
     }
+#endif
 
-    return OK;
+    return x;
 }
 
-status_t ColorConverter::convertTIYUV420PackedSemiPlanar(
-        const BitmapParams &src, const BitmapParams &dst) {
-    uint8_t *kAdjustedClip = initClip();
+struct ColorConverter::RowBand {
+    const YUV420Rows *mRows;
+    size_t mRowBegin;
+    size_t mRowEnd;
+};
+
+// Threads that each convert one band of every frame that is split, the
+// calling thread converts the first band itself.
+struct ColorConverter::WorkerPool {
+    WorkerPool(size_t numThreads);
+    ~WorkerPool();
+
+    // The number of threads asked for, and the number that actually started.
+    size_t requestedThreads() const { return mRequestedThreads; }
+    size_t numThreads() const { return mNumThreads; }
+
+    // Returns once all numBands bands, at most numThreads() + 1, are done.
+    void run(const RowBand *bands, size_t numBands);
+
+private:
+    struct Worker {
+        WorkerPool *mPool;
+        size_t mBandIndex;
+    };
+
+    Mutex mLock;
+    Condition mWorkAvailable;
+    Condition mWorkDone;
+
+    const RowBand *mBands;
+    size_t mNumBands;
+    size_t mPending;
+    uint32_t mGeneration;
+    bool mExit;
+
+    pthread_t mThreads[kMaxThreads];
+    Worker mWorkers[kMaxThreads];
+    size_t mRequestedThreads;
+    size_t mNumThreads;
+
+    static void *ThreadWrapper(void *me);
+    void threadEntry(size_t bandIndex);
+
+    WorkerPool(const WorkerPool &);
+    WorkerPool &operator=(const WorkerPool &);
+};
+
+ColorConverter::WorkerPool::WorkerPool(size_t numThreads)
+    : mBands(NULL),
+      mNumBands(0),
+      mPending(0),
+      mGeneration(0),
+      mExit(false),
+      mRequestedThreads(numThreads),
+      mNumThreads(0) {
+    for (size_t i = 0; i < numThreads && i + 1 < kMaxThreads; ++i) {
+        mWorkers[i].mPool = this;
+        mWorkers[i].mBandIndex = i + 1;
+
+        if (pthread_create(
+                    &mThreads[i], NULL, ThreadWrapper, &mWorkers[i]) != 0) {
+            ALOGW("failed to start color conversion thread");
+            break;
+        }
 
-    if (!((src.mCropLeft & 1) == 0
-            && src.cropWidth() == dst.cropWidth()
-            && src.cropHeight() == dst.cropHeight())) {
-        return ERROR_UNSUPPORTED;
+        ++mNumThreads;
     }
+}
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+ColorConverter::WorkerPool::~WorkerPool() {
+    {
+        Mutex::Autolock autoLock(mLock);
+        mExit = true;
+        mWorkAvailable.broadcast();
+    }
 
-    const uint8_t *src_y = (const uint8_t *)src.mBits;
+    for (size_t i = 0; i < mNumThreads; ++i) {
+        pthread_join(mThreads[i], NULL);
+    }
+}
 
-    const uint8_t *src_u =
-        (const uint8_t *)src_y + src.mWidth * (src.mHeight - src.mCropTop / 2);
+// static
+void *ColorConverter::WorkerPool::ThreadWrapper(void *me) {
+    Worker *worker = static_cast<Worker *>(me);
+    worker->mPool->threadEntry(worker->mBandIndex);
+    return NULL;
+}
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
+void ColorConverter::WorkerPool::threadEntry(size_t bandIndex) {
+    uint32_t generation = 0;
 
-            signed u = (signed)src_u[x & ~1] - 128;
-            signed v = (signed)src_u[(x & ~1) + 1] - 128;
+    Mutex::Autolock autoLock(mLock);
 
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
+    for (;;) {
+        while (!mExit && mGeneration == generation) {
+            mWorkAvailable.wait(mLock);
+        }
 
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
+        if (mExit) {
+            break;
+        }
 
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
+        generation = mGeneration;
 
-            uint32_t rgb1 =
-                ((kAdjustedClip[r1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[b1] >> 3);
+        if (bandIndex >= mNumBands) {
+            continue;
+        }
 
-            uint32_t rgb2 =
-                ((kAdjustedClip[r2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[b2] >> 3);
+        const RowBand &band = mBands[bandIndex];
 
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
+        mLock.unlock();
+        convertRows(*band.mRows, band.mRowBegin, band.mRowEnd);
+        mLock.lock();
+
+        if (--mPending == 0) {
+            mWorkDone.signal();
         }
+    }
+}
+
+void ColorConverter::WorkerPool::run(const RowBand *bands, size_t numBands) {
+    CHECK_LE(numBands, mNumThreads + 1);
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        mBands = bands;
+        mNumBands = numBands;
+        mPending = numBands - 1;
+        ++mGeneration;
+        mWorkAvailable.broadcast();
+    }
+
+    convertRows(*bands[0].mRows, bands[0].mRowBegin, bands[0].mRowEnd);
+
+    Mutex::Autolock autoLock(mLock);
+    while (mPending > 0) {
+        mWorkDone.wait(mLock);
+    }
+}
 
-        src_y += src.mWidth;
+void ColorConverter::convertRowBands(const YUV420Rows &rows, size_t height) {
+    size_t numBands = 1;
 
-        if (y & 1) {
-            src_u += src.mWidth;
+    size_t maxBands = mMaxThreads;
+    if (maxBands == 0) {
+        long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+        maxBands = numCpus > 0 ? numCpus : 1;
+        if (maxBands > kMaxAutoThreads) {
+            maxBands = kMaxAutoThreads;
         }
+    } else if (maxBands > kMaxThreads) {
+        maxBands = kMaxThreads;
+    }
 
-        dst_ptr += dst.mWidth;
+    // Frames below the threshold aren't worth waking up other threads for.
+    size_t numPixels = rows.mWidth * height;
+    if (maxBands > 1 && numPixels >= 2 * kMinPixelsPerThread) {
+        numBands = numPixels / kMinPixelsPerThread;
+        if (numBands > maxBands) {
+            numBands = maxBands;
+        }
+        if (numBands > height) {
+            numBands = height;
+        }
     }
 
-    return OK;
+    if (numBands > 1
+            && (mWorkers == NULL
+                || mWorkers->requestedThreads() + 1 < maxBands)) {
+        // Sized for the largest split, so that it is started only once.
+        delete mWorkers;
+        mWorkers = new WorkerPool(maxBands - 1);
+    }
+
+    if (numBands > 1 && numBands > mWorkers->numThreads() + 1) {
+        numBands = mWorkers->numThreads() + 1;
+    }
+
+    if (numBands <= 1) {
+        convertRows(rows, 0, height);
+        return;
+    }
+
+    RowBand bands[kMaxThreads];
+    for (size_t i = 0; i < numBands; ++i) {
+        bands[i].mRows = &rows;
+        bands[i].mRowBegin = height * i / numBands;
+        bands[i].mRowEnd = height * (i + 1) / numBands;
+    }
+
+    mWorkers->run(bands, numBands);
+}
+
+void ColorConverter::setMaxThreads(size_t maxThreads) {
+    mMaxThreads = maxThreads;
 }
 
 uint8_t *ColorConverter::initClip() {
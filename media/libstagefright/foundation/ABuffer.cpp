@@ -20,6 +20,8 @@
 #include "ALooper.h"
 #include "AMessage.h"
 
+#include <media/stagefright/MediaBufferBase.h>
+
 namespace android {
 
 ABuffer::ABuffer(size_t capacity)
@@ -28,7 +30,8 @@ ABuffer::ABuffer(size_t capacity)
       mRangeOffset(0),
       mRangeLength(capacity),
       mInt32Data(0),
-      mOwnsData(true) {
+      mOwnsData(true),
+      mMediaBufferBase(NULL) {
 }
 
 ABuffer::ABuffer(void *data, size_t capacity)
@@ -37,7 +40,8 @@ ABuffer::ABuffer(void *data, size_t capacity)
       mRangeOffset(0),
       mRangeLength(capacity),
       mInt32Data(0),
-      mOwnsData(false) {
+      mOwnsData(false),
+      mMediaBufferBase(NULL) {
 }
 
 ABuffer::~ABuffer() {
@@ -48,6 +52,8 @@ ABuffer::~ABuffer() {
         }
     }
 
+    setMediaBufferBase(NULL);
+
     if (mFarewell != NULL) {
         mFarewell->post();
     }
@@ -65,6 +71,13 @@ void ABuffer::setFarewellMessage(const sp<AMessage> msg) {
     mFarewell = msg;
 }
 
+void ABuffer::setMediaBufferBase(MediaBufferBase *mediaBuffer) {
+    if (mMediaBufferBase != NULL) {
+        mMediaBufferBase->release();
+    }
+    mMediaBufferBase = mediaBuffer;
+}
+
 sp<AMessage> ABuffer::meta() {
     if (mMeta == NULL) {
         mMeta = new AMessage;
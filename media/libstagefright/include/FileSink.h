@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FILE_SINK_H_
+
+#define FILE_SINK_H_
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/Errors.h>
+#include <utils/List.h>
+#include <utils/RefBase.h>
+#include <utils/String8.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+// Output destination of a MediaWriter. Data is always written at the
+// current position, which advances by the number of bytes written.
+// The sink never takes ownership of the file descriptor.
+struct FileSink : public RefBase {
+    FileSink() {}
+
+    virtual status_t initCheck() const = 0;
+
+    virtual ssize_t writev(const struct iovec *iov, int iovcnt) = 0;
+    ssize_t write(const void *data, size_t size);
+
+    virtual status_t seek(off64_t offset) = 0;
+    virtual off64_t position() const = 0;
+
+    // Hints that the file is expected to grow by roughly "window" bytes
+    // at a time, sinks may use this to reserve storage ahead of writes.
+    virtual void setPreallocationWindow(off64_t window) {}
+
+    // Blocks until everything written so far has reached the file and
+    // returns the first error encountered, if any.
+    virtual status_t flush() = 0;
+
+    virtual void dump(String8 *result) const {}
+
+protected:
+    virtual ~FileSink() {}
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(FileSink);
+};
+
+// Issues one (vectored) write per call on the calling thread.
+struct DirectFileSink : public FileSink {
+    DirectFileSink(int fd);
+
+    virtual status_t initCheck() const;
+
+    virtual ssize_t writev(const struct iovec *iov, int iovcnt);
+
+    virtual status_t seek(off64_t offset);
+    virtual off64_t position() const;
+
+    virtual status_t flush();
+
+protected:
+    virtual ~DirectFileSink();
+
+private:
+    int mFd;
+    off64_t mPosition;
+    status_t mError;
+
+    DISALLOW_EVIL_CONSTRUCTORS(DirectFileSink);
+};
+
+// Copies data into a ring of large, page aligned blocks which a dedicated
+// thread writes out, so that the caller only blocks on storage if all
+// blocks are in flight.
+struct WriteBehindFileSink : public FileSink {
+    enum {
+        kDefaultBlockSize = 512 * 1024,
+        kDefaultNumBlocks = 8,
+    };
+
+    WriteBehindFileSink(
+            int fd,
+            size_t blockSize = kDefaultBlockSize,
+            size_t numBlocks = kDefaultNumBlocks);
+
+    virtual status_t initCheck() const;
+
+    virtual ssize_t writev(const struct iovec *iov, int iovcnt);
+
+    virtual status_t seek(off64_t offset);
+    virtual off64_t position() const;
+
+    virtual void setPreallocationWindow(off64_t window);
+
+    virtual status_t flush();
+
+    virtual void dump(String8 *result) const;
+
+protected:
+    virtual ~WriteBehindFileSink();
+
+private:
+    struct Block {
+        uint8_t *mData;
+        size_t mSize;
+        off64_t mOffset;
+    };
+
+    int mFd;
+    size_t mBlockSize;
+    status_t mInitCheck;
+
+    mutable Mutex mLock;
+    Condition mBlockQueued;
+    Condition mBlockWritten;
+
+    Vector<Block *> mBlocks;
+    List<Block *> mFreeBlocks;
+    List<Block *> mQueuedBlocks;
+    size_t mNumBlocksInFlight;
+
+    // Only accessed by the writing thread, never by the flush thread.
+    Block *mCurrentBlock;
+    off64_t mPosition;
+
+    bool mDone;
+    bool mThreadStarted;
+    pthread_t mThread;
+
+    status_t mError;
+
+    off64_t mInitialFileSize;
+    off64_t mHighestOffset;
+    // Guarded by mLock, only the flush thread grows the preallocation.
+    off64_t mPreallocationWindow;
+    off64_t mPreallocatedSize;
+
+    int64_t mNumBytesWritten;
+    int64_t mNumWriteCalls;
+    int64_t mNumCallerStalls;
+    int64_t mTotalStallTimeUs;
+
+    Block *acquireBlock_l();
+    void queueCurrentBlock();
+
+    void preallocate(off64_t end);
+    status_t writeBlock(const Block *block);
+
+    static void *ThreadWrapper(void *me);
+    void threadFunc();
+
+    DISALLOW_EVIL_CONSTRUCTORS(WriteBehindFileSink);
+};
+
+}  // namespace android
+
+#endif  // FILE_SINK_H_
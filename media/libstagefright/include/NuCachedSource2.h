@@ -59,6 +59,8 @@ struct NuCachedSource2 : public DataSource {
     status_t getEstimatedBandwidthKbps(int32_t *kbps);
     status_t setCacheStatCollectFreq(int32_t freqMs);
 
+    void dump(String8 *result) const;
+
     static void RemoveCacheSpecificHeaders(
             KeyedVector<String8, String8> *headers,
             String8 *cacheConfig,
@@ -75,6 +77,16 @@ private:
         kDefaultHighWaterThreshold      = 20 * 1024 * 1024,
         kDefaultLowWaterThreshold       = 4 * 1024 * 1024,
 
+        // Bounds for the water marks derived from the observed read and
+        // fetch rates, unless the client configured them explicitly.
+        kMinLowWaterThreshold           = 1 * 1024 * 1024,
+        kMaxLowWaterThreshold           = 8 * 1024 * 1024,
+        kMinPrefetchBytes               = 4 * 1024 * 1024,
+
+        // Data fetched earlier and outside of the current window is kept
+        // up to this size in case the reader seeks back into it.
+        kDefaultRetainedThreshold       = 8 * 1024 * 1024,
+
         // Read data after a 15 sec timeout whether we're actively
         // fetching or not.
         kDefaultKeepAliveIntervalUs     = 15000000,
@@ -115,6 +127,32 @@ private:
 
     bool mDisconnectAtHighwatermark;
 
+    size_t mRetainedThresholdBytes;
+
+    // End of the last read served from a retained range, or -1. Reset by
+    // any other read.
+    off64_t mRetainedReadPos;
+
+    // True if that read started where the previous retained read ended,
+    // only then does the idle prefetcher move to mRetainedReadPos.
+    bool mRetainedReadContinued;
+
+    // False if the water marks were configured explicitly.
+    bool mAdaptiveThresholds;
+    int64_t mReadBytesPerSec;
+    int64_t mFetchBytesPerSec;
+    int64_t mLastRateSampleTimeUs;
+    off64_t mLastRateSamplePos;
+
+    // Every byte range fetched so far, start -> end, to account for data
+    // that had been evicted and is fetched again.
+    KeyedVector<off64_t, off64_t> mFetchedRanges;
+
+    int64_t mNumReads;
+    int64_t mNumCacheHits;
+    int64_t mNumBytesFetched;
+    int64_t mNumBytesRefetched;
+
     void onMessageReceived(const sp<AMessage> &msg);
     void onFetch();
     void onRead(const sp<AMessage> &msg);
@@ -125,6 +163,9 @@ private:
 
     size_t approxDataRemaining_l(status_t *finalStatus) const;
 
+    void addFetchedRange_l(off64_t offset, size_t size);
+    void updateThresholds_l();
+
     void restartPrefetcherIfNecessary_l(
             bool ignoreLowWaterThreshold = false, bool force = false);
 
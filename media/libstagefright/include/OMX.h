@@ -103,8 +103,13 @@ public:
             const char *parameter_name,
             OMX_INDEXTYPE *index);
 
+    virtual status_t submitBuffers(
+            node_id node, const Vector<BufferCommand> &commands);
+
     virtual void binderDied(const wp<IBinder> &the_late_who);
 
+    virtual status_t dump(int fd, const Vector<String16> &args);
+
     OMX_ERRORTYPE OnEvent(
             node_id node,
             OMX_IN OMX_EVENTTYPE eEvent,
@@ -21,6 +21,7 @@
 #include "OMX.h"
 
 #include <utils/RefBase.h>
+#include <utils/String8.h>
 #include <utils/threads.h>
 
 namespace android {
@@ -30,7 +31,7 @@ struct OMXMaster;
 
 struct OMXNodeInstance {
     OMXNodeInstance(
-            OMX *owner, const sp<IOMXObserver> &observer);
+            OMX *owner, const sp<IOMXObserver> &observer, const char *name);
 
     void setHandle(OMX::node_id node_id, OMX_HANDLETYPE handle);
 
@@ -85,10 +86,14 @@ struct OMXNodeInstance {
     status_t getExtensionIndex(
             const char *parameterName, OMX_INDEXTYPE *index);
 
-    void onMessage(const omx_message &msg);
+    status_t submitBuffers(const Vector<IOMX::BufferCommand> &commands);
+
+    void onMessages(const List<omx_message> &messages);
     void onObserverDied(OMXMaster *master);
     void onGetHandleFailed();
 
+    void dump(String8 &result) const;
+
     static OMX_CALLBACKTYPE kCallbacks;
 
 private:
@@ -100,6 +105,17 @@ private:
     sp<IOMXObserver> mObserver;
     bool mDying;
 
+    String8 mName;
+
+    // Buffer statistics, reported by dump(). They have their own lock,
+    // which is never held across calls into the component, so that
+    // OMX::dump() can take it with OMX::mLock held.
+    mutable Mutex mStatsLock;
+    int32_t mNumZeroCopyBuffers;
+    int32_t mNumBackupBuffers;
+    int64_t mBytesCopiedToOMX;
+    int64_t mBytesCopiedFromOMX;
+
     struct ActiveBuffer {
         OMX_U32 mPortIndex;
         OMX::buffer_id mID;
@@ -111,6 +127,11 @@ private:
     void addActiveBuffer(OMX_U32 portIndex, OMX::buffer_id id);
     void removeActiveBuffer(OMX_U32 portIndex, OMX::buffer_id id);
     void freeActiveBuffers();
+    status_t fillBuffer_l(OMX::buffer_id buffer);
+    status_t emptyBuffer_l(
+            OMX::buffer_id buffer,
+            OMX_U32 rangeOffset, OMX_U32 rangeLength,
+            OMX_U32 flags, OMX_TICKS timestamp);
     status_t useGraphicBuffer2_l(
             OMX_U32 portIndex, const sp<GraphicBuffer> &graphicBuffer,
             OMX::buffer_id *buffer);
@@ -82,11 +82,20 @@ public:
 
     status_t findThumbnailSample(uint32_t *sample_index);
 
+    // Chunk offsets and sample sizes are loaded into a compact in-memory
+    // index on first use if it fits within this many bytes, otherwise
+    // they're read from the data source on demand. 0 disables the index.
+    // Affects SampleTables created after the call.
+    static void SetIndexMemoryBudget(size_t bytes);
+
 protected:
     ~SampleTable();
 
 private:
     struct CompositionDeltaLookup;
+    struct PackedArray;
+
+    static size_t sIndexMemoryBudget;
 
     static const uint32_t kChunkOffsetType32;
     static const uint32_t kChunkOffsetType64;
@@ -111,6 +120,11 @@ private:
     uint32_t mTimeToSampleCount;
     uint32_t *mTimeToSample;
 
+    // Index of the first sample and its decoding time for each entry in
+    // mTimeToSample.
+    uint64_t *mTimeToSampleFirstSample;
+    uint32_t *mTimeToSampleFirstTime;
+
     struct SampleTimeEntry {
         uint32_t mSampleIndex;
         uint32_t mCompositionTime;
@@ -135,11 +149,30 @@ private:
     };
     SampleToChunkEntry *mSampleToChunkEntries;
 
+    size_t mIndexMemoryBudget;
+    bool mIndexBuilt;
+    PackedArray *mChunkOffsetIndex;
+    PackedArray *mSampleSizeIndex;
+
     friend struct SampleIterator;
 
     status_t getSampleSize_l(uint32_t sample_index, size_t *sample_size);
     uint32_t getCompositionTimeOffset(uint32_t sampleIndex);
 
+    // Return false if the value is not available from the in-memory index
+    // and needs to be read from the data source.
+    bool getIndexedChunkOffset_l(uint32_t chunk, off64_t *offset);
+    bool getIndexedSampleSize_l(uint32_t sampleIndex, size_t *size);
+
+    // Returns the index of the time-to-sample entry covering "sampleIndex"
+    // or mTimeToSampleCount if there is none.
+    uint32_t findTimeToSampleEntry(uint32_t sampleIndex) const;
+
+    void buildIndex_l();
+    PackedArray *buildPackedArray(
+            off64_t offset, uint32_t count, uint32_t fieldBits,
+            size_t budget);
+
     static int CompareIncreasingTime(const void *, const void *);
 
     void buildSampleEntriesTable();
@@ -20,19 +20,23 @@
 
 #include <pthread.h>
 
-#include <utils/List.h>
 #include <utils/RefBase.h>
 #include <utils/threads.h>
+#include <utils/Vector.h>
 
 namespace android {
 
+// Pending events are kept in a binary heap ordered by their trigger time,
+// each event remembers its position in the heap so that it can be cancelled
+// without searching for it.
 struct TimedEventQueue {
 
     typedef int32_t event_id;
 
     struct Event : public RefBase {
         Event()
-            : mEventID(0) {
+            : mEventID(0),
+              mQueueIndex(0) {
         }
 
         virtual ~Event() {}
@@ -49,6 +53,10 @@ struct TimedEventQueue {
 
         event_id mEventID;
 
+        // Position in the heap while queued, only valid when the queued
+        // item carries the current event id.
+        size_t mQueueIndex;
+
         void setEventID(event_id id) {
             mEventID = id;
         }
@@ -86,7 +94,12 @@ struct TimedEventQueue {
     // removed from the queue and won't fire.
     bool cancelEvent(event_id id);
 
-    // Cancel any pending event that satisfies the predicate.
+    // Same as above for the event last posted as "event", this doesn't
+    // need to search the queue.
+    bool cancelEvent(const sp<Event> &event);
+
+    // Cancel any pending event that satisfies the predicate, the events
+    // are handed to the predicate in the order they would fire.
     // If stopAfterFirstMatch is true, only cancels the first event
     // satisfying the predicate (if any).
     void cancelEvents(
@@ -97,9 +110,18 @@ struct TimedEventQueue {
     static int64_t getRealTimeUs();
 
 private:
+    enum {
+        // An event due within this interval fires right away rather than
+        // after another wakeup, and posting an event that is due less
+        // than this before the pending wakeup doesn't wake the thread.
+        kWakeupSlackUs = 1000,
+    };
+
     struct QueueItem {
         sp<Event> event;
         int64_t realtime_us;
+        int64_t sequence;  // keeps events posted for the same time in order
+        event_id id;
     };
 
     struct StopEvent : public TimedEventQueue::Event {
@@ -109,11 +131,16 @@ private:
     };
 
     pthread_t mThread;
-    List<QueueItem> mQueue;
+    Vector<QueueItem> mQueue;
     Mutex mLock;
     Condition mQueueNotEmptyCondition;
     Condition mQueueHeadChangedCondition;
     event_id mNextEventID;
+    int64_t mNextSequence;
+
+    // The time the event thread is waiting for, INT64_MIN unless it
+    // is waiting for the head of the queue.
+    int64_t mWakeupTimeUs;
 
     bool mRunning;
     bool mStopped;
@@ -121,7 +148,14 @@ private:
     static void *ThreadWrapper(void *me);
     void threadEntry();
 
-    sp<Event> removeEventFromQueue_l(event_id id);
+    static bool IsEarlier(const QueueItem &a, const QueueItem &b);
+    static int CompareItems(const QueueItem *a, const QueueItem *b);
+
+    void setItem_l(size_t index, const QueueItem &item);
+    void siftUp_l(size_t index);
+    void siftDown_l(size_t index);
+    sp<Event> removeItem_l(size_t index);
+    ssize_t findItem_l(const QueueItem &item) const;
 
     TimedEventQueue(const TimedEventQueue &);
     TimedEventQueue &operator=(const TimedEventQueue &);
@@ -82,6 +82,12 @@ struct ATSParser::Program : public RefBase {
         return mParser->mFlags;
     }
 
+    bool borrowPayloads() const {
+        return mParser->mBorrowPayloads;
+    }
+
+    void copyBorrowedPayloads();
+
 private:
     ATSParser *mParser;
     unsigned mProgramNumber;
@@ -117,6 +123,8 @@ struct ATSParser::Stream : public RefBase {
 
     sp<MediaSource> getSource(SourceType type);
 
+    void copyBorrowedPayloads();
+
 protected:
     virtual ~Stream();
 
@@ -128,6 +136,12 @@ private:
     int32_t mExpectedContinuityCounter;
 
     sp<ABuffer> mBuffer;
+
+    // TS packet payloads making up the current PES packet that are still
+    // in the buffer handed to feedTSPackets(). mBuffer is empty while
+    // there are any.
+    Vector<struct iovec> mBorrowedPayloads;
+
     sp<AnotherPacketSource> mSource;
     bool mPayloadStarted;
 
@@ -136,11 +150,15 @@ private:
     ElementaryStreamQueue *mQueue;
 
     status_t flush();
-    status_t parsePES(ABitReader *br);
+    status_t parsePES(
+            ABitReader *br,
+            const struct iovec *moreData = NULL, size_t numMoreData = 0);
+
+    void appendToBuffer(const void *data, size_t size);
 
     void onPayloadData(
             unsigned PTS_DTS_flags, uint64_t PTS, uint64_t DTS,
-            const uint8_t *data, size_t size);
+            const struct iovec *iov, int iovcnt);
 
     void extractAACFrames(const sp<ABuffer> &buffer);
 
@@ -433,6 +451,12 @@ sp<MediaSource> ATSParser::Program::getSource(SourceType type) {
     return NULL;
 }
 
+void ATSParser::Program::copyBorrowedPayloads() {
+    for (size_t i = 0; i < mStreams.size(); ++i) {
+        mStreams.editValueAt(i)->copyBorrowedPayloads();
+    }
+}
+
 int64_t ATSParser::Program::convertPTSToTimestamp(uint64_t PTS) {
     if (!(mParser->mFlags & TS_TIMESTAMPS_ARE_ABSOLUTE)) {
         if (!mFirstPTSValid) {
@@ -532,6 +556,7 @@ status_t ATSParser::Stream::parse(
 
         mPayloadStarted = false;
         mBuffer->setRange(0, 0);
+        mBorrowedPayloads.clear();
         mExpectedContinuityCounter = -1;
 
         return OK;
@@ -562,7 +587,24 @@ status_t ATSParser::Stream::parse(
     size_t payloadSizeBits = br->numBitsLeft();
     CHECK_EQ(payloadSizeBits % 8, 0u);
 
-    size_t neededSize = mBuffer->size() + payloadSizeBits / 8;
+    if (mProgram->borrowPayloads() && mBuffer->size() == 0) {
+        // The packet stays valid until feedTSPackets() returns, remember
+        // where the payload is and copy it only once the PES is complete.
+        struct iovec payload;
+        payload.iov_base = const_cast<uint8_t *>(br->data());
+        payload.iov_len = payloadSizeBits / 8;
+        mBorrowedPayloads.push(payload);
+
+        return OK;
+    }
+
+    appendToBuffer(br->data(), payloadSizeBits / 8);
+
+    return OK;
+}
+
+void ATSParser::Stream::appendToBuffer(const void *data, size_t size) {
+    size_t neededSize = mBuffer->size() + size;
     if (mBuffer->capacity() < neededSize) {
         // Increment in multiples of 64K.
         neededSize = (neededSize + 65535) & ~65535;
@@ -575,10 +617,17 @@ status_t ATSParser::Stream::parse(
         mBuffer = newBuffer;
     }
 
-    memcpy(mBuffer->data() + mBuffer->size(), br->data(), payloadSizeBits / 8);
-    mBuffer->setRange(0, mBuffer->size() + payloadSizeBits / 8);
+    memcpy(mBuffer->data() + mBuffer->size(), data, size);
+    mBuffer->setRange(0, mBuffer->size() + size);
+}
 
-    return OK;
+void ATSParser::Stream::copyBorrowedPayloads() {
+    for (size_t i = 0; i < mBorrowedPayloads.size(); ++i) {
+        const struct iovec &payload = mBorrowedPayloads.itemAt(i);
+        appendToBuffer(payload.iov_base, payload.iov_len);
+    }
+
+    mBorrowedPayloads.clear();
 }
 
 bool ATSParser::Stream::isVideo() const {
@@ -617,6 +666,7 @@ void ATSParser::Stream::signalDiscontinuity(
 
     mPayloadStarted = false;
     mBuffer->setRange(0, 0);
+    mBorrowedPayloads.clear();
 
     bool clearFormat = false;
     if (isAudio()) {
@@ -655,7 +705,10 @@ void ATSParser::Stream::signalEOS(status_t finalResult) {
     }
 }
 
-status_t ATSParser::Stream::parsePES(ABitReader *br) {
+// "moreData" continues the PES packet beyond the end of "br", it is only
+// used for the payload, all of the header must be covered by "br".
+status_t ATSParser::Stream::parsePES(
+        ABitReader *br, const struct iovec *moreData, size_t numMoreData) {
     unsigned packet_startcode_prefix = br->getBits(24);
 
     ALOGV("packet_startcode_prefix = 0x%08x", packet_startcode_prefix);
@@ -784,35 +837,55 @@ status_t ATSParser::Stream::parsePES(ABitReader *br) {
 
         // ES data follows.
 
+        Vector<struct iovec> payload;
+        struct iovec iov;
+        iov.iov_base = const_cast<uint8_t *>(br->data());
+        iov.iov_len = br->numBitsLeft() / 8;
+        payload.push(iov);
+
+        size_t payloadSize = iov.iov_len;
+        for (size_t i = 0; i < numMoreData; ++i) {
+            payload.push(moreData[i]);
+            payloadSize += moreData[i].iov_len;
+        }
+
         if (PES_packet_length != 0) {
             CHECK_GE(PES_packet_length, PES_header_data_length + 3);
 
             unsigned dataLength =
                 PES_packet_length - 3 - PES_header_data_length;
 
-            if (br->numBitsLeft() < dataLength * 8) {
+            if (payloadSize < dataLength) {
                 ALOGE("PES packet does not carry enough data to contain "
                      "payload. (numBitsLeft = %d, required = %d)",
-                     br->numBitsLeft(), dataLength * 8);
+                     payloadSize * 8, dataLength * 8);
 
                 return ERROR_MALFORMED;
             }
 
-            CHECK_GE(br->numBitsLeft(), dataLength * 8);
+            // Drop whatever follows the payload.
+            size_t n = 0;
+            size_t size = 0;
+            while (size + payload.itemAt(n).iov_len < dataLength) {
+                size += payload.itemAt(n).iov_len;
+                ++n;
+            }
+            payload.editItemAt(n).iov_len = dataLength - size;
 
             onPayloadData(
-                    PTS_DTS_flags, PTS, DTS, br->data(), dataLength);
+                    PTS_DTS_flags, PTS, DTS, payload.array(), n + 1);
 
-            br->skipBits(dataLength * 8);
+            if (numMoreData == 0) {
+                br->skipBits(dataLength * 8);
+            }
         } else {
             onPayloadData(
-                    PTS_DTS_flags, PTS, DTS,
-                    br->data(), br->numBitsLeft() / 8);
+                    PTS_DTS_flags, PTS, DTS, payload.array(), payload.size());
 
             size_t payloadSizeBits = br->numBitsLeft();
             CHECK_EQ(payloadSizeBits % 8, 0u);
 
-            ALOGV("There's %d bytes of payload.", payloadSizeBits / 8);
+            ALOGV("There's %d bytes of payload.", payloadSize);
         }
     } else if (stream_id == 0xbe) {  // padding_stream
         CHECK_NE(PES_packet_length, 0u);
@@ -826,6 +899,46 @@ status_t ATSParser::Stream::parsePES(ABitReader *br) {
 }
 
 status_t ATSParser::Stream::flush() {
+    if (!mBorrowedPayloads.isEmpty()) {
+        const struct iovec &first = mBorrowedPayloads.itemAt(0);
+        const uint8_t *data = (const uint8_t *)first.iov_base;
+
+        // parsePES() needs the complete header in the first payload, and
+        // the data of stream types without one is skipped, not parsed.
+        size_t headerSize = 9;
+        if (first.iov_len >= headerSize) {
+            headerSize += data[8];
+        }
+
+        unsigned stream_id = first.iov_len > 3 ? data[3] : 0;
+
+        if (first.iov_len >= headerSize
+                && stream_id != 0xbc  // program_stream_map
+                && stream_id != 0xbe  // padding_stream
+                && stream_id != 0xbf  // private_stream_2
+                && stream_id != 0xf0  // ECM
+                && stream_id != 0xf1  // EMM
+                && stream_id != 0xff  // program_stream_directory
+                && stream_id != 0xf2  // DSMCC
+                && stream_id != 0xf8) {  // H.222.1 type E
+            ALOGV("flushing stream 0x%04x, %d borrowed payloads",
+                  mElementaryPID, mBorrowedPayloads.size());
+
+            ABitReader br(data, first.iov_len);
+
+            status_t err = parsePES(
+                    &br,
+                    mBorrowedPayloads.array() + 1,
+                    mBorrowedPayloads.size() - 1);
+
+            mBorrowedPayloads.clear();
+
+            return err;
+        }
+
+        copyBorrowedPayloads();
+    }
+
     if (mBuffer->size() == 0) {
         return OK;
     }
@@ -843,7 +956,7 @@ status_t ATSParser::Stream::flush() {
 
 void ATSParser::Stream::onPayloadData(
         unsigned PTS_DTS_flags, uint64_t PTS, uint64_t DTS,
-        const uint8_t *data, size_t size) {
+        const struct iovec *iov, int iovcnt) {
 #if 0
     ALOGI("payload streamType 0x%02x, PTS = 0x%016llx, dPTS = %lld",
           mStreamType,
@@ -859,7 +972,7 @@ void ATSParser::Stream::onPayloadData(
         timeUs = mProgram->convertPTSToTimestamp(PTS);
     }
 
-    status_t err = mQueue->appendData(data, size, timeUs);
+    status_t err = mQueue->appendData(iov, iovcnt, timeUs);
 
     if (err != OK) {
         return;
@@ -921,6 +1034,7 @@ ATSParser::ATSParser(uint32_t flags)
     : mFlags(flags),
       mAbsoluteTimeAnchorUs(-1ll),
       mNumTSPacketsParsed(0),
+      mBorrowPayloads(false),
       mNumPCRs(0) {
     mPSISections.add(0 /* PID */, new PSISection);
 }
@@ -935,6 +1049,33 @@ status_t ATSParser::feedTSPacket(const void *data, size_t size) {
     return parseTS(&br);
 }
 
+status_t ATSParser::feedTSPackets(const void *data, size_t numPackets) {
+    const uint8_t *packet = (const uint8_t *)data;
+
+    mBorrowPayloads = true;
+
+    status_t err = OK;
+    for (size_t i = 0; i < numPackets; ++i) {
+        ABitReader br(packet, kTSPacketSize);
+        err = parseTS(&br);
+
+        if (err != OK) {
+            break;
+        }
+
+        packet += kTSPacketSize;
+    }
+
+    mBorrowPayloads = false;
+
+    // The caller may reuse the buffer once we return.
+    for (size_t i = 0; i < mPrograms.size(); ++i) {
+        mPrograms.editItemAt(i)->copyBorrowedPayloads();
+    }
+
+    return err;
+}
+
 void ATSParser::signalDiscontinuity(
         DiscontinuityType type, const sp<AMessage> &extra) {
     int64_t mediaTimeUs;
@@ -64,6 +64,11 @@ struct ATSParser : public RefBase {
 
     status_t feedTSPacket(const void *data, size_t size);
 
+    // Parses "numPackets" consecutive transport stream packets. PES payloads
+    // are referenced in place while the call lasts instead of being copied
+    // packet by packet, only data still pending when it returns is copied.
+    status_t feedTSPackets(const void *data, size_t numPackets);
+
     void signalDiscontinuity(
             DiscontinuityType type, const sp<AMessage> &extra);
 
@@ -108,6 +113,10 @@ private:
 
     size_t mNumTSPacketsParsed;
 
+    // True while feedTSPackets() runs, i.e. while the packet data outlives
+    // the parsing of a single packet.
+    bool mBorrowPayloads;
+
     void parseProgramAssociationTable(ABitReader *br);
     void parseProgramMap(ABitReader *br);
     void parsePES(ABitReader *br);
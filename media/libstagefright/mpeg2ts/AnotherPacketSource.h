@@ -56,6 +56,9 @@ struct AnotherPacketSource : public MediaSource {
 
     void signalEOS(status_t result);
 
+    // Drops everything that is queued, including a pending end of stream.
+    void clear();
+
     status_t dequeueAccessUnit(sp<ABuffer> *buffer);
 
 protected:
@@ -50,6 +50,7 @@ void ElementaryStreamQueue::clear(bool clearFormat) {
     }
 
     mRangeInfos.clear();
+    mAlignedAccessUnits.clear();
 
     if (clearFormat) {
         mFormat.clear();
@@ -134,12 +135,23 @@ status_t ElementaryStreamQueue::appendData(
 #else
                 uint8_t *ptr = (uint8_t *)data;
 
+                // Look for "\x00\x00\x00\x01", i.e. a three byte startcode
+                // preceded by another 0x00.
                 ssize_t startOffset = -1;
-                for (size_t i = 0; i + 3 < size; ++i) {
-                    if (!memcmp("\x00\x00\x00\x01", &ptr[i], 4)) {
-                        startOffset = i;
+                size_t offset = 1;
+                while (offset < size) {
+                    ssize_t pos = FindStartCode(&ptr[offset], size - offset);
+                    if (pos < 0) {
                         break;
                     }
+
+                    offset += pos;
+                    if (ptr[offset - 1] == 0x00) {
+                        startOffset = offset - 1;
+                        break;
+                    }
+
+                    ++offset;
                 }
 
                 if (startOffset < 0) {
@@ -167,13 +179,7 @@ status_t ElementaryStreamQueue::appendData(
 #else
                 uint8_t *ptr = (uint8_t *)data;
 
-                ssize_t startOffset = -1;
-                for (size_t i = 0; i + 2 < size; ++i) {
-                    if (!memcmp("\x00\x00\x01", &ptr[i], 3)) {
-                        startOffset = i;
-                        break;
-                    }
-                }
+                ssize_t startOffset = FindStartCode(ptr, size);
 
                 if (startOffset < 0) {
                     return ERROR_MALFORMED;
@@ -261,6 +267,104 @@ status_t ElementaryStreamQueue::appendData(
         }
     }
 
+    struct iovec iov;
+    iov.iov_base = const_cast<void *>(data);
+    iov.iov_len = size;
+    appendRange(&iov, 1, timeUs);
+
+#if 0
+    if (mMode == AAC) {
+        ALOGI("size = %d, timeUs = %.2f secs", size, timeUs / 1E6);
+        hexdump(data, size);
+    }
+#endif
+
+    return OK;
+}
+
+status_t ElementaryStreamQueue::appendData(
+        const struct iovec *iov, int iovcnt, int64_t timeUs) {
+    if (iovcnt == 1) {
+        return appendData(iov[0].iov_base, iov[0].iov_len, timeUs);
+    }
+
+    if ((mBuffer == NULL || mBuffer->size() == 0)
+            && (iovcnt == 0
+                || !isSyncedAt(
+                    (const uint8_t *)iov[0].iov_base, iov[0].iov_len))) {
+        // appendData() has to search for the syncword, which needs the
+        // data in one piece.
+        size_t size = 0;
+        for (int i = 0; i < iovcnt; ++i) {
+            size += iov[i].iov_len;
+        }
+
+        sp<ABuffer> buffer = new ABuffer(size);
+        size_t offset = 0;
+        for (int i = 0; i < iovcnt; ++i) {
+            memcpy(buffer->data() + offset, iov[i].iov_base, iov[i].iov_len);
+            offset += iov[i].iov_len;
+        }
+
+        return appendData(buffer->data(), size, timeUs);
+    }
+
+    appendRange(iov, iovcnt, timeUs);
+
+    return OK;
+}
+
+// Returns true iff the syncword search in appendData() would find a match
+// at offset 0 of an empty queue.
+bool ElementaryStreamQueue::isSyncedAt(
+        const uint8_t *data, size_t size) const {
+    switch (mMode) {
+        case H264:
+        case MPEG_VIDEO:
+            return size >= 4 && !memcmp("\x00\x00\x00\x01", data, 4);
+
+        case MPEG4_VIDEO:
+            return size >= 3 && !memcmp("\x00\x00\x01", data, 3);
+
+        case AAC:
+            return IsSeeminglyValidADTSHeader(data, size);
+
+        case MPEG_AUDIO:
+            return IsSeeminglyValidMPEGAudioHeader(data, size);
+
+        case PCM_AUDIO:
+            return true;
+
+        default:
+            TRESPASS();
+            return false;
+    }
+}
+
+void ElementaryStreamQueue::appendRange(
+        const struct iovec *iov, int iovcnt, int64_t timeUs) {
+    size_t size = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        size += iov[i].iov_len;
+    }
+
+    if ((mFlags & kFlag_AlignedData) && mMode == H264
+            && (mBuffer == NULL || mBuffer->size() == 0)) {
+        // The data is exactly one access unit, assemble it right away
+        // instead of going through mBuffer.
+        sp<ABuffer> accessUnit = new ABuffer(size);
+        size_t offset = 0;
+        for (int i = 0; i < iovcnt; ++i) {
+            memcpy(accessUnit->data() + offset,
+                   iov[i].iov_base, iov[i].iov_len);
+            offset += iov[i].iov_len;
+        }
+        accessUnit->meta()->setInt64("timeUs", timeUs);
+
+        mAlignedAccessUnits.push_back(accessUnit);
+        return;
+    }
+
     size_t neededSize = (mBuffer == NULL ? 0 : mBuffer->size()) + size;
     if (mBuffer == NULL || neededSize > mBuffer->capacity()) {
         neededSize = (neededSize + 65535) & ~65535;
@@ -278,26 +382,31 @@ status_t ElementaryStreamQueue::appendData(
         mBuffer = buffer;
     }
 
-    memcpy(mBuffer->data() + mBuffer->size(), data, size);
-    mBuffer->setRange(0, mBuffer->size() + size);
+    for (int i = 0; i < iovcnt; ++i) {
+        memcpy(mBuffer->data() + mBuffer->size(),
+               iov[i].iov_base, iov[i].iov_len);
+        mBuffer->setRange(0, mBuffer->size() + iov[i].iov_len);
+    }
 
     RangeInfo info;
     info.mLength = size;
     info.mTimestampUs = timeUs;
     mRangeInfos.push_back(info);
-
-#if 0
-    if (mMode == AAC) {
-        ALOGI("size = %d, timeUs = %.2f secs", size, timeUs / 1E6);
-        hexdump(data, size);
-    }
-#endif
-
-    return OK;
 }
 
 sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnit() {
     if ((mFlags & kFlag_AlignedData) && mMode == H264) {
+        if (!mAlignedAccessUnits.empty()) {
+            sp<ABuffer> accessUnit = *mAlignedAccessUnits.begin();
+            mAlignedAccessUnits.erase(mAlignedAccessUnits.begin());
+
+            if (mFormat == NULL) {
+                mFormat = MakeAVCCodecSpecificData(accessUnit);
+            }
+
+            return accessUnit;
+        }
+
         if (mRangeInfos.empty()) {
             return NULL;
         }
@@ -746,10 +855,12 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
 
     size_t offset = 0;
     while (offset + 3 < size) {
-        if (memcmp(&data[offset], "\x00\x00\x01", 3)) {
-            ++offset;
-            continue;
+        // The byte following the startcode must be available too.
+        ssize_t pos = FindStartCode(&data[offset], size - offset - 1);
+        if (pos < 0) {
+            break;
         }
+        offset += pos;
 
         pprevStartCode = prevStartCode;
         prevStartCode = currentStartCode;
@@ -854,13 +965,9 @@ static ssize_t getNextChunkSize(
         TRESPASS();
     }
 
-    size_t offset = 3;
-    while (offset + 2 < size) {
-        if (!memcmp(&data[offset], kStartCode, 3)) {
-            return offset;
-        }
-
-        ++offset;
+    ssize_t offset = FindStartCode(&data[3], size - 3);
+    if (offset >= 0) {
+        return offset + 3;
     }
 
     return -EAGAIN;
@@ -23,6 +23,8 @@
 #include <utils/List.h>
 #include <utils/RefBase.h>
 
+#include <sys/uio.h>
+
 namespace android {
 
 struct ABuffer;
@@ -45,6 +47,12 @@ struct ElementaryStreamQueue {
     ElementaryStreamQueue(Mode mode, uint32_t flags = 0);
 
     status_t appendData(const void *data, size_t size, int64_t timeUs);
+
+    // Same as above for data that is scattered across several buffers,
+    // e.g. the payloads of consecutive transport stream packets.
+    status_t appendData(
+            const struct iovec *iov, int iovcnt, int64_t timeUs);
+
     void clear(bool clearFormat);
 
     sp<ABuffer> dequeueAccessUnit();
@@ -63,8 +71,15 @@ private:
     sp<ABuffer> mBuffer;
     List<RangeInfo> mRangeInfos;
 
+    // Access units appended in kFlag_AlignedData H264 mode while mBuffer
+    // was empty, copied straight into their own buffers.
+    List<sp<ABuffer> > mAlignedAccessUnits;
+
     sp<MetaData> mFormat;
 
+    bool isSyncedAt(const uint8_t *data, size_t size) const;
+    void appendRange(const struct iovec *iov, int iovcnt, int64_t timeUs);
+
     sp<ABuffer> dequeueAccessUnitH264();
     sp<ABuffer> dequeueAccessUnitAAC();
     sp<ABuffer> dequeueAccessUnitMPEGAudio();
@@ -19,6 +19,7 @@
 #include <utils/Log.h>
 
 #include <dlfcn.h>
+#include <unistd.h>
 
 #include "../include/OMX.h"
 
@@ -72,10 +73,16 @@ private:
     bool mDone;
     Condition mQueueChanged;
     List<omx_message> mQueue;
+    size_t mMaxMessagesPerDispatch;
 
     sp<CallbackDispatcherThread> mThread;
 
-    void dispatch(const omx_message &msg);
+    enum {
+        // Bounds the size of a single callback transaction.
+        kMaxMessagesPerDispatch = 32,
+    };
+
+    void dispatch(const List<omx_message> &messages);
 
     CallbackDispatcher(const CallbackDispatcher &);
     CallbackDispatcher &operator=(const CallbackDispatcher &);
@@ -83,7 +90,9 @@ private:
 
 OMX::CallbackDispatcher::CallbackDispatcher(OMXNodeInstance *owner)
     : mOwner(owner),
-      mDone(false) {
+      mDone(false),
+      mMaxMessagesPerDispatch(
+              IOMX::BufferBatchingEnabled() ? kMaxMessagesPerDispatch : 1) {
     mThread = new CallbackDispatcherThread(this);
     mThread->run("OMXCallbackDisp", ANDROID_PRIORITY_FOREGROUND);
 }
@@ -113,17 +122,17 @@ void OMX::CallbackDispatcher::post(const omx_message &msg) {
     mQueueChanged.signal();
 }
 
-void OMX::CallbackDispatcher::dispatch(const omx_message &msg) {
+void OMX::CallbackDispatcher::dispatch(const List<omx_message> &messages) {
     if (mOwner == NULL) {
         ALOGV("Would have dispatched a message to a node that's already gone.");
         return;
     }
-    mOwner->onMessage(msg);
+    mOwner->onMessages(messages);
 }
 
 bool OMX::CallbackDispatcher::loop() {
     for (;;) {
-        omx_message msg;
+        List<omx_message> messages;
 
         {
             Mutex::Autolock autoLock(mLock);
@@ -135,11 +144,16 @@ bool OMX::CallbackDispatcher::loop() {
                 break;
             }
 
-            msg = *mQueue.begin();
-            mQueue.erase(mQueue.begin());
+            // Everything queued by now goes out in a single callback.
+            size_t count = 0;
+            while (!mQueue.empty() && count < mMaxMessagesPerDispatch) {
+                messages.push_back(*mQueue.begin());
+                mQueue.erase(mQueue.begin());
+                ++count;
+            }
         }
 
-        dispatch(msg);
+        dispatch(messages);
     }
 
     return false;
@@ -185,6 +199,21 @@ void OMX::binderDied(const wp<IBinder> &the_late_who) {
     instance->onObserverDied(mMaster);
 }
 
+status_t OMX::dump(int fd, const Vector<String16> &args) {
+    String8 result;
+
+    Mutex::Autolock autoLock(mLock);
+
+    result.appendFormat(" OMX nodes: %d\n", mNodeIDToInstance.size());
+    for (size_t i = 0; i < mNodeIDToInstance.size(); ++i) {
+        mNodeIDToInstance.valueAt(i)->dump(result);
+    }
+
+    write(fd, result.string(), result.size());
+
+    return OK;
+}
+
 bool OMX::livesLocally(node_id node, pid_t pid) {
     return pid == getpid();
 }
@@ -223,7 +252,7 @@ status_t OMX::allocateNode(
 
     *node = 0;
 
-    OMXNodeInstance *instance = new OMXNodeInstance(this, observer);
+    OMXNodeInstance *instance = new OMXNodeInstance(this, observer, name);
 
     OMX_COMPONENTTYPE *handle;
     OMX_ERRORTYPE err = mMaster->makeComponentInstance(
@@ -377,6 +406,11 @@ status_t OMX::emptyBuffer(
             buffer, range_offset, range_length, flags, timestamp);
 }
 
+status_t OMX::submitBuffers(
+        node_id node, const Vector<BufferCommand> &commands) {
+    return findInstance(node)->submitBuffers(commands);
+}
+
 status_t OMX::getExtensionIndex(
         node_id node,
         const char *parameter_name,
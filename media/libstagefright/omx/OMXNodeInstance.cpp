@@ -46,24 +46,29 @@ struct BufferMeta {
           mIsBackup(false) {
     }
 
-    void CopyFromOMX(const OMX_BUFFERHEADERTYPE *header) {
+    // Both return the number of bytes copied.
+    size_t CopyFromOMX(const OMX_BUFFERHEADERTYPE *header) {
         if (!mIsBackup) {
-            return;
+            return 0;
         }
 
         memcpy((OMX_U8 *)mMem->pointer() + header->nOffset,
                header->pBuffer + header->nOffset,
                header->nFilledLen);
+
+        return header->nFilledLen;
     }
 
-    void CopyToOMX(const OMX_BUFFERHEADERTYPE *header) {
+    size_t CopyToOMX(const OMX_BUFFERHEADERTYPE *header) {
         if (!mIsBackup) {
-            return;
+            return 0;
         }
 
         memcpy(header->pBuffer + header->nOffset,
                (const OMX_U8 *)mMem->pointer() + header->nOffset,
                header->nFilledLen);
+
+        return header->nFilledLen;
     }
 
 private:
@@ -82,12 +87,17 @@ OMX_CALLBACKTYPE OMXNodeInstance::kCallbacks = {
 };
 
 OMXNodeInstance::OMXNodeInstance(
-        OMX *owner, const sp<IOMXObserver> &observer)
+        OMX *owner, const sp<IOMXObserver> &observer, const char *name)
     : mOwner(owner),
       mNodeID(NULL),
       mHandle(NULL),
       mObserver(observer),
-      mDying(false) {
+      mDying(false),
+      mName(name),
+      mNumZeroCopyBuffers(0),
+      mNumBackupBuffers(0),
+      mBytesCopiedToOMX(0),
+      mBytesCopiedFromOMX(0) {
 }
 
 OMXNodeInstance::~OMXNodeInstance() {
@@ -411,6 +421,11 @@ status_t OMXNodeInstance::useBuffer(
 
     addActiveBuffer(portIndex, *buffer);
 
+    {
+        Mutex::Autolock statsLock(mStatsLock);
+        ++mNumZeroCopyBuffers;
+    }
+
     return OK;
 }
 
@@ -592,6 +607,11 @@ status_t OMXNodeInstance::allocateBufferWithBackup(
 
     addActiveBuffer(portIndex, *buffer);
 
+    {
+        Mutex::Autolock statsLock(mStatsLock);
+        ++mNumBackupBuffers;
+    }
+
     return OK;
 }
 
@@ -615,6 +635,10 @@ status_t OMXNodeInstance::freeBuffer(
 status_t OMXNodeInstance::fillBuffer(OMX::buffer_id buffer) {
     Mutex::Autolock autoLock(mLock);
 
+    return fillBuffer_l(buffer);
+}
+
+status_t OMXNodeInstance::fillBuffer_l(OMX::buffer_id buffer) {
     OMX_BUFFERHEADERTYPE *header = (OMX_BUFFERHEADERTYPE *)buffer;
     header->nFilledLen = 0;
     header->nOffset = 0;
@@ -631,6 +655,13 @@ status_t OMXNodeInstance::emptyBuffer(
         OMX_U32 flags, OMX_TICKS timestamp) {
     Mutex::Autolock autoLock(mLock);
 
+    return emptyBuffer_l(buffer, rangeOffset, rangeLength, flags, timestamp);
+}
+
+status_t OMXNodeInstance::emptyBuffer_l(
+        OMX::buffer_id buffer,
+        OMX_U32 rangeOffset, OMX_U32 rangeLength,
+        OMX_U32 flags, OMX_TICKS timestamp) {
     OMX_BUFFERHEADERTYPE *header = (OMX_BUFFERHEADERTYPE *)buffer;
     header->nFilledLen = rangeLength;
     header->nOffset = rangeOffset;
@@ -639,7 +670,11 @@ status_t OMXNodeInstance::emptyBuffer(
 
     BufferMeta *buffer_meta =
         static_cast<BufferMeta *>(header->pAppPrivate);
-    buffer_meta->CopyToOMX(header);
+    size_t bytesCopied = buffer_meta->CopyToOMX(header);
+    if (bytesCopied > 0) {
+        Mutex::Autolock statsLock(mStatsLock);
+        mBytesCopiedToOMX += bytesCopied;
+    }
 
     OMX_ERRORTYPE err = OMX_EmptyThisBuffer(mHandle, header);
 
@@ -656,19 +691,71 @@ status_t OMXNodeInstance::getExtensionIndex(
     return StatusFromOMXError(err);
 }
 
-void OMXNodeInstance::onMessage(const omx_message &msg) {
-    if (msg.type == omx_message::FILL_BUFFER_DONE) {
-        OMX_BUFFERHEADERTYPE *buffer =
-            static_cast<OMX_BUFFERHEADERTYPE *>(
-                    msg.u.extended_buffer_data.buffer);
+status_t OMXNodeInstance::submitBuffers(
+        const Vector<IOMX::BufferCommand> &commands) {
+    Mutex::Autolock autoLock(mLock);
 
-        BufferMeta *buffer_meta =
-            static_cast<BufferMeta *>(buffer->pAppPrivate);
+    for (size_t i = 0; i < commands.size(); ++i) {
+        const IOMX::BufferCommand &command = commands[i];
+
+        status_t err;
+        if (command.mType == IOMX::BufferCommand::EMPTY_BUFFER) {
+            err = emptyBuffer_l(
+                    command.mBuffer, command.mRangeOffset,
+                    command.mRangeLength, command.mFlags,
+                    command.mTimestamp);
+        } else {
+            err = fillBuffer_l(command.mBuffer);
+        }
+
+        if (err != OK) {
+            return err;
+        }
+    }
+
+    return OK;
+}
+
+void OMXNodeInstance::onMessages(const List<omx_message> &messages) {
+    size_t count = 0;
+    size_t bytesCopied = 0;
+    for (List<omx_message>::const_iterator it = messages.begin();
+         it != messages.end(); ++it) {
+        const omx_message &msg = *it;
+        if (msg.type == omx_message::FILL_BUFFER_DONE) {
+            OMX_BUFFERHEADERTYPE *buffer =
+                static_cast<OMX_BUFFERHEADERTYPE *>(
+                        msg.u.extended_buffer_data.buffer);
 
-        buffer_meta->CopyFromOMX(buffer);
+            BufferMeta *buffer_meta =
+                static_cast<BufferMeta *>(buffer->pAppPrivate);
+
+            bytesCopied += buffer_meta->CopyFromOMX(buffer);
+        }
+        ++count;
+    }
+
+    if (bytesCopied > 0) {
+        Mutex::Autolock statsLock(mStatsLock);
+        mBytesCopiedFromOMX += bytesCopied;
     }
 
-    mObserver->onMessage(msg);
+    // Observers that predate onMessages() only see single messages.
+    if (count == 1) {
+        mObserver->onMessage(*messages.begin());
+    } else {
+        mObserver->onMessages(messages);
+    }
+}
+
+void OMXNodeInstance::dump(String8 &result) const {
+    Mutex::Autolock statsLock(mStatsLock);
+
+    result.appendFormat(
+            "  node %p %s: %d zero-copy buffers, %d buffers with backup, "
+            "%lld bytes copied to OMX, %lld bytes copied from OMX\n",
+            mNodeID, mName.string(), mNumZeroCopyBuffers, mNumBackupBuffers,
+            mBytesCopiedToOMX, mBytesCopiedFromOMX);
 }
 
 void OMXNodeInstance::onObserverDied(OMXMaster *master) {
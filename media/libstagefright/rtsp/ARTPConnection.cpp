@@ -31,12 +31,23 @@
 #include <media/stagefright/foundation/hexdump.h>
 
 #include <arpa/inet.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 namespace android {
 
 static const size_t kMaxUDPSize = 1500;
 
+// Maximum number of datagrams drained from a socket per receive call.
+
+// Upper bound on the number of recycled receive buffers, once exceeded
+// buffers are allocated (and freed) per datagram as before.
+static const size_t kMaxPooledBuffers = 512;
+
+static const size_t kMaxEpollEvents = 32;
+
 static uint16_t u16at(const uint8_t *data) {
     return data[0] << 8 | data[1];
 }
@@ -67,13 +78,67 @@ struct ARTPConnection::StreamInfo {
     bool mIsInjected;
 };
 
+// Layout compatible with the kernel's struct mmsghdr, which older libc
+// headers do not provide.
+struct ReceiveSlot {
+    struct msghdr mHeader;
+    unsigned int mLength;
+};
+
+// Receives up to "count" datagrams from socket "s" without blocking,
+// returns the number of datagrams received or -1 on error (errno is set).
+static ssize_t receiveBatch(int s, ReceiveSlot *slots, size_t count) {
+#ifdef __NR_recvmmsg
+    ssize_t n;
+    do {
+        n = syscall(__NR_recvmmsg, s, slots, count, MSG_DONTWAIT, NULL);
+    } while (n < 0 && errno == EINTR);
+
+    if (n >= 0 || errno != ENOSYS) {
+        return n;
+    }
+#endif
+
+    size_t i = 0;
+    while (i < count) {
+        ssize_t nbytes;
+        do {
+            nbytes = recvmsg(s, &slots[i].mHeader, MSG_DONTWAIT);
+        } while (nbytes < 0 && errno == EINTR);
+
+        if (nbytes < 0) {
+            if (i > 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            return i > 0 ? (ssize_t)i : -1;
+        }
+
+        slots[i].mLength = nbytes;
+        ++i;
+    }
+
+    return i;
+}
+
 ARTPConnection::ARTPConnection(uint32_t flags)
     : mFlags(flags),
       mPollEventPending(false),
-      mLastReceiverReportTimeUs(-1) {
+      mLastReceiverReportTimeUs(-1),
+      mEpollFd(-1),
+      mNextPoolIndex(0),
+      mNumReceiveCalls(0),
+      mNumPacketsReceived(0),
+      mNumPoolHits(0),
+      mNumPoolMisses(0) {
+    mEpollFd = epoll_create(kMaxEpollEvents);
+    CHECK_GE(mEpollFd, 0);
 }
 
 ARTPConnection::~ARTPConnection() {
+    dumpStats();
+
+    close(mEpollFd);
+    mEpollFd = -1;
 }
 
 void ARTPConnection::addStream(
@@ -205,10 +270,31 @@ void ARTPConnection::onAddStream(const sp<AMessage> &msg) {
     memset(&info->mRemoteRTCPAddr, 0, sizeof(info->mRemoteRTCPAddr));
 
     if (!injected) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+
+        ev.data.fd = info->mRTPSocket;
+        CHECK_EQ(epoll_ctl(mEpollFd, EPOLL_CTL_ADD, info->mRTPSocket, &ev), 0);
+
+        ev.data.fd = info->mRTCPSocket;
+        CHECK_EQ(epoll_ctl(mEpollFd, EPOLL_CTL_ADD, info->mRTCPSocket, &ev), 0);
+
         postPollEvent();
     }
 }
 
+void ARTPConnection::unregisterStream(const StreamInfo *info) {
+    if (info->mIsInjected) {
+        return;
+    }
+
+    // The owner may already have closed the sockets, in which case the
+    // kernel has dropped them from the interest list and these fail.
+    epoll_ctl(mEpollFd, EPOLL_CTL_DEL, info->mRTPSocket, NULL);
+    epoll_ctl(mEpollFd, EPOLL_CTL_DEL, info->mRTCPSocket, NULL);
+}
+
 void ARTPConnection::onRemoveStream(const sp<AMessage> &msg) {
     int32_t rtpSocket, rtcpSocket;
     CHECK(msg->findInt32("rtp-socket", &rtpSocket));
@@ -224,6 +310,7 @@ void ARTPConnection::onRemoveStream(const sp<AMessage> &msg) {
         return;
     }
 
+    unregisterStream(&*it);
     mStreams.erase(it);
 }
 
@@ -245,65 +332,54 @@ void ARTPConnection::onPollStreams() {
         return;
     }
 
-    struct timeval tv;
-    tv.tv_sec = 0;
-    tv.tv_usec = kSelectTimeoutUs;
-
-    fd_set rs;
-    FD_ZERO(&rs);
-
-    int maxSocket = -1;
+    bool haveSockets = false;
     for (List<StreamInfo>::iterator it = mStreams.begin();
          it != mStreams.end(); ++it) {
-        if ((*it).mIsInjected) {
-            continue;
-        }
-
-        FD_SET(it->mRTPSocket, &rs);
-        FD_SET(it->mRTCPSocket, &rs);
-
-        if (it->mRTPSocket > maxSocket) {
-            maxSocket = it->mRTPSocket;
-        }
-        if (it->mRTCPSocket > maxSocket) {
-            maxSocket = it->mRTCPSocket;
+        if (!(*it).mIsInjected) {
+            haveSockets = true;
+            break;
         }
     }
 
-    if (maxSocket == -1) {
+    if (!haveSockets) {
         return;
     }
 
-    int res = select(maxSocket + 1, &rs, NULL, NULL, &tv);
+    struct epoll_event events[kMaxEpollEvents];
+    int res;
+    do {
+        res = epoll_wait(
+                mEpollFd, events, kMaxEpollEvents, kSelectTimeoutUs / 1000ll);
+    } while (res < 0 && errno == EINTR);
+
+    for (int i = 0; i < res; ++i) {
+        int fd = events[i].data.fd;
 
-    if (res > 0) {
         List<StreamInfo>::iterator it = mStreams.begin();
-        while (it != mStreams.end()) {
-            if ((*it).mIsInjected) {
-                ++it;
-                continue;
-            }
+        while (it != mStreams.end()
+                && (it->mIsInjected
+                    || (it->mRTPSocket != fd && it->mRTCPSocket != fd))) {
+            ++it;
+        }
 
-            status_t err = OK;
-            if (FD_ISSET(it->mRTPSocket, &rs)) {
-                err = receive(&*it, true);
-            }
-            if (err == OK && FD_ISSET(it->mRTCPSocket, &rs)) {
-                err = receive(&*it, false);
-            }
+        if (it == mStreams.end()) {
+            // Stream was removed while handling an earlier event.
+            continue;
+        }
 
-            if (err == -ECONNRESET) {
-                // socket failure, this stream is dead, Jim.
+        status_t err = receive(&*it, fd == it->mRTPSocket);
 
-                ALOGW("failed to receive RTP/RTCP datagram.");
-                it = mStreams.erase(it);
-                continue;
-            }
+        if (err == -ECONNRESET) {
+            // socket failure, this stream is dead, Jim.
 
-            ++it;
+            ALOGW("failed to receive RTP/RTCP datagram.");
+            unregisterStream(&*it);
+            mStreams.erase(it);
         }
     }
 
+    flushPendingSources();
+
     int64_t nowUs = ALooper::GetNowUs();
     if (mLastReceiverReportTimeUs <= 0
             || mLastReceiverReportTimeUs + 5000000ll <= nowUs) {
@@ -351,6 +427,7 @@ void ARTPConnection::onPollStreams() {
                     ALOGW("failed to send RTCP receiver report (%s).",
                          n == 0 ? "connection gone" : strerror(errno));
 
+                    unregisterStream(s);
                     it = mStreams.erase(it);
                     continue;
                 }
@@ -362,6 +439,8 @@ void ARTPConnection::onPollStreams() {
 
             ++it;
         }
+
+        dumpStats();
     }
 
     if (!mStreams.empty()) {
@@ -374,39 +453,129 @@ status_t ARTPConnection::receive(StreamInfo *s, bool receiveRTP) {
 
     CHECK(!s->mIsInjected);
 
-    sp<ABuffer> buffer = new ABuffer(65536);
+    struct iovec iov[kMaxReceiveBatch];
+    struct sockaddr_in remoteAddr[kMaxReceiveBatch];
+    ReceiveSlot slots[kMaxReceiveBatch];
 
-    socklen_t remoteAddrLen =
-        (!receiveRTP && s->mNumRTCPPacketsReceived == 0)
-            ? sizeof(s->mRemoteRTCPAddr) : 0;
+    for (size_t i = 0; i < kMaxReceiveBatch; ++i) {
+        if (mReceiveBuffers[i] == NULL) {
+            mReceiveBuffers[i] = acquireBuffer();
+        }
 
-    ssize_t nbytes;
-    do {
-        nbytes = recvfrom(
+        iov[i].iov_base = mReceiveBuffers[i]->base();
+        iov[i].iov_len = mReceiveBuffers[i]->capacity();
+
+        memset(&slots[i], 0, sizeof(slots[i]));
+        slots[i].mHeader.msg_iov = &iov[i];
+        slots[i].mHeader.msg_iovlen = 1;
+
+        if (!receiveRTP) {
+            slots[i].mHeader.msg_name = &remoteAddr[i];
+            slots[i].mHeader.msg_namelen = sizeof(remoteAddr[i]);
+        }
+    }
+
+    ssize_t n = receiveBatch(
             receiveRTP ? s->mRTPSocket : s->mRTCPSocket,
-            buffer->data(),
-            buffer->capacity(),
-            0,
-            remoteAddrLen > 0 ? (struct sockaddr *)&s->mRemoteRTCPAddr : NULL,
-            remoteAddrLen > 0 ? &remoteAddrLen : NULL);
-    } while (nbytes < 0 && errno == EINTR);
-
-    if (nbytes <= 0) {
+            slots, kMaxReceiveBatch);
+
+    ++mNumReceiveCalls;
+
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return OK;
+    }
+
+    if (n <= 0) {
         return -ECONNRESET;
     }
 
-    buffer->setRange(0, nbytes);
+    mNumPacketsReceived += n;
 
-    // ALOGI("received %d bytes.", buffer->size());
+    for (ssize_t i = 0; i < n; ++i) {
+        size_t nbytes = slots[i].mLength;
 
-    status_t err;
-    if (receiveRTP) {
-        err = parseRTP(s, buffer);
-    } else {
-        err = parseRTCP(s, buffer);
+        if (nbytes == 0) {
+            return -ECONNRESET;
+        }
+
+        if (slots[i].mHeader.msg_flags & MSG_TRUNC) {
+            ALOGW("dropping oversized %s datagram.", receiveRTP ? "RTP" : "RTCP");
+            continue;
+        }
+
+        // The buffer now belongs to the stream, the slot is refilled on
+        // the next call.
+        sp<ABuffer> buffer = mReceiveBuffers[i];
+        mReceiveBuffers[i].clear();
+        buffer->setRange(0, nbytes);
+
+        // ALOGI("received %d bytes.", buffer->size());
+
+        if (receiveRTP) {
+            parseRTP(s, buffer);
+        } else {
+            if (s->mNumRTCPPacketsReceived == 0) {
+                s->mRemoteRTCPAddr = remoteAddr[i];
+            }
+
+            parseRTCP(s, buffer);
+        }
     }
 
-    return err;
+    return OK;
+}
+
+sp<ABuffer> ARTPConnection::acquireBuffer() {
+    size_t poolSize = mBufferPool.size();
+
+    for (size_t i = 0; i < poolSize; ++i) {
+        size_t index = (mNextPoolIndex + i) % poolSize;
+        const sp<ABuffer> &buffer = mBufferPool.itemAt(index);
+
+        // Nobody but the pool holds on to this buffer anymore, since all
+        // other references are gone nobody can acquire a new one either.
+        if (buffer->getStrongCount() == 1) {
+            mNextPoolIndex = (index + 1) % poolSize;
+            ++mNumPoolHits;
+
+            buffer->setRange(0, buffer->capacity());
+            buffer->setInt32Data(0);
+            buffer->meta()->clear();
+
+            return buffer;
+        }
+    }
+
+    ++mNumPoolMisses;
+
+    sp<ABuffer> buffer = new ABuffer(kMaxUDPSize);
+
+    if (poolSize < kMaxPooledBuffers) {
+        mBufferPool.push(buffer);
+    }
+
+    return buffer;
+}
+
+void ARTPConnection::flushPendingSources() {
+    for (size_t i = 0; i < mPendingSources.size(); ++i) {
+        mPendingSources.editItemAt(i)->processQueuedPackets();
+    }
+
+    mPendingSources.clear();
+}
+
+void ARTPConnection::dumpStats() const {
+    int64_t numAcquired = mNumPoolHits + mNumPoolMisses;
+
+    ALOGV("received %lld packets in %lld calls (%.2f packets/call), "
+          "buffer pool size %zu, hit rate %.2f%%",
+          mNumPacketsReceived,
+          mNumReceiveCalls,
+          mNumReceiveCalls > 0
+            ? (double)mNumPacketsReceived / mNumReceiveCalls : 0.0,
+          mBufferPool.size(),
+          numAcquired > 0 ? 100.0 * mNumPoolHits / numAcquired : 0.0);
 }
 
 status_t ARTPConnection::parseRTP(StreamInfo *s, const sp<ABuffer> &buffer) {
@@ -490,7 +659,19 @@ status_t ARTPConnection::parseRTP(StreamInfo *s, const sp<ABuffer> &buffer) {
     buffer->setInt32Data(u16at(&data[2]));
     buffer->setRange(payloadOffset, size - payloadOffset);
 
-    source->processRTPPacket(buffer);
+    source->queueRTPPacket(buffer);
+
+    bool pending = false;
+    for (size_t i = 0; i < mPendingSources.size(); ++i) {
+        if (mPendingSources.itemAt(i) == source) {
+            pending = true;
+            break;
+        }
+    }
+
+    if (!pending) {
+        mPendingSources.push(source);
+    }
 
     return OK;
 }
@@ -669,6 +850,8 @@ void ARTPConnection::onInjectPacket(const sp<AMessage> &msg) {
     } else {
         err = parseRTCP(s, buffer);
     }
+
+    flushPendingSources();
 }
 
 }  // namespace android
@@ -20,6 +20,7 @@
 
 #include <media/stagefright/foundation/AHandler.h>
 #include <utils/List.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -64,6 +65,10 @@ private:
 
     static const int64_t kSelectTimeoutUs;
 
+    enum {
+        kMaxReceiveBatch = 16,
+    };
+
     uint32_t mFlags;
 
     struct StreamInfo;
@@ -72,6 +77,26 @@ private:
     bool mPollEventPending;
     int64_t mLastReceiverReportTimeUs;
 
+    int mEpollFd;
+
+    // Receive buffers are recycled once all downstream references
+    // (source queues, assemblers) have been dropped.
+    Vector<sp<ABuffer> > mBufferPool;
+    size_t mNextPoolIndex;
+
+    // Buffers handed to the next receive call. Only the slots whose
+    // packets were passed on are refilled from the pool.
+    sp<ABuffer> mReceiveBuffers[kMaxReceiveBatch];
+
+    // Sources that had packets queued during the current receive batch
+    // and still need to run their assembler.
+    Vector<sp<ARTPSource> > mPendingSources;
+
+    int64_t mNumReceiveCalls;
+    int64_t mNumPacketsReceived;
+    int64_t mNumPoolHits;
+    int64_t mNumPoolMisses;
+
     void onAddStream(const sp<AMessage> &msg);
     void onRemoveStream(const sp<AMessage> &msg);
     void onPollStreams();
@@ -79,6 +104,10 @@ private:
     void onSendReceiverReports();
 
     status_t receive(StreamInfo *info, bool receiveRTP);
+    sp<ABuffer> acquireBuffer();
+    void flushPendingSources();
+    void unregisterStream(const StreamInfo *info);
+    void dumpStats() const;
 
     status_t parseRTP(StreamInfo *info, const sp<ABuffer> &buffer);
     status_t parseRTCP(StreamInfo *info, const sp<ABuffer> &buffer);
@@ -44,6 +44,7 @@ ARTPSource::ARTPSource(
     : mID(id),
       mHighestSeqNumber(0),
       mNumBuffersReceived(0),
+      mHasQueuedPackets(false),
       mLastNTPTime(0),
       mLastNTPTimeUpdateUs(0),
       mIssueFIRRequests(false),
@@ -86,7 +87,24 @@ static uint32_t AbsDiff(uint32_t seq1, uint32_t seq2) {
 }
 
 void ARTPSource::processRTPPacket(const sp<ABuffer> &buffer) {
-    if (queuePacket(buffer) && mAssembler != NULL) {
+    queueRTPPacket(buffer);
+    processQueuedPackets();
+}
+
+void ARTPSource::queueRTPPacket(const sp<ABuffer> &buffer) {
+    if (queuePacket(buffer)) {
+        mHasQueuedPackets = true;
+    }
+}
+
+void ARTPSource::processQueuedPackets() {
+    if (!mHasQueuedPackets) {
+        return;
+    }
+
+    mHasQueuedPackets = false;
+
+    if (mAssembler != NULL) {
         mAssembler->onPacketReceived(this);
     }
 }
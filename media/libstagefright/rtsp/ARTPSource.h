@@ -38,6 +38,13 @@ struct ARTPSource : public RefBase {
             const sp<AMessage> &notify);
 
     void processRTPPacket(const sp<ABuffer> &buffer);
+
+    // Queues a packet without running the assembler. Used by callers that
+    // receive packets in batches, they must follow up with a call to
+    // processQueuedPackets() once the batch has been queued.
+    void queueRTPPacket(const sp<ABuffer> &buffer);
+    void processQueuedPackets();
+
     void timeUpdate(uint32_t rtpTime, uint64_t ntpTime);
     void byeReceived();
 
@@ -52,6 +59,7 @@ private:
     int32_t mNumBuffersReceived;
 
     List<sp<ABuffer> > mQueue;
+    bool mHasQueuedPackets;
     sp<ARTPAssembler> mAssembler;
 
     uint64_t mLastNTPTime;
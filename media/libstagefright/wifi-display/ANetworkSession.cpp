@@ -22,10 +22,12 @@
 #include "ParsedMessage.h"
 
 #include <arpa/inet.h>
+#include <cutils/atomic.h>
 #include <fcntl.h>
 #include <net/if.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 
 #include <media/stagefright/foundation/ABuffer.h>
@@ -38,14 +40,21 @@ namespace android {
 
 static const size_t kMaxUDPSize = 1500;
 
+// Maximum number of events retrieved by a single epoll_wait.
+static const int kMaxEvents = 64;
+
+// epoll cookie of a shard's wakeup pipe, session IDs start at 1.
+static const uint64_t kPipeCookie = 0;
+
 struct ANetworkSession::NetworkThread : public Thread {
-    NetworkThread(ANetworkSession *session);
+    NetworkThread(ANetworkSession *session, Shard *shard);
 
 protected:
     virtual ~NetworkThread();
 
 private:
     ANetworkSession *mSession;
+    Shard *mShard;
 
     virtual bool threadLoop();
 
@@ -72,6 +81,11 @@ struct ANetworkSession::Session : public RefBase {
 
     bool isRTSPServer() const;
     bool isTCPDatagramServer() const;
+    bool isConnecting() const;
+
+    // Only called for accepted connections, once the session has been
+    // added and can be looked up by its ID.
+    void notifyClientConnected();
 
     bool wantsToRead();
     bool wantsToWrite();
@@ -83,6 +97,8 @@ struct ANetworkSession::Session : public RefBase {
 
     void setIsRTSPConnection(bool yesno);
 
+    void dump(AString *result) const;
+
 protected:
     virtual ~Session();
 
@@ -102,6 +118,11 @@ private:
 
     AString mInBuffer;
 
+    int64_t mNumBytesRead;
+    int64_t mNumReads;
+    int64_t mNumBytesWritten;
+    int64_t mNumWrites;
+
     void notifyError(bool send, status_t err, const char *detail);
     void notify(NotificationReason reason);
 
@@ -109,15 +130,17 @@ private:
 };
 ////////////////////////////////////////////////////////////////////////////////
 
-ANetworkSession::NetworkThread::NetworkThread(ANetworkSession *session)
-    : mSession(session) {
+ANetworkSession::NetworkThread::NetworkThread(
+        ANetworkSession *session, Shard *shard)
+    : mSession(session),
+      mShard(shard) {
 }
 
 ANetworkSession::NetworkThread::~NetworkThread() {
 }
 
 bool ANetworkSession::NetworkThread::threadLoop() {
-    mSession->threadLoop();
+    mSession->threadLoop(mShard);
 
     return true;
 }
@@ -135,47 +158,54 @@ ANetworkSession::Session::Session(
       mSocket(s),
       mNotify(notify),
       mSawReceiveFailure(false),
-      mSawSendFailure(false) {
-    if (mState == CONNECTED) {
-        struct sockaddr_in localAddr;
-        socklen_t localAddrLen = sizeof(localAddr);
-
-        int res = getsockname(
-                mSocket, (struct sockaddr *)&localAddr, &localAddrLen);
-        CHECK_GE(res, 0);
-
-        struct sockaddr_in remoteAddr;
-        socklen_t remoteAddrLen = sizeof(remoteAddr);
-
-        res = getpeername(
-                mSocket, (struct sockaddr *)&remoteAddr, &remoteAddrLen);
-        CHECK_GE(res, 0);
-
-        in_addr_t addr = ntohl(localAddr.sin_addr.s_addr);
-        AString localAddrString = StringPrintf(
-                "%d.%d.%d.%d",
-                (addr >> 24),
-                (addr >> 16) & 0xff,
-                (addr >> 8) & 0xff,
-                addr & 0xff);
-
-        addr = ntohl(remoteAddr.sin_addr.s_addr);
-        AString remoteAddrString = StringPrintf(
-                "%d.%d.%d.%d",
-                (addr >> 24),
-                (addr >> 16) & 0xff,
-                (addr >> 8) & 0xff,
-                addr & 0xff);
-
-        sp<AMessage> msg = mNotify->dup();
-        msg->setInt32("sessionID", mSessionID);
-        msg->setInt32("reason", kWhatClientConnected);
-        msg->setString("server-ip", localAddrString.c_str());
-        msg->setInt32("server-port", ntohs(localAddr.sin_port));
-        msg->setString("client-ip", remoteAddrString.c_str());
-        msg->setInt32("client-port", ntohs(remoteAddr.sin_port));
-        msg->post();
-    }
+      mSawSendFailure(false),
+      mNumBytesRead(0),
+      mNumReads(0),
+      mNumBytesWritten(0),
+      mNumWrites(0) {
+}
+
+void ANetworkSession::Session::notifyClientConnected() {
+    CHECK_EQ(mState, CONNECTED);
+
+    struct sockaddr_in localAddr;
+    socklen_t localAddrLen = sizeof(localAddr);
+
+    int res = getsockname(
+            mSocket, (struct sockaddr *)&localAddr, &localAddrLen);
+    CHECK_GE(res, 0);
+
+    struct sockaddr_in remoteAddr;
+    socklen_t remoteAddrLen = sizeof(remoteAddr);
+
+    res = getpeername(
+            mSocket, (struct sockaddr *)&remoteAddr, &remoteAddrLen);
+    CHECK_GE(res, 0);
+
+    in_addr_t addr = ntohl(localAddr.sin_addr.s_addr);
+    AString localAddrString = StringPrintf(
+            "%d.%d.%d.%d",
+            (addr >> 24),
+            (addr >> 16) & 0xff,
+            (addr >> 8) & 0xff,
+            addr & 0xff);
+
+    addr = ntohl(remoteAddr.sin_addr.s_addr);
+    AString remoteAddrString = StringPrintf(
+            "%d.%d.%d.%d",
+            (addr >> 24),
+            (addr >> 16) & 0xff,
+            (addr >> 8) & 0xff,
+            addr & 0xff);
+
+    sp<AMessage> msg = mNotify->dup();
+    msg->setInt32("sessionID", mSessionID);
+    msg->setInt32("reason", kWhatClientConnected);
+    msg->setString("server-ip", localAddrString.c_str());
+    msg->setInt32("server-port", ntohs(localAddr.sin_port));
+    msg->setString("client-ip", remoteAddrString.c_str());
+    msg->setInt32("client-port", ntohs(remoteAddr.sin_port));
+    msg->post();
 }
 
 ANetworkSession::Session::~Session() {
@@ -201,6 +231,37 @@ sp<AMessage> ANetworkSession::Session::getNotificationMessage() const {
     return mNotify;
 }
 
+void ANetworkSession::Session::dump(AString *result) const {
+    const char *type;
+    switch (mState) {
+        case CONNECTING:
+            type = "connecting";
+            break;
+        case CONNECTED:
+            type = mIsRTSPConnection ? "RTSP connection" : "TCP datagrams";
+            break;
+        case LISTENING_RTSP:
+            type = "RTSP server";
+            break;
+        case LISTENING_TCP_DGRAMS:
+            type = "TCP datagram server";
+            break;
+        default:
+            type = "UDP";
+            break;
+    }
+
+    result->append(StringPrintf(
+            "  session %d (%s, socket %d): "
+            "read %lld bytes in %lld calls, wrote %lld bytes in %lld calls, "
+            "%d bytes / %d datagrams queued%s%s\n",
+            mSessionID, type, mSocket,
+            mNumBytesRead, mNumReads, mNumBytesWritten, mNumWrites,
+            mOutBuffer.size(), mOutDatagrams.size(),
+            mSawReceiveFailure ? ", receive failed" : "",
+            mSawSendFailure ? ", send failed" : ""));
+}
+
 bool ANetworkSession::Session::isRTSPServer() const {
     return mState == LISTENING_RTSP;
 }
@@ -209,6 +270,10 @@ bool ANetworkSession::Session::isTCPDatagramServer() const {
     return mState == LISTENING_TCP_DGRAMS;
 }
 
+bool ANetworkSession::Session::isConnecting() const {
+    return mState == CONNECTING;
+}
+
 bool ANetworkSession::Session::wantsToRead() {
     return !mSawReceiveFailure && mState != CONNECTING;
 }
@@ -244,6 +309,9 @@ status_t ANetworkSession::Session::readMore() {
             } else {
                 buf->setRange(0, n);
 
+                mNumBytesRead += n;
+                ++mNumReads;
+
                 int64_t nowUs = ALooper::GetNowUs();
                 buf->meta()->setInt64("arrivalTimeUs", nowUs);
 
@@ -280,25 +348,33 @@ status_t ANetworkSession::Session::readMore() {
         return err;
     }
 
-    char tmp[512];
-    ssize_t n;
-    do {
-        n = recv(mSocket, tmp, sizeof(tmp), 0);
-    } while (n < 0 && errno == EINTR);
-
+    // The socket is registered edge-triggered, drain it completely.
     status_t err = OK;
+    for (;;) {
+        char tmp[512];
+        ssize_t n;
+        do {
+            n = recv(mSocket, tmp, sizeof(tmp), 0);
+        } while (n < 0 && errno == EINTR);
+
+        if (n > 0) {
+            mInBuffer.append(tmp, n);
 
-    if (n > 0) {
-        mInBuffer.append(tmp, n);
+            mNumBytesRead += n;
+            ++mNumReads;
 
 #if 0
-        ALOGI("in:");
-        hexdump(tmp, n);
+            ALOGI("in:");
+            hexdump(tmp, n);
 #endif
-    } else if (n < 0) {
-        err = -errno;
-    } else {
-        err = -ECONNRESET;
+        } else {
+            if (n < 0) {
+                err = (errno == EAGAIN || errno == EWOULDBLOCK) ? OK : -errno;
+            } else {
+                err = -ECONNRESET;
+            }
+            break;
+        }
     }
 
     if (!mIsRTSPConnection) {
@@ -433,6 +509,9 @@ status_t ANetworkSession::Session::writeMore() {
             err = OK;
 
             if (n > 0) {
+                mNumBytesWritten += n;
+                ++mNumWrites;
+
                 mOutDatagrams.erase(mOutDatagrams.begin());
             } else if (n < 0) {
                 err = -errno;
@@ -478,24 +557,34 @@ status_t ANetworkSession::Session::writeMore() {
     CHECK_EQ(mState, CONNECTED);
     CHECK(!mOutBuffer.empty());
 
-    ssize_t n;
-    do {
-        n = send(mSocket, mOutBuffer.c_str(), mOutBuffer.size(), 0);
-    } while (n < 0 && errno == EINTR);
-
     status_t err = OK;
 
-    if (n > 0) {
+    while (err == OK && !mOutBuffer.empty()) {
+        ssize_t n;
+        do {
+            n = send(mSocket, mOutBuffer.c_str(), mOutBuffer.size(), 0);
+        } while (n < 0 && errno == EINTR);
+
+        if (n > 0) {
 #if 0
-        ALOGI("out:");
-        hexdump(mOutBuffer.c_str(), n);
+            ALOGI("out:");
+            hexdump(mOutBuffer.c_str(), n);
 #endif
 
-        mOutBuffer.erase(0, n);
-    } else if (n < 0) {
-        err = -errno;
-    } else if (n == 0) {
-        err = -ECONNRESET;
+            mNumBytesWritten += n;
+            ++mNumWrites;
+
+            mOutBuffer.erase(0, n);
+        } else if (n < 0) {
+            err = -errno;
+        } else if (n == 0) {
+            err = -ECONNRESET;
+        }
+    }
+
+    if (err == -EAGAIN || err == -EWOULDBLOCK) {
+        // We'll be told once the socket becomes writable again.
+        err = OK;
     }
 
     if (err != OK) {
@@ -556,57 +645,176 @@ void ANetworkSession::Session::notify(NotificationReason reason) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
-ANetworkSession::ANetworkSession()
-    : mNextSessionID(1) {
+ANetworkSession::Shard::Shard()
+    : mEpollFd(-1) {
     mPipeFd[0] = mPipeFd[1] = -1;
+
+    mEpollFd = epoll_create(kMaxEvents);
+    if (mEpollFd < 0) {
+        ALOGE("epoll_create failed (%s)", strerror(errno));
+        return;
+    }
+
+    if (pipe(mPipeFd) != 0) {
+        ALOGE("pipe failed (%s)", strerror(errno));
+        mPipeFd[0] = mPipeFd[1] = -1;
+        return;
+    }
+
+    // A full pipe already guarantees a wakeup, never block on it.
+    MakeSocketNonBlocking(mPipeFd[0]);
+    MakeSocketNonBlocking(mPipeFd[1]);
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.u64 = kPipeCookie;
+
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mPipeFd[0], &ev) < 0) {
+        ALOGE("epoll_ctl failed (%s)", strerror(errno));
+        close(mEpollFd);
+        mEpollFd = -1;
+    }
+}
+
+ANetworkSession::Shard::~Shard() {
+    CHECK(mThread == NULL);
+
+    // Sessions close their sockets, which unregisters them.
+    mSessions.clear();
+
+    if (mEpollFd >= 0) {
+        close(mEpollFd);
+        mEpollFd = -1;
+    }
+
+    if (mPipeFd[0] >= 0) {
+        close(mPipeFd[0]);
+        close(mPipeFd[1]);
+        mPipeFd[0] = mPipeFd[1] = -1;
+    }
+}
+
+ANetworkSession::ANetworkSession(size_t numThreads)
+    : mStarted(false),
+      mNextSessionID(1) {
+    if (numThreads < 1) {
+        numThreads = 1;
+    }
+
+    for (size_t i = 0; i < numThreads; ++i) {
+        mShards.push(new Shard);
+    }
 }
 
 ANetworkSession::~ANetworkSession() {
     stop();
+
+    for (size_t i = 0; i < mShards.size(); ++i) {
+        delete mShards.editItemAt(i);
+    }
+    mShards.clear();
 }
 
 status_t ANetworkSession::start() {
-    if (mThread != NULL) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mStarted) {
         return INVALID_OPERATION;
     }
 
-    int res = pipe(mPipeFd);
-    if (res != 0) {
-        mPipeFd[0] = mPipeFd[1] = -1;
-        return -errno;
+    for (size_t i = 0; i < mShards.size(); ++i) {
+        if (mShards[i]->mEpollFd < 0 || mShards[i]->mPipeFd[0] < 0) {
+            return NO_INIT;
+        }
     }
 
-    mThread = new NetworkThread(this);
+    for (size_t i = 0; i < mShards.size(); ++i) {
+        Shard *shard = mShards[i];
 
-    status_t err = mThread->run("ANetworkSession", ANDROID_PRIORITY_AUDIO);
+        shard->mThread = new NetworkThread(this, shard);
 
-    if (err != OK) {
-        mThread.clear();
+        status_t err =
+            shard->mThread->run("ANetworkSession", ANDROID_PRIORITY_AUDIO);
 
-        close(mPipeFd[0]);
-        close(mPipeFd[1]);
-        mPipeFd[0] = mPipeFd[1] = -1;
+        if (err != OK) {
+            shard->mThread.clear();
 
-        return err;
+            while (i-- > 0) {
+                shard = mShards[i];
+
+                shard->mThread->requestExit();
+                interrupt(shard);
+                shard->mThread->requestExitAndWait();
+
+                shard->mThread.clear();
+            }
+
+            return err;
+        }
     }
 
+    mStarted = true;
+
     return OK;
 }
 
 status_t ANetworkSession::stop() {
-    if (mThread == NULL) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (!mStarted) {
         return INVALID_OPERATION;
     }
 
-    mThread->requestExit();
-    interrupt();
-    mThread->requestExitAndWait();
+    for (size_t i = 0; i < mShards.size(); ++i) {
+        Shard *shard = mShards[i];
 
-    mThread.clear();
+        shard->mThread->requestExit();
+        interrupt(shard);
+        shard->mThread->requestExitAndWait();
 
-    close(mPipeFd[0]);
-    close(mPipeFd[1]);
-    mPipeFd[0] = mPipeFd[1] = -1;
+        shard->mThread.clear();
+    }
+
+    mStarted = false;
+
+    return OK;
+}
+
+ANetworkSession::Shard *ANetworkSession::shardForSession(
+        int32_t sessionID) const {
+    return mShards[(uint32_t)sessionID % mShards.size()];
+}
+
+status_t ANetworkSession::addSession(
+        const sp<Session> &session, bool notifyClientConnected) {
+    Shard *shard = shardForSession(session->sessionID());
+
+    Mutex::Autolock autoLock(shard->mLock);
+
+    // Registered once for both directions, the network thread only looks
+    // at the directions the session is interested in at the time.
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+    ev.data.u64 = session->sessionID();
+
+    if (epoll_ctl(shard->mEpollFd, EPOLL_CTL_ADD, session->socket(), &ev) < 0) {
+        status_t err = -errno;
+
+        ALOGE("failed to register socket %d of session %d (%s)",
+              session->socket(), session->sessionID(), strerror(-err));
+
+        return err;
+    }
+
+    shard->mSessions.add(session->sessionID(), session);
+
+    if (notifyClientConnected) {
+        // Posted with the shard locked so that it precedes any data
+        // notification for the new session.
+        session->notifyClientConnected();
+    }
 
     return OK;
 }
@@ -688,17 +896,22 @@ status_t ANetworkSession::createTCPDatagramSession(
 }
 
 status_t ANetworkSession::destroySession(int32_t sessionID) {
-    Mutex::Autolock autoLock(mLock);
+    Shard *shard = shardForSession(sessionID);
 
-    ssize_t index = mSessions.indexOfKey(sessionID);
+    Mutex::Autolock autoLock(shard->mLock);
+
+    ssize_t index = shard->mSessions.indexOfKey(sessionID);
 
     if (index < 0) {
         return -ENOENT;
     }
 
-    mSessions.removeItemsAt(index);
+    // The socket may outlive the session if a reference is still held
+    // elsewhere, make sure we won't see any more events for it.
+    epoll_ctl(shard->mEpollFd, EPOLL_CTL_DEL,
+              shard->mSessions.valueAt(index)->socket(), NULL);
 
-    interrupt();
+    shard->mSessions.removeItemsAt(index);
 
     return OK;
 }
@@ -726,8 +939,6 @@ status_t ANetworkSession::createClientOrServer(
         unsigned remotePort,
         const sp<AMessage> &notify,
         int32_t *sessionID) {
-    Mutex::Autolock autoLock(mLock);
-
     *sessionID = 0;
     status_t err = OK;
     int s, res;
@@ -880,7 +1091,7 @@ status_t ANetworkSession::createClientOrServer(
     }
 
     session = new Session(
-            mNextSessionID++,
+            android_atomic_inc(&mNextSessionID),
             state,
             s,
             notify);
@@ -891,9 +1102,12 @@ status_t ANetworkSession::createClientOrServer(
         session->setIsRTSPConnection(true);
     }
 
-    mSessions.add(session->sessionID(), session);
+    err = addSession(session);
 
-    interrupt();
+    if (err != OK) {
+        // The session owns the socket now.
+        goto bail;
+    }
 
     *sessionID = session->sessionID();
 
@@ -909,15 +1123,17 @@ bail:
 
 status_t ANetworkSession::connectUDPSession(
         int32_t sessionID, const char *remoteHost, unsigned remotePort) {
-    Mutex::Autolock autoLock(mLock);
+    Shard *shard = shardForSession(sessionID);
+
+    Mutex::Autolock autoLock(shard->mLock);
 
-    ssize_t index = mSessions.indexOfKey(sessionID);
+    ssize_t index = shard->mSessions.indexOfKey(sessionID);
 
     if (index < 0) {
         return -ENOENT;
     }
 
-    const sp<Session> session = mSessions.valueAt(index);
+    const sp<Session> session = shard->mSessions.valueAt(index);
     int s = session->socket();
 
     struct sockaddr_in remoteAddr;
@@ -947,73 +1163,74 @@ status_t ANetworkSession::connectUDPSession(
 
 status_t ANetworkSession::sendRequest(
         int32_t sessionID, const void *data, ssize_t size) {
-    Mutex::Autolock autoLock(mLock);
+    Shard *shard = shardForSession(sessionID);
 
-    ssize_t index = mSessions.indexOfKey(sessionID);
+    Mutex::Autolock autoLock(shard->mLock);
+
+    ssize_t index = shard->mSessions.indexOfKey(sessionID);
 
     if (index < 0) {
         return -ENOENT;
     }
 
-    const sp<Session> session = mSessions.valueAt(index);
+    const sp<Session> session = shard->mSessions.valueAt(index);
 
     status_t err = session->sendRequest(data, size);
 
-    interrupt();
+    // Sockets are registered edge-triggered, so there won't be another
+    // EPOLLOUT unless a send fails with EAGAIN. Send right away instead of
+    // waking up the network thread, whatever doesn't fit is sent from there.
+    if (err == OK && session->wantsToWrite()) {
+        status_t writeErr = session->writeMore();
+        if (writeErr != OK) {
+            ALOGE("writeMore on socket %d failed w/ error %d (%s)",
+                  session->socket(), writeErr, strerror(-writeErr));
+        }
+    }
 
     return err;
 }
 
-void ANetworkSession::interrupt() {
-    static const char dummy = 0;
-
-    ssize_t n;
-    do {
-        n = write(mPipeFd[1], &dummy, 1);
-    } while (n < 0 && errno == EINTR);
+status_t ANetworkSession::dump(
+        int fd, const Vector<String16> & /* args */) const {
+    AString result = StringPrintf(
+            "ANetworkSession: %d thread(s)\n", mShards.size());
 
-    if (n < 0) {
-        ALOGW("Error writing to pipe (%s)", strerror(errno));
-    }
-}
+    for (size_t i = 0; i < mShards.size(); ++i) {
+        const Shard *shard = mShards[i];
 
-void ANetworkSession::threadLoop() {
-    fd_set rs, ws;
-    FD_ZERO(&rs);
-    FD_ZERO(&ws);
+        Mutex::Autolock autoLock(shard->mLock);
 
-    FD_SET(mPipeFd[0], &rs);
-    int maxFd = mPipeFd[0];
+        result.append(StringPrintf(
+                " thread %d: %d session(s)\n", i, shard->mSessions.size()));
 
-    {
-        Mutex::Autolock autoLock(mLock);
+        for (size_t j = 0; j < shard->mSessions.size(); ++j) {
+            shard->mSessions.valueAt(j)->dump(&result);
+        }
+    }
 
-        for (size_t i = 0; i < mSessions.size(); ++i) {
-            const sp<Session> &session = mSessions.valueAt(i);
+    write(fd, result.c_str(), result.size());
 
-            int s = session->socket();
+    return OK;
+}
 
-            if (s < 0) {
-                continue;
-            }
+void ANetworkSession::interrupt(Shard *shard) {
+    static const char dummy = 0;
 
-            if (session->wantsToRead()) {
-                FD_SET(s, &rs);
-                if (s > maxFd) {
-                    maxFd = s;
-                }
-            }
+    ssize_t n;
+    do {
+        n = write(shard->mPipeFd[1], &dummy, 1);
+    } while (n < 0 && errno == EINTR);
 
-            if (session->wantsToWrite()) {
-                FD_SET(s, &ws);
-                if (s > maxFd) {
-                    maxFd = s;
-                }
-            }
-        }
+    if (n < 0 && errno != EAGAIN) {
+        ALOGW("Error writing to pipe (%s)", strerror(errno));
     }
+}
 
-    int res = select(maxFd + 1, &rs, &ws, NULL, NULL /* tv */);
+void ANetworkSession::threadLoop(Shard *shard) {
+    struct epoll_event events[kMaxEvents];
+
+    int res = epoll_wait(shard->mEpollFd, events, kMaxEvents, -1 /* timeout */);
 
     if (res == 0) {
         return;
@@ -1024,31 +1241,38 @@ void ANetworkSession::threadLoop() {
             return;
         }
 
-        ALOGE("select failed w/ error %d (%s)", errno, strerror(errno));
+        ALOGE("epoll_wait failed w/ error %d (%s)", errno, strerror(errno));
         return;
     }
 
-    if (FD_ISSET(mPipeFd[0], &rs)) {
-        char c;
-        ssize_t n;
-        do {
-            n = read(mPipeFd[0], &c, 1);
-        } while (n < 0 && errno == EINTR);
-
-        if (n < 0) {
-            ALOGW("Error reading from pipe (%s)", strerror(errno));
-        }
-
-        --res;
-    }
+    List<sp<Session> > sessionsToAdd;
 
     {
-        Mutex::Autolock autoLock(mLock);
+        Mutex::Autolock autoLock(shard->mLock);
+
+        for (int i = 0; i < res; ++i) {
+            if (events[i].data.u64 == kPipeCookie) {
+                char c[16];
+                ssize_t n;
+                do {
+                    n = read(shard->mPipeFd[0], c, sizeof(c));
+                } while (n > 0 || (n < 0 && errno == EINTR));
+
+                if (n < 0 && errno != EAGAIN) {
+                    ALOGW("Error reading from pipe (%s)", strerror(errno));
+                }
+                continue;
+            }
+
+            int32_t sessionID = (int32_t)events[i].data.u64;
 
-        List<sp<Session> > sessionsToAdd;
+            ssize_t index = shard->mSessions.indexOfKey(sessionID);
+            if (index < 0) {
+                // Destroyed after the event was reported.
+                continue;
+            }
 
-        for (size_t i = mSessions.size(); res > 0 && i-- > 0;) {
-            const sp<Session> &session = mSessions.valueAt(i);
+            const sp<Session> session = shard->mSessions.valueAt(index);
 
             int s = session->socket();
 
@@ -1056,19 +1280,41 @@ void ANetworkSession::threadLoop() {
                 continue;
             }
 
-            if (FD_ISSET(s, &rs) || FD_ISSET(s, &ws)) {
-                --res;
+            uint32_t flags = events[i].events;
+            bool readable = (flags & (EPOLLIN | EPOLLERR | EPOLLHUP)) != 0;
+            bool writable = (flags & (EPOLLOUT | EPOLLERR | EPOLLHUP)) != 0;
+
+            if (writable && session->isConnecting()) {
+                // Complete the connection first, data that arrived along
+                // with it will not be reported again.
+                status_t err = session->writeMore();
+                if (err != OK) {
+                    ALOGE("connect on socket %d failed w/ error %d (%s)",
+                          s, err, strerror(-err));
+                }
             }
 
-            if (FD_ISSET(s, &rs)) {
+            if (readable && session->wantsToRead()) {
                 if (session->isRTSPServer() || session->isTCPDatagramServer()) {
-                    struct sockaddr_in remoteAddr;
-                    socklen_t remoteAddrLen = sizeof(remoteAddr);
-
-                    int clientSocket = accept(
-                            s, (struct sockaddr *)&remoteAddr, &remoteAddrLen);
+                    for (;;) {
+                        struct sockaddr_in remoteAddr;
+                        socklen_t remoteAddrLen = sizeof(remoteAddr);
+
+                        int clientSocket = accept(
+                                s, (struct sockaddr *)&remoteAddr, &remoteAddrLen);
+
+                        if (clientSocket < 0) {
+                            if (errno == EINTR) {
+                                continue;
+                            }
+
+                            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                                ALOGE("accept returned error %d (%s)",
+                                      errno, strerror(errno));
+                            }
+                            break;
+                        }
 
-                    if (clientSocket >= 0) {
                         status_t err = MakeSocketNonBlocking(clientSocket);
 
                         if (err != OK) {
@@ -1078,34 +1324,31 @@ void ANetworkSession::threadLoop() {
 
                             close(clientSocket);
                             clientSocket = -1;
-                        } else {
-                            in_addr_t addr = ntohl(remoteAddr.sin_addr.s_addr);
-
-                            ALOGI("incoming connection from %d.%d.%d.%d:%d "
-                                  "(socket %d)",
-                                  (addr >> 24),
-                                  (addr >> 16) & 0xff,
-                                  (addr >> 8) & 0xff,
-                                  addr & 0xff,
-                                  ntohs(remoteAddr.sin_port),
-                                  clientSocket);
-
-                            sp<Session> clientSession =
-                                // using socket sd as sessionID
-                                new Session(
-                                        mNextSessionID++,
-                                        Session::CONNECTED,
-                                        clientSocket,
-                                        session->getNotificationMessage());
-
-                            clientSession->setIsRTSPConnection(
-                                    session->isRTSPServer());
-
-                            sessionsToAdd.push_back(clientSession);
+                            continue;
                         }
-                    } else {
-                        ALOGE("accept returned error %d (%s)",
-                              errno, strerror(errno));
+
+                        in_addr_t addr = ntohl(remoteAddr.sin_addr.s_addr);
+
+                        ALOGI("incoming connection from %d.%d.%d.%d:%d "
+                              "(socket %d)",
+                              (addr >> 24),
+                              (addr >> 16) & 0xff,
+                              (addr >> 8) & 0xff,
+                              addr & 0xff,
+                              ntohs(remoteAddr.sin_port),
+                              clientSocket);
+
+                        sp<Session> clientSession =
+                            new Session(
+                                    android_atomic_inc(&mNextSessionID),
+                                    Session::CONNECTED,
+                                    clientSocket,
+                                    session->getNotificationMessage());
+
+                        clientSession->setIsRTSPConnection(
+                                session->isRTSPServer());
+
+                        sessionsToAdd.push_back(clientSession);
                     }
                 } else {
                     status_t err = session->readMore();
@@ -1116,7 +1359,7 @@ void ANetworkSession::threadLoop() {
                 }
             }
 
-            if (FD_ISSET(s, &ws)) {
+            if (writable && session->wantsToWrite()) {
                 status_t err = session->writeMore();
                 if (err != OK) {
                     ALOGE("writeMore on socket %d failed w/ error %d (%s)",
@@ -1124,17 +1367,18 @@ void ANetworkSession::threadLoop() {
                 }
             }
         }
+    }
 
-        while (!sessionsToAdd.empty()) {
-            sp<Session> session = *sessionsToAdd.begin();
-            sessionsToAdd.erase(sessionsToAdd.begin());
-
-            mSessions.add(session->sessionID(), session);
+    // New sessions may belong to another shard, add them without holding
+    // our own lock.
+    while (!sessionsToAdd.empty()) {
+        sp<Session> session = *sessionsToAdd.begin();
+        sessionsToAdd.erase(sessionsToAdd.begin());
 
+        if (addSession(session, true /* notifyClientConnected */) == OK) {
             ALOGI("added clientSession %d", session->sessionID());
         }
     }
 }
 
 }  // namespace android
-
@@ -21,7 +21,9 @@
 #include <media/stagefright/foundation/ABase.h>
 #include <utils/KeyedVector.h>
 #include <utils/RefBase.h>
+#include <utils/String16.h>
 #include <utils/Thread.h>
+#include <utils/Vector.h>
 
 #include <netinet/in.h>
 
@@ -30,9 +32,11 @@ namespace android {
 struct AMessage;
 
 // Helper class to manage a number of live sockets (datagram and stream-based)
-// on a single thread. Clients are notified about activity through AMessages.
+// on one or more threads. Sessions are distributed across the threads by
+// session ID, all activity of a given session happens on the same thread.
+// Clients are notified about activity through AMessages.
 struct ANetworkSession : public RefBase {
-    ANetworkSession();
+    ANetworkSession(size_t numThreads = 1);
 
     status_t start();
     status_t stop();
@@ -76,6 +80,9 @@ struct ANetworkSession : public RefBase {
     status_t sendRequest(
             int32_t sessionID, const void *data, ssize_t size = -1);
 
+    // Lists all sessions along with their read/write statistics.
+    status_t dump(int fd, const Vector<String16> &args) const;
+
     enum NotificationReason {
         kWhatError,
         kWhatConnected,
@@ -92,14 +99,28 @@ private:
     struct NetworkThread;
     struct Session;
 
-    Mutex mLock;
-    sp<Thread> mThread;
+    // The sessions served by one thread, each one owns an epoll instance
+    // with all of its sessions' sockets registered (edge-triggered) for as
+    // long as the session exists.
+    struct Shard {
+        Shard();
+        ~Shard();
+
+        mutable Mutex mLock;
+        KeyedVector<int32_t, sp<Session> > mSessions;
+
+        int mEpollFd;
+        int mPipeFd[2];
 
-    int32_t mNextSessionID;
+        sp<Thread> mThread;
+    };
+
+    Mutex mLock;
+    bool mStarted;
 
-    int mPipeFd[2];
+    volatile int32_t mNextSessionID;
 
-    KeyedVector<int32_t, sp<Session> > mSessions;
+    Vector<Shard *> mShards;
 
     enum Mode {
         kModeCreateUDPSession,
@@ -117,8 +138,12 @@ private:
             const sp<AMessage> &notify,
             int32_t *sessionID);
 
-    void threadLoop();
-    void interrupt();
+    Shard *shardForSession(int32_t sessionID) const;
+    status_t addSession(
+            const sp<Session> &session, bool notifyClientConnected = false);
+
+    void threadLoop(Shard *shard);
+    void interrupt(Shard *shard);
 
     static status_t MakeSocketNonBlocking(int s);
 
@@ -58,6 +58,10 @@ LOCAL_SRC_FILES += FastMixer.cpp FastMixerState.cpp
 
 LOCAL_CFLAGS += -DFAST_MIXER_STATISTICS
 
+LOCAL_SRC_FILES += FastCapture.cpp FastCaptureState.cpp
+
+LOCAL_CFLAGS += -DFAST_CAPTURE_STATISTICS
+
 # uncomment to display CPU load adjusted for CPU frequency
 # LOCAL_CFLAGS += -DCPU_FREQUENCY_STATISTICS
 
@@ -100,5 +104,54 @@ LOCAL_MODULE_TAGS := optional
 
 include $(BUILD_EXECUTABLE)
 
+#
+# build audio mixer benchmark
+#
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+    test-mixer.cpp              \
+    AudioMixer.cpp.arm          \
+    AudioResampler.cpp.arm      \
+    AudioResamplerCubic.cpp.arm \
+    AudioResamplerSinc.cpp.arm
+
+LOCAL_C_INCLUDES := \
+    $(call include-path-for, audio-effects) \
+    $(call include-path-for, audio-utils)
+
+LOCAL_SHARED_LIBRARIES := \
+    libaudioutils \
+    libcommon_time_client \
+    libeffects \
+    libdl \
+    libcutils \
+    libutils
+
+LOCAL_MODULE:= test-mixer
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_EXECUTABLE)
+
+#
+# build control block latency benchmark
+#
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+    test-cblk.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+    libmedia \
+    libcutils \
+    libutils
+
+LOCAL_MODULE:= test-cblk
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_EXECUTABLE)
+
 
 include $(call all-makefiles-under,$(LOCAL_PATH))
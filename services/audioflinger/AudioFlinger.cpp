@@ -75,8 +75,10 @@
 #include <common_time/local_clock.h>
 
 #include "FastMixer.h"
+#include "FastCapture.h"
 
 // NBAIO implementations
+#include <media/nbaio/AudioStreamInSource.h>
 #include <media/nbaio/AudioStreamOutSink.h>
 #include <media/nbaio/MonoPipe.h>
 #include <media/nbaio/MonoPipeReader.h>
@@ -159,12 +161,27 @@ static const enum {
     //  up large writes into smaller ones, and the wrapper would need to deal with scheduler.
 } kUseFastMixer = FastMixer_Static;
 
+// Whether to use fast capture
+static const enum {
+    FastCapture_Never,  // never initialize or use: for debugging only
+    FastCapture_Always, // always initialize and use, even if not needed: for debugging only
+    FastCapture_Static, // initialize if the HAL input buffer is short enough, then use all the time
+} kUseFastCapture = FastCapture_Static;
+
+// maximum HAL input buffer size for which FastCapture_Static initializes fast capture;
+// with longer buffers the record thread already keeps up without SCHED_FIFO
+static const uint32_t kMaxFastCaptureBufferSizeMs = 10;
+
+// number of HAL buffer periods RecordThread waits for fast capture to write before giving up
+static const int kFastCaptureMaxWaitPeriods = 8;
+
 static uint32_t gScreenState; // incremented by 2 when screen state changes, bit 0 == 1 means "off"
                               // AudioFlinger::setParameters() updates, other threads read w/o lock
 
 // Priorities for requestPriority
 static const int kPriorityAudioApp = 2;
 static const int kPriorityFastMixer = 3;
+static const int kPriorityFastCapture = 3;
 
 // IAudioFlinger::createTrack() reports back to client the total size of shared memory area
 // for the track.  The client then sub-divides this into smaller buffers for its use.
@@ -3427,7 +3444,7 @@ void AudioFlinger::PlaybackThread::invalidateTracks(audio_stream_type_t streamTy
         sp<Track> t = mTracks[i];
         if (t->streamType() == streamType) {
             android_atomic_or(CBLK_INVALID_ON, &t->mCblk->flags);
-            t->mCblk->cv.signal();
+            t->mCblk->wake();
         }
     }
 }
@@ -4508,19 +4525,16 @@ status_t AudioFlinger::PlaybackThread::Track::getNextBuffer(
 
     // Check if last stepServer failed, try to step now
     if (mStepServerFailed) {
-        // FIXME When called by fast mixer, this takes a mutex with tryLock().
-        //       Since the fast mixer is higher priority than client callback thread,
-        //       it does not result in priority inversion for client.
-        //       But a non-blocking solution would be preferable to avoid
-        //       fast mixer being unable to tryLock(), and
-        //       to avoid the extra context switches if the client wakes up,
-        //       discovers the mutex is locked, then has to wait for fast mixer to unlock.
+        // stepServer() only takes the cblk mutex when a loop is set.  Fast tracks can have
+        // one too, as static tracks are eligible for the fast mixer and can loop.  The mutex
+        // is taken with tryLock(), so the fast mixer never blocks on it: if the client holds
+        // it, the step fails and is retried here on the next call.
         if (!step())  goto getNextBuffer_exit;
         ALOGV("stepServer recovered");
         mStepServerFailed = false;
     }
 
-    // FIXME Same as above
+    // Same as above
     framesReady = cblk->framesReady();
 
     if (CC_LIKELY(framesReady)) {
@@ -4547,14 +4561,9 @@ getNextBuffer_exit:
     return NOT_ENOUGH_DATA;
 }
 
-// Note that framesReady() takes a mutex on the control block using tryLock().
-// This could result in priority inversion if framesReady() is called by the normal mixer,
-// as the normal mixer thread runs at lower
-// priority than the client's callback thread:  there is a short window within framesReady()
-// during which the normal mixer could be preempted, and the client callback would block.
-// Another problem can occur if framesReady() is called by the fast mixer:
-// the tryLock() could block for up to 1 ms, and a sequence of these could delay fast mixer.
-// FIXME Replace AudioTrackShared control block implementation by a non-blocking FIFO queue.
+// Note that framesReady() is lock-free, except when the client has set a loop: it then takes
+// a mutex on the control block using tryLock(), which could block for up to 1 ms and
+// result in priority inversion if called by the normal mixer.
 size_t AudioFlinger::PlaybackThread::Track::framesReady() const {
     return mCblk->framesReady();
 }
@@ -5672,23 +5681,24 @@ status_t AudioFlinger::PlaybackThread::OutputTrack::obtainBuffer(AudioBufferProv
     uint32_t framesAvail = cblk->framesAvailable();
 
 
-    if (framesAvail == 0) {
-        Mutex::Autolock _l(cblk->lock);
-        goto start_loop_here;
-        while (framesAvail == 0) {
-            active = mActive;
-            if (CC_UNLIKELY(!active)) {
-                ALOGV("Not active and NO_MORE_BUFFERS");
-                return NO_MORE_BUFFERS;
-            }
-            result = cblk->cv.waitRelative(cblk->lock, milliseconds(waitTimeMs));
-            if (result != NO_ERROR) {
-                return NO_MORE_BUFFERS;
-            }
-            // read the server count again
-        start_loop_here:
-            framesAvail = cblk->framesAvailable_l();
+    while (framesAvail == 0) {
+        active = mActive;
+        if (CC_UNLIKELY(!active)) {
+            ALOGV("Not active and NO_MORE_BUFFERS");
+            return NO_MORE_BUFFERS;
+        }
+        // see AudioTrack::obtainBuffer()
+        int32_t sequence = cblk->prepareWaitServer();
+        framesAvail = cblk->framesAvailable();
+        if (framesAvail != 0) {
+            break;
         }
+        result = cblk->waitServer(sequence, waitTimeMs);
+        if (result != NO_ERROR) {
+            return NO_MORE_BUFFERS;
+        }
+        // read the server count again
+        framesAvail = cblk->framesAvailable();
     }
 
 //    if (framesAvail < framesReq) {
@@ -5995,9 +6005,13 @@ AudioFlinger::RecordThread::RecordThread(const sp<AudioFlinger>& audioFlinger,
     mInput(input), mResampler(NULL), mRsmpOutBuffer(NULL), mRsmpInBuffer(NULL),
     // mRsmpInIndex and mInputBytes set by readInputParameters()
     mReqChannelCount(popcount(channelMask)),
-    mReqSampleRate(sampleRate)
+    mReqSampleRate(sampleRate),
     // mBytesRead is only meaningful while active, and so is cleared in start()
     // (but might be better to also clear here for dump?)
+    mFastCapture(NULL),
+    // mInputSource and mPipeSink are set by initFastCapture(), mPipeSource by startFastCapture()
+    mFastCaptureFutex(0),
+    mFastCaptureReadFutex(0)
 {
     snprintf(mName, kNameLength, "AudioIn_%X", id);
 
@@ -6007,6 +6021,7 @@ AudioFlinger::RecordThread::RecordThread(const sp<AudioFlinger>& audioFlinger,
 
 AudioFlinger::RecordThread::~RecordThread()
 {
+    deleteFastCapture();
     delete[] mRsmpInBuffer;
     delete mResampler;
     delete[] mRsmpOutBuffer;
@@ -6129,10 +6144,10 @@ bool AudioFlinger::RecordThread::threadLoop()
                         if (framesOut && mFrameCount == mRsmpInIndex) {
                             if (framesOut == mFrameCount &&
                                 ((int)mChannelCount == mReqChannelCount || mFormat != AUDIO_FORMAT_PCM_16_BIT)) {
-                                mBytesRead = mInput->stream->read(mInput->stream, buffer.raw, mInputBytes);
+                                mBytesRead = readInput(buffer.raw);
                                 framesOut = 0;
                             } else {
-                                mBytesRead = mInput->stream->read(mInput->stream, mRsmpInBuffer, mInputBytes);
+                                mBytesRead = readInput(mRsmpInBuffer);
                                 mRsmpInIndex = 0;
                             }
                             if (mBytesRead <= 0) {
@@ -6237,9 +6252,218 @@ void AudioFlinger::RecordThread::standby()
 
 void AudioFlinger::RecordThread::inputStandBy()
 {
+    // the fast capture thread must not be inside the HAL read when we put the HAL in standby
+    idleFastCapture();
     mInput->stream->common.standby(&mInput->stream->common);
 }
 
+void AudioFlinger::RecordThread::initFastCapture()
+{
+    ALOG_ASSERT(mFastCapture == NULL);
+    if (mInput == NULL) {
+        return;
+    }
+
+    // initialize fast capture depending on configuration
+    size_t frameCount = mInputBytes / mFrameSize;
+    bool initFastCapture;
+    switch (kUseFastCapture) {
+    case FastCapture_Never:
+        initFastCapture = false;
+        break;
+    case FastCapture_Always:
+        initFastCapture = true;
+        break;
+    case FastCapture_Static:
+        initFastCapture = frameCount * 1000 <= kMaxFastCaptureBufferSizeMs * mSampleRate;
+        break;
+    }
+    // NBAIO only describes 16-bit PCM, mono or stereo, at 44.1 or 48 kHz
+    NBAIO_Format format = Format_from_SR_C(mSampleRate, mChannelCount);
+    if (mFormat != AUDIO_FORMAT_PCM_16_BIT || format == Format_Invalid) {
+        initFastCapture = false;
+    }
+    if (!initFastCapture) {
+        return;
+    }
+
+    // create an NBAIO source for the HAL input stream, and negotiate
+    mInputSource = new AudioStreamInSource(mInput->stream);
+    size_t numCounterOffers = 0;
+    const NBAIO_Format offers[1] = {format};
+    ssize_t index = mInputSource->negotiate(offers, 1, NULL, numCounterOffers);
+    ALOG_ASSERT(index == 0);
+
+    // create a Pipe for fast capture to write into; our own reader is attached by
+    // startFastCapture().  This pipe depth compensates for scheduling latency of the record
+    // thread, which drains one HAL buffer at a time.  Note the pipe implementation rounds up
+    // the request to a power of 2.  Further readers can be attached to the same pipe without
+    // affecting the writer.
+    Pipe *pipe = new Pipe(frameCount * 8, format);
+    numCounterOffers = 0;
+    index = pipe->negotiate(offers, 1, NULL, numCounterOffers);
+    ALOG_ASSERT(index == 0);
+    mPipeSink = pipe;
+
+    // create fast capture and leave it in cold idle until the first read
+    mFastCapture = new FastCapture();
+    FastCaptureStateQueue *sq = mFastCapture->sq();
+#ifdef STATE_QUEUE_DUMP
+    sq->setObserverDump(&mFastCaptureObserverDump);
+    sq->setMutatorDump(&mFastCaptureMutatorDump);
+#endif
+    FastCaptureState *state = sq->begin();
+    state->mInputSource = mInputSource.get();
+    state->mInputSourceGen++;
+    state->mPipeSink = pipe;
+    state->mPipeSinkGen++;
+    state->mFrameCount = frameCount;
+    state->mCommand = FastCaptureState::COLD_IDLE;
+    mFastCaptureFutex = 0;
+    state->mColdFutexAddr = &mFastCaptureFutex;
+    state->mColdGen++;
+    state->mReadFutexAddr = &mFastCaptureReadFutex;
+    state->mDumpState = &mFastCaptureDumpState;
+    sq->end();
+    sq->push(FastCaptureStateQueue::BLOCK_UNTIL_PUSHED);
+
+    // start the fast capture
+    mFastCapture->run("FastCapture", PRIORITY_URGENT_AUDIO);
+    pid_t tid = mFastCapture->getTid();
+    int err = requestPriority(getpid_cached, tid, kPriorityFastCapture);
+    if (err != 0) {
+        ALOGW("Policy SCHED_FIFO priority %d is unavailable for pid %d tid %d; error %d",
+                kPriorityFastCapture, getpid_cached, tid, err);
+    }
+}
+
+void AudioFlinger::RecordThread::deleteFastCapture()
+{
+    if (mFastCapture == NULL) {
+        return;
+    }
+    FastCaptureStateQueue *sq = mFastCapture->sq();
+    FastCaptureState *state = sq->begin();
+    if (state->mCommand == FastCaptureState::COLD_IDLE) {
+        int32_t old = android_atomic_inc(&mFastCaptureFutex);
+        if (old == -1) {
+            __futex_syscall3(&mFastCaptureFutex, FUTEX_WAKE_PRIVATE, 1);
+        }
+    }
+    state->mCommand = FastCaptureState::EXIT;
+    sq->end();
+    sq->push(FastCaptureStateQueue::BLOCK_UNTIL_PUSHED);
+    mFastCapture->join();
+    delete mFastCapture;
+    mFastCapture = NULL;
+    // a PipeReader must not outlive its Pipe
+    mPipeSource.clear();
+    mPipeSink.clear();
+    mInputSource.clear();
+}
+
+void AudioFlinger::RecordThread::startFastCapture()
+{
+    if (mFastCapture == NULL) {
+        return;
+    }
+    FastCaptureStateQueue *sq = mFastCapture->sq();
+    FastCaptureState *state = sq->begin();
+    if (state->mCommand != FastCaptureState::READ_WRITE) {
+        // Anything still in the pipe was captured before the idle and is stale by now.
+        // A new reader only sees what is written after it is attached.
+        mPipeSource.clear();
+        PipeReader *pipeReader = new PipeReader(*(Pipe *) mPipeSink.get());
+        size_t numCounterOffers = 0;
+        const NBAIO_Format offers[1] = {mPipeSink->format()};
+        ssize_t index = pipeReader->negotiate(offers, 1, NULL, numCounterOffers);
+        ALOG_ASSERT(index == 0);
+        mPipeSource = pipeReader;
+        if (state->mCommand == FastCaptureState::COLD_IDLE) {
+            int32_t old = android_atomic_inc(&mFastCaptureFutex);
+            if (old == -1) {
+                __futex_syscall3(&mFastCaptureFutex, FUTEX_WAKE_PRIVATE, 1);
+            }
+        }
+        state->mCommand = FastCaptureState::READ_WRITE;
+        sq->end();
+        sq->push(FastCaptureStateQueue::BLOCK_UNTIL_PUSHED);
+    } else {
+        sq->end(false /*didModify*/);
+    }
+}
+
+void AudioFlinger::RecordThread::idleFastCapture()
+{
+    if (mFastCapture == NULL) {
+        return;
+    }
+    FastCaptureStateQueue *sq = mFastCapture->sq();
+    FastCaptureState *state = sq->begin();
+    if (!(state->mCommand & FastCaptureState::IDLE)) {
+        state->mCommand = FastCaptureState::COLD_IDLE;
+        state->mColdFutexAddr = &mFastCaptureFutex;
+        state->mColdGen++;
+        mFastCaptureFutex = 0;
+        sq->end();
+        // BLOCK_UNTIL_PUSHED would be insufficient, as we need it to stop doing I/O now
+        sq->push(FastCaptureStateQueue::BLOCK_UNTIL_ACKED);
+    } else {
+        sq->end(false /*didModify*/);
+    }
+}
+
+ssize_t AudioFlinger::RecordThread::readInput(void *buffer)
+{
+    if (mFastCapture == NULL) {
+        return mInput->stream->read(mInput->stream, buffer, mInputBytes);
+    }
+
+    // HAL errors seen by fast capture while we wait are returned as if we had read the HAL
+    // ourselves, so that the callers' error handling still applies.
+    uint32_t readErrors = (uint32_t) android_atomic_acquire_load(
+            (int32_t *) &mFastCaptureDumpState.mReadErrors);
+
+    startFastCapture();
+
+    // The pipe never blocks, so wait on the read futex until fast capture has written again.
+    // The futex is sampled before each pipe read, so a write in between is not missed.
+    // Give up after a few periods without a write: fast capture is stuck in the HAL.
+    size_t frameCount = mInputBytes / mFrameSize;
+    int64_t timeoutNs = (frameCount * kFastCaptureMaxWaitPeriods * 1000000000LL) / mSampleRate;
+    const struct timespec timeout = {(time_t) (timeoutNs / 1000000000LL),
+            (long) (timeoutNs % 1000000000LL)};
+    size_t framesRead = 0;
+    while (framesRead < frameCount) {
+        int32_t readSequence = android_atomic_acquire_load(&mFastCaptureReadFutex);
+        ssize_t ret = mPipeSource->read((int8_t *)buffer + framesRead * mFrameSize,
+                frameCount - framesRead, AudioBufferProvider::kInvalidPTS);
+        if (ret > 0) {
+            framesRead += ret;
+        } else if (ret == (ssize_t) OVERRUN) {
+            // we fell behind the fast capture and the oldest data was dropped; the reader has
+            // skipped ahead, so what we already have is no longer contiguous with the rest
+            ALOGW("RecordThread: fast capture pipe overrun");
+            framesRead = 0;
+        } else if (ret == 0 || ret == (ssize_t) WOULD_BLOCK) {
+            if ((uint32_t) android_atomic_acquire_load(
+                    (int32_t *) &mFastCaptureDumpState.mReadErrors) != readErrors) {
+                status_t status = mFastCaptureDumpState.mLastReadError;
+                ALOGW("RecordThread: fast capture read failed: %d", status);
+                return status < 0 ? status : -EIO;
+            }
+            if (__futex_syscall4(&mFastCaptureReadFutex, FUTEX_WAIT_PRIVATE, readSequence,
+                    &timeout) == -ETIMEDOUT) {
+                ALOGW("RecordThread: timed out waiting for fast capture");
+                return TIMED_OUT;
+            }
+        } else {
+            return ret;
+        }
+    }
+    return mInputBytes;
+}
+
 sp<AudioFlinger::RecordThread::RecordTrack>  AudioFlinger::RecordThread::createRecordTrack_l(
         const sp<AudioFlinger::Client>& client,
         uint32_t sampleRate,
@@ -6511,6 +6735,18 @@ void AudioFlinger::RecordThread::dumpInternals(int fd, const Vector<String16>& a
     write(fd, result.string(), result.size());
 
     dumpBase(fd, args);
+
+    // Make a non-atomic copy of fast capture dump state so it won't change underneath us
+    FastCaptureDumpState copy = mFastCaptureDumpState;
+    copy.dump(fd);
+
+#ifdef STATE_QUEUE_DUMP
+    // Similar for state queue
+    StateQueueObserverDump observerCopy = mFastCaptureObserverDump;
+    observerCopy.dump(fd);
+    StateQueueMutatorDump mutatorCopy = mFastCaptureMutatorDump;
+    mutatorCopy.dump(fd);
+#endif
 }
 
 void AudioFlinger::RecordThread::dumpTracks(int fd, const Vector<String16>& args)
@@ -6549,7 +6785,7 @@ status_t AudioFlinger::RecordThread::getNextBuffer(AudioBufferProvider::Buffer*
     int channelCount;
 
     if (framesReady == 0) {
-        mBytesRead = mInput->stream->read(mInput->stream, mRsmpInBuffer, mInputBytes);
+        mBytesRead = readInput(mRsmpInBuffer);
         if (mBytesRead <= 0) {
             if ((mBytesRead < 0) && (mActiveTrack->mState == TrackBase::ACTIVE)) {
                 ALOGE("RecordThread::getNextBuffer() Error reading audio input");
@@ -6659,6 +6895,9 @@ bool AudioFlinger::RecordThread::checkForNewParameters_l()
             mAudioSource = (audio_source_t)value;
         }
         if (status == NO_ERROR) {
+            // the HAL isn't expected to handle set_parameters concurrently with a read;
+            // fast capture restarts at the next readInput()
+            idleFastCapture();
             status = mInput->stream->common.set_parameters(&mInput->stream->common, keyValuePair.string());
             if (status == INVALID_OPERATION) {
                 inputStandBy();
@@ -6732,6 +6971,9 @@ void AudioFlinger::RecordThread::audioConfigChanged_l(int event, int param) {
 
 void AudioFlinger::RecordThread::readInputParameters()
 {
+    // the input configuration may have changed underneath the fast capture
+    deleteFastCapture();
+
     delete mRsmpInBuffer;
     // mRsmpInBuffer is always assigned a new[] below
     delete mRsmpOutBuffer;
@@ -6771,6 +7013,8 @@ void AudioFlinger::RecordThread::readInputParameters()
 
     }
     mRsmpInIndex = mFrameCount;
+
+    initFastCapture();
 }
 
 unsigned int AudioFlinger::RecordThread::getInputFramesLost()
@@ -48,6 +48,7 @@
 #include <media/AudioBufferProvider.h>
 #include <media/ExtendedAudioBufferProvider.h>
 #include "FastMixer.h"
+#include "FastCapture.h"
 #include <media/nbaio/NBAIO.h>
 #include "AudioWatchdog.h"
 
@@ -1551,6 +1552,21 @@ private:
                 // Call the HAL standby method unconditionally, and don't change mStandby flag
                 void inputStandBy();
 
+                // Create the fast capture thread and its pipe if the input configuration allows it
+                void initFastCapture();
+
+                // Stop and delete the fast capture thread, if any
+                void deleteFastCapture();
+
+                // Ask the fast capture thread to start reading, if it isn't already
+                void startFastCapture();
+
+                // Put the fast capture thread into cold idle, and wait until it no longer reads
+                void idleFastCapture();
+
+                // Read one HAL buffer of mInputBytes, from the fast capture pipe if there is one
+                ssize_t readInput(void *buffer);
+
                 AudioStreamIn                       *mInput;
                 SortedVector < sp<RecordTrack> >    mTracks;
                 // mActiveTrack has dual roles:  it indicates the current active track, and
@@ -1572,6 +1588,28 @@ private:
                 // when < 0, maximum frames to drop before starting capture even if sync event is
                 // not received
                 ssize_t                             mFramestoDrop;
+
+                // one-time initialization per input configuration, no locks required
+                FastCapture*                        mFastCapture;   // non-NULL if there is also a
+                                                                    // fast capture
+                sp<NBAIO_Source>                    mInputSource;   // HAL input, read by fast capture
+                sp<NBAIO_Sink>                      mPipeSink;      // written by fast capture
+                sp<NBAIO_Source>                    mPipeSource;    // our reader of mPipeSink,
+                                                                    // replaced at each start
+
+                // contents are not guaranteed to be consistent, no locks required
+                FastCaptureDumpState                mFastCaptureDumpState;
+#ifdef STATE_QUEUE_DUMP
+                StateQueueObserverDump              mFastCaptureObserverDump;
+                StateQueueMutatorDump               mFastCaptureMutatorDump;
+#endif
+
+                // accessible only within the threadLoop(), no locks required
+                //          mFastCapture->sq()      // for mutating and pushing state
+                int32_t                             mFastCaptureFutex;  // for cold idle
+
+                // incremented and woken by fast capture, readInput() waits on it
+                int32_t                             mFastCaptureReadFutex;
     };
 
     // server side of the client's IAudioRecord
@@ -39,6 +39,7 @@
 #include <media/EffectsFactoryApi.h>
 
 #include "AudioMixer.h"
+#include "AudioMixerKernels.h"
 
 namespace android {
 
@@ -930,12 +931,8 @@ void AudioMixer::track__16BitsStereo(track_t* t, int32_t* out, size_t frameCount
             //        t, vlInc/65536.0f, vl/65536.0f, t->volume[0],
             //        (vl + vlInc*frameCount)/65536.0f, frameCount);
 
-            do {
-                *out++ += (vl >> 16) * (int32_t) *in++;
-                *out++ += (vr >> 16) * (int32_t) *in++;
-                vl += vlInc;
-                vr += vrInc;
-            } while (--frameCount);
+            accumulateRampStereo16(out, in, frameCount, &vl, &vr, vlInc, vrInc);
+            in += frameCount * 2;
 
             t->prevVolume[0] = vl;
             t->prevVolume[1] = vr;
@@ -944,14 +941,8 @@ void AudioMixer::track__16BitsStereo(track_t* t, int32_t* out, size_t frameCount
 
         // constant gain
         else {
-            const uint32_t vrl = t->volumeRL;
-            do {
-                uint32_t rl = *reinterpret_cast<const uint32_t *>(in);
-                in += 2;
-                out[0] = mulAddRL(1, rl, vrl, out[0]);
-                out[1] = mulAddRL(0, rl, vrl, out[1]);
-                out += 2;
-            } while (--frameCount);
+            accumulateStereo16(out, in, frameCount, t->volume[0], t->volume[1]);
+            in += frameCount * 2;
         }
     }
     t->in = in;
@@ -1030,14 +1021,8 @@ void AudioMixer::track__16BitsMono(track_t* t, int32_t* out, size_t frameCount,
         }
         // constant gain
         else {
-            const int16_t vl = t->volume[0];
-            const int16_t vr = t->volume[1];
-            do {
-                int16_t l = *in++;
-                out[0] = mulAdd(l, vl, out[0]);
-                out[1] = mulAdd(l, vr, out[1]);
-                out += 2;
-            } while (--frameCount);
+            accumulateMono16(out, in, frameCount, t->volume[0], t->volume[1]);
+            in += frameCount;
         }
     }
     t->in = in;
@@ -1171,7 +1156,7 @@ void AudioMixer::process__genericNoResampling(state_t* state, int64_t pts)
                     }
                 }
             }
-            ditherAndClamp(out, outTemp, BLOCKSIZE);
+            clampStereo16(out, outTemp, BLOCKSIZE);
             out += BLOCKSIZE;
             numFrames += BLOCKSIZE;
         } while (numFrames < state->frameCount);
@@ -1253,7 +1238,7 @@ void AudioMixer::process__genericResampling(state_t* state, int64_t pts)
                 }
             }
         }
-        ditherAndClamp(out, outTemp, numFrames);
+        clampStereo16(out, outTemp, numFrames);
     }
 }
 
@@ -1276,7 +1261,9 @@ void AudioMixer::process__OneTrack16BitsStereoNoResampling(state_t* state,
 
     const int16_t vl = t.volume[0];
     const int16_t vr = t.volume[1];
+#if !defined(AUDIO_MIXER_NEON) && !defined(AUDIO_MIXER_SSE2)
     const uint32_t vrl = t.volumeRL;
+#endif
     while (numFrames) {
         b.frameCount = numFrames;
         int64_t outputPTS = calculateOutputPTS(t, pts, out - t.mainBuffer);
@@ -1293,6 +1280,11 @@ void AudioMixer::process__OneTrack16BitsStereoNoResampling(state_t* state,
         }
         size_t outFrames = b.frameCount;
 
+#if defined(AUDIO_MIXER_NEON) || defined(AUDIO_MIXER_SSE2)
+        // the vector kernel always clamps, which is free there
+        scaleStereo16(out, in, outFrames, vl, vr);
+        out += outFrames;
+#else
         if (CC_UNLIKELY(uint32_t(vl) > UNITY_GAIN || uint32_t(vr) > UNITY_GAIN)) {
             // volume is boosted, so we might need to clamp even though
             // we process only one track.
@@ -1315,6 +1307,7 @@ void AudioMixer::process__OneTrack16BitsStereoNoResampling(state_t* state,
                 *out++ = (r<<16) | (l & 0xFFFF);
             } while (--outFrames);
         }
+#endif
         numFrames -= b.frameCount;
         t.bufferProvider->releaseBuffer(&b);
     }
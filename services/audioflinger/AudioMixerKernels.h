@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_MIXER_KERNELS_H
+#define ANDROID_AUDIO_MIXER_KERNELS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <audio_utils/primitives.h>
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AUDIO_MIXER_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define AUDIO_MIXER_SSE2 1
+#endif
+
+namespace android {
+
+// ----------------------------------------------------------------------------
+
+// Inner loops of the AudioMixer track hooks. The mix bus is int32_t with
+// 12 fractional bits (volumes are 3.12 fixed point), so the only saturation
+// happens once per output buffer in clampStereo16().
+//
+// Each kernel processes as many frames as possible with NEON or SSE2 when
+// the target is built with them, and finishes with the scalar loop that the
+// hooks used before.  Results are bit-exact with the scalar code.
+
+// out[2i] += in[2i] * vl, out[2i+1] += in[2i+1] * vr
+static inline void accumulateStereo16(int32_t* out, const int16_t* in,
+        size_t frameCount, int16_t vl, int16_t vr)
+{
+#if defined(AUDIO_MIXER_NEON)
+    const int16_t volume[4] = { vl, vr, vl, vr };
+    const int16x4_t v = vld1_s16(volume);
+    for (; frameCount >= 4; frameCount -= 4) {
+        int16x8_t s = vld1q_s16(in);
+        int32x4_t o0 = vld1q_s32(out);
+        int32x4_t o1 = vld1q_s32(out + 4);
+        o0 = vmlal_s16(o0, vget_low_s16(s), v);
+        o1 = vmlal_s16(o1, vget_high_s16(s), v);
+        vst1q_s32(out, o0);
+        vst1q_s32(out + 4, o1);
+        in += 8;
+        out += 8;
+    }
+#elif defined(AUDIO_MIXER_SSE2)
+    const __m128i v = _mm_set_epi16(vr, vl, vr, vl, vr, vl, vr, vl);
+    for (; frameCount >= 4; frameCount -= 4) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+        __m128i lo = _mm_mullo_epi16(s, v);
+        __m128i hi = _mm_mulhi_epi16(s, v);
+        __m128i* o = reinterpret_cast<__m128i*>(out);
+        _mm_storeu_si128(o, _mm_add_epi32(_mm_loadu_si128(o),
+                _mm_unpacklo_epi16(lo, hi)));
+        _mm_storeu_si128(o + 1, _mm_add_epi32(_mm_loadu_si128(o + 1),
+                _mm_unpackhi_epi16(lo, hi)));
+        in += 8;
+        out += 8;
+    }
+#endif
+    for (; frameCount > 0; frameCount--) {
+        out[0] += in[0] * vl;
+        out[1] += in[1] * vr;
+        in += 2;
+        out += 2;
+    }
+}
+
+// out[2i] += in[i] * vl, out[2i+1] += in[i] * vr
+static inline void accumulateMono16(int32_t* out, const int16_t* in,
+        size_t frameCount, int16_t vl, int16_t vr)
+{
+#if defined(AUDIO_MIXER_NEON)
+    const int16_t volume[4] = { vl, vr, vl, vr };
+    const int16x4_t v = vld1_s16(volume);
+    for (; frameCount >= 4; frameCount -= 4) {
+        int16x4_t m = vld1_s16(in);
+        int16x4x2_t s = vzip_s16(m, m);
+        int32x4_t o0 = vld1q_s32(out);
+        int32x4_t o1 = vld1q_s32(out + 4);
+        o0 = vmlal_s16(o0, s.val[0], v);
+        o1 = vmlal_s16(o1, s.val[1], v);
+        vst1q_s32(out, o0);
+        vst1q_s32(out + 4, o1);
+        in += 4;
+        out += 8;
+    }
+#elif defined(AUDIO_MIXER_SSE2)
+    const __m128i v = _mm_set_epi16(vr, vl, vr, vl, vr, vl, vr, vl);
+    for (; frameCount >= 4; frameCount -= 4) {
+        __m128i m = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in));
+        __m128i s = _mm_unpacklo_epi16(m, m);
+        __m128i lo = _mm_mullo_epi16(s, v);
+        __m128i hi = _mm_mulhi_epi16(s, v);
+        __m128i* o = reinterpret_cast<__m128i*>(out);
+        _mm_storeu_si128(o, _mm_add_epi32(_mm_loadu_si128(o),
+                _mm_unpacklo_epi16(lo, hi)));
+        _mm_storeu_si128(o + 1, _mm_add_epi32(_mm_loadu_si128(o + 1),
+                _mm_unpackhi_epi16(lo, hi)));
+        in += 4;
+        out += 8;
+    }
+#endif
+    for (; frameCount > 0; frameCount--) {
+        int32_t l = *in++;
+        out[0] += l * vl;
+        out[1] += l * vr;
+        out += 2;
+    }
+}
+
+// Volume ramp, *vl and *vr are 3.28 and advance by vlInc and vrInc per frame.
+// out[2i] += (vl >> 16) * in[2i], out[2i+1] += (vr >> 16) * in[2i+1]
+static inline void accumulateRampStereo16(int32_t* out, const int16_t* in,
+        size_t frameCount, int32_t* vl, int32_t* vr,
+        int32_t vlInc, int32_t vrInc)
+{
+    int32_t l = *vl;
+    int32_t r = *vr;
+#if defined(AUDIO_MIXER_NEON) || defined(AUDIO_MIXER_SSE2)
+    // two frames per iteration, the volumes wrap exactly like the scalar
+    // loop since all arithmetic is modulo 2^32.
+    const size_t vectorFrames = frameCount & ~1;
+    if (vectorFrames > 0) {
+        const int32_t volume[4] = {
+            l, r, int32_t(uint32_t(l) + uint32_t(vlInc)),
+            int32_t(uint32_t(r) + uint32_t(vrInc)) };
+        const int32_t increment[4] = {
+            int32_t(uint32_t(vlInc) * 2), int32_t(uint32_t(vrInc) * 2),
+            int32_t(uint32_t(vlInc) * 2), int32_t(uint32_t(vrInc) * 2) };
+#if defined(AUDIO_MIXER_NEON)
+        int32x4_t v = vld1q_s32(volume);
+        const int32x4_t inc = vld1q_s32(increment);
+        for (size_t i = 0; i < vectorFrames; i += 2) {
+            int32x4_t s = vmovl_s16(vld1_s16(in));
+            int32x4_t o = vld1q_s32(out);
+            o = vmlaq_s32(o, vshrq_n_s32(v, 16), s);
+            vst1q_s32(out, o);
+            v = vaddq_s32(v, inc);
+            in += 4;
+            out += 4;
+        }
+#else
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(volume));
+        const __m128i inc =
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(increment));
+        for (size_t i = 0; i < vectorFrames; i += 2) {
+            // the integer part of a ramping volume always fits in 16 bits
+            __m128i g = _mm_srai_epi32(v, 16);
+            g = _mm_packs_epi32(g, g);
+            __m128i s = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in));
+            __m128i p = _mm_unpacklo_epi16(
+                    _mm_mullo_epi16(s, g), _mm_mulhi_epi16(s, g));
+            __m128i* o = reinterpret_cast<__m128i*>(out);
+            _mm_storeu_si128(o, _mm_add_epi32(_mm_loadu_si128(o), p));
+            v = _mm_add_epi32(v, inc);
+            in += 4;
+            out += 4;
+        }
+#endif
+        l = int32_t(uint32_t(l) + uint32_t(vlInc) * vectorFrames);
+        r = int32_t(uint32_t(r) + uint32_t(vrInc) * vectorFrames);
+        frameCount -= vectorFrames;
+    }
+#endif
+    for (; frameCount > 0; frameCount--) {
+        *out++ += (l >> 16) * (int32_t) *in++;
+        *out++ += (r >> 16) * (int32_t) *in++;
+        l += vlInc;
+        r += vrInc;
+    }
+    *vl = l;
+    *vr = r;
+}
+
+// Converts the mix bus to interleaved 16-bit stereo, same as
+// ditherAndClamp(): out = clamp16(sums >> 12) for each sample.
+static inline void clampStereo16(int32_t* out, const int32_t* sums,
+        size_t frameCount)
+{
+    int16_t* dst = reinterpret_cast<int16_t*>(out);
+#if defined(AUDIO_MIXER_NEON)
+    for (; frameCount >= 4; frameCount -= 4) {
+        int16x4_t lo = vqshrn_n_s32(vld1q_s32(sums), 12);
+        int16x4_t hi = vqshrn_n_s32(vld1q_s32(sums + 4), 12);
+        vst1q_s16(dst, vcombine_s16(lo, hi));
+        sums += 8;
+        dst += 8;
+    }
+#elif defined(AUDIO_MIXER_SSE2)
+    for (; frameCount >= 4; frameCount -= 4) {
+        const __m128i* s = reinterpret_cast<const __m128i*>(sums);
+        __m128i lo = _mm_srai_epi32(_mm_loadu_si128(s), 12);
+        __m128i hi = _mm_srai_epi32(_mm_loadu_si128(s + 1), 12);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+                _mm_packs_epi32(lo, hi));
+        sums += 8;
+        dst += 8;
+    }
+#endif
+    for (; frameCount > 0; frameCount--) {
+        int32_t l = *sums++ >> 12;
+        int32_t r = *sums++ >> 12;
+        *dst++ = int16_t(clamp16(l));
+        *dst++ = int16_t(clamp16(r));
+    }
+}
+
+// Single track fast path: out = clamp16((in * volume) >> 12). When the
+// volume is at most unity the clamp never triggers, so this matches both
+// the boosted and the unboosted loops of the one track hook.
+static inline void scaleStereo16(int32_t* out, const int16_t* in,
+        size_t frameCount, int16_t vl, int16_t vr)
+{
+    int16_t* dst = reinterpret_cast<int16_t*>(out);
+#if defined(AUDIO_MIXER_NEON)
+    const int16_t volume[4] = { vl, vr, vl, vr };
+    const int16x4_t v = vld1_s16(volume);
+    for (; frameCount >= 4; frameCount -= 4) {
+        int16x8_t s = vld1q_s16(in);
+        int16x4_t lo = vqshrn_n_s32(vmull_s16(vget_low_s16(s), v), 12);
+        int16x4_t hi = vqshrn_n_s32(vmull_s16(vget_high_s16(s), v), 12);
+        vst1q_s16(dst, vcombine_s16(lo, hi));
+        in += 8;
+        dst += 8;
+    }
+#elif defined(AUDIO_MIXER_SSE2)
+    const __m128i v = _mm_set_epi16(vr, vl, vr, vl, vr, vl, vr, vl);
+    for (; frameCount >= 4; frameCount -= 4) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+        __m128i plo = _mm_mullo_epi16(s, v);
+        __m128i phi = _mm_mulhi_epi16(s, v);
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(plo, phi), 12);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(plo, phi), 12);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+                _mm_packs_epi32(lo, hi));
+        in += 8;
+        dst += 8;
+    }
+#endif
+    for (; frameCount > 0; frameCount--) {
+        int32_t l = (in[0] * vl) >> 12;
+        int32_t r = (in[1] * vr) >> 12;
+        *dst++ = int16_t(clamp16(l));
+        *dst++ = int16_t(clamp16(r));
+        in += 2;
+    }
+}
+
+// ----------------------------------------------------------------------------
+}; // namespace android
+
+#endif // ANDROID_AUDIO_MIXER_KERNELS_H
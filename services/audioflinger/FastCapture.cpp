@@ -0,0 +1,467 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "FastCapture"
+//#define LOG_NDEBUG 0
+
+#include <sys/atomics.h>
+#include <time.h>
+#include <cutils/atomic.h>
+#include <utils/Log.h>
+#include <utils/Trace.h>
+#include <media/AudioBufferProvider.h>
+#ifdef FAST_CAPTURE_STATISTICS
+#include <cpustats/CentralTendencyStatistics.h>
+#endif
+#include "FastCapture.h"
+
+#define FAST_HOT_IDLE_NS     1000000L   // 1 ms: time to sleep while hot idling
+#define FAST_DEFAULT_NS    999999999L   // ~1 sec: default time to sleep
+
+namespace android {
+
+// Fast capture thread
+bool FastCapture::threadLoop()
+{
+    static const FastCaptureState initial;
+    const FastCaptureState *current = &initial;
+    struct timespec oldTs = {0, 0};
+    bool oldTsValid = false;
+    long sleepNs = -1;  // -1: busy wait, 0: sched_yield, > 0: nanosleep
+    NBAIO_Source *inputSource = NULL;
+    int inputSourceGen = 0;
+    NBAIO_Sink *pipeSink = NULL;
+    int pipeSinkGen = 0;
+    char *readBuffer = NULL;
+    size_t readBufferFrames = 0;    // number of frames in readBuffer not yet written to pipeSink
+    NBAIO_Format format = Format_Invalid;
+    unsigned sampleRate = 0;
+    size_t frameCount = 0;
+    long periodNs = 0;      // expected period; the time required to capture one read buffer
+    long overrunNs = 0;     // overrun likely when read cycle is greater than this value
+    FastCaptureDumpState dummyDumpState, *dumpState = &dummyDumpState;
+    bool ignoreNextOverrun = true;  // used to ignore the first cycle after a (re-)start
+#ifdef FAST_CAPTURE_STATISTICS
+    struct timespec oldLoad = {0, 0};    // previous value of clock_gettime(CLOCK_THREAD_CPUTIME_ID)
+    bool oldLoadValid = false;  // whether oldLoad is valid
+    uint32_t bounds = 0;
+    bool full = false;      // whether we have collected at least kSamplingN samples
+#endif
+    unsigned coldGen = 0;   // last observed mColdGen
+
+    for (;;) {
+
+        // either nanosleep, sched_yield, or busy wait
+        if (sleepNs >= 0) {
+            if (sleepNs > 0) {
+                ALOG_ASSERT(sleepNs < 1000000000);
+                const struct timespec req = {0, sleepNs};
+                nanosleep(&req, NULL);
+            } else {
+                sched_yield();
+            }
+        }
+        // default to long sleep for next cycle
+        sleepNs = FAST_DEFAULT_NS;
+
+        // poll for state change
+        const FastCaptureState *next = mSQ.poll();
+        if (next == NULL) {
+            // continue to use the default initial state until a real state is available
+            ALOG_ASSERT(current == &initial);
+            next = current;
+        }
+
+        FastCaptureState::Command command = next->mCommand;
+        if (next != current) {
+            // As soon as possible of learning of a new dump area, start using it
+            dumpState = next->mDumpState != NULL ? next->mDumpState : &dummyDumpState;
+            // Unlike the fast mixer we never diff against the previous state; everything we
+            // need from it is cached in locals, so there is no need to preserve it over idle.
+            if (!(current->mCommand & FastCaptureState::IDLE) &&
+                    (command & FastCaptureState::IDLE)) {
+                oldTsValid = false;
+#ifdef FAST_CAPTURE_STATISTICS
+                oldLoadValid = false;
+#endif
+                ignoreNextOverrun = true;
+            }
+            current = next;
+        }
+#if !LOG_NDEBUG
+        next = NULL;    // not referenced again
+#endif
+
+        dumpState->mCommand = command;
+
+        switch (command) {
+        case FastCaptureState::INITIAL:
+        case FastCaptureState::HOT_IDLE:
+            sleepNs = FAST_HOT_IDLE_NS;
+            continue;
+        case FastCaptureState::COLD_IDLE:
+            // only perform a cold idle command once
+            if (current->mColdGen != coldGen) {
+                int32_t *coldFutexAddr = current->mColdFutexAddr;
+                ALOG_ASSERT(coldFutexAddr != NULL);
+                int32_t old = android_atomic_dec(coldFutexAddr);
+                if (old <= 0) {
+                    __futex_syscall4(coldFutexAddr, FUTEX_WAIT_PRIVATE, old - 1, NULL);
+                }
+                // anything left over from before the idle is stale by now
+                readBufferFrames = 0;
+                sleepNs = -1;
+                coldGen = current->mColdGen;
+#ifdef FAST_CAPTURE_STATISTICS
+                bounds = 0;
+                full = false;
+#endif
+                oldTsValid = !clock_gettime(CLOCK_MONOTONIC, &oldTs);
+            } else {
+                sleepNs = FAST_HOT_IDLE_NS;
+            }
+            continue;
+        case FastCaptureState::EXIT:
+            delete[] readBuffer;
+            return false;
+        case FastCaptureState::READ:
+        case FastCaptureState::WRITE:
+        case FastCaptureState::READ_WRITE:
+            break;
+        default:
+            LOG_FATAL("bad command %d", command);
+        }
+
+        // there is a non-idle state available to us; did the configuration change?
+        NBAIO_Format previousFormat = format;
+        if (current->mInputSourceGen != inputSourceGen) {
+            inputSource = current->mInputSource;
+            inputSourceGen = current->mInputSourceGen;
+            if (inputSource == NULL) {
+                format = Format_Invalid;
+                sampleRate = 0;
+            } else {
+                format = inputSource->format();
+                sampleRate = Format_sampleRate(format);
+            }
+            dumpState->mSampleRate = sampleRate;
+        }
+
+        if (current->mPipeSinkGen != pipeSinkGen) {
+            pipeSink = current->mPipeSink;
+            pipeSinkGen = current->mPipeSinkGen;
+            ALOG_ASSERT(pipeSink == NULL || pipeSink->format() == format);
+        }
+
+        if ((format != previousFormat) || (current->mFrameCount != frameCount)) {
+            frameCount = current->mFrameCount;
+            // FIXME to avoid priority inversion, don't delete here
+            delete[] readBuffer;
+            readBuffer = NULL;
+            readBufferFrames = 0;
+            if (frameCount > 0 && sampleRate > 0) {
+                // FIXME new may block for unbounded time at internal mutex of the heap
+                //       implementation; it would be better to have RecordThread allocate for us
+                readBuffer = new char[frameCount * Format_frameSize(format)];
+                periodNs = (frameCount * 1000000000LL) / sampleRate;    // 1.00
+                overrunNs = (frameCount * 1750000000LL) / sampleRate;   // 1.75
+            } else {
+                periodNs = 0;
+                overrunNs = 0;
+            }
+            dumpState->mFrameCount = frameCount;
+        }
+
+        // do work using current state here
+        bool attemptedRead = false;
+        bool readFailed = false;
+        if ((command & FastCaptureState::READ) && (inputSource != NULL) && (readBuffer != NULL)) {
+            // read() blocks in the HAL until a buffer is available, which paces this loop
+            dumpState->mReadSequence++;
+#if defined(ATRACE_TAG) && (ATRACE_TAG != ATRACE_TAG_NEVER)
+            Tracer::traceBegin(ATRACE_TAG, "read");
+#endif
+            ssize_t framesRead = inputSource->read(readBuffer, frameCount,
+                    AudioBufferProvider::kInvalidPTS);
+#if defined(ATRACE_TAG) && (ATRACE_TAG != ATRACE_TAG_NEVER)
+            Tracer::traceEnd(ATRACE_TAG);
+#endif
+            dumpState->mReadSequence++;
+            if (framesRead >= 0) {
+                ALOG_ASSERT((size_t) framesRead <= frameCount);
+                dumpState->mFramesRead += framesRead;
+                readBufferFrames = framesRead;
+            } else {
+                dumpState->mLastReadError = (status_t) framesRead;
+                android_atomic_release_store(dumpState->mReadErrors + 1,
+                        (int32_t *) &dumpState->mReadErrors);
+                readBufferFrames = 0;
+                readFailed = true;
+            }
+            attemptedRead = true;
+        }
+
+        ssize_t framesWritten = 0;
+        if ((command & FastCaptureState::WRITE) && (pipeSink != NULL) && (readBufferFrames > 0)) {
+            // write() to a Pipe is non-blocking and lock-free; slow readers overrun on their own
+            framesWritten = pipeSink->write(readBuffer, readBufferFrames);
+            if (framesWritten > 0) {
+                dumpState->mFramesWritten += framesWritten;
+            }
+            readBufferFrames = 0;
+        }
+
+        // wake RecordThread if it is waiting for these frames, or for the error
+        int32_t *readFutexAddr = current->mReadFutexAddr;
+        if (readFutexAddr != NULL && (framesWritten > 0 || readFailed)) {
+            android_atomic_inc(readFutexAddr);
+            __futex_syscall3(readFutexAddr, FUTEX_WAKE_PRIVATE, 1);
+        }
+
+        if (!attemptedRead || readFailed) {
+            // Nothing blocked in the HAL to pace the loop, so sleep for a period instead;
+            // don't spin at SCHED_FIFO on a HAL that fails without blocking.
+            sleepNs = periodNs > 0 ? periodNs : FAST_HOT_IDLE_NS;
+            ignoreNextOverrun = true;
+            continue;
+        }
+        sleepNs = -1;
+
+        // The HAL read paces the loop.  A cycle that takes much longer than one period means
+        // that we were preempted or the HAL stalled, and the input buffer has likely overrun.
+        struct timespec newTs;
+        int rc = clock_gettime(CLOCK_MONOTONIC, &newTs);
+        if (rc == 0) {
+            if (oldTsValid) {
+                time_t sec = newTs.tv_sec - oldTs.tv_sec;
+                long nsec = newTs.tv_nsec - oldTs.tv_nsec;
+                ALOGE_IF(sec < 0 || (sec == 0 && nsec < 0),
+                        "clock_gettime(CLOCK_MONOTONIC) failed: was %ld.%09ld but now %ld.%09ld",
+                        oldTs.tv_sec, oldTs.tv_nsec, newTs.tv_sec, newTs.tv_nsec);
+                if (nsec < 0) {
+                    --sec;
+                    nsec += 1000000000;
+                }
+                if (sec > 0 || nsec > overrunNs) {
+                    if (ignoreNextOverrun) {
+                        ignoreNextOverrun = false;
+                    } else {
+#if defined(ATRACE_TAG) && (ATRACE_TAG != ATRACE_TAG_NEVER)
+                        ScopedTrace st(ATRACE_TAG, "overrun");
+#endif
+                        // FIXME only log occasionally
+                        ALOGV("overrun: time since last cycle %d.%03ld sec",
+                                (int) sec, nsec / 1000000L);
+                        dumpState->mOverruns++;
+                    }
+                } else {
+                    ignoreNextOverrun = false;
+                }
+#ifdef FAST_CAPTURE_STATISTICS
+                // advance the FIFO queue bounds
+                size_t i = bounds & (FastCaptureDumpState::kSamplingN - 1);
+                bounds = (bounds & 0xFFFF0000) | ((bounds + 1) & 0xFFFF);
+                if (full) {
+                    bounds += 0x10000;
+                } else if (!(bounds & (FastCaptureDumpState::kSamplingN - 1))) {
+                    full = true;
+                }
+                // compute the delta value of clock_gettime(CLOCK_MONOTONIC)
+                uint32_t monotonicNs = nsec;
+                if (sec > 0 && sec < 4) {
+                    monotonicNs += sec * 1000000000;
+                }
+                // compute the raw CPU load = delta value of clock_gettime(CLOCK_THREAD_CPUTIME_ID)
+                uint32_t loadNs = 0;
+                struct timespec newLoad;
+                rc = clock_gettime(CLOCK_THREAD_CPUTIME_ID, &newLoad);
+                if (rc == 0) {
+                    if (oldLoadValid) {
+                        sec = newLoad.tv_sec - oldLoad.tv_sec;
+                        nsec = newLoad.tv_nsec - oldLoad.tv_nsec;
+                        if (nsec < 0) {
+                            --sec;
+                            nsec += 1000000000;
+                        }
+                        loadNs = nsec;
+                        if (sec > 0 && sec < 4) {
+                            loadNs += sec * 1000000000;
+                        }
+                    } else {
+                        // first time through the loop
+                        oldLoadValid = true;
+                    }
+                    oldLoad = newLoad;
+                }
+                // save values in FIFO queues for dumpsys
+                // these stores #1, #2 are not atomic with respect to each other,
+                // or with respect to store #3 below
+                dumpState->mMonotonicNs[i] = monotonicNs;
+                dumpState->mLoadNs[i] = loadNs;
+                // this store #3 is not atomic with respect to stores #1, #2 above, but
+                // the newest open and oldest closed halves are atomic with respect to each other
+                dumpState->mBounds = bounds;
+#if defined(ATRACE_TAG) && (ATRACE_TAG != ATRACE_TAG_NEVER)
+                ATRACE_INT("cycle_ms", monotonicNs / 1000000);
+                ATRACE_INT("load_us", loadNs / 1000);
+#endif
+#endif
+            } else {
+                // first time through the loop
+                oldTsValid = true;
+                ignoreNextOverrun = true;
+            }
+            oldTs = newTs;
+        } else {
+            // monotonic clock is broken
+            oldTsValid = false;
+        }
+
+    }   // for (;;)
+
+    // never return 'true'; Thread::_threadLoop() locks mutex which can result in priority inversion
+}
+
+FastCaptureDumpState::FastCaptureDumpState() :
+    mCommand(FastCaptureState::INITIAL), mReadSequence(0), mFramesRead(0), mReadErrors(0),
+    mLastReadError(OK), mFramesWritten(0), mOverruns(0), mSampleRate(0), mFrameCount(0)
+#ifdef FAST_CAPTURE_STATISTICS
+    , mBounds(0)
+#endif
+{
+#ifdef FAST_CAPTURE_STATISTICS
+    // sample arrays aren't accessed atomically with respect to the bounds,
+    // so clearing reduces chance for dumpsys to read random uninitialized samples
+    memset(&mMonotonicNs, 0, sizeof(mMonotonicNs));
+    memset(&mLoadNs, 0, sizeof(mLoadNs));
+#endif
+}
+
+FastCaptureDumpState::~FastCaptureDumpState()
+{
+}
+
+#ifdef FAST_CAPTURE_STATISTICS
+// helper function called by qsort()
+static int compare_uint32_t(const void *pa, const void *pb)
+{
+    uint32_t a = *(const uint32_t *)pa;
+    uint32_t b = *(const uint32_t *)pb;
+    if (a < b) {
+        return -1;
+    } else if (a > b) {
+        return 1;
+    } else {
+        return 0;
+    }
+}
+#endif
+
+void FastCaptureDumpState::dump(int fd)
+{
+    if (mCommand == FastCaptureState::INITIAL) {
+        fdprintf(fd, "FastCapture not initialized\n");
+        return;
+    }
+#define COMMAND_MAX 32
+    char string[COMMAND_MAX];
+    switch (mCommand) {
+    case FastCaptureState::INITIAL:
+        strcpy(string, "INITIAL");
+        break;
+    case FastCaptureState::HOT_IDLE:
+        strcpy(string, "HOT_IDLE");
+        break;
+    case FastCaptureState::COLD_IDLE:
+        strcpy(string, "COLD_IDLE");
+        break;
+    case FastCaptureState::EXIT:
+        strcpy(string, "EXIT");
+        break;
+    case FastCaptureState::READ:
+        strcpy(string, "READ");
+        break;
+    case FastCaptureState::WRITE:
+        strcpy(string, "WRITE");
+        break;
+    case FastCaptureState::READ_WRITE:
+        strcpy(string, "READ_WRITE");
+        break;
+    default:
+        snprintf(string, COMMAND_MAX, "%d", mCommand);
+        break;
+    }
+    double readPeriodSec = (double) mFrameCount / (double) mSampleRate;
+    fdprintf(fd, "FastCapture command=%s readSequence=%u framesRead=%u framesWritten=%u\n"
+                 "            readErrors=%u overruns=%u\n"
+                 "            sampleRate=%u frameCount=%u readPeriod=%.2f ms\n",
+                 string, mReadSequence, mFramesRead, mFramesWritten,
+                 mReadErrors, mOverruns,
+                 mSampleRate, mFrameCount, readPeriodSec * 1e3);
+#ifdef FAST_CAPTURE_STATISTICS
+    // find the interval of valid samples
+    uint32_t bounds = mBounds;
+    uint32_t newestOpen = bounds & 0xFFFF;
+    uint32_t oldestClosed = bounds >> 16;
+    uint32_t n = (newestOpen - oldestClosed) & 0xFFFF;
+    if (n > kSamplingN) {
+        ALOGE("too many samples %u", n);
+        n = kSamplingN;
+    }
+    // statistics for monotonic (wall clock) time and thread raw CPU load in time
+    CentralTendencyStatistics wall, loadNs;
+    // as for the fast mixer, each tail is 1/1000 of the sample set, or about three stddev
+    static const uint32_t kTailDenominator = 1000;
+    uint32_t *tail = n >= kTailDenominator ? new uint32_t[n] : NULL;
+    // loop over all the samples
+    for (uint32_t j = 0; j < n; ++j) {
+        size_t i = oldestClosed++ & (kSamplingN - 1);
+        uint32_t wallNs = mMonotonicNs[i];
+        if (tail != NULL) {
+            tail[j] = wallNs;
+        }
+        wall.sample(wallNs);
+        loadNs.sample(mLoadNs[i]);
+    }
+    fdprintf(fd, "Simple moving statistics over last %.1f seconds:\n", wall.n() * readPeriodSec);
+    fdprintf(fd, "  wall clock time in ms per read cycle:\n"
+                 "    mean=%.2f min=%.2f max=%.2f stddev=%.2f\n",
+                 wall.mean()*1e-6, wall.minimum()*1e-6, wall.maximum()*1e-6, wall.stddev()*1e-6);
+    fdprintf(fd, "  raw CPU load in us per read cycle:\n"
+                 "    mean=%.0f min=%.0f max=%.0f stddev=%.0f\n",
+                 loadNs.mean()*1e-3, loadNs.minimum()*1e-3, loadNs.maximum()*1e-3,
+                 loadNs.stddev()*1e-3);
+    if (tail != NULL) {
+        qsort(tail, n, sizeof(uint32_t), compare_uint32_t);
+        // assume same number of tail samples on each side, left and right
+        uint32_t count = n / kTailDenominator;
+        CentralTendencyStatistics left, right;
+        for (uint32_t i = 0; i < count; ++i) {
+            left.sample(tail[i]);
+            right.sample(tail[n - (i + 1)]);
+        }
+        fdprintf(fd, "Distribution of read cycle times in ms for the tails (> ~3 stddev outliers):\n"
+                     "  left tail: mean=%.2f min=%.2f max=%.2f stddev=%.2f\n"
+                     "  right tail: mean=%.2f min=%.2f max=%.2f stddev=%.2f\n",
+                     left.mean()*1e-6, left.minimum()*1e-6, left.maximum()*1e-6, left.stddev()*1e-6,
+                     right.mean()*1e-6, right.minimum()*1e-6, right.maximum()*1e-6,
+                     right.stddev()*1e-6);
+        delete[] tail;
+    }
+#endif
+}
+
+}   // namespace android
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_FAST_CAPTURE_H
+#define ANDROID_AUDIO_FAST_CAPTURE_H
+
+#include <utils/Debug.h>
+#include <utils/Thread.h>
+extern "C" {
+#include "../private/bionic_futex.h"
+}
+#include "StateQueue.h"
+#include "FastCaptureState.h"
+
+namespace android {
+
+typedef StateQueue<FastCaptureState> FastCaptureStateQueue;
+
+// The fast capture thread reads the input HAL at SCHED_FIFO priority, and writes what it reads
+// to a non-blocking pipe.  RecordThread and any other clients each consume the pipe through
+// their own PipeReader, so a slow reader can't stall the HAL reads.
+class FastCapture : public Thread {
+
+public:
+            FastCapture() : Thread(false /*canCallJava*/) { }
+    virtual ~FastCapture() { }
+
+            FastCaptureStateQueue* sq() { return &mSQ; }
+
+private:
+    virtual bool                threadLoop();
+            FastCaptureStateQueue mSQ;
+
+};  // class FastCapture
+
+// The FastCaptureDumpState keeps a cache of FastCapture statistics that can be logged by dumpsys.
+// The same rules apply as for FastMixerDumpState: each native word-sized field is accessed
+// atomically, the overall structure is not, and only POD types are permitted.
+struct FastCaptureDumpState {
+    FastCaptureDumpState();
+    /*virtual*/ ~FastCaptureDumpState();
+
+    void dump(int fd);          // should only be called on a stable copy, not the original
+
+    FastCaptureState::Command mCommand; // current command
+    uint32_t mReadSequence;     // incremented before and after each read()
+    uint32_t mFramesRead;       // total number of frames read successfully
+    uint32_t mReadErrors;       // total number of read() errors
+    status_t mLastReadError;    // status of the most recent failed read(), set before mReadErrors
+    uint32_t mFramesWritten;    // total number of frames written to the pipe
+    uint32_t mOverruns;         // total number of late cycles, input was likely lost
+    uint32_t mSampleRate;
+    size_t   mFrameCount;
+
+#ifdef FAST_CAPTURE_STATISTICS
+    // Recently collected samples of per-cycle monotonic time and thread CPU time,
+    // using the same sampling frame and bounds representation as FastMixerDumpState.
+    static const uint32_t kSamplingN = 0x1000;
+    uint32_t mBounds;                   // bounds for mMonotonicNs and mLoadNs
+    uint32_t mMonotonicNs[kSamplingN];  // delta monotonic (wall clock) time
+    uint32_t mLoadNs[kSamplingN];       // delta CPU load in time
+#endif
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_FAST_CAPTURE_H
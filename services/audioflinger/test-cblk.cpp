@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Streams small buffers through an audio_track_cblk_t shared between two
+// processes, the way an AudioTrack feeds a mixer thread, and measures how
+// long the client takes to wake up after each server step.
+
+#include <private/media/AudioTrackShared.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <math.h>
+#include <new>
+
+using namespace android;
+
+// Lives in the shared mapping right after the control block.
+struct Shared {
+    volatile int64_t mStepNs;       // when the server last stepped
+    volatile int32_t mDone;
+    int32_t mUnderruns;
+    int64_t mStepCostNs;
+    int64_t mMaxStepCostNs;
+};
+
+static int64_t now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-p frames] [-b periods] [-n iterations] [-r rate] [-c]\n", name);
+    fprintf(stderr, "    -p    frames per period (default 64)\n");
+    fprintf(stderr, "    -b    buffer size in periods (default 2)\n");
+    fprintf(stderr, "    -n    number of periods (default 2000)\n");
+    fprintf(stderr, "    -r    sample rate (default 48000)\n");
+    fprintf(stderr, "    -c    wait on the cblk mutex and condition instead of the futex\n");
+    return -1;
+}
+
+// Consumes a period at a fixed rate, like a mixer thread.
+static void server(audio_track_cblk_t* cblk, Shared* shared, uint32_t period,
+        int iterations, int64_t periodNs, bool useCondition) {
+    timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (int i = 0; i < iterations; i++) {
+        next.tv_nsec += periodNs;
+        while (next.tv_nsec >= 1000000000) {
+            next.tv_nsec -= 1000000000;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+        if (cblk->framesReady() < period) {
+            shared->mUnderruns++;
+            continue;
+        }
+        int64_t start = now_ns();
+        shared->mStepNs = start;
+        if (useCondition) {
+            cblk->lock.lock();
+            cblk->stepServer(period);
+            cblk->cv.signal();
+            cblk->lock.unlock();
+        } else {
+            cblk->stepServer(period);
+        }
+        int64_t cost = now_ns() - start;
+        shared->mStepCostNs += cost;
+        if (cost > shared->mMaxStepCostNs) {
+            shared->mMaxStepCostNs = cost;
+        }
+    }
+    android_atomic_release_store(1, &shared->mDone);
+    cblk->lock.lock();
+    cblk->cv.signal();
+    cblk->lock.unlock();
+    cblk->wake();
+}
+
+// Refills the buffer each time the server frees a period, and returns the number of wake up
+// latencies stored in latencies.
+static int client(audio_track_cblk_t* cblk, Shared* shared, uint32_t period,
+        int64_t* latencies, int maxLatencies, bool useCondition) {
+    int count = 0;
+    while (!android_atomic_acquire_load(&shared->mDone)) {
+        bool waited = false;
+        if (useCondition) {
+            cblk->lock.lock();
+            while (cblk->framesAvailable_l() < period && !shared->mDone) {
+                cblk->cv.waitRelative(cblk->lock, milliseconds(WAIT_PERIOD_MS));
+                waited = true;
+            }
+            cblk->lock.unlock();
+        } else {
+            while (cblk->framesAvailable() < period && !shared->mDone) {
+                int32_t sequence = cblk->prepareWaitServer();
+                if (cblk->framesAvailable() >= period || shared->mDone) {
+                    break;
+                }
+                cblk->waitServer(sequence, WAIT_PERIOD_MS);
+                waited = true;
+            }
+        }
+        if (shared->mDone) {
+            break;
+        }
+        if (waited && count < maxLatencies) {
+            latencies[count++] = now_ns() - shared->mStepNs;
+        }
+        memset(cblk->buffer(cblk->user), 0, period * cblk->frameSize);
+        cblk->stepUser(period);
+    }
+    return count;
+}
+
+static int compare(const void* a, const void* b) {
+    int64_t x = *(const int64_t*) a;
+    int64_t y = *(const int64_t*) b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    const char* const progname = argv[0];
+    uint32_t period = 64;
+    uint32_t periods = 2;
+    int iterations = 2000;
+    uint32_t sampleRate = 48000;
+    bool useCondition = false;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "p:b:n:r:c")) != -1) {
+        switch (ch) {
+        case 'p':
+            period = atoi(optarg);
+            break;
+        case 'b':
+            periods = atoi(optarg);
+            break;
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        case 'r':
+            sampleRate = atoi(optarg);
+            break;
+        case 'c':
+            useCondition = true;
+            break;
+        default:
+            usage(progname);
+            return -1;
+        }
+    }
+    if (period == 0 || periods < 2 || iterations <= 0 || sampleRate == 0) {
+        return usage(progname);
+    }
+
+    const size_t frameSize = 4;     // stereo 16 bit
+    const uint32_t frameCount = period * periods;
+    const size_t size = sizeof(audio_track_cblk_t) + sizeof(Shared) + frameCount * frameSize;
+    void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+
+    audio_track_cblk_t* cblk = new(base) audio_track_cblk_t();
+    Shared* shared = new(cblk + 1) Shared();
+    cblk->buffers = (char*) (shared + 1);
+    cblk->frameCount = frameCount;
+    cblk->frameSize = frameSize;
+    cblk->sampleRate = sampleRate;
+    cblk->bufferTimeoutMs = MAX_RUN_TIMEOUT_MS;
+    cblk->flags = CBLK_DIRECTION_OUT;
+
+    // start with a full buffer, so that the client always waits for the server
+    cblk->stepUser(frameCount);
+
+    const int64_t periodNs = (int64_t) period * 1000000000LL / sampleRate;
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (pid == 0) {
+        server(cblk, shared, period, iterations, periodNs, useCondition);
+        _exit(0);
+    }
+
+    int64_t* latencies = new int64_t[iterations];
+    int count = client(cblk, shared, period, latencies, iterations, useCondition);
+    waitpid(pid, NULL, 0);
+
+    if (count == 0) {
+        fprintf(stderr, "the client never waited\n");
+        return 1;
+    }
+    double mean = 0;
+    for (int i = 0; i < count; i++) {
+        mean += latencies[i];
+    }
+    mean /= count;
+    double variance = 0;
+    for (int i = 0; i < count; i++) {
+        variance += (latencies[i] - mean) * (latencies[i] - mean);
+    }
+    qsort(latencies, count, sizeof(int64_t), compare);
+
+    printf("%s wait, %u frame periods (%.3f ms), %u periods buffered\n",
+            useCondition ? "mutex/condition" : "futex", period, periodNs / 1E6, periods);
+    printf("wake up latency over %d periods: mean %.1f us, jitter %.1f us, "
+            "min %.1f us, 99%% %.1f us, max %.1f us\n",
+            count, mean / 1E3, sqrt(variance / count) / 1E3, latencies[0] / 1E3,
+            latencies[count * 99 / 100] / 1E3, latencies[count - 1] / 1E3);
+    int steps = iterations - shared->mUnderruns;
+    printf("server step cost: mean %.2f us, max %.2f us, underruns %d\n",
+            steps ? shared->mStepCostNs / 1E3 / steps : 0, shared->mMaxStepCostNs / 1E3,
+            shared->mUnderruns);
+
+    delete[] latencies;
+    munmap(base, size);
+    return 0;
+}
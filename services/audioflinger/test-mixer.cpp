@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the CPU cost of AudioMixer::process() per mixed track, and
+// checks the vector mixer kernels against the scalar loops they replace.
+
+#include "AudioMixer.h"
+#include "AudioMixerKernels.h"
+#include <media/AudioBufferProvider.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <math.h>
+
+using namespace android;
+
+// Loops over a short sine wave forever.
+class SineProvider : public AudioBufferProvider {
+public:
+    SineProvider(int channels, float frequency, uint32_t sampleRate)
+        : mChannels(channels), mFrames(4096), mPosition(0) {
+        mData = new int16_t[mFrames * 2 * mChannels];
+        for (size_t i = 0; i < mFrames * 2; i++) {
+            int16_t s = (int16_t)(32767 * sin(2 * M_PI * frequency * i / sampleRate));
+            for (int c = 0; c < mChannels; c++) {
+                mData[i * mChannels + c] = s;
+            }
+        }
+    }
+
+    virtual ~SineProvider() {
+        delete[] mData;
+    }
+
+    virtual status_t getNextBuffer(Buffer* buffer, int64_t pts) {
+        size_t count = buffer->frameCount;
+        if (count > mFrames) {
+            count = mFrames;
+        }
+        buffer->frameCount = count;
+        buffer->i16 = mData + mPosition * mChannels;
+        return NO_ERROR;
+    }
+
+    virtual void releaseBuffer(Buffer* buffer) {
+        mPosition = (mPosition + buffer->frameCount) % mFrames;
+        buffer->frameCount = 0;
+        buffer->raw = NULL;
+    }
+
+private:
+    const int mChannels;
+    const size_t mFrames;
+    size_t mPosition;
+    int16_t* mData;
+};
+
+static int64_t now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-t tracks] [-f frames] [-n iterations] [-m] [-r]\n", name);
+    fprintf(stderr, "    -t    number of mixed tracks (default 8)\n");
+    fprintf(stderr, "    -f    frames per mix buffer (default 1024)\n");
+    fprintf(stderr, "    -n    number of mix buffers (default 2000)\n");
+    fprintf(stderr, "    -m    mono tracks\n");
+    fprintf(stderr, "    -r    ramp volume on every buffer\n");
+    return -1;
+}
+
+static bool checkKernels() {
+    const size_t frames = 1027;   // not a multiple of the vector width
+    int16_t* in = new int16_t[frames * 2];
+    int32_t* a = new int32_t[frames * 2];
+    int32_t* b = new int32_t[frames * 2];
+    int32_t* outA = new int32_t[frames];
+    int32_t* outB = new int32_t[frames];
+    bool ok = true;
+
+    srand(1);
+    for (size_t i = 0; i < frames * 2; i++) {
+        in[i] = (int16_t)(rand() & 0xFFFF);
+        a[i] = b[i] = (rand() & 0xFFFFF) - 0x80000;
+    }
+
+    const int16_t vl = 0x1234;
+    const int16_t vr = 0x0987;
+    accumulateStereo16(a, in, frames, vl, vr);
+    accumulateMono16(a, in, frames, vr, vl);
+    for (size_t i = 0; i < frames; i++) {
+        b[2 * i] += in[2 * i] * vl;
+        b[2 * i + 1] += in[2 * i + 1] * vr;
+    }
+    for (size_t i = 0; i < frames; i++) {
+        b[2 * i] += in[i] * vr;
+        b[2 * i + 1] += in[i] * vl;
+    }
+    if (memcmp(a, b, frames * 2 * sizeof(int32_t))) {
+        fprintf(stderr, "accumulate kernels mismatch\n");
+        ok = false;
+    }
+
+    int32_t l = 0x0100 << 16, r = 0x1000 << 16;
+    const int32_t lInc = 0x00003456, rInc = -0x00001234;
+    accumulateRampStereo16(a, in, frames, &l, &r, lInc, rInc);
+    int32_t sl = 0x0100 << 16, sr = 0x1000 << 16;
+    for (size_t i = 0; i < frames; i++) {
+        b[2 * i] += (sl >> 16) * in[2 * i];
+        b[2 * i + 1] += (sr >> 16) * in[2 * i + 1];
+        sl += lInc;
+        sr += rInc;
+    }
+    if (memcmp(a, b, frames * 2 * sizeof(int32_t)) || l != sl || r != sr) {
+        fprintf(stderr, "ramp kernel mismatch\n");
+        ok = false;
+    }
+
+    clampStereo16(outA, a, frames);
+    ditherAndClamp(outB, b, frames);
+    if (memcmp(outA, outB, frames * sizeof(int32_t))) {
+        fprintf(stderr, "clamp kernel mismatch\n");
+        ok = false;
+    }
+
+    scaleStereo16(outA, in, frames, 0x1800, 0x0800);
+    for (size_t i = 0; i < frames; i++) {
+        int32_t sl = clamp16((in[2 * i] * 0x1800) >> 12);
+        int32_t sr = clamp16((in[2 * i + 1] * 0x0800) >> 12);
+        outB[i] = (sr << 16) | (sl & 0xFFFF);
+    }
+    if (memcmp(outA, outB, frames * sizeof(int32_t))) {
+        fprintf(stderr, "scale kernel mismatch\n");
+        ok = false;
+    }
+
+    delete[] in;
+    delete[] a;
+    delete[] b;
+    delete[] outA;
+    delete[] outB;
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    const char* const progname = argv[0];
+    int numTracks = 8;
+    size_t frameCount = 1024;
+    int iterations = 2000;
+    bool mono = false;
+    bool ramp = false;
+    const uint32_t sampleRate = 44100;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "t:f:n:mr")) != -1) {
+        switch (ch) {
+        case 't':
+            numTracks = atoi(optarg);
+            break;
+        case 'f':
+            frameCount = atoi(optarg);
+            break;
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        case 'm':
+            mono = true;
+            break;
+        case 'r':
+            ramp = true;
+            break;
+        default:
+            usage(progname);
+            return -1;
+        }
+    }
+    if (numTracks < 1 || numTracks > (int)AudioMixer::MAX_NUM_TRACKS
+            || frameCount == 0 || iterations < 1) {
+        usage(progname);
+        return -1;
+    }
+
+    if (!checkKernels()) {
+        return 1;
+    }
+
+#if defined(AUDIO_MIXER_NEON)
+    const char* kernels = "neon";
+#elif defined(AUDIO_MIXER_SSE2)
+    const char* kernels = "sse2";
+#else
+    const char* kernels = "scalar";
+#endif
+
+    AudioMixer* mixer = new AudioMixer(frameCount, sampleRate);
+    int32_t* mixBuffer = new int32_t[frameCount];
+    SineProvider** providers = new SineProvider*[numTracks];
+    int* names = new int[numTracks];
+    const audio_channel_mask_t mask =
+            mono ? AUDIO_CHANNEL_OUT_MONO : AUDIO_CHANNEL_OUT_STEREO;
+
+    for (int i = 0; i < numTracks; i++) {
+        providers[i] = new SineProvider(mono ? 1 : 2, 220.0f * (i + 1), sampleRate);
+        names[i] = mixer->getTrackName(mask, 0);
+        if (names[i] < 0) {
+            fprintf(stderr, "getTrackName failed\n");
+            return 1;
+        }
+        mixer->setBufferProvider(names[i], providers[i]);
+        mixer->setParameter(names[i], AudioMixer::TRACK, AudioMixer::MAIN_BUFFER,
+                mixBuffer);
+        mixer->setParameter(names[i], AudioMixer::TRACK, AudioMixer::CHANNEL_MASK,
+                (void *)mask);
+        mixer->setParameter(names[i], AudioMixer::VOLUME, AudioMixer::VOLUME0,
+                (void *)(AudioMixer::UNITY_GAIN / numTracks));
+        mixer->setParameter(names[i], AudioMixer::VOLUME, AudioMixer::VOLUME1,
+                (void *)(AudioMixer::UNITY_GAIN / numTracks));
+        mixer->enable(names[i]);
+    }
+
+    int64_t total = 0;
+    for (int n = 0; n < iterations; n++) {
+        if (ramp) {
+            // alternate between two levels so that every buffer ramps
+            int volume = (n & 1) ? AudioMixer::UNITY_GAIN / numTracks
+                                 : AudioMixer::UNITY_GAIN / (2 * numTracks);
+            for (int i = 0; i < numTracks; i++) {
+                mixer->setParameter(names[i], AudioMixer::RAMP_VOLUME,
+                        AudioMixer::VOLUME0, (void *)volume);
+                mixer->setParameter(names[i], AudioMixer::RAMP_VOLUME,
+                        AudioMixer::VOLUME1, (void *)volume);
+            }
+        }
+        int64_t start = now_ns();
+        mixer->process(AudioBufferProvider::kInvalidPTS);
+        total += now_ns() - start;
+    }
+
+    double trackFrames = (double)numTracks * frameCount * iterations;
+    printf("%s kernels, %d %s tracks%s, %u frames per buffer\n", kernels,
+            numTracks, mono ? "mono" : "stereo", ramp ? " (ramping)" : "",
+            frameCount);
+    printf("%.2f ns per track frame, %.2f%% of one CPU per track at %u Hz\n",
+            total / trackFrames,
+            100.0 * total / trackFrames * sampleRate / 1e9, sampleRate);
+
+    for (int i = 0; i < numTracks; i++) {
+        mixer->disable(names[i]);
+        mixer->deleteTrackName(names[i]);
+        delete providers[i];
+    }
+    delete mixer;
+    delete[] mixBuffer;
+    delete[] providers;
+    delete[] names;
+    return 0;
+}